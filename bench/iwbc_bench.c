@@ -0,0 +1,388 @@
+/*
+ * Front-end throughput benchmark for IWBC
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * Writes a synthetic program shaped by its options and times the lexer
+ * (lexer_next_token), the parser (parser_parse), the IR generator
+ * (generator_generate) and a whole compile to bitcode (iwbc_compile) on
+ * it, reporting the best of several runs as MB/s, tokens/s and AST
+ * nodes/s. The parser pulls its tokens from the lexer, so its time
+ * includes lexing; the table also shows it with the lexer's taken out.
+ *
+ *   iwbc_bench [--statements N] [--depth D] [--ident-length L]
+ *              [--strings PERCENT] [--runs R] [--seed S] [--write FILE]
+ *   iwbc_bench [--runs R] <program.iwb>
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+#include "parser.h"
+#include "generator.h"
+#include "iwbc.h"
+#include "phase.h"
+
+// Statements per synthetic FUNCTION, so no one function grows huge
+#define BENCH_FUNCTION_STATEMENTS 100
+
+// Numeric and string variables each FUNCTION works on
+#define BENCH_VARIABLES 16
+
+typedef struct {
+    long statements;        // total statements in FUNCTION bodies
+    int depth;              // depth of each numeric expression tree
+    int ident_length;       // characters in every variable name
+    int strings;            // percent of statements that build strings
+    int runs;
+    uint64_t seed;
+} ProgramShape;
+
+typedef struct {
+    char* text;
+    size_t length;
+    size_t capacity;
+} Buffer;
+
+static void append(Buffer* buffer, const char* format, ...) {
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(buffer->text + buffer->length, buffer->capacity - buffer->length, format, args);
+        va_end(args);
+        if (buffer->length + (size_t)n < buffer->capacity) {
+            buffer->length += (size_t)n;
+            return;
+        }
+        buffer->capacity = buffer->capacity * 2 + (size_t)n + 1;
+        buffer->text = realloc(buffer->text, buffer->capacity);
+    }
+}
+
+// xorshift64*, so a seed always gives the same program
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+static int random_below(uint64_t* state, int limit) {
+    return (int)(next_random(state) % (uint64_t)limit);
+}
+
+// A variable name of exactly length characters (longer when the index
+// needs it): the kind letter, the index, then padding
+static void variable(Buffer* buffer, char kind, int index, int length) {
+    int written = snprintf(NULL, 0, "%c%d", kind, index);
+    append(buffer, "%c%d", kind, index);
+    for (int i = written; i < length; i++) {
+        append(buffer, "x");
+    }
+}
+
+static void expression(Buffer* buffer, const ProgramShape* shape, uint64_t* state, int depth) {
+    if (depth == 0) {
+        if (random_below(state, 3) == 0) {
+            append(buffer, "%d", random_below(state, 1000));
+        } else {
+            variable(buffer, 'v', random_below(state, BENCH_VARIABLES), shape->ident_length);
+        }
+        return;
+    }
+    static const char* const operators[] = { "+", "-", "*" };
+    bool grouped = depth < shape->depth;
+    if (grouped) append(buffer, "(");
+    expression(buffer, shape, state, depth - 1);
+    append(buffer, " %s ", operators[random_below(state, 3)]);
+    expression(buffer, shape, state, depth - 1);
+    if (grouped) append(buffer, ")");
+}
+
+static void string_statement(Buffer* buffer, const ProgramShape* shape, uint64_t* state, const char* indent) {
+    append(buffer, "%sLET ", indent);
+    variable(buffer, 's', random_below(state, BENCH_VARIABLES), shape->ident_length);
+    append(buffer, " = ");
+    variable(buffer, 's', random_below(state, BENCH_VARIABLES), shape->ident_length);
+    append(buffer, " + \"");
+    int length = 4 + random_below(state, 28);
+    for (int i = 0; i < length; i++) {
+        append(buffer, "%c", 'a' + random_below(state, 26));
+    }
+    append(buffer, "\" + ");
+    variable(buffer, 'v', random_below(state, BENCH_VARIABLES), shape->ident_length);
+    append(buffer, "\n");
+}
+
+static void numeric_statement(Buffer* buffer, const ProgramShape* shape, uint64_t* state, const char* indent) {
+    append(buffer, "%sLET ", indent);
+    variable(buffer, 'v', random_below(state, BENCH_VARIABLES), shape->ident_length);
+    append(buffer, " = ");
+    expression(buffer, shape, state, shape->depth);
+    append(buffer, "\n");
+}
+
+static void statement(Buffer* buffer, const ProgramShape* shape, uint64_t* state, const char* indent) {
+    if (random_below(state, 100) < shape->strings) {
+        string_statement(buffer, shape, state, indent);
+    } else {
+        numeric_statement(buffer, shape, state, indent);
+    }
+}
+
+// FUNCTIONs of BENCH_FUNCTION_STATEMENTS statements each, some of them
+// inside IF and FOR blocks, and a main that calls every one
+static char* generate_program(const ProgramShape* shape, size_t* length) {
+    Buffer buffer = { malloc(1 << 16), 0, 1 << 16 };
+    uint64_t state = shape->seed ? shape->seed : 1;
+    long functions = (shape->statements + BENCH_FUNCTION_STATEMENTS - 1) / BENCH_FUNCTION_STATEMENTS;
+    long remaining = shape->statements;
+    for (long f = 0; f < functions; f++) {
+        append(&buffer, "FUNCTION g%ld(a, b)\n", f);
+        for (int v = 0; v < BENCH_VARIABLES; v++) {
+            append(&buffer, "    LET ");
+            variable(&buffer, 'v', v, shape->ident_length);
+            append(&buffer, " = a + %d\n", v);
+            append(&buffer, "    LET ");
+            variable(&buffer, 's', v, shape->ident_length);
+            append(&buffer, " = \"\"\n");
+        }
+        long count = remaining < BENCH_FUNCTION_STATEMENTS ? remaining : BENCH_FUNCTION_STATEMENTS;
+        remaining -= count;
+        for (long i = 0; i < count;) {
+            int block = random_below(&state, 10);
+            if (block == 0 && count - i > 4) {
+                append(&buffer, "    IF ");
+                variable(&buffer, 'v', random_below(&state, BENCH_VARIABLES), shape->ident_length);
+                append(&buffer, " < b THEN\n");
+                for (int j = 0; j < 3; j++) statement(&buffer, shape, &state, "        ");
+                append(&buffer, "    ENDIF\n");
+                i += 3;
+            } else if (block == 1 && count - i > 4) {
+                append(&buffer, "    FOR k = 1 TO b\n");
+                for (int j = 0; j < 3; j++) statement(&buffer, shape, &state, "        ");
+                append(&buffer, "    NEXT k\n");
+                i += 3;
+            } else {
+                statement(&buffer, shape, &state, "    ");
+                i++;
+            }
+        }
+        append(&buffer, "    RETURN ");
+        variable(&buffer, 'v', 0, shape->ident_length);
+        append(&buffer, "\nEND\n");
+    }
+    for (long f = 0; f < functions; f++) {
+        append(&buffer, "PRINT g%ld(%ld, 3)\n", f, f);
+    }
+    *length = buffer.length;
+    return buffer.text;
+}
+
+static char* read_program(const char* filename, size_t* length) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open file %s\n", filename);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = malloc(size + 1);
+    *length = fread(text, 1, size, file);
+    text[*length] = '\0';
+    fclose(file);
+    return text;
+}
+
+static double lex(const char* source, long* tokens) {
+    double start = phase_seconds(CLOCK_MONOTONIC);
+    Lexer* lexer = lexer_create_in_place(source, NULL);
+    *tokens = 0;
+    for (;;) {
+        Token* token = lexer_next_token(lexer);
+        bool end = token->type == TOKEN_EOF;
+        free(token->value);
+        free(token);
+        if (end) break;
+        (*tokens)++;
+    }
+    lexer_destroy(lexer);
+    return phase_seconds(CLOCK_MONOTONIC) - start;
+}
+
+// The AST of source, or NULL when it does not parse; seconds is the
+// time parser_parse took
+static ASTNode* parse(const char* source, double* seconds) {
+    Lexer* lexer = lexer_create_in_place(source, NULL);
+    Parser* parser = parser_create(lexer);
+    double start = phase_seconds(CLOCK_MONOTONIC);
+    ASTNode* ast = parser_parse(parser);
+    *seconds = phase_seconds(CLOCK_MONOTONIC) - start;
+    if (parser->failed) {
+        ast_destroy(ast);
+        ast = NULL;
+    }
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    return ast;
+}
+
+static double generate(ASTNode* ast, bool* ok) {
+    Generator* gen = generator_create("iwbasic_module");
+    double start = phase_seconds(CLOCK_MONOTONIC);
+    generator_generate(gen, ast);
+    double seconds = phase_seconds(CLOCK_MONOTONIC) - start;
+    *ok = gen->error_count == 0;
+    generator_destroy(gen);
+    return seconds;
+}
+
+static double compile(const char* source, size_t length, bool* ok) {
+    double start = phase_seconds(CLOCK_MONOTONIC);
+    IwbcResult* result = iwbc_compile(source, length, IWBC_OUTPUT_BITCODE, NULL);
+    double seconds = phase_seconds(CLOCK_MONOTONIC) - start;
+    *ok = iwbc_result_ok(result);
+    iwbc_result_destroy(result);
+    return seconds;
+}
+
+static long count_nodes(const ASTNode* node) {
+    long count = 1;
+    for (int i = 0; i < node->children_count; i++) {
+        count += count_nodes(node->children[i]);
+    }
+    return count;
+}
+
+static void report(const char* stage, double seconds, size_t bytes, long tokens, long nodes) {
+    if (seconds <= 0) {
+        printf("  %-14s %10.3f %10s %12s %12s\n", stage, 0.0, "-", "-", "-");
+        return;
+    }
+    printf("  %-14s %10.3f %10.2f %12.2f %12.2f\n", stage, seconds * 1e3, bytes / seconds / 1e6,
+           tokens / seconds / 1e6, nodes / seconds / 1e6);
+}
+
+static double best(double a, double b) {
+    return a < b ? a : b;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [options] [program.iwb]\n", program);
+    fprintf(stderr, "Times lexing, parsing, IR generation and a whole compile to bitcode of\n");
+    fprintf(stderr, "program.iwb, or of a synthetic program shaped by:\n");
+    fprintf(stderr, "  --statements N         statements in the program (default 20000)\n");
+    fprintf(stderr, "  --depth D              depth of each arithmetic expression (default 4)\n");
+    fprintf(stderr, "  --ident-length L       characters in each variable name (default 8)\n");
+    fprintf(stderr, "  --strings PERCENT      share of statements that build strings (default 20)\n");
+    fprintf(stderr, "  --seed S               seed for the program's random choices (default 1)\n");
+    fprintf(stderr, "  --write FILE           write the synthetic program to FILE and stop\n");
+    fprintf(stderr, "  --runs R               report the best of R runs (default 5)\n");
+}
+
+static bool number_option(int argc, char* argv[], int* i, const char* name, long minimum, long maximum,
+                          long* value) {
+    if (strcmp(argv[*i], name) != 0) return false;
+    char* end = NULL;
+    *value = *i + 1 < argc ? strtol(argv[++*i], &end, 10) : minimum - 1;
+    if (!end || *end || *value < minimum || *value > maximum) {
+        fprintf(stderr, "Error: %s needs a number from %ld to %ld\n", name, minimum, maximum);
+        exit(1);
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    ProgramShape shape = { 20000, 4, 8, 20, 5, 1 };
+    const char* input = NULL;
+    const char* write_to = NULL;
+    for (int i = 1; i < argc; i++) {
+        long value;
+        if (number_option(argc, argv, &i, "--statements", 1, 100000000, &value)) {
+            shape.statements = value;
+        } else if (number_option(argc, argv, &i, "--depth", 0, 16, &value)) {
+            shape.depth = (int)value;
+        } else if (number_option(argc, argv, &i, "--ident-length", 1, 255, &value)) {
+            shape.ident_length = (int)value;
+        } else if (number_option(argc, argv, &i, "--strings", 0, 100, &value)) {
+            shape.strings = (int)value;
+        } else if (number_option(argc, argv, &i, "--runs", 1, 1000, &value)) {
+            shape.runs = (int)value;
+        } else if (number_option(argc, argv, &i, "--seed", 1, INT64_MAX, &value)) {
+            shape.seed = (uint64_t)value;
+        } else if (strcmp(argv[i], "--write") == 0 && i + 1 < argc) {
+            write_to = argv[++i];
+        } else if (argv[i][0] == '-' || input) {
+            usage(argv[0]);
+            return 1;
+        } else {
+            input = argv[i];
+        }
+    }
+
+    size_t length;
+    char* source = input ? read_program(input, &length) : generate_program(&shape, &length);
+    if (!source) return 1;
+    if (write_to) {
+        FILE* file = fopen(write_to, "w");
+        if (!file || fwrite(source, 1, length, file) != length || fclose(file) != 0) {
+            fprintf(stderr, "Error: Could not write %s\n", write_to);
+            return 1;
+        }
+        free(source);
+        return 0;
+    }
+
+    long tokens = 0;
+    double lex_time = lex(source, &tokens);
+    double parse_time;
+    ASTNode* ast = parse(source, &parse_time);
+    if (!ast) {
+        fprintf(stderr, "Error: The program does not parse\n");
+        free(source);
+        return 1;
+    }
+    long nodes = count_nodes(ast);
+    bool generated;
+    double generate_time = generate(ast, &generated);
+    bool compiled;
+    double compile_time = compile(source, length, &compiled);
+    if (!generated || !compiled) {
+        fprintf(stderr, "Error: The program does not compile\n");
+        ast_destroy(ast);
+        free(source);
+        return 1;
+    }
+    for (int run = 1; run < shape.runs; run++) {
+        long ignored;
+        double seconds;
+        lex_time = best(lex_time, lex(source, &ignored));
+        ast_destroy(parse(source, &seconds));
+        parse_time = best(parse_time, seconds);
+        generate_time = best(generate_time, generate(ast, &generated));
+        compile_time = best(compile_time, compile(source, length, &compiled));
+    }
+
+    if (input) {
+        printf("iwbc_bench: %s", input);
+    } else {
+        printf("iwbc_bench: %ld statements, depth %d, identifiers of %d, %d%% strings",
+               shape.statements, shape.depth, shape.ident_length, shape.strings);
+    }
+    printf(": %.2f MB, %ld tokens, %ld nodes, best of %d\n", length / 1e6, tokens, nodes, shape.runs);
+    printf("  %-14s %10s %10s %12s %12s\n", "stage", "ms", "MB/s", "Mtokens/s", "Mnodes/s");
+    report("lex", lex_time, length, tokens, nodes);
+    report("parse", parse_time, length, tokens, nodes);
+    report("parse - lex", parse_time > lex_time ? parse_time - lex_time : 0, length, tokens, nodes);
+    report("generate", generate_time, length, tokens, nodes);
+    report("end to end", compile_time, length, tokens, nodes);
+
+    ast_destroy(ast);
+    free(source);
+    return 0;
+}
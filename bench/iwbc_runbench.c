@@ -0,0 +1,452 @@
+/*
+ * Runtime benchmark harness for IWBC
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * Runs the kernels in bench/kernels, each a BASIC program (name.iwb)
+ * with a C program that does the same work (name.c). Every kernel is
+ * compiled to a native executable (iwbc -c, linked with the runtime)
+ * and through the JIT, with and without array bounds checks, and run
+ * alongside its C version built with -O2. A build whose output differs
+ * from the C version's fails. Every timed run follows a run of the C
+ * version, and the table gives the median time of several runs and the
+ * median of each run's slowdown against the C run before it, so drift
+ * in the machine's speed over the benchmark cancels out. A slowdown
+ * that grew by more than the threshold over the stored baseline fails.
+ * Ratios rather than times are kept so a baseline carries over between
+ * machines better.
+ *
+ *   iwbc_runbench [--runs N] [--baseline FILE] [--threshold PERCENT]
+ *                 [--write-baseline FILE] [kernel...]
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "iwbc.h"
+#include "phase.h"
+
+#define MAX_KERNELS 64
+#define MAX_BASELINE 512
+
+typedef enum { BACKEND_NATIVE, BACKEND_JIT } Backend;
+
+static const char* const backend_names[] = { "native", "jit" };
+
+typedef struct {
+    char kernel[64];
+    char backend[16];
+    char checks[16];
+    double ratio;
+} BaselineEntry;
+
+typedef struct {
+    BaselineEntry entries[MAX_BASELINE];
+    int count;
+} Baseline;
+
+typedef struct {
+    const char* work;       // scratch directory for builds and outputs
+    int runs;
+    double threshold;       // fraction a slowdown may grow by
+    const Baseline* baseline;
+    FILE* record;           // --write-baseline, or NULL
+    bool failed;
+} Bench;
+
+// The whole file, NUL-terminated, or NULL if it cannot be read
+static char* read_text(const char* path, size_t* length) {
+    *length = 0;
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+    long size = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    char* text = size >= 0 && fseek(file, 0, SEEK_SET) == 0 ? malloc((size_t)size + 1) : NULL;
+    if (text) {
+        *length = fread(text, 1, (size_t)size, file);
+        text[*length] = '\0';
+    }
+    fclose(file);
+    return text;
+}
+
+static bool same_file(const char* a, const char* b) {
+    size_t a_length = 0, b_length = 0;
+    char* a_text = read_text(a, &a_length);
+    char* b_text = read_text(b, &b_length);
+    bool same = a_text && b_text && a_length == b_length && memcmp(a_text, b_text, a_length) == 0;
+    free(a_text);
+    free(b_text);
+    return same;
+}
+
+// Runs argv with its stdout going to output (NULL to leave it alone)
+// and returns its exit status, -1 if it did not run; seconds is the
+// wall time from start to exit
+static int run_program(char* const argv[], const char* output, double* seconds) {
+    fflush(stdout);
+    double start = phase_seconds(CLOCK_MONOTONIC);
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (output) {
+            int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) _exit(127);
+            dup2(fd, STDOUT_FILENO);
+            close(fd);
+        }
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    int status;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid) return -1;
+    if (seconds) *seconds = phase_seconds(CLOCK_MONOTONIC) - start;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// Median time of bench->runs runs, and the median of each one's time
+// over that of the C run just before it; seconds is negative if a run
+// failed
+typedef struct {
+    double seconds;
+    double ratio;
+} Timing;
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double median(double* values, int count) {
+    qsort(values, count, sizeof(double), compare_doubles);
+    return count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+// Collects the runs of one build: times[run] and ratios[run]
+typedef struct {
+    double* times;
+    double* ratios;
+    int count;
+} Runs;
+
+static Runs runs_create(const Bench* bench) {
+    return (Runs){ malloc(bench->runs * sizeof(double)), malloc(bench->runs * sizeof(double)), 0 };
+}
+
+// Runs the C version (reference) ahead of a timed run; false if it failed
+static bool run_reference(char* const reference[], double* seconds) {
+    *seconds = 1;
+    return !reference || run_program(reference, "/dev/null", seconds) == 0;
+}
+
+static void runs_add(Runs* runs, double seconds, double reference_seconds) {
+    runs->times[runs->count] = seconds;
+    runs->ratios[runs->count] = seconds / reference_seconds;
+    runs->count++;
+}
+
+static Timing runs_finish(Runs* runs, bool ok) {
+    Timing timing = { -1, 0 };
+    if (ok && runs->count > 0) {
+        timing.seconds = median(runs->times, runs->count);
+        timing.ratio = median(runs->ratios, runs->count);
+    }
+    free(runs->times);
+    free(runs->ratios);
+    return timing;
+}
+
+// Runs argv once with its output going to output, then bench->runs
+// times, each after a run of reference (NULL for none: the ratio is
+// then the time itself)
+static Timing time_program(const Bench* bench, char* const argv[], const char* output, char* const reference[]) {
+    Runs runs = runs_create(bench);
+    bool ok = run_program(argv, output, NULL) == 0;
+    for (int run = 0; ok && run < bench->runs; run++) {
+        double reference_seconds, seconds;
+        ok = run_reference(reference, &reference_seconds) && run_program(argv, "/dev/null", &seconds) == 0;
+        if (ok) runs_add(&runs, seconds, reference_seconds);
+    }
+    return runs_finish(&runs, ok);
+}
+
+// Compiles and runs source through the JIT bench->runs times plus one
+// whose output goes to output; only the runs themselves are timed, each
+// after a run of reference
+static Timing time_jit(const Bench* bench, const char* source, size_t length, const IwbcOptions* options,
+                       const char* output, char* const reference[]) {
+    Runs runs = runs_create(bench);
+    bool ok = true;
+    for (int run = 0; ok && run <= bench->runs; run++) {
+        IwbcResult* result = iwbc_compile(source, length, IWBC_OUTPUT_JIT, options);
+        if (!iwbc_result_ok(result)) {
+            fputs(iwbc_result_diagnostics(result), stderr);
+            iwbc_result_destroy(result);
+            ok = false;
+            break;
+        }
+        double reference_seconds = 1;
+        if (run > 0 && !run_reference(reference, &reference_seconds)) {
+            iwbc_result_destroy(result);
+            ok = false;
+            break;
+        }
+        int fd = open(run == 0 ? output : "/dev/null", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        fflush(stdout);
+        int own_out = dup(STDOUT_FILENO);
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+        double start = phase_seconds(CLOCK_MONOTONIC);
+        int status = iwbc_result_run(result);
+        double seconds = phase_seconds(CLOCK_MONOTONIC) - start;
+        fflush(stdout);
+        dup2(own_out, STDOUT_FILENO);
+        close(own_out);
+        iwbc_result_destroy(result);
+        ok = status == 0;
+        if (ok && run > 0) runs_add(&runs, seconds, reference_seconds);
+    }
+    return runs_finish(&runs, ok);
+}
+
+// Writes the object file for source to object
+static bool compile_object(const char* source, size_t length, const IwbcOptions* options, const char* object) {
+    IwbcResult* result = iwbc_compile(source, length, IWBC_OUTPUT_OBJECT, options);
+    size_t size = 0;
+    const void* data = iwbc_result_data(result, &size);
+    bool ok = data != NULL;
+    if (ok) {
+        FILE* file = fopen(object, "wb");
+        ok = file && fwrite(data, 1, size, file) == size;
+        if (file && fclose(file) != 0) ok = false;
+    } else {
+        fputs(iwbc_result_diagnostics(result), stderr);
+    }
+    iwbc_result_destroy(result);
+    return ok;
+}
+
+static bool load_baseline(const char* path, Baseline* baseline) {
+    FILE* file = fopen(path, "r");
+    if (!file) return false;
+    char line[256];
+    while (fgets(line, sizeof(line), file) && baseline->count < MAX_BASELINE) {
+        BaselineEntry* entry = &baseline->entries[baseline->count];
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%63s %15s %15s %lf", entry->kernel, entry->backend, entry->checks, &entry->ratio) == 4) {
+            baseline->count++;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static const BaselineEntry* find_baseline(const Baseline* baseline, const char* kernel, const char* backend,
+                                          const char* checks) {
+    for (int i = 0; baseline && i < baseline->count; i++) {
+        const BaselineEntry* entry = &baseline->entries[i];
+        if (strcmp(entry->kernel, kernel) == 0 && strcmp(entry->backend, backend) == 0 &&
+            strcmp(entry->checks, checks) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Prints one row of the table and checks it against the baseline
+static void report(Bench* bench, const char* kernel, const char* backend, const char* checks, Timing timing,
+                   bool right) {
+    printf("  %-12s %-8s %-10s", kernel, backend, checks);
+    if (timing.seconds < 0) {
+        printf(" %10s %8s  failed to build or run\n", "-", "-");
+        bench->failed = true;
+        return;
+    }
+    double ratio = timing.ratio;
+    printf(" %10.1f %7.2fx", timing.seconds * 1e3, ratio);
+    if (!right) {
+        printf("  wrong output\n");
+        bench->failed = true;
+        return;
+    }
+    if (bench->record) fprintf(bench->record, "%s %s %s %.3f\n", kernel, backend, checks, ratio);
+    const BaselineEntry* entry = find_baseline(bench->baseline, kernel, backend, checks);
+    if (!entry) {
+        printf("\n");
+    } else if (ratio > entry->ratio * (1 + bench->threshold)) {
+        printf("  slower than baseline %.2fx\n", entry->ratio);
+        bench->failed = true;
+    } else if (ratio < entry->ratio * (1 - bench->threshold)) {
+        printf("  faster than baseline %.2fx\n", entry->ratio);
+    } else {
+        printf("  baseline %.2fx\n", entry->ratio);
+    }
+}
+
+static void run_kernel(Bench* bench, const char* dir, const char* kernel) {
+    char path[4096], reference_source[4096], reference[4096], expected[4096];
+    snprintf(path, sizeof(path), "%s/%s.iwb", dir, kernel);
+    snprintf(reference_source, sizeof(reference_source), "%s/%s.c", dir, kernel);
+    snprintf(reference, sizeof(reference), "%s/%s.ref", bench->work, kernel);
+    snprintf(expected, sizeof(expected), "%s/%s.expected", bench->work, kernel);
+
+    size_t length;
+    char* source = read_text(path, &length);
+    char* build_reference[] = { BENCH_C_COMPILER, "-O2", "-o", reference, reference_source, NULL };
+    char* const reference_argv[] = { reference, NULL };
+    Timing reference_timing = { -1, 0 };
+    if (source && run_program(build_reference, NULL, NULL) == 0) {
+        reference_timing = time_program(bench, reference_argv, expected, NULL);
+    }
+    printf("  %-12s %-8s %-10s", kernel, "C", "-O2");
+    if (reference_timing.seconds <= 0) {
+        printf(" %10s %8s  failed to build or run\n", "-", "-");
+        bench->failed = true;
+        free(source);
+        return;
+    }
+    printf(" %10.1f %7.2fx\n", reference_timing.seconds * 1e3, 1.0);
+
+    for (int checked = 1; checked >= 0; checked--) {
+        const char* checks = checked ? "checked" : "unchecked";
+        IwbcOptions options;
+        iwbc_options_init(&options);
+        options.bounds_check = checked;
+        options.path = path;
+        for (Backend backend = BACKEND_NATIVE; backend <= BACKEND_JIT; backend++) {
+            char output[4096];
+            snprintf(output, sizeof(output), "%s/%s.%s.%s.out", bench->work, kernel, backend_names[backend], checks);
+            Timing timing = { -1, 0 };
+            if (backend == BACKEND_NATIVE) {
+                char object[4096], executable[4096];
+                snprintf(object, sizeof(object), "%s/%s.%s.o", bench->work, kernel, checks);
+                snprintf(executable, sizeof(executable), "%s/%s.%s", bench->work, kernel, checks);
+                char* link[] = { BENCH_C_COMPILER, "-o", executable, object, BENCH_RUNTIME,
+                                 "-lpthread", "-ldl", "-lm", NULL };
+                if (compile_object(source, length, &options, object) && run_program(link, NULL, NULL) == 0) {
+                    timing = time_program(bench, (char* const[]){ executable, NULL }, output, reference_argv);
+                }
+            } else {
+                timing = time_jit(bench, source, length, &options, output, reference_argv);
+            }
+            report(bench, kernel, backend_names[backend], checks, timing,
+                   timing.seconds >= 0 && same_file(output, expected));
+        }
+    }
+    free(source);
+}
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// The kernels in dir: every name.iwb that has a name.c, sorted
+static int find_kernels(const char* dir, char* names[]) {
+    DIR* listing = opendir(dir);
+    if (!listing) return 0;
+    int count = 0;
+    struct dirent* entry;
+    while ((entry = readdir(listing)) && count < MAX_KERNELS) {
+        size_t length = strlen(entry->d_name);
+        if (length <= 4 || strcmp(entry->d_name + length - 4, ".iwb") != 0) continue;
+        char reference[4096];
+        snprintf(reference, sizeof(reference), "%s/%.*s.c", dir, (int)(length - 4), entry->d_name);
+        if (access(reference, R_OK) != 0) continue;
+        names[count++] = strndup(entry->d_name, length - 4);
+    }
+    closedir(listing);
+    qsort(names, count, sizeof(char*), compare_names);
+    return count;
+}
+
+static int remove_entry(const char* path, const struct stat* info, int flag, struct FTW* walk) {
+    (void)info;
+    (void)flag;
+    (void)walk;
+    return remove(path);
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [options] [kernel...]\n", program);
+    fprintf(stderr, "Runs the kernels of %s natively and through the JIT, with and without\n", BENCH_KERNEL_DIR);
+    fprintf(stderr, "bounds checks, against their C versions. Options:\n");
+    fprintf(stderr, "  --runs N               report the median of N runs (default 5)\n");
+    fprintf(stderr, "  --baseline FILE        compare slowdowns with FILE (default %s)\n", BENCH_BASELINE);
+    fprintf(stderr, "  --threshold PERCENT    fail when a slowdown grew by more (default 50)\n");
+    fprintf(stderr, "  --write-baseline FILE  record this run's slowdowns in FILE\n");
+}
+
+int main(int argc, char* argv[]) {
+    Bench bench = { .runs = 5, .threshold = 0.5 };
+    const char* baseline_path = BENCH_BASELINE;
+    const char* record_path = NULL;
+    char* kernels[MAX_KERNELS];
+    int kernel_count = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            bench.runs = atoi(argv[++i]);
+            if (bench.runs < 1) {
+                fprintf(stderr, "Error: --runs needs a count\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            bench.threshold = atof(argv[++i]) / 100;
+            if (bench.threshold <= 0) {
+                fprintf(stderr, "Error: --threshold needs a percentage\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--write-baseline") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else if (kernel_count < MAX_KERNELS) {
+            kernels[kernel_count++] = strdup(argv[i]);
+        }
+    }
+    if (kernel_count == 0) kernel_count = find_kernels(BENCH_KERNEL_DIR, kernels);
+    if (kernel_count == 0) {
+        fprintf(stderr, "Error: No kernels found in %s\n", BENCH_KERNEL_DIR);
+        return 1;
+    }
+
+    static Baseline baseline;
+    if (load_baseline(baseline_path, &baseline)) {
+        bench.baseline = &baseline;
+    } else if (strcmp(baseline_path, BENCH_BASELINE) != 0) {
+        fprintf(stderr, "Error: Could not read baseline %s\n", baseline_path);
+        return 1;
+    }
+    if (record_path) {
+        bench.record = fopen(record_path, "w");
+        if (!bench.record) {
+            fprintf(stderr, "Error: Could not write %s\n", record_path);
+            return 1;
+        }
+        fprintf(bench.record, "# kernel backend checks slowdown-against-C\n");
+    }
+    char work[] = "/tmp/iwbc_runbench.XXXXXX";
+    if (!mkdtemp(work)) {
+        fprintf(stderr, "Error: Could not create a scratch directory\n");
+        return 1;
+    }
+    bench.work = work;
+
+    printf("iwbc_runbench: median of %d runs, slowdown against C%s\n", bench.runs,
+           bench.baseline ? ", checked against the baseline" : "");
+    printf("  %-12s %-8s %-10s %10s %8s\n", "kernel", "backend", "checks", "ms", "vs C");
+    for (int k = 0; k < kernel_count; k++) {
+        run_kernel(&bench, BENCH_KERNEL_DIR, kernels[k]);
+        free(kernels[k]);
+    }
+
+    if (bench.record) fclose(bench.record);
+    nftw(work, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return bench.failed ? 1 : 0;
+}
@@ -0,0 +1,12 @@
+// Reference for arith.iwb
+#include <stdio.h>
+
+int main(void) {
+    int s = 0;
+    for (int i = 1; i <= 40000000; i++) {
+        s = s + i * 7 - i / 3 * 2;
+        s = s - s / 1000003 * 1000003;
+    }
+    printf("%d\n", s);
+    return 0;
+}
@@ -0,0 +1,27 @@
+// Reference for arrays.iwb
+#include <stdio.h>
+
+static int a[100000];
+
+int main(void) {
+    for (int k = 0; k <= 99999; k++) {
+        a[k] = k - k / 17 * 17;
+    }
+    for (int pass = 1; pass <= 300; pass++) {
+        for (int k = 1; k <= 99999; k++) {
+            a[k] = a[k] + a[k - 1];
+            a[k] = a[k] - a[k] / 65521 * 65521;
+        }
+        for (int k = 0; k <= 99998; k++) {
+            a[k] = a[k] + a[k + 1] * 3;
+            a[k] = a[k] - a[k] / 65521 * 65521;
+        }
+    }
+    int s = 0;
+    for (int k = 0; k <= 99999; k++) {
+        s = s + a[k];
+        s = s - s / 1000003 * 1000003;
+    }
+    printf("%d\n", s);
+    return 0;
+}
@@ -0,0 +1,24 @@
+// Reference for dispatch.iwb
+#include <stdio.h>
+
+int main(void) {
+    int acc = 1;
+    int seed = 12345;
+    for (int i = 1; i <= 20000000; i++) {
+        seed = seed * 1103 + 12345;
+        seed = seed - seed / 1048573 * 1048573;
+        switch (seed - seed / 8 * 8) {
+            case 0: acc = acc + 3; break;
+            case 1: acc = acc * 3; break;
+            case 2: acc = acc - 7; break;
+            case 3: acc = acc / 2; break;
+            case 4: acc = acc + i; break;
+            case 5: acc = acc - i / 4; break;
+            case 6: acc = acc * 5 + 1; break;
+            case 7: acc = acc + seed; break;
+        }
+        acc = acc - acc / 999983 * 999983;
+    }
+    printf("%d\n", acc);
+    return 0;
+}
@@ -0,0 +1,10 @@
+// Reference for print.iwb
+#include <stdio.h>
+
+int main(void) {
+    for (int i = 1; i <= 1000000; i++) {
+        printf("%d\n", i);
+        printf("row\n");
+    }
+    return 0;
+}
@@ -0,0 +1,12 @@
+// Reference for recursion.iwb
+#include <stdio.h>
+
+static int fib(int n) {
+    if (n < 2) return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+int main(void) {
+    printf("%d\n", fib(36));
+    return 0;
+}
@@ -0,0 +1,42 @@
+// Reference for strings.iwb
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char* text;
+    size_t length;
+    size_t capacity;
+} Text;
+
+static void append(Text* t, const char* s, size_t n) {
+    if (t->length + n + 1 > t->capacity) {
+        t->capacity = (t->length + n + 1) * 2;
+        t->text = realloc(t->text, t->capacity);
+    }
+    memcpy(t->text + t->length, s, n);
+    t->length += n;
+    t->text[t->length] = '\0';
+}
+
+int main(void) {
+    int total = 0;
+    char number[16];
+    for (int round = 1; round <= 200; round++) {
+        Text s = { NULL, 0, 0 };
+        for (int i = 1; i <= 2000; i++) {
+            append(&s, "x", 1);
+            append(&s, number, (size_t)snprintf(number, sizeof(number), "%d", i));
+        }
+        Text sb = { NULL, 0, 0 };
+        for (int i = 1; i <= 20000; i++) {
+            append(&sb, number, (size_t)snprintf(number, sizeof(number), "%d", i));
+            append(&sb, ",", 1);
+        }
+        total = total + (int)s.length + (int)sb.length;
+        free(s.text);
+        free(sb.text);
+    }
+    printf("%d\n", total);
+    return 0;
+}
@@ -22,6 +22,28 @@ const char* token_type_to_string(TokenType type) {
         case TOKEN_FUNCTION: return "FUNCTION";
         case TOKEN_RETURN: return "RETURN";
         case TOKEN_END: return "END";
+        case TOKEN_PARALLEL: return "PARALLEL";
+        case TOKEN_REDUCE: return "REDUCE";
+        case TOKEN_SPAWN: return "SPAWN";
+        case TOKEN_AWAIT: return "AWAIT";
+        case TOKEN_CHANNEL: return "CHANNEL";
+        case TOKEN_SEND: return "SEND";
+        case TOKEN_RECEIVE: return "RECEIVE";
+        case TOKEN_YIELD: return "YIELD";
+        case TOKEN_EACH: return "EACH";
+        case TOKEN_IN: return "IN";
+        case TOKEN_STRINGBUILDER: return "STRINGBUILDER";
+        case TOKEN_APPEND: return "APPEND";
+        case TOKEN_DICT: return "DICT";
+        case TOKEN_SORT: return "SORT";
+        case TOKEN_OPEN: return "OPEN";
+        case TOKEN_READLINE: return "READLINE";
+        case TOKEN_WRITELINE: return "WRITELINE";
+        case TOKEN_CLOSE: return "CLOSE";
+        case TOKEN_DBCONNECT: return "DBCONNECT";
+        case TOKEN_DBEXECSQL: return "DBEXECSQL";
+        case TOKEN_DBQUERY: return "DBQUERY";
+        case TOKEN_INCLUDE: return "INCLUDE";
         case TOKEN_EQUALS: return "EQUALS";
         case TOKEN_PLUS: return "PLUS";
         case TOKEN_MINUS: return "MINUS";
@@ -34,6 +56,7 @@ const char* token_type_to_string(TokenType type) {
         case TOKEN_LBRACKET: return "LBRACKET";
         case TOKEN_RBRACKET: return "RBRACKET";
         case TOKEN_COMMA: return "COMMA";
+        case TOKEN_COLON: return "COLON";
         case TOKEN_IDENTIFIER: return "IDENTIFIER";
         case TOKEN_NUMBER: return "NUMBER";
         case TOKEN_STRING: return "STRING";
@@ -0,0 +1,38 @@
+/*
+ * Compilation cache header file
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Hex digits in a cache key
+#define CACHE_KEY_LENGTH 32
+
+typedef struct {
+    const char* dir;
+    uint64_t max_bytes;     // trimmed back to this, least recently used first
+} CompileCache;
+
+// Fills key (CACHE_KEY_LENGTH + 1 chars) from the bytes and directory
+// of input, the compiler build, options and, for object files, the host
+// target. False when input cannot be read.
+bool cache_key(const char* input, const char* options, bool object, char* key);
+
+// Copies the output cached under key to output; false on a miss
+bool cache_fetch(const CompileCache* cache, const char* key, const char* output);
+
+// Adds output to the cache under key, valid while the files the compile
+// read in besides input (its INCLUDEs) keep their content
+void cache_store(const CompileCache* cache, const char* key, const char* output,
+                 char* const* files, int file_count);
+
+// Evicts the least recently used entries until the cache fits
+void cache_trim(const CompileCache* cache);
+
+#endif
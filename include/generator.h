@@ -1,7 +1,7 @@
 /* 
  * Generator header file
  * Created: February 20, 2025 by LHS
- * Last modified: February 27, 2025 by LHS
+ * Last modified: October 19, 2026 by LHS
  *
  */
 
@@ -11,20 +11,140 @@
 #include <llvm-c/Core.h>
 #include <llvm-c/BitWriter.h>
 #include <llvm-c/Analysis.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+#include <stdbool.h>
 #include "parser.h"
+#include "phase.h"
+
+// Every array is aligned to a cache line so the vectorizer can use
+// aligned loads and stores on it
+#define GENERATOR_ARRAY_ALIGN 64
+
+// Arrays of constant size up to this many bytes live on the stack,
+// anything larger or sized at run time is heap allocated
+#define GENERATOR_STACK_ARRAY_LIMIT (16 * 1024)
+
+// Lanes per vector in whole-array statements and reductions; eight i32
+// lanes fill one 256-bit register
+#define GENERATOR_VECTOR_WIDTH 8
+
+// Alignment of the i32 promise a generator YIELDs into; FOR EACH must
+// pass the same value to llvm.coro.promise
+#define GENERATOR_PROMISE_ALIGN 4
+
+typedef struct {
+    char* name;
+    LLVMValueRef value;     // alloca holding the variable
+    LLVMTypeRef type;
+} Variable;
+
+typedef struct {
+    char* name;
+    LLVMValueRef base;      // i32* to element 0, or the i32** slot when on_heap
+    LLVMValueRef* dims;     // extent per dimension: constant, or i32* slot when dynamic
+    int dim_count;
+    bool on_heap;
+    bool dynamic;
+} ArrayInfo;
+
+// Value range of a FOR variable whose bounds are compile-time constants
+// and which the loop body never assigns
+typedef struct {
+    const char* var;
+    long long lo;
+    long long hi;
+} LoopRange;
+
+// Where the time of generator_emit_object goes, filled in when
+// gen->emit_stats is set
+typedef struct {
+    PhaseSample optimize;           // the O2 pipeline; wall time of the slowest partition
+    PhaseSample emit;               // everything else: splitting, instruction selection, the archive
+    long optimized_instructions;    // IR instructions left after optimizing
+} EmitStats;
 
 typedef struct {
+    // Every type and constant belongs to this context, so generators on
+    // different threads share no LLVM state
+    LLVMContextRef context;
     LLVMModuleRef module;
     LLVMBuilderRef builder;
     LLVMValueRef function;
     LLVMBasicBlockRef current_block;
-    LLVMValueRef* variables;
+    Variable* variables;
     int var_count;
+    ArrayInfo* arrays;
+    int array_count;
+    
+    // Bounds checking: on by default, dropped by --no-bounds-check
+    bool bounds_check;
+    
+    // Loops running DBEXECSQL share one transaction: on by default,
+    // dropped by --no-db-batch
+    bool db_batch;
+    bool in_db_batch;           // inside a loop that opened a batch
+    LoopRange* ranges;          // enclosing FOR loops, innermost last
+    int range_count;
+    ASTNode** prechecked;       // subscripts covered by the preheader check of an enclosing FOR
+    int prechecked_count;
+    const char* subst_name;     // while set, reads of this variable yield subst_value
+    LLVMValueRef subst_value;
+    
+    // FUNCTIONs that YIELD are LLVM coroutines; these are set while one
+    // is being emitted
+    LLVMValueRef coro_id;
+    LLVMValueRef coro_handle;
+    LLVMValueRef coro_out;          // the i32 promise YIELD stores each value in
+    LLVMBasicBlockRef coro_final;   // final suspend; RETURN and the end of the body go here
+    LLVMBasicBlockRef coro_cleanup; // frees the frame when the consumer destroys it
+    LLVMBasicBlockRef coro_suspend; // returns the handle to whoever started or resumed it
+    bool has_coroutines;            // run the coroutine lowering passes
+    LLVMValueRef* open_generators;  // handles of the enclosing FOR EACH loops
+    int open_generator_count;
+    
+    // Long strings built by the function being emitted live in its
+    // arena, created on first use and released on every way out
+    LLVMValueRef arena;
+    LLVMValueRef* exits;            // the ret (or last branch) of each way out
+    int exit_count;
+    int arena_uses;                 // get_arena calls so far in the function
+    LLVMValueRef* collects;         // iwbrt_arena_collect calls awaiting their roots
+    int collect_count;
+    // Likewise the list of tasks the function has SPAWNed, which AWAIT
+    // reads results from until the function returns
+    LLVMValueRef tasks;
+    
+    ASTNode* program;               // the whole program, for analyses that look ahead
+    
+    // Statements arrive one at a time (generator_generate_statement) and
+    // there is no program to look ahead in: calls may reach FUNCTIONs
+    // defined further down, which are declared on first use. Only the
+    // AST is given up this way; the module keeps everything emitted.
+    bool streaming;
+    
+    int error_count;                // errors reported so far
+    FILE* diagnostics;              // errors and warnings, stderr by default
+    EmitStats* emit_stats;          // NULL unless the caller measures emission
 } Generator;
 
 Generator* generator_create(const char* module_name);
 void generator_generate(Generator* gen, ASTNode* ast);
-void generator_write_bitcode(Generator* gen, const char* filename);
+// Streaming: emits one top-level statement, which the caller may free
+// afterwards, then finishes main once the last one is in
+void generator_generate_statement(Generator* gen, ASTNode* statement);
+void generator_finish(Generator* gen);
+bool generator_write_bitcode(Generator* gen, const char* filename);
+// Optimizes the module and writes a host object file, split over up to
+// threads partitions that are compiled in parallel (src/codegen.c).
+// More than one partition makes the file an ar archive of their objects.
+bool generator_write_object(Generator* gen, const char* filename, int threads);
+// The same object file in memory; NULL on failure
+LLVMMemoryBufferRef generator_emit_object(Generator* gen, int threads);
+// Sets up the host target for the two above, which otherwise do it on
+// first use
+void generator_initialize_targets(void);
+// IR instructions in the module so far
+long generator_instruction_count(Generator* gen);
 void generator_destroy(Generator* gen);
 
 #endif
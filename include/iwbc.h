@@ -0,0 +1,79 @@
+/*
+ * IWBC library header
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * The compiler as a library: a program held in memory goes in, and
+ * bitcode, an object file or code loaded into the calling process comes
+ * out, with no files and no child processes. Link with -liwbc. Every
+ * compile has its own parser, generator and LLVM context, so any number
+ * may run at once on different threads.
+ *
+ * JIT-compiled programs call the runtime (iwbrt.h) and libc, which are
+ * looked up among the symbols of the process. libiwbc.so carries the
+ * runtime; a program linking libiwbc.a must link all of libiwbrt.a and
+ * export it (-Wl,--whole-archive -liwbrt -Wl,--no-whole-archive
+ * -rdynamic). A program that stops on a runtime error stops the process
+ * it runs in, just as it would stop its own.
+ */
+
+#ifndef IWBC_H
+#define IWBC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum {
+    IWBC_OUTPUT_BITCODE,    // LLVM bitcode, what iwbc writes by default
+    IWBC_OUTPUT_OBJECT,     // optimized host object file, what iwbc -c writes
+    IWBC_OUTPUT_JIT         // optimized and loaded into this process
+} IwbcOutput;
+
+typedef struct {
+    bool bounds_check;      // array bounds checks; on by default
+    bool db_batch;          // DBEXECSQL loops as one transaction; on by default
+    int codegen_threads;    // objects: parts compiled in parallel; 1 by default
+    const char* path;       // name the source goes by: INCLUDE names are
+                            // relative to it; NULL for the working directory
+    FILE* trace;            // the lexer and parser's trace; NULL (the default) for none
+} IwbcOptions;
+
+typedef struct IwbcResult IwbcResult;
+
+// Fills options with the defaults iwbc uses
+void iwbc_options_init(IwbcOptions* options);
+
+// Compiles the length bytes at source (which need not end in a zero).
+// options may be NULL for the defaults. Never returns NULL; see
+// iwbc_result_ok for whether the compile worked.
+IwbcResult* iwbc_compile(const char* source, size_t length, IwbcOutput output,
+                         const IwbcOptions* options);
+
+// True when the program parsed and compiled without errors
+bool iwbc_result_ok(const IwbcResult* result);
+
+// The errors and warnings of the compile, as iwbc would print them;
+// an empty string when there were none
+const char* iwbc_result_diagnostics(const IwbcResult* result);
+
+// Bitcode or object: the bytes, owned by result; NULL if the compile
+// failed or the output was a JIT
+const void* iwbc_result_data(const IwbcResult* result, size_t* size);
+
+// JIT: the address of a global symbol of the program; FUNCTIONs are
+// local to it, so in practice main. NULL when there is none.
+void* iwbc_result_symbol(IwbcResult* result, const char* name);
+
+// JIT: runs the program's main and returns its exit status; -1 if the
+// compile failed
+int iwbc_result_run(IwbcResult* result);
+
+// Frees the output; a JIT's code is unloaded and must not be running
+void iwbc_result_destroy(IwbcResult* result);
+
+// Runs an iwbc command line in this process and returns its exit status
+// (libiwbc.so only: the iwbc executable is a launcher for this)
+int iwbc_command(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * Key hashing shared by the compiler and the runtime
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * The generator hashes string literals used as DICT keys while
+ * compiling and passes the result to the runtime, so both sides must
+ * agree bit for bit. Bytes are assembled in a fixed order rather than
+ * loaded as machine words, which keeps the hash the same on every host.
+ */
+
+#ifndef IWBHASH_H
+#define IWBHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define IWB_HASH_SEED 0x9e3779b97f4a7c15ULL
+#define IWB_HASH_MULTIPLIER 0xff51afd7ed558ccdULL
+
+// Final avalanche (from MurmurHash3): every input bit affects every
+// output bit, so the low bits used for the slot and the high bits used
+// for the control byte are both well spread
+static inline uint64_t iwb_hash_finish(uint64_t h) {
+    h ^= h >> 33;
+    h *= IWB_HASH_MULTIPLIER;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline uint64_t iwb_hash_int(int32_t key) {
+    return iwb_hash_finish((uint64_t)(uint32_t)key ^ IWB_HASH_SEED);
+}
+
+// Eight bytes at a time; compilers turn the loop into one load on
+// little-endian targets
+static inline uint64_t iwb_hash_bytes(const char* data, size_t length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t h = IWB_HASH_SEED ^ (length * IWB_HASH_MULTIPLIER);
+    while (length > 0) {
+        size_t take = length < 8 ? length : 8;
+        uint64_t word = 0;
+        for (size_t i = 0; i < take; i++) {
+            word |= (uint64_t)bytes[i] << (8 * i);
+        }
+        h = (h ^ iwb_hash_finish(word)) * IWB_HASH_MULTIPLIER;
+        h = (h << 31) | (h >> 33);
+        bytes += take;
+        length -= take;
+    }
+    return iwb_hash_finish(h);
+}
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * IWBC runtime library header
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * Functions compiled programs call into for work that is not worth
+ * emitting inline as IR. Link generated code with -liwbrt -lpthread
+ * (and -ldl before glibc 2.34); the database runtime loads SQLite
+ * when the program first connects.
+ */
+
+#ifndef IWBRT_H
+#define IWBRT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Body of a PARALLEL FOR outlined by the generator: runs iterations
+// lo..hi (inclusive) with the captured variables reached through ctx
+typedef void (*iwbrt_range_fn)(void* ctx, int32_t lo, int32_t hi);
+
+// Runs body over start..end (inclusive) on the thread pool. The range
+// is cut into chunks; each thread drains its own share and then
+// steals chunks from the others. Returns once every iteration has run.
+// Calls made from inside a parallel body run serially on the caller.
+void iwbrt_parallel_for(int32_t start, int32_t end, iwbrt_range_fn body, void* ctx);
+
+// Threads in the pool, counting the calling thread. Taken from
+// IWB_THREADS when set, otherwise the number of online CPUs.
+int iwbrt_thread_count(void);
+
+// A spawned task; the handle SPAWN yields
+typedef struct iwbrt_task iwbrt_task;
+
+// Thunk the generator emits per spawned FUNCTION: unpacks the argument
+// block and calls the function
+typedef int32_t (*iwbrt_task_fn)(void* args);
+
+// Queues fn on the calling thread's work-stealing deque. The size bytes
+// at args are copied, so the caller may reuse them right away. The task
+// is added to *owner, the list of tasks the spawning frame holds, and
+// stays allocated until that list is released and the task has run.
+iwbrt_task* iwbrt_spawn(iwbrt_task_fn fn, const void* args, size_t size, iwbrt_task** owner);
+
+// Returns the task's result, running other queued tasks while it is
+// outstanding. A task may be awaited any number of times, through any
+// copy of its handle and from several threads at once.
+int32_t iwbrt_await(iwbrt_task* task);
+
+// Drops the spawning frame's hold on every task of the list *owner, on
+// the frame's way out; tasks still running are freed when they finish
+void iwbrt_tasks_release(iwbrt_task** owner);
+
+// A bounded, lock-free multi-producer/multi-consumer queue of i32
+typedef struct iwbrt_channel iwbrt_channel;
+
+// Capacity is rounded up to a power of two
+iwbrt_channel* iwbrt_channel_create(int32_t capacity);
+void iwbrt_channel_destroy(iwbrt_channel* channel);
+
+// Block while the channel is full or empty. Tasks cannot be suspended,
+// so while callers are blocked the runtime starts spare threads for
+// the tasks still queued; pipeline stages always make progress.
+void iwbrt_channel_send(iwbrt_channel* channel, int32_t value);
+int32_t iwbrt_channel_receive(iwbrt_channel* channel);
+
+// Send or receive count values in order, claiming as many cells as are
+// free with a single atomic operation
+void iwbrt_channel_send_batch(iwbrt_channel* channel, const int32_t* values, int64_t count);
+void iwbrt_channel_receive_batch(iwbrt_channel* channel, int32_t* values, int64_t count);
+
+// Bump allocator behind the strings of one FUNCTION call (or of main).
+// The generator keeps it zeroed in the function's frame, so a call that
+// builds no long strings never allocates; everything is released at
+// once when the function returns.
+typedef struct iwbrt_arena {
+    struct ArenaBlock* head;
+    char* next;
+    char* end;
+    size_t last_size;
+    size_t used;                // bytes in all blocks
+    size_t limit;               // used past which a collection runs (0: the default)
+} iwbrt_arena;
+
+void* iwbrt_arena_alloc(iwbrt_arena* arena, size_t size);
+void iwbrt_arena_release(iwbrt_arena* arena);
+
+// A BASIC string. The layout is shared with generated code, which builds
+// literals as constants: capacity 0 means the bytes are inline in small
+// (at most 15 of them), UINT32_MAX a literal's bytes in read-only
+// memory, anything else an arena buffer of that many bytes. Strings are
+// not NUL-terminated.
+typedef struct {
+    uint32_t length;
+    uint32_t capacity;
+    union {
+        char small[16];
+        char* data;
+    };
+} iwbrt_string;
+
+// Once the arena has grown past its limit, moves the strings held by
+// the count variables at roots into fresh blocks and frees the old
+// ones, so strings no variable holds any more stop taking memory. The
+// generator calls it at the end of every loop iteration that built
+// strings, where temporaries are dead and the function's string
+// variables are the only way into the arena.
+void iwbrt_arena_collect(iwbrt_arena* arena, iwbrt_string** roots, int32_t count);
+
+// dst shares src's bytes; any spare capacity stays with src
+void iwbrt_string_assign(iwbrt_string* dst, const iwbrt_string* src);
+// Empties s and gives it room for capacity bytes (STRINGBUILDER)
+void iwbrt_string_reserve(iwbrt_arena* arena, iwbrt_string* s, int32_t capacity);
+// Gives s a copy in arena of bytes it points to outside of it (a
+// READLINE view or a literal), so it outlives the memory they are in
+void iwbrt_string_detach(iwbrt_arena* arena, iwbrt_string* s);
+// s = s + tail in place, doubling s's buffer when it is full
+void iwbrt_string_append(iwbrt_arena* arena, iwbrt_string* s, const iwbrt_string* tail);
+void iwbrt_string_concat(iwbrt_arena* arena, iwbrt_string* out, const iwbrt_string* a, const iwbrt_string* b);
+void iwbrt_string_from_int(iwbrt_string* out, int32_t value);
+void iwbrt_string_from_float(iwbrt_string* out, float value);
+// -1, 0 or 1 in byte order
+int32_t iwbrt_string_compare(const iwbrt_string* a, const iwbrt_string* b);
+void iwbrt_string_print(const iwbrt_string* s);
+// iwb_hash_bytes (iwbhash.h) of the string's bytes
+uint64_t iwbrt_string_hash(const iwbrt_string* s);
+
+// A hash table from i32 or string keys to i32 values (DICT)
+typedef struct iwbrt_dict iwbrt_dict;
+
+// Sized to hold capacity keys before it first grows
+iwbrt_dict* iwbrt_dict_create(int32_t capacity);
+void iwbrt_dict_destroy(iwbrt_dict* dict);
+int32_t iwbrt_dict_count(const iwbrt_dict* dict);
+
+// get returns 0 for a missing key, like an unset BASIC variable. slot
+// returns where the key's value is stored, adding the key (as 0) if it
+// is missing; the pointer is good until the next key is added. String
+// keys come with their hash, which the generator computes at compile
+// time for literals.
+int32_t iwbrt_dict_get_int(const iwbrt_dict* dict, int32_t key);
+int32_t iwbrt_dict_has_int(const iwbrt_dict* dict, int32_t key);
+int32_t* iwbrt_dict_slot_int(iwbrt_dict* dict, int32_t key);
+int32_t iwbrt_dict_get_str(const iwbrt_dict* dict, const iwbrt_string* key, uint64_t hash);
+int32_t iwbrt_dict_has_str(const iwbrt_dict* dict, const iwbrt_string* key, uint64_t hash);
+int32_t* iwbrt_dict_slot_str(iwbrt_dict* dict, const iwbrt_string* key, uint64_t hash);
+
+// A file opened by OPEN
+typedef struct iwbrt_file iwbrt_file;
+
+// mode starts with r (read, the default), w (truncate) or a (append).
+// A file that cannot be opened ends the program with a message.
+iwbrt_file* iwbrt_file_open(const iwbrt_string* path, const iwbrt_string* mode);
+void iwbrt_file_close(iwbrt_file* file);
+// -1 once every line has been read
+int32_t iwbrt_file_eof(iwbrt_file* file);
+// Reads the next line, without its line ending, into line; returns -1,
+// or 0 (leaving line empty) at the end of the file. With view set the
+// line may point into the file's own memory, valid until the next
+// READLINE or CLOSE of the file; otherwise it is copied into arena.
+int32_t iwbrt_file_readline(iwbrt_file* file, iwbrt_arena* arena, iwbrt_string* line, int32_t view);
+void iwbrt_file_writeline(iwbrt_file* file, const iwbrt_string* text);
+
+// Opens (creating it if needed) the SQLite database file name, closing
+// the one connected before
+void iwbrt_db_connect(const iwbrt_string* name);
+
+// A prepared statement from the cache
+typedef struct iwbrt_statement iwbrt_statement;
+
+// Looks sql up in the statement cache, preparing it on a miss; hash is
+// iwb_hash_bytes of the text. Takes the database lock, which
+// iwbrt_db_execute and iwbrt_db_query release, so every prepare must be
+// followed by one of them. Returns NULL (still locked) when the SQL
+// cannot be prepared.
+iwbrt_statement* iwbrt_db_prepare(const iwbrt_string* sql, uint64_t hash);
+// Parameters are numbered from 1
+void iwbrt_db_bind_int(iwbrt_statement* statement, int32_t index, int32_t value);
+void iwbrt_db_bind_float(iwbrt_statement* statement, int32_t index, float value);
+void iwbrt_db_bind_text(iwbrt_statement* statement, int32_t index, const iwbrt_string* value);
+// For a query, whose rows are read after the string may have changed
+void iwbrt_db_bind_text_copy(iwbrt_statement* statement, int32_t index, const iwbrt_string* value);
+// Runs the statement to completion, discarding any rows
+void iwbrt_db_execute(iwbrt_statement* statement);
+
+// An open query result
+typedef struct iwbrt_cursor iwbrt_cursor;
+
+// Starts statement as a query, releasing the lock like iwbrt_db_execute,
+// and frees old (the cursor the DBQUERY made last time, or NULL)
+iwbrt_cursor* iwbrt_db_query(iwbrt_statement* statement, iwbrt_cursor* old);
+// Fills up to capacity rows: column c of row r goes to columns[c][r],
+// converted to an integer. Returns the rows filled, 0 once the result
+// is exhausted.
+int32_t iwbrt_db_fetch(iwbrt_cursor* cursor, int32_t** columns, int32_t column_count, int64_t capacity);
+
+// Bracket a loop so its statements share one transaction; calls nest
+void iwbrt_db_batch_begin(void);
+void iwbrt_db_batch_end(void);
+
+// A zero-filled, 64-byte aligned block for a DIM array with the given
+// extents. Ends the program with an error naming line when an extent
+// is below one or the array does not fit in memory.
+int32_t* iwbrt_array_alloc(const int32_t* extents, int32_t dim_count, int32_t line);
+
+// Sorts ascending: radix sort for large arrays, pdqsort otherwise
+void iwbrt_sort_i32(int32_t* values, int64_t count);
+// Index of key in ascending values, or -1
+int32_t iwbrt_bsearch_i32(const int32_t* values, int64_t count, int32_t key);
+// Index of the first element equal to key, or -1
+int32_t iwbrt_find_i32(const int32_t* values, int64_t count, int32_t key);
+
+#endif
@@ -1,7 +1,7 @@
 /* 
  * Lexer header file
  * Created: February 20, 2025 by LHS
- * Last modified: February 27, 2025 by LHS
+ * Last modified: October 19, 2026 by LHS
  *
  */
 
@@ -10,6 +10,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 
 typedef enum {
     // Keywords
@@ -31,6 +32,28 @@ typedef enum {
     TOKEN_FUNCTION,
     TOKEN_RETURN,
     TOKEN_END,
+    TOKEN_PARALLEL,
+    TOKEN_REDUCE,
+    TOKEN_SPAWN,
+    TOKEN_AWAIT,
+    TOKEN_CHANNEL,
+    TOKEN_SEND,
+    TOKEN_RECEIVE,
+    TOKEN_YIELD,
+    TOKEN_EACH,
+    TOKEN_IN,
+    TOKEN_STRINGBUILDER,
+    TOKEN_APPEND,
+    TOKEN_DICT,
+    TOKEN_SORT,
+    TOKEN_OPEN,
+    TOKEN_READLINE,
+    TOKEN_WRITELINE,
+    TOKEN_CLOSE,
+    TOKEN_DBCONNECT,
+    TOKEN_DBEXECSQL,
+    TOKEN_DBQUERY,
+    TOKEN_INCLUDE,
     
     // Operators
     TOKEN_EQUALS,
@@ -47,6 +70,7 @@ typedef enum {
     TOKEN_LBRACKET,
     TOKEN_RBRACKET,
     TOKEN_COMMA,
+    TOKEN_COLON,
     
     // Values
     TOKEN_IDENTIFIER,
@@ -67,12 +91,17 @@ typedef struct {
 
 typedef struct {
     char* source;
-    int position;
+    bool owns_source;
+    size_t position;
     int line;
     int column;
+    FILE* trace;        // tokens as they are made, stdout by default; NULL for none
 } Lexer;
 
 Lexer* lexer_create(const char* source);
+// Lexes source without copying it; it must stay until lexer_destroy.
+// The trace goes to trace, or nowhere when it is NULL.
+Lexer* lexer_create_in_place(const char* source, FILE* trace);
 Token* lexer_next_token(Lexer* lexer);
 void lexer_destroy(Lexer* lexer);
 
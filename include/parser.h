@@ -1,7 +1,7 @@
 /* 
  * Parser header file
  * Created: February 20, 2025 by LHS
- * Last modified: February 27, 2025 by LHS
+ * Last modified: October 19, 2026 by LHS
  *
  */
 
@@ -24,7 +24,29 @@ typedef enum {
     NODE_STRING,
     NODE_IDENTIFIER,
     NODE_OPERATOR,
-    NODE_ARRAY_ACCESS
+    NODE_ARRAY_ACCESS,
+    NODE_DIM,
+    NODE_PARALLEL_FOR,
+    NODE_REDUCE,
+    NODE_SPAWN,
+    NODE_AWAIT,
+    NODE_CHANNEL,
+    NODE_SEND,
+    NODE_RECEIVE,
+    NODE_YIELD,
+    NODE_FOR_EACH,
+    NODE_STRINGBUILDER,
+    NODE_APPEND,
+    NODE_DICT,
+    NODE_SORT,
+    NODE_OPEN,
+    NODE_READLINE,
+    NODE_WRITELINE,
+    NODE_CLOSE,
+    NODE_DBCONNECT,
+    NODE_DBEXECSQL,
+    NODE_DBQUERY,
+    NODE_INCLUDE
 } NodeType;
 
 typedef struct ASTNode {
@@ -36,13 +58,43 @@ typedef struct ASTNode {
     int column;
 } ASTNode;
 
+// Files INCLUDEd so far in one compile, shared by the parser of the
+// program and those of the files it includes
+typedef struct {
+    char** paths;
+    int count;
+} IncludeSet;
+
 typedef struct {
     Lexer* lexer;
     Token* current_token;
+    // Tokens already consumed by the statement being parsed, freed when
+    // the next top-level statement starts
+    Token** spent;
+    int spent_count;
+    int spent_capacity;
+    const char* path;           // file being parsed; INCLUDE names are relative to it
+    IncludeSet* includes;       // created on the first INCLUDE
+    bool owns_includes;
+    bool failed;                // a statement or INCLUDE did not parse
+    FILE* trace;                // the parse as it goes, the lexer's trace to start with
+    FILE* errors;               // syntax errors, stdout by default
 } Parser;
 
 Parser* parser_create(Lexer* lexer);
 ASTNode* parser_parse(Parser* parser);
+// Parses the next top-level statement; NULL at the end of the input or
+// on a syntax error (failed is then set). An INCLUDE comes back with the
+// statements of the file as children, or none if it was included before.
+ASTNode* parser_next_statement(Parser* parser);
+// Parses a whole file without reading in what it INCLUDEs; NULL on a
+// syntax error
+ASTNode* parser_parse_module(Parser* parser);
+// Writes "ERROR: " and the message to the parser's errors
+void parser_error(Parser* parser, const char* format, ...);
+// Reads in the file an INCLUDE statement names (src/include.c)
+bool parser_include(Parser* parser, ASTNode* node);
+void include_set_destroy(IncludeSet* includes);
 void parser_destroy(Parser* parser);
 void ast_destroy(ASTNode* node);
 
@@ -0,0 +1,49 @@
+/*
+ * Compile phase measurements
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * What --time-report and --stats sample at the edges of each phase of
+ * a compile. CPU time is the sampling thread's own, so compiles running
+ * side by side (-j) do not count each other's work; the heap figure is
+ * the whole process's.
+ */
+
+#ifndef PHASE_H
+#define PHASE_H
+
+#include <malloc.h>
+#include <stdint.h>
+#include <time.h>
+
+typedef struct {
+    double wall;        // seconds
+    double cpu;         // seconds of this thread's CPU time
+    int64_t heap;       // bytes in use from malloc
+} PhaseSample;
+
+static inline double phase_seconds(clockid_t clock) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static inline PhaseSample phase_sample(void) {
+    struct mallinfo2 heap = mallinfo2();
+    PhaseSample sample = {
+        phase_seconds(CLOCK_MONOTONIC),
+        phase_seconds(CLOCK_THREAD_CPUTIME_ID),
+        (int64_t)(heap.uordblks + heap.hblkhd)
+    };
+    return sample;
+}
+
+// Adds the time and heap growth since start to total
+static inline void phase_add_since(PhaseSample* total, PhaseSample start) {
+    PhaseSample now = phase_sample();
+    total->wall += now.wall - start.wall;
+    total->cpu += now.cpu - start.cpu;
+    total->heap += now.heap - start.heap;
+}
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * Compile server header file
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/un.h>
+
+#define SERVER_MAGIC "IWBCREQ1"
+
+// Starts a request; sent with the client's stdout and stderr attached
+typedef struct {
+    char magic[8];
+    uint32_t umask;
+    uint32_t string_count;  // working directory, IWBC_CACHE_DIR, then argv
+    uint32_t size;          // bytes of the strings that follow, each ending in a zero
+} RequestHeader;
+
+// Runs a command line the way iwbc would and returns its exit status
+typedef int (*ServerCommand)(int argc, char** argv);
+
+// Serves the command lines clients forward over the Unix socket at path
+// on workers processes, until SIGINT or SIGTERM. Returns iwbc's exit
+// status.
+int server_run(const char* path, int workers, ServerCommand command);
+
+// Has the server at path run this command line with the caller's
+// working directory, umask, IWBC_CACHE_DIR, stdout and stderr. False
+// when no server answers at path; otherwise status is the exit status.
+bool server_forward(const char* path, int argc, char** argv, int* status);
+
+// Socket plumbing shared by both sides (src/client.c)
+bool server_address(const char* path, struct sockaddr_un* address);
+// A socket connected to the server at path, or -1
+int server_connect(const char* path);
+bool server_read(int fd, void* data, size_t size);
+bool server_send(int fd, const void* data, size_t size);
+
+#endif
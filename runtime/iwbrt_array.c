@@ -0,0 +1,50 @@
+/*
+ * DIM arrays on the heap
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * Arrays whose size is only known at run time, or that are too large
+ * for the stack, are allocated here. The extents come from the program,
+ * so each one is checked before it is used: a DIM with an extent below
+ * one, or one whose size does not fit in memory, ends the program with
+ * the line of the DIM instead of handing the generated code a block
+ * smaller than its subscripts assume.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "iwbrt.h"
+
+// Matches GENERATOR_ARRAY_ALIGN: whole-array loops use aligned vector loads
+#define IWBRT_ARRAY_ALIGN 64
+
+int32_t* iwbrt_array_alloc(const int32_t* extents, int32_t dim_count, int32_t line) {
+    int64_t count = 1;
+    for (int32_t k = 0; k < dim_count; k++) {
+        if (extents[k] < 1) {
+            fprintf(stderr, "Runtime error: DIM with an extent of %d at line %d\n", extents[k], line);
+            exit(1);
+        }
+        if (__builtin_mul_overflow(count, (int64_t)extents[k], &count)) {
+            count = -1;
+            break;
+        }
+    }
+    size_t bytes;
+    if (count < 0 || __builtin_mul_overflow((size_t)count, sizeof(int32_t), &bytes) ||
+        bytes > SIZE_MAX - (IWBRT_ARRAY_ALIGN - 1)) {
+        fprintf(stderr, "Runtime error: DIM of an array too large for memory at line %d\n", line);
+        exit(1);
+    }
+    // aligned_alloc wants the size rounded up to the alignment
+    size_t rounded = (bytes + IWBRT_ARRAY_ALIGN - 1) & ~(size_t)(IWBRT_ARRAY_ALIGN - 1);
+    int32_t* data = aligned_alloc(IWBRT_ARRAY_ALIGN, rounded);
+    if (!data) {
+        fprintf(stderr, "Runtime error: out of memory for DIM at line %d\n", line);
+        exit(1);
+    }
+    memset(data, 0, bytes);
+    return data;
+}
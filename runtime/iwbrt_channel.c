@@ -0,0 +1,189 @@
+/*
+ * Bounded channels for CHANNEL/SEND/RECEIVE
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * A channel is a ring of cells in the style of Vyukov's bounded MPMC
+ * queue. Every cell carries a sequence number that says whose turn it
+ * is: a producer may fill the cell at position pos once its sequence
+ * equals pos, a consumer may empty it once it equals pos + 1. Producers
+ * and consumers claim positions with one CAS on their own counter, so
+ * neither side takes a lock and the two sides only meet on the cells.
+ *
+ * The batch calls claim as many positions as are available with that
+ * one CAS and then fill or empty the cells in order, so a stage moving
+ * an array through a channel pays one atomic per batch instead of one
+ * per element.
+ */
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "iwbrt.h"
+#include "iwbrt_internal.h"
+
+typedef struct {
+    _Atomic size_t sequence;
+    int32_t value;
+} ChannelCell;
+
+// The two counters sit on separate cache lines so producers and
+// consumers do not invalidate each other's claims
+struct iwbrt_channel {
+    ChannelCell* cells;
+    size_t mask;
+    char pad1[64 - sizeof(ChannelCell*) - sizeof(size_t)];
+    _Atomic size_t send_pos;
+    char pad2[64 - sizeof(size_t)];
+    _Atomic size_t receive_pos;
+    char pad3[64 - sizeof(size_t)];
+};
+
+iwbrt_channel* iwbrt_channel_create(int32_t capacity) {
+    // Round up to a power of two so positions map to cells with a mask
+    size_t size = 2;
+    while (size < (size_t)(capacity > 0 ? capacity : 1)) {
+        size <<= 1;
+    }
+
+    iwbrt_channel* channel = NULL;
+    if (posix_memalign((void**)&channel, 64, sizeof(iwbrt_channel)) != 0 ||
+        !(channel->cells = malloc(size * sizeof(ChannelCell)))) {
+        fprintf(stderr, "iwbrt: out of memory creating channel\n");
+        exit(1);
+    }
+    channel->mask = size - 1;
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&channel->cells[i].sequence, i);
+    }
+    atomic_init(&channel->send_pos, 0);
+    atomic_init(&channel->receive_pos, 0);
+    return channel;
+}
+
+void iwbrt_channel_destroy(iwbrt_channel* channel) {
+    if (!channel) return;
+    free(channel->cells);
+    free(channel);
+}
+
+static void check_channel(iwbrt_channel* channel) {
+    if (!channel) {
+        fprintf(stderr, "iwbrt: channel used before its CHANNEL statement ran\n");
+        exit(1);
+    }
+}
+
+// Claims up to want positions on counter; returns how many were claimed
+// (0 when the channel is full or empty for this side) and the first
+// position in *first. ready is the sequence the first cell must carry
+// relative to its position: 0 for producers, 1 for consumers.
+static size_t claim(iwbrt_channel* channel, _Atomic size_t* counter, _Atomic size_t* other,
+                    size_t ready, size_t want, size_t* first) {
+    size_t pos = atomic_load_explicit(counter, memory_order_relaxed);
+    for (;;) {
+        ChannelCell* cell = &channel->cells[pos & channel->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + ready);
+        if (diff < 0) {
+            return 0;
+        }
+        if (diff > 0) {
+            // Someone else claimed pos meanwhile
+            pos = atomic_load_explicit(counter, memory_order_relaxed);
+            continue;
+        }
+
+        // Producers may run at most one lap ahead of consumers, consumers
+        // never past producers' claims
+        size_t limit = atomic_load_explicit(other, memory_order_acquire);
+        size_t available = ready == 0 ? limit + channel->mask + 1 - pos : limit - pos;
+        size_t count = want < available ? want : available;
+        if (count == 0) count = 1;
+        if (atomic_compare_exchange_weak_explicit(counter, &pos, pos + count,
+                memory_order_relaxed, memory_order_relaxed)) {
+            *first = pos;
+            return count;
+        }
+    }
+}
+
+// Waits for the cell at pos to reach sequence pos + ready; the claim
+// guarantees the other side is already on its way out of it
+static ChannelCell* wait_cell(iwbrt_channel* channel, size_t pos, size_t ready) {
+    ChannelCell* cell = &channel->cells[pos & channel->mask];
+    while (atomic_load_explicit(&cell->sequence, memory_order_acquire) != pos + ready) {
+        sched_yield();
+    }
+    return cell;
+}
+
+void iwbrt_channel_send_batch(iwbrt_channel* channel, const int32_t* values, int64_t count) {
+    check_channel(channel);
+    int blocked = 0;
+    while (count > 0) {
+        size_t first;
+        size_t claimed = claim(channel, &channel->send_pos, &channel->receive_pos, 0, (size_t)count, &first);
+        if (claimed == 0) {
+            // Running tasks inline here could bury the other end of
+            // the channel under this frame; let a spare thread run them
+            if (!blocked) {
+                iwbrt_block_begin();
+                blocked = 1;
+            }
+            iwbrt_block_wait();
+            continue;
+        }
+        for (size_t i = 0; i < claimed; i++) {
+            ChannelCell* cell = wait_cell(channel, first + i, 0);
+            cell->value = values[i];
+            atomic_store_explicit(&cell->sequence, first + i + 1, memory_order_release);
+        }
+        values += claimed;
+        count -= claimed;
+    }
+    if (blocked) {
+        iwbrt_block_end();
+    }
+}
+
+void iwbrt_channel_receive_batch(iwbrt_channel* channel, int32_t* values, int64_t count) {
+    check_channel(channel);
+    int blocked = 0;
+    while (count > 0) {
+        size_t first;
+        size_t claimed = claim(channel, &channel->receive_pos, &channel->send_pos, 1, (size_t)count, &first);
+        if (claimed == 0) {
+            // Running tasks inline here could bury the other end of
+            // the channel under this frame; let a spare thread run them
+            if (!blocked) {
+                iwbrt_block_begin();
+                blocked = 1;
+            }
+            iwbrt_block_wait();
+            continue;
+        }
+        for (size_t i = 0; i < claimed; i++) {
+            ChannelCell* cell = wait_cell(channel, first + i, 1);
+            values[i] = cell->value;
+            atomic_store_explicit(&cell->sequence, first + i + channel->mask + 1, memory_order_release);
+        }
+        values += claimed;
+        count -= claimed;
+    }
+    if (blocked) {
+        iwbrt_block_end();
+    }
+}
+
+void iwbrt_channel_send(iwbrt_channel* channel, int32_t value) {
+    iwbrt_channel_send_batch(channel, &value, 1);
+}
+
+int32_t iwbrt_channel_receive(iwbrt_channel* channel) {
+    int32_t value;
+    iwbrt_channel_receive_batch(channel, &value, 1);
+    return value;
+}
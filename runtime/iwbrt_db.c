@@ -0,0 +1,420 @@
+/*
+ * Embedded SQLite database for DBCONNECT/DBEXECSQL
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * A program talks to one SQLite database at a time; there is no server
+ * and the user and password of DBCONNECT are accepted but unused.
+ *
+ * Preparing a statement costs far more than running it, so prepared
+ * statements are kept in a least-recently-used cache keyed by their
+ * SQL text. The generator hashes literal SQL at compile time and every
+ * lookup is one hash probe; a hit only resets the statement. Values
+ * reach the statement as ? parameters, so the same INSERT run with new
+ * values every time is prepared once.
+ *
+ * Outside a transaction SQLite commits (and syncs) after every
+ * statement. The generator therefore brackets the outermost loop that
+ * runs DBEXECSQL with iwbrt_db_batch_begin/end, which run the whole
+ * loop as one transaction. A statement that starts or ends a
+ * transaction itself first commits the batch, which then stays closed.
+ *
+ * DBQUERY turns a statement into a cursor, which takes the statement
+ * out of the cache and owns it. DBFETCH steps the cursor to fill one
+ * block of rows straight into DIM arrays, a column per array, so only
+ * one block of a result is ever in memory and numeric columns land in
+ * arrays the vectorized whole-array code works on.
+ *
+ * SQLite itself is loaded with dlopen by the first DBCONNECT, so a
+ * program that never touches a database neither links against it nor
+ * pays for loading and relocating it at startup.
+ *
+ * All calls share one lock, taken by iwbrt_db_prepare and released by
+ * iwbrt_db_execute or iwbrt_db_query, so tasks and parallel bodies may
+ * use the database while the bindings of one statement stay together.
+ */
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sqlite3.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "iwbrt.h"
+#include "iwbrt_internal.h"
+
+// Prepared statements kept; the bucket count is a power of two above it
+#define IWBRT_DB_CACHE_SIZE 64
+#define IWBRT_DB_CACHE_BUCKETS 128
+
+struct iwbrt_statement {
+    sqlite3_stmt* stmt;         // NULL for an entry on the free list
+    char* sql;
+    uint32_t length;
+    uint64_t hash;
+    int controls_transaction;   // BEGIN, COMMIT and the like
+    int bucket_next;            // next entry in the same bucket (or free), or -1
+    int newer, older;           // recency list, -1 at either end
+};
+
+static struct {
+    pthread_mutex_t lock;
+    sqlite3* db;
+    int registered;
+
+    iwbrt_statement entries[IWBRT_DB_CACHE_SIZE];
+    int used;                   // entries handed out so far
+    int free_list;              // entries given up by cursors
+    int buckets[IWBRT_DB_CACHE_BUCKETS];
+    int newest, oldest;
+    iwbrt_cursor* cursors;      // open cursors, whose statements close with the database
+
+    int batch_depth;            // nested batch_begin calls outstanding
+    int batch_open;             // a BEGIN issued by the batch is pending
+} db = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// The SQLite entry points used here, resolved by load_sqlite
+typedef struct {
+    void* library;
+    int (*open)(const char*, sqlite3**);
+    int (*close)(sqlite3*);
+    const char* (*errmsg)(sqlite3*);
+    int (*exec)(sqlite3*, const char*, int (*)(void*, int, char**, char**), void*, char**);
+    int (*get_autocommit)(sqlite3*);
+    int (*prepare_v2)(sqlite3*, const char*, int, sqlite3_stmt**, const char**);
+    int (*bind_int)(sqlite3_stmt*, int, int);
+    int (*bind_double)(sqlite3_stmt*, int, double);
+    int (*bind_text)(sqlite3_stmt*, int, const char*, int, void (*)(void*));
+    int (*step)(sqlite3_stmt*);
+    int (*reset)(sqlite3_stmt*);
+    int (*clear_bindings)(sqlite3_stmt*);
+    int (*column_count)(sqlite3_stmt*);
+    int (*column_int)(sqlite3_stmt*, int);
+    int (*finalize)(sqlite3_stmt*);
+} SqliteApi;
+
+static SqliteApi sqlite;
+
+// Loads SQLite on first use; false (after saying why) if it is missing
+static int load_sqlite(void) {
+    if (sqlite.library) return 1;
+    void* library = dlopen("libsqlite3.so.0", RTLD_NOW | RTLD_LOCAL);
+    if (!library) library = dlopen("libsqlite3.so", RTLD_NOW | RTLD_LOCAL);
+    if (!library) {
+        fprintf(stderr, "iwbrt: cannot load SQLite: %s\n", dlerror());
+        return 0;
+    }
+
+    static const struct {
+        const char* name;
+        size_t offset;
+    } symbols[] = {
+#define SQLITE_SYMBOL(field) { "sqlite3_" #field, offsetof(SqliteApi, field) }
+        SQLITE_SYMBOL(open), SQLITE_SYMBOL(close), SQLITE_SYMBOL(errmsg),
+        SQLITE_SYMBOL(exec), SQLITE_SYMBOL(get_autocommit), SQLITE_SYMBOL(prepare_v2),
+        SQLITE_SYMBOL(bind_int), SQLITE_SYMBOL(bind_double), SQLITE_SYMBOL(bind_text),
+        SQLITE_SYMBOL(step), SQLITE_SYMBOL(reset), SQLITE_SYMBOL(clear_bindings),
+        SQLITE_SYMBOL(column_count), SQLITE_SYMBOL(column_int), SQLITE_SYMBOL(finalize),
+#undef SQLITE_SYMBOL
+    };
+    for (size_t i = 0; i < sizeof(symbols) / sizeof(symbols[0]); i++) {
+        void* address = dlsym(library, symbols[i].name);
+        if (!address) {
+            fprintf(stderr, "iwbrt: SQLite lacks %s\n", symbols[i].name);
+            dlclose(library);
+            return 0;
+        }
+        memcpy((char*)&sqlite + symbols[i].offset, &address, sizeof(address));
+    }
+    sqlite.library = library;
+    return 1;
+}
+
+static void report(const char* what) {
+    fprintf(stderr, "iwbrt: %s: %s\n", what, db.db ? sqlite.errmsg(db.db) : "no database connected");
+}
+
+static void exec_plain(const char* sql) {
+    if (sqlite.exec(db.db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+        report(sql);
+    }
+}
+
+static void commit_batch(void) {
+    if (db.batch_open) {
+        db.batch_open = 0;
+        if (!sqlite.get_autocommit(db.db)) exec_plain("COMMIT");
+    }
+}
+
+static void unlink_entry(int index) {
+    iwbrt_statement* entry = &db.entries[index];
+    if (entry->newer >= 0) db.entries[entry->newer].older = entry->older;
+    else db.newest = entry->older;
+    if (entry->older >= 0) db.entries[entry->older].newer = entry->newer;
+    else db.oldest = entry->newer;
+}
+
+static void push_newest(int index) {
+    iwbrt_statement* entry = &db.entries[index];
+    entry->newer = -1;
+    entry->older = db.newest;
+    if (db.newest >= 0) db.entries[db.newest].newer = index;
+    db.newest = index;
+    if (db.oldest < 0) db.oldest = index;
+}
+
+struct iwbrt_cursor {
+    sqlite3_stmt* stmt;         // NULL once the rows are exhausted or the database closed
+    iwbrt_cursor* next;
+};
+
+static void clear_cache(void) {
+    for (int i = 0; i < db.used; i++) {
+        if (!db.entries[i].stmt) continue;
+        sqlite.finalize(db.entries[i].stmt);
+        free(db.entries[i].sql);
+    }
+    db.used = 0;
+    db.free_list = -1;
+    db.newest = db.oldest = -1;
+    memset(db.buckets, -1, sizeof(db.buckets));
+}
+
+static void finish_cursor(iwbrt_cursor* cursor) {
+    if (!cursor->stmt) return;
+    sqlite.finalize(cursor->stmt);
+    cursor->stmt = NULL;
+    iwbrt_cursor** link = &db.cursors;
+    while (*link != cursor) link = &(*link)->next;
+    *link = cursor->next;
+}
+
+static void disconnect(void) {
+    if (!db.db) return;
+    commit_batch();
+    clear_cache();
+    while (db.cursors) finish_cursor(db.cursors);
+    sqlite.close(db.db);
+    db.db = NULL;
+}
+
+static void disconnect_at_exit(void) {
+    pthread_mutex_lock(&db.lock);
+    disconnect();
+    pthread_mutex_unlock(&db.lock);
+}
+
+void iwbrt_db_connect(const iwbrt_string* name) {
+    char* path = malloc(name->length + 1);
+    if (!path) return;
+    memcpy(path, iwbrt_string_bytes(name), name->length);
+    path[name->length] = '\0';
+
+    pthread_mutex_lock(&db.lock);
+    disconnect();
+    if (!load_sqlite()) {
+        pthread_mutex_unlock(&db.lock);
+        free(path);
+        return;
+    }
+    if (!db.registered) {
+        atexit(disconnect_at_exit);
+        db.registered = 1;
+    }
+    clear_cache();
+    if (sqlite.open(path, &db.db) != SQLITE_OK) {
+        report(path);
+        sqlite.close(db.db);
+        db.db = NULL;
+    }
+    // A batch running around this DBCONNECT carries on with the new
+    // database
+    if (db.db && db.batch_depth > 0) {
+        exec_plain("BEGIN");
+        db.batch_open = 1;
+    }
+    pthread_mutex_unlock(&db.lock);
+    free(path);
+}
+
+static int is_transaction_control(const char* sql) {
+    while (*sql == ' ' || *sql == '\t' || *sql == '\n' || *sql == '\r') sql++;
+    static const char* const words[] = { "BEGIN", "COMMIT", "END", "ROLLBACK", "SAVEPOINT", "RELEASE" };
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+        size_t n = strlen(words[i]);
+        if (strncasecmp(sql, words[i], n) == 0 && (sql[n] == '\0' || sql[n] == ' ' || sql[n] == ';')) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Takes an entry out of the recency list and its bucket; the caller
+// decides what becomes of its statement
+static void remove_entry(int index) {
+    iwbrt_statement* entry = &db.entries[index];
+    unlink_entry(index);
+    int* link = &db.buckets[entry->hash & (IWBRT_DB_CACHE_BUCKETS - 1)];
+    while (*link != index) link = &db.entries[*link].bucket_next;
+    *link = entry->bucket_next;
+    free(entry->sql);
+    entry->sql = NULL;
+    entry->stmt = NULL;
+}
+
+// Prepares sql into a free entry, evicting the least recently used
+static iwbrt_statement* prepare_entry(const char* sql, uint32_t length, uint64_t hash) {
+    sqlite3_stmt* stmt;
+    if (sqlite.prepare_v2(db.db, sql, (int)length, &stmt, NULL) != SQLITE_OK) {
+        report("cannot prepare statement");
+        return NULL;
+    }
+
+    int index;
+    if (db.free_list >= 0) {
+        index = db.free_list;
+        db.free_list = db.entries[index].bucket_next;
+    } else if (db.used < IWBRT_DB_CACHE_SIZE) {
+        index = db.used++;
+    } else {
+        index = db.oldest;
+        sqlite.finalize(db.entries[index].stmt);
+        remove_entry(index);
+    }
+
+    iwbrt_statement* entry = &db.entries[index];
+    entry->stmt = stmt;
+    entry->sql = malloc(length + 1);
+    if (entry->sql) {
+        memcpy(entry->sql, sql, length);
+        entry->sql[length] = '\0';
+    }
+    entry->length = length;
+    entry->hash = hash;
+    entry->controls_transaction = entry->sql && is_transaction_control(entry->sql);
+    int* bucket = &db.buckets[hash & (IWBRT_DB_CACHE_BUCKETS - 1)];
+    entry->bucket_next = *bucket;
+    *bucket = index;
+    push_newest(index);
+    return entry;
+}
+
+iwbrt_statement* iwbrt_db_prepare(const iwbrt_string* sql, uint64_t hash) {
+    pthread_mutex_lock(&db.lock);
+    if (!db.db) {
+        report("DBEXECSQL");
+        return NULL;
+    }
+    const char* text = iwbrt_string_bytes(sql);
+    for (int i = db.buckets[hash & (IWBRT_DB_CACHE_BUCKETS - 1)]; i >= 0; i = db.entries[i].bucket_next) {
+        iwbrt_statement* entry = &db.entries[i];
+        if (entry->hash == hash && entry->length == sql->length && entry->sql &&
+            memcmp(entry->sql, text, sql->length) == 0) {
+            unlink_entry(i);
+            push_newest(i);
+            return entry;
+        }
+    }
+    return prepare_entry(text, sql->length, hash);
+}
+
+void iwbrt_db_bind_int(iwbrt_statement* statement, int32_t index, int32_t value) {
+    if (statement) sqlite.bind_int(statement->stmt, index, value);
+}
+
+void iwbrt_db_bind_float(iwbrt_statement* statement, int32_t index, float value) {
+    if (statement) sqlite.bind_double(statement->stmt, index, value);
+}
+
+// The bytes are only read while the statement runs, before the string
+// can change, so SQLite need not copy them
+void iwbrt_db_bind_text(iwbrt_statement* statement, int32_t index, const iwbrt_string* value) {
+    if (statement) {
+        sqlite.bind_text(statement->stmt, index, iwbrt_string_bytes(value), (int)value->length, SQLITE_STATIC);
+    }
+}
+
+// A query's rows are stepped through long after DBQUERY, so its text
+// values are copied
+void iwbrt_db_bind_text_copy(iwbrt_statement* statement, int32_t index, const iwbrt_string* value) {
+    if (statement) {
+        sqlite.bind_text(statement->stmt, index, iwbrt_string_bytes(value), (int)value->length, SQLITE_TRANSIENT);
+    }
+}
+
+void iwbrt_db_execute(iwbrt_statement* statement) {
+    if (statement) {
+        if (statement->controls_transaction) commit_batch();
+        int status;
+        do {
+            status = sqlite.step(statement->stmt);
+        } while (status == SQLITE_ROW);
+        if (status != SQLITE_DONE) report("SQL error");
+        sqlite.reset(statement->stmt);
+        sqlite.clear_bindings(statement->stmt);
+    }
+    pthread_mutex_unlock(&db.lock);
+}
+
+iwbrt_cursor* iwbrt_db_query(iwbrt_statement* statement, iwbrt_cursor* old) {
+    if (old) {
+        finish_cursor(old);
+        free(old);
+    }
+    iwbrt_cursor* cursor = calloc(1, sizeof(iwbrt_cursor));
+    if (cursor && statement) {
+        // The cursor keeps the statement; its entry goes on the free list
+        if (statement->controls_transaction) commit_batch();
+        int index = (int)(statement - db.entries);
+        cursor->stmt = statement->stmt;
+        remove_entry(index);
+        statement->bucket_next = db.free_list;
+        db.free_list = index;
+        cursor->next = db.cursors;
+        db.cursors = cursor;
+    }
+    pthread_mutex_unlock(&db.lock);
+    return cursor;
+}
+
+int32_t iwbrt_db_fetch(iwbrt_cursor* cursor, int32_t** columns, int32_t column_count, int64_t capacity) {
+    pthread_mutex_lock(&db.lock);
+    int32_t rows = 0;
+    if (cursor && cursor->stmt) {
+        int width = sqlite.column_count(cursor->stmt);
+        while (rows < capacity) {
+            int status = sqlite.step(cursor->stmt);
+            if (status != SQLITE_ROW) {
+                if (status != SQLITE_DONE) report("SQL error");
+                finish_cursor(cursor);
+                break;
+            }
+            for (int c = 0; c < column_count; c++) {
+                columns[c][rows] = c < width ? sqlite.column_int(cursor->stmt, c) : 0;
+            }
+            rows++;
+        }
+    }
+    pthread_mutex_unlock(&db.lock);
+    return rows;
+}
+
+void iwbrt_db_batch_begin(void) {
+    pthread_mutex_lock(&db.lock);
+    if (db.batch_depth++ == 0 && db.db && sqlite.get_autocommit(db.db)) {
+        exec_plain("BEGIN");
+        db.batch_open = 1;
+    }
+    pthread_mutex_unlock(&db.lock);
+}
+
+void iwbrt_db_batch_end(void) {
+    pthread_mutex_lock(&db.lock);
+    if (--db.batch_depth == 0 && db.db) {
+        commit_batch();
+    }
+    pthread_mutex_unlock(&db.lock);
+}
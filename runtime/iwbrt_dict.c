@@ -0,0 +1,224 @@
+/*
+ * Hash tables for DICT
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * An open-addressing table in the style of Abseil's Swiss tables. Next
+ * to the entries sits one control byte per slot: 0x80 for an empty
+ * slot, otherwise the top 7 bits of the key's hash. A lookup starts at
+ * the slot picked by the hash and compares 16 control bytes at once
+ * with SSE2, so it only touches entries whose 7 bits match, which is
+ * almost always just the one it is looking for. The first 16 control
+ * bytes are mirrored after the last so a group never wraps.
+ *
+ * Integer and string keys may be mixed in one table; a string key never
+ * equals an integer key. String keys are copied into memory the table
+ * owns, since the string they came from may live in a function's arena.
+ * Entries are never removed, so there are no tombstones to skip.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "iwbhash.h"
+#include "iwbrt.h"
+#include "iwbrt_internal.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define GROUP_WIDTH 16
+#define CTRL_EMPTY ((int8_t)0x80)
+#define DICT_MIN_CAPACITY 16
+
+typedef struct {
+    uint64_t hash;
+    char* data;         // string key bytes, NULL for an integer key
+    int32_t key;        // the integer key, or the string key's length
+    int32_t value;
+} DictEntry;
+
+struct iwbrt_dict {
+    int8_t* ctrl;       // capacity + GROUP_WIDTH control bytes
+    DictEntry* entries;
+    size_t mask;        // capacity - 1; capacity is a power of two
+    size_t count;
+    size_t growth_left; // inserts left before the table is 7/8 full
+};
+
+static void* fail_out_of_memory(void) {
+    fprintf(stderr, "iwbrt: out of memory growing DICT\n");
+    exit(1);
+}
+
+static size_t h1(uint64_t hash) {
+    return (size_t)hash;
+}
+
+static int8_t h2(uint64_t hash) {
+    return (int8_t)(hash >> 57);
+}
+
+// Bit i set where group[i] == value
+static uint32_t group_match(const int8_t* group, int8_t value) {
+#ifdef __SSE2__
+    __m128i bytes = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(group[i] == value) << i;
+    }
+    return mask;
+#endif
+}
+
+static void set_ctrl(iwbrt_dict* dict, size_t slot, int8_t value) {
+    dict->ctrl[slot] = value;
+    if (slot < GROUP_WIDTH) {
+        dict->ctrl[dict->mask + 1 + slot] = value;
+    }
+}
+
+static void allocate(iwbrt_dict* dict, size_t capacity) {
+    dict->ctrl = malloc(capacity + GROUP_WIDTH);
+    dict->entries = malloc(capacity * sizeof(DictEntry));
+    if (!dict->ctrl || !dict->entries) fail_out_of_memory();
+    memset(dict->ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH);
+    dict->mask = capacity - 1;
+    dict->growth_left = capacity - capacity / 8 - dict->count;
+}
+
+// First empty slot on hash's probe sequence. Groups are visited at
+// triangular offsets, which reach every group of a power-of-two table.
+static size_t find_empty(const iwbrt_dict* dict, uint64_t hash) {
+    size_t pos = h1(hash) & dict->mask;
+    for (size_t step = GROUP_WIDTH;; step += GROUP_WIDTH) {
+        uint32_t empty = group_match(dict->ctrl + pos, CTRL_EMPTY);
+        if (empty) {
+            return (pos + __builtin_ctz(empty)) & dict->mask;
+        }
+        pos = (pos + step) & dict->mask;
+    }
+}
+
+// Doubles the table; stored hashes mean no key is hashed again
+static void grow(iwbrt_dict* dict) {
+    int8_t* old_ctrl = dict->ctrl;
+    DictEntry* old_entries = dict->entries;
+    size_t old_capacity = dict->mask + 1;
+
+    allocate(dict, old_capacity * 2);
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_ctrl[i] == CTRL_EMPTY) continue;
+        size_t slot = find_empty(dict, old_entries[i].hash);
+        set_ctrl(dict, slot, h2(old_entries[i].hash));
+        dict->entries[slot] = old_entries[i];
+    }
+    free(old_ctrl);
+    free(old_entries);
+}
+
+static int same_key(const DictEntry* entry, uint64_t hash, const char* data, int32_t key) {
+    if (entry->hash != hash || entry->key != key) return 0;
+    if (!data) return entry->data == NULL;
+    return entry->data && memcmp(entry->data, data, (size_t)key) == 0;
+}
+
+// The entry for the key (data NULL: the integer key; otherwise the
+// string of key bytes at data), or NULL when it is absent
+static DictEntry* find(const iwbrt_dict* dict, uint64_t hash, const char* data, int32_t key) {
+    size_t pos = h1(hash) & dict->mask;
+    int8_t tag = h2(hash);
+    for (size_t step = GROUP_WIDTH;; step += GROUP_WIDTH) {
+        const int8_t* group = dict->ctrl + pos;
+        for (uint32_t match = group_match(group, tag); match; match &= match - 1) {
+            DictEntry* entry = &dict->entries[(pos + __builtin_ctz(match)) & dict->mask];
+            if (same_key(entry, hash, data, key)) return entry;
+        }
+        if (group_match(group, CTRL_EMPTY)) return NULL;
+        pos = (pos + step) & dict->mask;
+    }
+}
+
+static DictEntry* insert(iwbrt_dict* dict, uint64_t hash, const char* data, int32_t key) {
+    if (dict->growth_left == 0) {
+        grow(dict);
+    }
+    size_t slot = find_empty(dict, hash);
+    set_ctrl(dict, slot, h2(hash));
+    dict->count++;
+    dict->growth_left--;
+
+    DictEntry* entry = &dict->entries[slot];
+    entry->hash = hash;
+    entry->key = key;
+    entry->value = 0;
+    entry->data = NULL;
+    if (data) {
+        entry->data = malloc(key > 0 ? (size_t)key : 1);
+        if (!entry->data) fail_out_of_memory();
+        memcpy(entry->data, data, (size_t)key);
+    }
+    return entry;
+}
+
+iwbrt_dict* iwbrt_dict_create(int32_t capacity) {
+    iwbrt_dict* dict = calloc(1, sizeof(iwbrt_dict));
+    if (!dict) return fail_out_of_memory();
+
+    // Room for capacity keys without growing
+    size_t slots = DICT_MIN_CAPACITY;
+    while (capacity > 0 && slots - slots / 8 < (size_t)capacity) {
+        slots *= 2;
+    }
+    allocate(dict, slots);
+    return dict;
+}
+
+void iwbrt_dict_destroy(iwbrt_dict* dict) {
+    if (!dict) return;
+    for (size_t i = 0; i <= dict->mask; i++) {
+        if (dict->ctrl[i] != CTRL_EMPTY) free(dict->entries[i].data);
+    }
+    free(dict->ctrl);
+    free(dict->entries);
+    free(dict);
+}
+
+int32_t iwbrt_dict_count(const iwbrt_dict* dict) {
+    return (int32_t)dict->count;
+}
+
+int32_t iwbrt_dict_get_int(const iwbrt_dict* dict, int32_t key) {
+    DictEntry* entry = find(dict, iwb_hash_int(key), NULL, key);
+    return entry ? entry->value : 0;
+}
+
+int32_t iwbrt_dict_has_int(const iwbrt_dict* dict, int32_t key) {
+    return find(dict, iwb_hash_int(key), NULL, key) != NULL;
+}
+
+int32_t* iwbrt_dict_slot_int(iwbrt_dict* dict, int32_t key) {
+    uint64_t hash = iwb_hash_int(key);
+    DictEntry* entry = find(dict, hash, NULL, key);
+    if (!entry) entry = insert(dict, hash, NULL, key);
+    return &entry->value;
+}
+
+int32_t iwbrt_dict_get_str(const iwbrt_dict* dict, const iwbrt_string* key, uint64_t hash) {
+    DictEntry* entry = find(dict, hash, iwbrt_string_bytes(key), (int32_t)key->length);
+    return entry ? entry->value : 0;
+}
+
+int32_t iwbrt_dict_has_str(const iwbrt_dict* dict, const iwbrt_string* key, uint64_t hash) {
+    return find(dict, hash, iwbrt_string_bytes(key), (int32_t)key->length) != NULL;
+}
+
+int32_t* iwbrt_dict_slot_str(iwbrt_dict* dict, const iwbrt_string* key, uint64_t hash) {
+    const char* bytes = iwbrt_string_bytes(key);
+    DictEntry* entry = find(dict, hash, bytes, (int32_t)key->length);
+    if (!entry) entry = insert(dict, hash, bytes, (int32_t)key->length);
+    return &entry->value;
+}
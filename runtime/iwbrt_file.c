@@ -0,0 +1,245 @@
+/*
+ * Line-oriented file I/O for OPEN/READLINE/WRITELINE/CLOSE
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * A regular file opened for reading is mapped whole, so reading it is
+ * a walk through memory with no system calls and no copying. Anything
+ * that cannot be mapped (pipes, terminals) is read in 1 MB chunks into
+ * a buffer that grows only if a single line is longer than it. Lines
+ * are found with memchr, which the C library implements with SIMD.
+ *
+ * READLINE either copies the line into the caller's arena or, when
+ * the generator has proven the variable does not keep the line past
+ * the next READLINE or CLOSE of the file, hands back a view of the
+ * bytes in place. Lines of 15 bytes or less are always stored inline.
+ *
+ * Output goes through a 1 MB buffer that is written out when full, on
+ * CLOSE, and at exit for files the program never closed.
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "iwbrt.h"
+#include "iwbrt_internal.h"
+
+#define IWBRT_FILE_BUFFER (1024 * 1024)
+
+struct iwbrt_file {
+    int fd;
+    int writing;
+    char* data;         // mapping or buffer
+    size_t size;        // bytes valid in data
+    size_t pos;         // next byte to read
+    size_t capacity;    // buffer size; 0 when data is a mapping
+    int at_end;         // no more bytes will come from fd
+    struct iwbrt_file* next_writer;
+};
+
+// Files open for writing, flushed at exit
+static struct {
+    pthread_mutex_t lock;
+    iwbrt_file* head;
+    int registered;
+} writers = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static void fail(const char* what, const char* path) {
+    fprintf(stderr, "iwbrt: cannot %s %s\n", what, path);
+    exit(1);
+}
+
+static char* path_string(const iwbrt_string* s) {
+    char* path = malloc(s->length + 1);
+    if (!path) fail("allocate path for", "file");
+    memcpy(path, iwbrt_string_bytes(s), s->length);
+    path[s->length] = '\0';
+    return path;
+}
+
+static void flush(iwbrt_file* file);
+
+static void flush_writers(void) {
+    pthread_mutex_lock(&writers.lock);
+    for (iwbrt_file* file = writers.head; file; file = file->next_writer) {
+        flush(file);
+    }
+    pthread_mutex_unlock(&writers.lock);
+}
+
+static void add_writer(iwbrt_file* file) {
+    pthread_mutex_lock(&writers.lock);
+    if (!writers.registered) {
+        atexit(flush_writers);
+        writers.registered = 1;
+    }
+    file->next_writer = writers.head;
+    writers.head = file;
+    pthread_mutex_unlock(&writers.lock);
+}
+
+static void remove_writer(iwbrt_file* file) {
+    pthread_mutex_lock(&writers.lock);
+    iwbrt_file** link = &writers.head;
+    while (*link != file) link = &(*link)->next_writer;
+    *link = file->next_writer;
+    pthread_mutex_unlock(&writers.lock);
+}
+
+iwbrt_file* iwbrt_file_open(const iwbrt_string* path, const iwbrt_string* mode) {
+    char* name = path_string(path);
+    char kind = mode && mode->length > 0 ? iwbrt_string_bytes(mode)[0] : 'r';
+    iwbrt_file* file = calloc(1, sizeof(iwbrt_file));
+    if (!file) fail("open", name);
+
+    if (kind == 'w' || kind == 'a') {
+        int flags = O_WRONLY | O_CREAT | (kind == 'w' ? O_TRUNC : O_APPEND);
+        file->fd = open(name, flags, 0666);
+        if (file->fd < 0) fail("open for writing", name);
+        file->writing = 1;
+        file->capacity = IWBRT_FILE_BUFFER;
+        file->data = malloc(file->capacity);
+        if (!file->data) fail("allocate a buffer for", name);
+        add_writer(file);
+        free(name);
+        return file;
+    }
+
+    file->fd = open(name, O_RDONLY);
+    if (file->fd < 0) fail("open", name);
+    struct stat info;
+    if (fstat(file->fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, (size_t)info.st_size, MADV_SEQUENTIAL);
+            file->data = map;
+            file->size = (size_t)info.st_size;
+            file->at_end = 1;
+            free(name);
+            return file;
+        }
+    }
+    file->capacity = IWBRT_FILE_BUFFER;
+    file->data = malloc(file->capacity);
+    if (!file->data) fail("allocate a buffer for", name);
+    free(name);
+    return file;
+}
+
+static void flush(iwbrt_file* file) {
+    size_t done = 0;
+    while (done < file->size) {
+        ssize_t n = write(file->fd, file->data + done, file->size - done);
+        if (n <= 0) {
+            fprintf(stderr, "iwbrt: write failed\n");
+            exit(1);
+        }
+        done += (size_t)n;
+    }
+    file->size = 0;
+}
+
+void iwbrt_file_close(iwbrt_file* file) {
+    if (!file) return;
+    if (file->writing) {
+        remove_writer(file);
+        flush(file);
+        free(file->data);
+    } else if (file->capacity == 0) {
+        if (file->data) munmap(file->data, file->size);
+    } else {
+        free(file->data);
+    }
+    close(file->fd);
+    free(file);
+}
+
+// Reads more input behind the unread bytes, moving those to the front
+// and growing the buffer when they already fill it
+static void refill(iwbrt_file* file) {
+    size_t unread = file->size - file->pos;
+    if (file->pos > 0) {
+        memmove(file->data, file->data + file->pos, unread);
+        file->pos = 0;
+        file->size = unread;
+    }
+    if (file->size == file->capacity) {
+        file->capacity *= 2;
+        file->data = realloc(file->data, file->capacity);
+        if (!file->data) fail("grow the buffer of", "file");
+    }
+    ssize_t n = read(file->fd, file->data + file->size, file->capacity - file->size);
+    if (n <= 0) {
+        file->at_end = 1;
+    } else {
+        file->size += (size_t)n;
+    }
+}
+
+int32_t iwbrt_file_eof(iwbrt_file* file) {
+    if (!file || file->writing) return -1;
+    while (file->pos == file->size && !file->at_end) {
+        refill(file);
+    }
+    return file->pos == file->size ? -1 : 0;
+}
+
+int32_t iwbrt_file_readline(iwbrt_file* file, iwbrt_arena* arena, iwbrt_string* line, int32_t view) {
+    line->length = 0;
+    line->capacity = STRING_INLINE;
+    if (iwbrt_file_eof(file)) return 0;
+
+    const char* start;
+    const char* newline;
+    for (;;) {
+        start = file->data + file->pos;
+        newline = memchr(start, '\n', file->size - file->pos);
+        if (newline || file->at_end) break;
+        refill(file);
+    }
+    size_t length = newline ? (size_t)(newline - start) : file->size - file->pos;
+    file->pos += length + (newline ? 1 : 0);
+    if (length > 0 && start[length - 1] == '\r') length--;
+
+    line->length = (uint32_t)length;
+    if (length < sizeof(line->small)) {
+        memcpy(line->small, start, length);
+    } else if (view) {
+        line->capacity = STRING_STATIC;
+        line->data = (char*)start;
+    } else {
+        line->capacity = (uint32_t)length;
+        line->data = iwbrt_arena_alloc(arena, length);
+        memcpy(line->data, start, length);
+    }
+    return -1;
+}
+
+void iwbrt_file_writeline(iwbrt_file* file, const iwbrt_string* text) {
+    if (!file || !file->writing) {
+        fprintf(stderr, "iwbrt: WRITELINE to a file not opened for writing\n");
+        exit(1);
+    }
+    const char* bytes = iwbrt_string_bytes(text);
+    size_t length = text->length;
+    if (file->size + length + 1 > file->capacity) {
+        flush(file);
+        if (length + 1 > file->capacity) {
+            // Too long to buffer: write it straight through
+            file->data[0] = '\n';
+            if (write(file->fd, bytes, length) != (ssize_t)length || write(file->fd, file->data, 1) != 1) {
+                fprintf(stderr, "iwbrt: write failed\n");
+                exit(1);
+            }
+            return;
+        }
+    }
+    memcpy(file->data + file->size, bytes, length);
+    file->data[file->size + length] = '\n';
+    file->size += length + 1;
+}
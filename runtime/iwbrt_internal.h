@@ -0,0 +1,50 @@
+/*
+ * IWBC runtime internals shared between the runtime's source files
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ */
+
+#ifndef IWBRT_INTERNAL_H
+#define IWBRT_INTERNAL_H
+
+#include <stdatomic.h>
+#include "iwbrt.h"
+
+// Spare threads started while pool threads are blocked on a channel
+#define IWBRT_MAX_SPARES 32
+
+// Index of the calling thread in the pool; the program's own thread is
+// 0 and spare threads follow the regular ones
+int iwbrt_worker_id(void);
+
+// Threads that may own a task deque: the pool plus the spares started
+// so far. iwbrt_worker_id() is always below it.
+int iwbrt_worker_slots(void);
+
+// Tasks pushed onto a deque and not yet taken by anyone
+extern _Atomic long iwbrt_queued_tasks;
+
+// Runs one queued task, preferring the caller's own deque and stealing
+// otherwise. Returns 0 when there was nothing to run.
+int iwbrt_run_queued_task(int self);
+
+// Wakes a sleeping pool thread after a task was queued
+void iwbrt_wake_worker(void);
+
+// Bracket a wait on another thread (a full or empty channel). While
+// inside, the caller counts as blocked and iwbrt_block_wait starts a
+// spare thread if tasks are queued and nobody is free to run them, so
+// the other end of the channel cannot starve behind the blocked ones.
+void iwbrt_block_begin(void);
+void iwbrt_block_wait(void);
+void iwbrt_block_end(void);
+
+// iwbrt_string capacity values with special meaning
+#define STRING_INLINE 0             // bytes live in small
+#define STRING_STATIC UINT32_MAX    // bytes are a literal in the program image
+
+static inline const char* iwbrt_string_bytes(const iwbrt_string* s) {
+    return s->capacity == STRING_INLINE ? s->small : s->data;
+}
+
+#endif
@@ -0,0 +1,256 @@
+/*
+ * Thread pool for PARALLEL FOR and SPAWN
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * The pool is started on the first parallel loop, never at program
+ * start. The caller of iwbrt_parallel_for works as thread 0 while the
+ * pool threads take the others. Each thread owns a slice of the
+ * iteration space and claims chunks from its front with one atomic
+ * add; a thread whose slice is empty claims chunks from the slices of
+ * the others the same way, so uneven iterations balance out without
+ * locks.
+ *
+ * Between loops the pool threads run queued SPAWN tasks (iwbrt_task.c)
+ * and only sleep when there is neither a new loop nor a task. A task
+ * blocked on a channel keeps its thread, so when every thread is
+ * blocked and tasks are still queued a spare thread is started to run
+ * them; spares run tasks only and never join loops.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "iwbrt.h"
+#include "iwbrt_internal.h"
+
+// Chunks handed out per thread; more chunks balance better, fewer cost
+// less in atomics
+#define IWBRT_CHUNKS_PER_THREAD 8
+
+// One thread's share of the iteration space, padded to a cache line so
+// claims on different slices do not contend
+typedef struct {
+    _Atomic int64_t next;       // first unclaimed iteration
+    int64_t end;                // one past the last iteration
+    char pad[64 - 2 * sizeof(int64_t)];
+} WorkSlice;
+
+static struct {
+    pthread_once_t once;
+    int thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        // signalled when a loop or task is published
+    pthread_cond_t done;        // signalled when the last helper finishes
+    pthread_mutex_t submit;     // one loop at a time
+    unsigned long generation;   // bumped per published loop
+    int busy;                   // helpers still working on the current loop
+    _Atomic int sleepers;       // pool threads waiting on wake
+    _Atomic int blocked;        // threads inside iwbrt_block_begin/end
+    _Atomic int spares;         // spare threads started
+
+    // The loop being run
+    iwbrt_range_fn body;
+    void* ctx;
+    int64_t chunk;
+    WorkSlice* slices;
+} pool = {
+    .once = PTHREAD_ONCE_INIT,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+    .submit = PTHREAD_MUTEX_INITIALIZER,
+};
+
+// True on pool threads and on a caller while its loop runs
+static _Thread_local int in_parallel = 0;
+
+static _Thread_local int worker_id = 0;
+
+int iwbrt_worker_id(void) {
+    return worker_id;
+}
+
+int iwbrt_worker_slots(void) {
+    return pool.thread_count + atomic_load(&pool.spares);
+}
+
+void iwbrt_wake_worker(void) {
+    // A thread about to sleep counts itself before its last look at
+    // the queue, so either it sees the task or we see it here
+    if (atomic_load(&pool.sleepers) > 0) {
+        pthread_mutex_lock(&pool.lock);
+        pthread_cond_signal(&pool.wake);
+        pthread_mutex_unlock(&pool.lock);
+    }
+}
+
+// Claims one chunk from slice; false once the slice is drained
+static int claim_chunk(WorkSlice* slice, int64_t chunk, int64_t* lo, int64_t* hi) {
+    if (atomic_load_explicit(&slice->next, memory_order_relaxed) >= slice->end) {
+        return 0;
+    }
+    int64_t first = atomic_fetch_add_explicit(&slice->next, chunk, memory_order_relaxed);
+    if (first >= slice->end) {
+        return 0;
+    }
+    *lo = first;
+    *hi = first + chunk < slice->end ? first + chunk : slice->end;
+    return 1;
+}
+
+// Drains this thread's slice, then steals from the others in turn
+static void run_slices(int self) {
+    int n = pool.thread_count;
+    int64_t lo, hi;
+    for (int offset = 0; offset < n; offset++) {
+        WorkSlice* slice = &pool.slices[(self + offset) % n];
+        while (claim_chunk(slice, pool.chunk, &lo, &hi)) {
+            pool.body(pool.ctx, (int32_t)lo, (int32_t)(hi - 1));
+        }
+    }
+}
+
+static void* worker_main(void* arg) {
+    int self = (int)(intptr_t)arg;
+    unsigned long seen = 0;
+    in_parallel = 1;
+    worker_id = self;
+
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        if (self >= pool.thread_count) {
+            seen = pool.generation;
+        }
+        if (pool.generation == seen) {
+            pthread_mutex_unlock(&pool.lock);
+            int ran = iwbrt_run_queued_task(self);
+            pthread_mutex_lock(&pool.lock);
+            if (ran) continue;
+
+            atomic_fetch_add(&pool.sleepers, 1);
+            if (pool.generation == seen && atomic_load(&iwbrt_queued_tasks) == 0) {
+                pthread_cond_wait(&pool.wake, &pool.lock);
+            }
+            atomic_fetch_sub(&pool.sleepers, 1);
+            continue;
+        }
+        seen = pool.generation;
+        pthread_mutex_unlock(&pool.lock);
+
+        run_slices(self);
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.busy == 0) {
+            pthread_cond_signal(&pool.done);
+        }
+    }
+    return NULL;
+}
+
+static void start_pool(void) {
+    const char* env = getenv("IWB_THREADS");
+    int count = env ? atoi(env) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    pool.thread_count = count > 0 ? count : 1;
+
+    if (posix_memalign((void**)&pool.slices, 64, pool.thread_count * sizeof(WorkSlice)) != 0) {
+        fprintf(stderr, "iwbrt: out of memory starting thread pool\n");
+        pool.thread_count = 1;
+        return;
+    }
+
+    for (int i = 1; i < pool.thread_count; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, worker_main, (void*)(intptr_t)i) != 0) {
+            // Work still completes: unstarted threads' slices get stolen
+            fprintf(stderr, "iwbrt: could only start %d of %d threads\n", i, pool.thread_count);
+            pool.thread_count = i;
+            break;
+        }
+        pthread_detach(thread);
+    }
+}
+
+void iwbrt_block_begin(void) {
+    atomic_fetch_add(&pool.blocked, 1);
+}
+
+void iwbrt_block_end(void) {
+    atomic_fetch_sub(&pool.blocked, 1);
+}
+
+void iwbrt_block_wait(void) {
+    if (atomic_load(&iwbrt_queued_tasks) > 0) {
+        if (atomic_load(&pool.sleepers) > 0) {
+            iwbrt_wake_worker();
+        } else if (atomic_load(&pool.spares) < atomic_load(&pool.blocked) &&
+                   atomic_load(&pool.spares) < IWBRT_MAX_SPARES) {
+            // Started under the lock so racing waiters start one spare
+            pthread_mutex_lock(&pool.lock);
+            int spares = atomic_load(&pool.spares);
+            if (spares < atomic_load(&pool.blocked) && spares < IWBRT_MAX_SPARES) {
+                pthread_t thread;
+                atomic_store(&pool.spares, spares + 1);
+                if (pthread_create(&thread, NULL, worker_main,
+                                   (void*)(intptr_t)(pool.thread_count + spares)) == 0) {
+                    pthread_detach(thread);
+                } else {
+                    atomic_store(&pool.spares, spares);
+                }
+            }
+            pthread_mutex_unlock(&pool.lock);
+        }
+    }
+    sched_yield();
+}
+
+int iwbrt_thread_count(void) {
+    pthread_once(&pool.once, start_pool);
+    return pool.thread_count;
+}
+
+void iwbrt_parallel_for(int32_t start, int32_t end, iwbrt_range_fn body, void* ctx) {
+    if (start > end) return;
+
+    int threads = iwbrt_thread_count();
+    int64_t total = (int64_t)end - start + 1;
+    if (threads == 1 || in_parallel || total == 1) {
+        body(ctx, start, end);
+        return;
+    }
+
+    pthread_mutex_lock(&pool.submit);
+    in_parallel = 1;
+
+    int64_t chunk = total / ((int64_t)threads * IWBRT_CHUNKS_PER_THREAD);
+    pool.chunk = chunk > 0 ? chunk : 1;
+    pool.body = body;
+    pool.ctx = ctx;
+    int64_t share = (total + threads - 1) / threads;
+    for (int i = 0; i < threads; i++) {
+        int64_t lo = start + share * i;
+        int64_t hi = lo + share < (int64_t)end + 1 ? lo + share : (int64_t)end + 1;
+        atomic_store_explicit(&pool.slices[i].next, lo, memory_order_relaxed);
+        pool.slices[i].end = hi > lo ? hi : lo;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.busy = threads - 1;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    run_slices(0);
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.busy > 0) {
+        pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    in_parallel = 0;
+    pthread_mutex_unlock(&pool.submit);
+}
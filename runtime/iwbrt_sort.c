@@ -0,0 +1,296 @@
+/*
+ * Sorting and searching for SORT, BSEARCH and FIND
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * DIM arrays hold i32, which a least-significant-digit radix sort
+ * orders in four linear passes over the data, one per byte. The
+ * histograms of all four bytes are built in a single pass up front,
+ * and a pass is skipped when every element has the same byte there
+ * (small or narrow-ranged values rarely need more than two passes).
+ *
+ * Radix sort needs a second buffer and has a fixed cost per pass, so
+ * arrays below IWBRT_RADIX_MIN elements, or for which the buffer cannot
+ * be had, are sorted in place with pattern-defeating quicksort
+ * (Orson Peters' pdqsort): quicksort that notices already sorted runs,
+ * breaks up patterns that would make it degrade and falls back to
+ * heapsort when partitions keep coming out lopsided.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "iwbrt.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define IWBRT_RADIX_MIN 1024
+
+// pdqsort tuning, as in the reference implementation
+#define INSERTION_SORT_MAX 24
+#define NINTHER_MIN 128
+#define PARTIAL_INSERTION_LIMIT 8
+
+static void swap(int32_t* a, int32_t* b) {
+    int32_t t = *a;
+    *a = *b;
+    *b = t;
+}
+
+static void insertion_sort(int32_t* begin, int32_t* end) {
+    for (int32_t* cur = begin + 1; cur < end; cur++) {
+        int32_t value = *cur;
+        int32_t* hole = cur;
+        while (hole > begin && value < hole[-1]) {
+            *hole = hole[-1];
+            hole--;
+        }
+        *hole = value;
+    }
+}
+
+// Insertion sort that gives up after moving PARTIAL_INSERTION_LIMIT
+// elements; true if the range ended up sorted
+static int partial_insertion_sort(int32_t* begin, int32_t* end) {
+    size_t moved = 0;
+    for (int32_t* cur = begin + 1; cur < end; cur++) {
+        int32_t value = *cur;
+        int32_t* hole = cur;
+        while (hole > begin && value < hole[-1]) {
+            *hole = hole[-1];
+            hole--;
+        }
+        *hole = value;
+        moved += (size_t)(cur - hole);
+        if (moved > PARTIAL_INSERTION_LIMIT) return cur + 1 == end;
+    }
+    return 1;
+}
+
+static void sift_down(int32_t* heap, size_t count, size_t root) {
+    for (;;) {
+        size_t child = 2 * root + 1;
+        if (child >= count) return;
+        if (child + 1 < count && heap[child] < heap[child + 1]) child++;
+        if (heap[root] >= heap[child]) return;
+        swap(&heap[root], &heap[child]);
+        root = child;
+    }
+}
+
+static void heap_sort(int32_t* begin, int32_t* end) {
+    size_t count = (size_t)(end - begin);
+    for (size_t i = count / 2; i-- > 0;) {
+        sift_down(begin, count, i);
+    }
+    for (size_t i = count; i-- > 1;) {
+        swap(&begin[0], &begin[i]);
+        sift_down(begin, i, 0);
+    }
+}
+
+static void sort3(int32_t* a, int32_t* b, int32_t* c) {
+    if (*b < *a) swap(a, b);
+    if (*c < *b) swap(b, c);
+    if (*b < *a) swap(a, b);
+}
+
+// Partitions around the pivot at *begin: afterwards everything left of
+// the returned position is smaller and everything right of it is not.
+// *already is set when no element had to move.
+static int32_t* partition_right(int32_t* begin, int32_t* end, int* already) {
+    int32_t pivot = *begin;
+    int32_t* first = begin;
+    int32_t* last = end;
+    while (*++first < pivot) {}
+    if (first - 1 == begin) {
+        while (first < last && !(*--last < pivot)) {}
+    } else {
+        while (!(*--last < pivot)) {}
+    }
+    *already = first >= last;
+    while (first < last) {
+        swap(first, last);
+        while (*++first < pivot) {}
+        while (!(*--last < pivot)) {}
+    }
+    int32_t* pivot_pos = first - 1;
+    *begin = *pivot_pos;
+    *pivot_pos = pivot;
+    return pivot_pos;
+}
+
+// Puts elements equal to the pivot at *begin on the left; used when the
+// pivot equals the element before the range, so nothing to the left of
+// the range can be smaller and the equal run is done
+static int32_t* partition_left(int32_t* begin, int32_t* end) {
+    int32_t pivot = *begin;
+    int32_t* first = begin;
+    int32_t* last = end;
+    while (pivot < *--last) {}
+    if (last + 1 == end) {
+        while (first < last && !(pivot < *++first)) {}
+    } else {
+        while (!(pivot < *++first)) {}
+    }
+    while (first < last) {
+        swap(first, last);
+        while (pivot < *--last) {}
+        while (!(pivot < *++first)) {}
+    }
+    *begin = *last;
+    *last = pivot;
+    return last;
+}
+
+static void pdqsort_loop(int32_t* begin, int32_t* end, int bad_allowed, int leftmost) {
+    for (;;) {
+        size_t size = (size_t)(end - begin);
+        if (size < INSERTION_SORT_MAX) {
+            insertion_sort(begin, end);
+            return;
+        }
+
+        // Median of three, or the median of three medians for large
+        // ranges, moved to *begin
+        size_t half = size / 2;
+        if (size > NINTHER_MIN) {
+            sort3(begin, begin + half, end - 1);
+            sort3(begin + 1, begin + (half - 1), end - 2);
+            sort3(begin + 2, begin + (half + 1), end - 3);
+            sort3(begin + (half - 1), begin + half, begin + (half + 1));
+            swap(begin, begin + half);
+        } else {
+            sort3(begin + half, begin, end - 1);
+        }
+
+        if (!leftmost && !(begin[-1] < *begin)) {
+            begin = partition_left(begin, end) + 1;
+            continue;
+        }
+
+        int already;
+        int32_t* pivot = partition_right(begin, end, &already);
+        size_t left_size = (size_t)(pivot - begin);
+        size_t right_size = (size_t)(end - (pivot + 1));
+
+        if (left_size < size / 8 || right_size < size / 8) {
+            // Lopsided: after too many, stop trusting quicksort; until
+            // then shuffle a few elements to break the pattern
+            if (--bad_allowed == 0) {
+                heap_sort(begin, end);
+                return;
+            }
+            if (left_size >= INSERTION_SORT_MAX) {
+                swap(begin, begin + left_size / 4);
+                swap(pivot - 1, pivot - left_size / 4);
+            }
+            if (right_size >= INSERTION_SORT_MAX) {
+                swap(pivot + 1, pivot + 1 + right_size / 4);
+                swap(end - 1, end - right_size / 4);
+            }
+        } else if (already && partial_insertion_sort(begin, pivot) &&
+                   partial_insertion_sort(pivot + 1, end)) {
+            return;
+        }
+
+        // Recurse into the left part, loop on the right
+        pdqsort_loop(begin, pivot, bad_allowed, leftmost);
+        begin = pivot + 1;
+        leftmost = 0;
+    }
+}
+
+static void pdqsort(int32_t* values, int64_t count) {
+    int log2 = 0;
+    for (int64_t n = count; n > 1; n >>= 1) log2++;
+    pdqsort_loop(values, values + count, log2, 1);
+}
+
+// Sorts on the bytes of value ^ 0x80000000, which orders signed values
+static int radix_sort(int32_t* values, int64_t count) {
+    uint32_t* buffer = malloc((size_t)count * sizeof(uint32_t));
+    if (!buffer) return 0;
+
+    size_t histogram[4][256];
+    memset(histogram, 0, sizeof(histogram));
+    uint32_t* keys = (uint32_t*)values;
+    for (int64_t i = 0; i < count; i++) {
+        uint32_t key = keys[i] ^ 0x80000000u;
+        histogram[0][key & 0xff]++;
+        histogram[1][(key >> 8) & 0xff]++;
+        histogram[2][(key >> 16) & 0xff]++;
+        histogram[3][key >> 24]++;
+    }
+
+    uint32_t* from = keys;
+    uint32_t* to = buffer;
+    for (int pass = 0; pass < 4; pass++) {
+        int shift = 8 * pass;
+        size_t* counts = histogram[pass];
+        if (counts[((from[0] ^ 0x80000000u) >> shift) & 0xff] == (size_t)count) {
+            continue;
+        }
+        size_t offset = 0;
+        for (int b = 0; b < 256; b++) {
+            size_t n = counts[b];
+            counts[b] = offset;
+            offset += n;
+        }
+        for (int64_t i = 0; i < count; i++) {
+            uint32_t value = from[i];
+            to[counts[((value ^ 0x80000000u) >> shift) & 0xff]++] = value;
+        }
+        uint32_t* t = from;
+        from = to;
+        to = t;
+    }
+
+    if (from != keys) {
+        memcpy(keys, from, (size_t)count * sizeof(uint32_t));
+    }
+    free(buffer);
+    return 1;
+}
+
+void iwbrt_sort_i32(int32_t* values, int64_t count) {
+    if (count < 2) return;
+    if (count >= IWBRT_RADIX_MIN && radix_sort(values, count)) return;
+    pdqsort(values, count);
+}
+
+int32_t iwbrt_bsearch_i32(const int32_t* values, int64_t count, int32_t key) {
+    // Branch-free lower bound: the loop always runs log2(count) times
+    const int32_t* base = values;
+    int64_t n = count;
+    while (n > 1) {
+        int64_t half = n / 2;
+        base = base[half - 1] < key ? base + half : base;
+        n -= half;
+    }
+    if (count > 0 && *base < key) base++;
+    int64_t index = base - values;
+    return index < count && values[index] == key ? (int32_t)index : -1;
+}
+
+int32_t iwbrt_find_i32(const int32_t* values, int64_t count, int32_t key) {
+    int64_t i = 0;
+#ifdef __SSE2__
+    // 16 elements per step: four compares folded into one test
+    __m128i needle = _mm_set1_epi32(key);
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(values + i)), needle);
+        __m128i b = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(values + i + 4)), needle);
+        __m128i c = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(values + i + 8)), needle);
+        __m128i d = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(values + i + 12)), needle);
+        __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+        if (_mm_movemask_epi8(any)) break;
+    }
+#endif
+    for (; i < count; i++) {
+        if (values[i] == key) return (int32_t)i;
+    }
+    return -1;
+}
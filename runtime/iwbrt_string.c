@@ -0,0 +1,221 @@
+/*
+ * Strings and arenas for BASIC string variables
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * A string is a 24-byte value carrying its length. Up to 15 bytes are
+ * stored inline, so short strings and every formatted number never
+ * touch the allocator. Longer strings point into the arena of the
+ * function that built them; the arena is released in one go when the
+ * function returns, so strings are never freed one by one. Loops that
+ * build strings collect it now and then (iwbrt_arena_collect), moving
+ * what the variables still hold and dropping the rest.
+ *
+ * Copies share the bytes but drop any spare capacity, which makes the
+ * spare room after a string's bytes private to the variable that grew
+ * it. That is what lets s = s + x and APPEND extend a string in place,
+ * doubling its buffer when it runs out, instead of copying the whole
+ * string every time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "iwbhash.h"
+#include "iwbrt.h"
+#include "iwbrt_internal.h"
+
+// First arena block; each further block doubles up to the maximum
+#define IWBRT_ARENA_FIRST_BLOCK 4096
+#define IWBRT_ARENA_MAX_BLOCK (1024 * 1024)
+// An arena is first collected once its blocks pass this many bytes, and
+// after that once they pass twice what the last collection kept
+#define IWBRT_ARENA_COLLECT_AT (4 * 1024 * 1024)
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* previous;
+    size_t size;
+    char data[];
+} ArenaBlock;
+
+static void* fail_out_of_memory(void) {
+    fprintf(stderr, "iwbrt: out of memory building string\n");
+    exit(1);
+}
+
+void* iwbrt_arena_alloc(iwbrt_arena* arena, size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    if ((size_t)(arena->end - arena->next) < size) {
+        size_t block_size = arena->last_size ? arena->last_size * 2 : IWBRT_ARENA_FIRST_BLOCK;
+        if (block_size > IWBRT_ARENA_MAX_BLOCK) block_size = IWBRT_ARENA_MAX_BLOCK;
+        if (block_size < size) block_size = size;
+
+        ArenaBlock* block = malloc(sizeof(ArenaBlock) + block_size);
+        if (!block) return fail_out_of_memory();
+        block->previous = arena->head;
+        block->size = block_size;
+        arena->head = block;
+        arena->last_size = block_size;
+        arena->used += block_size;
+        arena->next = block->data;
+        arena->end = block->data + block_size;
+    }
+    void* memory = arena->next;
+    arena->next += size;
+    return memory;
+}
+
+void iwbrt_arena_release(iwbrt_arena* arena) {
+    ArenaBlock* block = arena->head;
+    while (block) {
+        ArenaBlock* previous = block->previous;
+        free(block);
+        block = previous;
+    }
+    memset(arena, 0, sizeof(*arena));
+}
+
+static int in_arena(const iwbrt_arena* arena, const char* data) {
+    for (ArenaBlock* block = arena->head; block; block = block->previous) {
+        if (data >= block->data && data < block->data + block->size) return 1;
+    }
+    return 0;
+}
+
+void iwbrt_arena_collect(iwbrt_arena* arena, iwbrt_string** roots, int32_t count) {
+    size_t limit = arena->limit ? arena->limit : IWBRT_ARENA_COLLECT_AT;
+    if (arena->used <= limit) return;
+
+    iwbrt_arena kept = { 0 };
+    for (int32_t i = 0; i < count; i++) {
+        iwbrt_string* s = roots[i];
+        if (s->capacity == STRING_INLINE || s->capacity == STRING_STATIC || !in_arena(arena, s->data)) {
+            continue;
+        }
+        // Copies share bytes; they move together, into room for the
+        // longest of them and for the one spare capacity belongs to
+        char* old = s->data;
+        size_t length = s->length;
+        size_t capacity = s->capacity;
+        for (int32_t j = i + 1; j < count; j++) {
+            iwbrt_string* other = roots[j];
+            if (other->capacity != STRING_INLINE && other->capacity != STRING_STATIC && other->data == old) {
+                if (other->length > length) length = other->length;
+                if (other->capacity > capacity) capacity = other->capacity;
+            }
+        }
+        char* data = iwbrt_arena_alloc(&kept, capacity);
+        memcpy(data, old, length);
+        for (int32_t j = i; j < count; j++) {
+            iwbrt_string* other = roots[j];
+            if (other->capacity != STRING_INLINE && other->capacity != STRING_STATIC && other->data == old) {
+                other->data = data;
+            }
+        }
+    }
+    iwbrt_arena_release(arena);
+    *arena = kept;
+    arena->limit = 2 * kept.used > IWBRT_ARENA_COLLECT_AT ? 2 * kept.used : IWBRT_ARENA_COLLECT_AT;
+}
+
+// Room for count bytes in total without moving, or 0
+static int has_room(const iwbrt_string* s, size_t count) {
+    if (s->capacity == STRING_INLINE) return count < sizeof(s->small);
+    if (s->capacity == STRING_STATIC) return 0;
+    return count <= s->capacity;
+}
+
+// Makes s hold at least capacity bytes, keeping its contents
+static char* make_room(iwbrt_arena* arena, iwbrt_string* s, size_t capacity) {
+    if (has_room(s, capacity)) {
+        return (char*)iwbrt_string_bytes(s);
+    }
+    if (capacity < sizeof(s->small)) {
+        // Only a static string can get here: bring it inline
+        char bytes[sizeof(s->small)];
+        memcpy(bytes, iwbrt_string_bytes(s), s->length);
+        memcpy(s->small, bytes, s->length);
+        s->capacity = STRING_INLINE;
+        return s->small;
+    }
+    if (capacity > UINT32_MAX - 1) {
+        fprintf(stderr, "iwbrt: string too long\n");
+        exit(1);
+    }
+    char* data = iwbrt_arena_alloc(arena, capacity);
+    memcpy(data, iwbrt_string_bytes(s), s->length);
+    s->data = data;
+    s->capacity = (uint32_t)capacity;
+    return data;
+}
+
+void iwbrt_string_assign(iwbrt_string* dst, const iwbrt_string* src) {
+    if (dst == src) return;
+    *dst = *src;
+    if (dst->capacity != STRING_INLINE && dst->capacity != STRING_STATIC) {
+        dst->capacity = dst->length;
+    }
+}
+
+void iwbrt_string_reserve(iwbrt_arena* arena, iwbrt_string* s, int32_t capacity) {
+    s->length = 0;
+    s->capacity = STRING_INLINE;
+    if (capacity > 0) {
+        make_room(arena, s, (size_t)capacity);
+    }
+}
+
+void iwbrt_string_detach(iwbrt_arena* arena, iwbrt_string* s) {
+    if (s->capacity == STRING_STATIC) {
+        make_room(arena, s, s->length);
+    }
+}
+
+void iwbrt_string_append(iwbrt_arena* arena, iwbrt_string* s, const iwbrt_string* tail) {
+    size_t length = (size_t)s->length + tail->length;
+    if (!has_room(s, length)) {
+        size_t capacity = 2 * (size_t)s->length;
+        if (capacity < length) capacity = length;
+        if (capacity < 32) capacity = 32;
+        make_room(arena, s, capacity);
+    }
+    // tail may be s itself; its bytes stay put while we write past them
+    memmove((char*)iwbrt_string_bytes(s) + s->length, iwbrt_string_bytes(tail), tail->length);
+    s->length = (uint32_t)length;
+}
+
+void iwbrt_string_concat(iwbrt_arena* arena, iwbrt_string* out, const iwbrt_string* a, const iwbrt_string* b) {
+    size_t length = (size_t)a->length + b->length;
+    iwbrt_string result = { 0 };
+    char* bytes = length < sizeof(result.small) ? result.small : make_room(arena, &result, length);
+    memcpy(bytes, iwbrt_string_bytes(a), a->length);
+    memcpy(bytes + a->length, iwbrt_string_bytes(b), b->length);
+    result.length = (uint32_t)length;
+    *out = result;
+}
+
+void iwbrt_string_from_int(iwbrt_string* out, int32_t value) {
+    out->capacity = STRING_INLINE;
+    out->length = (uint32_t)snprintf(out->small, sizeof(out->small), "%d", value);
+}
+
+void iwbrt_string_from_float(iwbrt_string* out, float value) {
+    out->capacity = STRING_INLINE;
+    out->length = (uint32_t)snprintf(out->small, sizeof(out->small), "%g", value);
+}
+
+int32_t iwbrt_string_compare(const iwbrt_string* a, const iwbrt_string* b) {
+    size_t shorter = a->length < b->length ? a->length : b->length;
+    int order = memcmp(iwbrt_string_bytes(a), iwbrt_string_bytes(b), shorter);
+    if (order != 0) return order < 0 ? -1 : 1;
+    return a->length < b->length ? -1 : a->length > b->length;
+}
+
+void iwbrt_string_print(const iwbrt_string* s) {
+    fwrite(iwbrt_string_bytes(s), 1, s->length, stdout);
+    fputc('\n', stdout);
+}
+
+uint64_t iwbrt_string_hash(const iwbrt_string* s) {
+    return iwb_hash_bytes(iwbrt_string_bytes(s), s->length);
+}
@@ -0,0 +1,223 @@
+/*
+ * Task scheduler for SPAWN/AWAIT
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * Every pool thread owns a Chase-Lev deque. SPAWN pushes onto the
+ * bottom of the spawning thread's deque without locks; the owner pops
+ * from the bottom (newest first, which keeps recursive work cache-warm)
+ * and idle threads steal from the top (oldest first, which hands them
+ * the biggest pieces of a divide-and-conquer tree). AWAIT never blocks
+ * while there is work: it runs queued tasks until the awaited one is
+ * done. Spare threads (see iwbrt_pool.c) own deques after the pool's.
+ *
+ * Handles may be copied freely, so AWAIT never frees a task. A task is
+ * held by the frame that spawned it, on a list released when the frame
+ * returns, and by its run until the result is stored; whichever lets go
+ * last frees it.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "iwbrt.h"
+#include "iwbrt_internal.h"
+
+// Slots per deque; a spawn into a full deque runs the task on the spot
+#define IWBRT_DEQUE_CAPACITY 4096
+
+enum { TASK_QUEUED, TASK_DONE };
+
+struct iwbrt_task {
+    iwbrt_task_fn fn;
+    _Atomic int state;
+    _Atomic int holds;          // the spawning frame and the run
+    int32_t result;
+    iwbrt_task* next;           // the spawning frame's next task
+    char args[];                // copy of the spawner's argument block
+};
+
+// Top and bottom sit on separate cache lines: thieves write one, the
+// owner the other
+typedef struct {
+    _Atomic int64_t top;
+    char pad1[64 - sizeof(int64_t)];
+    _Atomic int64_t bottom;
+    char pad2[64 - sizeof(int64_t)];
+    iwbrt_task* _Atomic slots[IWBRT_DEQUE_CAPACITY];
+} TaskDeque;
+
+_Atomic long iwbrt_queued_tasks = 0;
+
+// One slot per pool thread and possible spare; a deque is allocated the
+// first time its owner spawns
+static pthread_once_t deques_once = PTHREAD_ONCE_INIT;
+static TaskDeque* _Atomic* _Atomic deques = NULL;
+
+static void create_deque_table(void) {
+    int count = iwbrt_thread_count() + IWBRT_MAX_SPARES;
+    TaskDeque* _Atomic* table = calloc(count, sizeof(*table));
+    if (!table) {
+        fprintf(stderr, "iwbrt: out of memory creating task queues\n");
+        exit(1);
+    }
+    atomic_store(&deques, table);
+}
+
+static TaskDeque* own_deque(int self) {
+    TaskDeque* _Atomic* table = atomic_load(&deques);
+    TaskDeque* deque = atomic_load_explicit(&table[self], memory_order_relaxed);
+    if (!deque) {
+        if (posix_memalign((void**)&deque, 64, sizeof(TaskDeque)) != 0) {
+            fprintf(stderr, "iwbrt: out of memory creating task queue\n");
+            exit(1);
+        }
+        memset(deque, 0, sizeof(TaskDeque));
+        atomic_store_explicit(&table[self], deque, memory_order_release);
+    }
+    return deque;
+}
+
+// Owner only. Returns 0 when the deque is full.
+static int deque_push(TaskDeque* d, iwbrt_task* task) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    if (b - t >= IWBRT_DEQUE_CAPACITY) {
+        return 0;
+    }
+    atomic_store_explicit(&d->slots[b % IWBRT_DEQUE_CAPACITY], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return 1;
+}
+
+// Owner only
+static iwbrt_task* deque_pop(TaskDeque* d) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+    iwbrt_task* task = atomic_load_explicit(&d->slots[b % IWBRT_DEQUE_CAPACITY], memory_order_relaxed);
+    if (t == b) {
+        // Last task: race the thieves for it through top
+        if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                memory_order_seq_cst, memory_order_relaxed)) {
+            task = NULL;
+        }
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+// Any thread
+static iwbrt_task* deque_steal(TaskDeque* d) {
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b) {
+        return NULL;
+    }
+    iwbrt_task* task = atomic_load_explicit(&d->slots[t % IWBRT_DEQUE_CAPACITY], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+            memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return task;
+}
+
+static void drop_hold(iwbrt_task* task) {
+    if (atomic_fetch_sub_explicit(&task->holds, 1, memory_order_acq_rel) == 1) {
+        free(task);
+    }
+}
+
+static void run_task(iwbrt_task* task) {
+    task->result = task->fn(task->args);
+    atomic_store_explicit(&task->state, TASK_DONE, memory_order_release);
+    drop_hold(task);
+}
+
+int iwbrt_run_queued_task(int self) {
+    TaskDeque* _Atomic* table = atomic_load(&deques);
+    if (!table || atomic_load_explicit(&iwbrt_queued_tasks, memory_order_relaxed) == 0) {
+        return 0;
+    }
+
+    iwbrt_task* task = NULL;
+    TaskDeque* mine = atomic_load_explicit(&table[self], memory_order_relaxed);
+    if (mine) {
+        task = deque_pop(mine);
+    }
+    int slots = iwbrt_worker_slots();
+    for (int offset = 1; !task && offset < slots; offset++) {
+        TaskDeque* victim = atomic_load_explicit(&table[(self + offset) % slots], memory_order_acquire);
+        if (victim) {
+            task = deque_steal(victim);
+        }
+    }
+    if (!task) {
+        return 0;
+    }
+    atomic_fetch_sub(&iwbrt_queued_tasks, 1);
+    run_task(task);
+    return 1;
+}
+
+iwbrt_task* iwbrt_spawn(iwbrt_task_fn fn, const void* args, size_t size, iwbrt_task** owner) {
+    pthread_once(&deques_once, create_deque_table);
+
+    iwbrt_task* task = malloc(sizeof(iwbrt_task) + size);
+    if (!task) {
+        fprintf(stderr, "iwbrt: out of memory spawning task\n");
+        exit(1);
+    }
+    task->fn = fn;
+    atomic_init(&task->state, TASK_QUEUED);
+    atomic_init(&task->holds, 2);
+    task->next = *owner;
+    *owner = task;
+    memcpy(task->args, args, size);
+
+    if (!deque_push(own_deque(iwbrt_worker_id()), task)) {
+        run_task(task);
+        return task;
+    }
+    atomic_fetch_add(&iwbrt_queued_tasks, 1);
+    iwbrt_wake_worker();
+    return task;
+}
+
+int32_t iwbrt_await(iwbrt_task* task) {
+    if (!task) {
+        fprintf(stderr, "iwbrt: AWAIT of a handle no SPAWN set\n");
+        exit(1);
+    }
+    int self = iwbrt_worker_id();
+    while (atomic_load_explicit(&task->state, memory_order_acquire) != TASK_DONE) {
+        // The awaited task is either still queued, most likely on our
+        // own deque, or running elsewhere; either way help out
+        if (!iwbrt_run_queued_task(self)) {
+            sched_yield();
+        }
+    }
+    return task->result;
+}
+
+void iwbrt_tasks_release(iwbrt_task** owner) {
+    iwbrt_task* task = *owner;
+    *owner = NULL;
+    while (task) {
+        iwbrt_task* next = task->next;
+        drop_hold(task);
+        task = next;
+    }
+}
@@ -0,0 +1,352 @@
+/*
+ * Compilation cache for IWBC
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * Outputs are kept in a directory, one file per compile, named by a
+ * 128-bit key: the hash of the source bytes followed by a hash over
+ * that, the source's directory, the compiler build, the options that
+ * change the output and, for object files, the host triple, CPU and
+ * features. The compiler build is told apart by the GNU build IDs of
+ * every loaded object (libiwbc and LLVM among them), or by the bytes of
+ * the object holding the compiler when it has no build ID, so a rebuilt
+ * compiler never serves what an older one wrote.
+ *
+ * A program that INCLUDEs other files depends on more than its own
+ * bytes, so an entry starts with the path and content hash of every
+ * file the compile read in; a fetch checks them against the files as
+ * they are now and misses if any changed or went away.
+ *
+ * Entries are written to a temporary file in the cache directory and
+ * renamed into place, so a reader sees either nothing or a whole file,
+ * and several compilers may share one cache. A hit copies the entry to
+ * the output and refreshes its time; trimming deletes entries oldest
+ * first until the directory is back under its size limit. Nothing but
+ * key-named entries and stale temporary files is ever deleted.
+ */
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <link.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/TargetMachine.h>
+#include "cache.h"
+#include "iwbhash.h"
+
+#define CACHE_COPY_BUFFER (1024 * 1024)
+#define CACHE_ENTRY_MAGIC "IWBCENT1"
+
+// Temporary files older than this were left by a compile that died
+#define CACHE_STALE_SECONDS 3600
+
+static pthread_once_t identity_once = PTHREAD_ONCE_INIT;
+static uint64_t identity;
+
+static bool hash_file(const char* path, uint64_t* hash) {
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    size_t size = (size_t)info.st_size;
+    if (size == 0) {
+        *hash = iwb_hash_bytes("", 0);
+        close(fd);
+        return true;
+    }
+    char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    madvise(data, size, MADV_SEQUENTIAL);
+    *hash = iwb_hash_bytes(data, size);
+    munmap(data, size);
+    return true;
+}
+
+typedef struct {
+    const char* compiler;   // an address inside the compiler's code
+    int objects;            // loaded objects seen so far
+    int compiler_object;    // which of them holds the compiler, or -1
+    bool compiler_has_id;   // and whether it had a build ID
+} BuildIdScan;
+
+// Folds the GNU build ID note of a loaded object into identity
+static int add_build_id(struct dl_phdr_info* info, size_t size, void* data) {
+    (void)size;
+    BuildIdScan* scan = data;
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+        const char* start = (const char*)(info->dlpi_addr + phdr->p_vaddr);
+        if (phdr->p_type == PT_LOAD && scan->compiler >= start && scan->compiler < start + phdr->p_memsz) {
+            scan->compiler_object = scan->objects;
+        }
+    }
+    bool has_id = false;
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+        if (phdr->p_type != PT_NOTE) continue;
+        const char* note = (const char*)(info->dlpi_addr + phdr->p_vaddr);
+        const char* end = note + phdr->p_memsz;
+        while (note + sizeof(ElfW(Nhdr)) <= end) {
+            const ElfW(Nhdr)* header = (const ElfW(Nhdr)*)note;
+            const char* name = note + sizeof(ElfW(Nhdr));
+            const char* desc = name + ((header->n_namesz + 3) & ~3u);
+            if (header->n_type == NT_GNU_BUILD_ID && header->n_namesz == 4 && memcmp(name, "GNU", 4) == 0) {
+                identity = iwb_hash_finish(identity ^ iwb_hash_bytes(desc, header->n_descsz));
+                has_id = true;
+            }
+            note = desc + ((header->n_descsz + 3) & ~3u);
+        }
+    }
+    if (scan->compiler_object == scan->objects) scan->compiler_has_id = has_id;
+    scan->objects++;
+    return 0;
+}
+
+static void compute_identity(void) {
+    BuildIdScan scan = { (const char*)(uintptr_t)&cache_key, 0, -1, false };
+    dl_iterate_phdr(add_build_id, &scan);
+    if (!scan.compiler_has_id) {
+        // Linked without build IDs: go by the bytes of the file the
+        // compiler was loaded from, libiwbc.so when iwbc launched it.
+        // The first object is the executable, which dladdr names by
+        // argv[0].
+        Dl_info where;
+        uint64_t hash = 0;
+        if (scan.compiler_object == 0 || !dladdr((void*)(uintptr_t)&cache_key, &where) ||
+            !where.dli_fname || !hash_file(where.dli_fname, &hash)) {
+            hash_file("/proc/self/exe", &hash);
+        }
+        identity = iwb_hash_finish(identity ^ hash);
+    }
+}
+
+static uint64_t mix_string(uint64_t hash, const char* text) {
+    return iwb_hash_finish(hash ^ iwb_hash_bytes(text, strlen(text)));
+}
+
+bool cache_key(const char* input, const char* options, bool object, char* key) {
+    uint64_t source;
+    if (!hash_file(input, &source)) return false;
+    // INCLUDE names resolve against the input's directory, so the same
+    // bytes elsewhere may read in other files
+    char* real = realpath(input, NULL);
+    if (!real) return false;
+    char* slash = strrchr(real, '/');
+    slash[slash == real ? 1 : 0] = '\0';
+    pthread_once(&identity_once, compute_identity);
+
+    uint64_t config = iwb_hash_finish(identity ^ source);
+    config = mix_string(config, real);
+    config = mix_string(config, options);
+    free(real);
+    if (object) {
+        char* triple = LLVMGetDefaultTargetTriple();
+        char* cpu = LLVMGetHostCPUName();
+        char* features = LLVMGetHostCPUFeatures();
+        config = mix_string(config, triple);
+        config = mix_string(config, cpu);
+        config = mix_string(config, features);
+        LLVMDisposeMessage(triple);
+        LLVMDisposeMessage(cpu);
+        LLVMDisposeMessage(features);
+    }
+    snprintf(key, CACHE_KEY_LENGTH + 1, "%016llx%016llx",
+             (unsigned long long)source, (unsigned long long)config);
+    return true;
+}
+
+static char* path_in(const char* dir, const char* name) {
+    char* path = malloc(strlen(dir) + strlen(name) + 2);
+    sprintf(path, "%s/%s", dir, name);
+    return path;
+}
+
+static bool copy_fd(int in, int out) {
+    char* buffer = malloc(CACHE_COPY_BUFFER);
+    if (!buffer) return false;
+    bool ok = true;
+    for (;;) {
+        ssize_t n = read(in, buffer, CACHE_COPY_BUFFER);
+        if (n == 0) break;
+        if (n < 0) {
+            ok = false;
+            break;
+        }
+        ssize_t done = 0;
+        while (done < n) {
+            ssize_t written = write(out, buffer + done, (size_t)(n - done));
+            if (written <= 0) {
+                ok = false;
+                break;
+            }
+            done += written;
+        }
+        if (!ok) break;
+    }
+    free(buffer);
+    return ok;
+}
+
+static bool read_exact(int fd, void* data, size_t size) {
+    return read(fd, data, size) == (ssize_t)size;
+}
+
+static bool write_exact(int fd, const void* data, size_t size) {
+    return write(fd, data, size) == (ssize_t)size;
+}
+
+// Reads the entry's list of files read in, leaving in at the output;
+// true when every one of them still has the content it had
+static bool dependencies_current(int in) {
+    char magic[8];
+    uint32_t count;
+    if (!read_exact(in, magic, sizeof(magic)) || memcmp(magic, CACHE_ENTRY_MAGIC, sizeof(magic)) != 0 ||
+        !read_exact(in, &count, sizeof(count))) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t length;
+        uint64_t hash;
+        if (!read_exact(in, &length, sizeof(length)) || length >= PATH_MAX) return false;
+        char path[PATH_MAX];
+        if (!read_exact(in, path, length) || !read_exact(in, &hash, sizeof(hash))) return false;
+        path[length] = '\0';
+        uint64_t current;
+        if (!hash_file(path, &current) || current != hash) return false;
+    }
+    return true;
+}
+
+bool cache_fetch(const CompileCache* cache, const char* key, const char* output) {
+    char* path = path_in(cache->dir, key);
+    int in = open(path, O_RDONLY);
+    if (in < 0) {
+        free(path);
+        return false;
+    }
+    if (!dependencies_current(in)) {
+        close(in);
+        free(path);
+        return false;
+    }
+    int out = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    bool ok = out >= 0 && copy_fd(in, out);
+    if (out >= 0 && close(out) != 0) ok = false;
+    close(in);
+    if (ok) {
+        // Trimming goes by this time, which makes it least recently used
+        utimensat(AT_FDCWD, path, NULL, 0);
+    }
+    free(path);
+    return ok;
+}
+
+static bool write_dependencies(int out, char* const* files, int file_count) {
+    uint32_t count = (uint32_t)file_count;
+    if (!write_exact(out, CACHE_ENTRY_MAGIC, 8) || !write_exact(out, &count, sizeof(count))) return false;
+    for (int i = 0; i < file_count; i++) {
+        uint32_t length = (uint32_t)strlen(files[i]);
+        uint64_t hash;
+        if (length >= PATH_MAX || !hash_file(files[i], &hash)) return false;
+        if (!write_exact(out, &length, sizeof(length)) || !write_exact(out, files[i], length) ||
+            !write_exact(out, &hash, sizeof(hash))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void cache_store(const CompileCache* cache, const char* key, const char* output,
+                 char* const* files, int file_count) {
+    mkdir(cache->dir, 0777);
+    char* temp = path_in(cache->dir, "tmp.XXXXXX");
+    int out = mkstemp(temp);
+    if (out < 0) {
+        free(temp);
+        return;
+    }
+    int in = open(output, O_RDONLY);
+    bool ok = in >= 0 && write_dependencies(out, files, file_count) && copy_fd(in, out);
+    if (in >= 0) close(in);
+    // mkstemp creates the file private; a shared cache must be readable
+    if (fchmod(out, 0644) != 0) ok = false;
+    if (close(out) != 0) ok = false;
+    char* path = path_in(cache->dir, key);
+    if (!ok || rename(temp, path) != 0) unlink(temp);
+    free(path);
+    free(temp);
+}
+
+typedef struct {
+    char* name;
+    struct timespec used;
+    off_t size;
+} CacheEntry;
+
+static bool is_key(const char* name) {
+    size_t length = strlen(name);
+    return length == CACHE_KEY_LENGTH && strspn(name, "0123456789abcdef") == length;
+}
+
+static int compare_used(const void* a, const void* b) {
+    const struct timespec* x = &((const CacheEntry*)a)->used;
+    const struct timespec* y = &((const CacheEntry*)b)->used;
+    if (x->tv_sec != y->tv_sec) return x->tv_sec < y->tv_sec ? -1 : 1;
+    if (x->tv_nsec != y->tv_nsec) return x->tv_nsec < y->tv_nsec ? -1 : 1;
+    return 0;
+}
+
+void cache_trim(const CompileCache* cache) {
+    DIR* dir = opendir(cache->dir);
+    if (!dir) return;
+
+    CacheEntry* entries = NULL;
+    int count = 0;
+    int capacity = 0;
+    uint64_t total = 0;
+    time_t now = time(NULL);
+    struct dirent* ent;
+    while ((ent = readdir(dir))) {
+        struct stat info;
+        if (fstatat(dirfd(dir), ent->d_name, &info, 0) != 0 || !S_ISREG(info.st_mode)) continue;
+        if (strncmp(ent->d_name, "tmp.", 4) == 0) {
+            if (now - info.st_mtime > CACHE_STALE_SECONDS) unlinkat(dirfd(dir), ent->d_name, 0);
+            continue;
+        }
+        if (!is_key(ent->d_name)) continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            entries = realloc(entries, capacity * sizeof(CacheEntry));
+        }
+        entries[count++] = (CacheEntry){ strdup(ent->d_name), info.st_mtim, info.st_size };
+        total += (uint64_t)info.st_size;
+    }
+
+    if (total > cache->max_bytes) {
+        qsort(entries, count, sizeof(CacheEntry), compare_used);
+        for (int i = 0; i < count && total > cache->max_bytes; i++) {
+            // Gone already means another compiler trimmed it
+            if (unlinkat(dirfd(dir), entries[i].name, 0) == 0 || errno == ENOENT) {
+                total -= (uint64_t)entries[i].size;
+            }
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        free(entries[i].name);
+    }
+    free(entries);
+    closedir(dir);
+}
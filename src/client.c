@@ -0,0 +1,131 @@
+/*
+ * Compile server client for IWBC
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * The side of the server protocol (src/server.c) the iwbc executable
+ * needs. It uses nothing from LLVM, so forwarding a command line costs
+ * no more than starting a small program.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.h"
+
+bool server_read(int fd, void* data, size_t size) {
+    char* bytes = data;
+    while (size > 0) {
+        ssize_t n = read(fd, bytes, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        bytes += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+bool server_send(int fd, const void* data, size_t size) {
+    const char* bytes = data;
+    while (size > 0) {
+        ssize_t n = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        bytes += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+bool server_address(const char* path, struct sockaddr_un* address) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address->sun_path)) return false;
+    strcpy(address->sun_path, path);
+    return true;
+}
+
+int server_connect(const char* path) {
+    struct sockaddr_un address;
+    if (!server_address(path, &address)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool server_forward(const char* path, int argc, char** argv, int* status) {
+    int fd = server_connect(path);
+    if (fd < 0) return false;
+    char* cwd = getcwd(NULL, 0);
+    if (!cwd) {
+        close(fd);
+        return false;
+    }
+    const char* cache_dir = getenv("IWBC_CACHE_DIR");
+    if (!cache_dir) cache_dir = "";
+
+    size_t size = strlen(cwd) + 1 + strlen(cache_dir) + 1;
+    for (int i = 0; i < argc; i++) {
+        size += strlen(argv[i]) + 1;
+    }
+    char* strings = malloc(size);
+    char* s = strings;
+    s = stpcpy(s, cwd) + 1;
+    s = stpcpy(s, cache_dir) + 1;
+    for (int i = 0; i < argc; i++) {
+        s = stpcpy(s, argv[i]) + 1;
+    }
+    free(cwd);
+
+    mode_t mask = umask(0);
+    umask(mask);
+    RequestHeader header;
+    memcpy(header.magic, SERVER_MAGIC, sizeof(header.magic));
+    header.umask = (uint32_t)mask;
+    header.string_count = (uint32_t)argc + 2;
+    header.size = (uint32_t)size;
+
+    int fds[2] = { STDOUT_FILENO, STDERR_FILENO };
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+    struct iovec part = { &header, sizeof(header) };
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr* fd_message = CMSG_FIRSTHDR(&message);
+    fd_message->cmsg_level = SOL_SOCKET;
+    fd_message->cmsg_type = SCM_RIGHTS;
+    fd_message->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(fd_message), fds, sizeof(fds));
+
+    // Until the whole request is sent the compile can still run here
+    bool sent = sendmsg(fd, &message, MSG_NOSIGNAL) == (ssize_t)sizeof(header) &&
+                server_send(fd, strings, size);
+    free(strings);
+    if (!sent) {
+        close(fd);
+        return false;
+    }
+    int32_t answer;
+    if (server_read(fd, &answer, sizeof(answer))) {
+        *status = answer;
+    } else {
+        fprintf(stderr, "Error: Compile server at %s stopped before answering\n", path);
+        *status = 1;
+    }
+    close(fd);
+    return true;
+}
@@ -0,0 +1,530 @@
+/*
+ * Machine code emission for IWBC
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * Optimizes a generated module at O2 and emits a host object file.
+ * Optimization and instruction selection dominate compile time for big
+ * programs, so with more than one codegen thread the module is split
+ * after IR generation, in the style of LLVM's SplitModule: the function
+ * definitions are cut into runs of about equal size, every partition
+ * keeps declarations of the rest, and each partition is optimized and
+ * emitted on its own thread.
+ *
+ * LLVM contexts are not thread safe, so the module is written out as
+ * bitcode once and every thread reads its own copy into a fresh context
+ * before cutting it down to its partition. Locals another partition
+ * refers to are made hidden globals first; private unnamed constants
+ * are simply kept in each partition. main and the module's variables
+ * belong to partition 0; locals no other partition uses stay local and
+ * are dropped by the optimizer where unused.
+ *
+ * Target machines take a while to set up and serve one module at a
+ * time, so one that is done goes on an idle list for the next partition
+ * or compile in the process instead of being thrown away.
+ *
+ * One partition is written as a plain object file. Several are written
+ * as a static archive with a symbol index, which links exactly like an
+ * object: the linker pulls the member defining main and from there
+ * every member it references. Either is built in memory and only then
+ * written out, so a host compiling through libiwbc gets the same bytes
+ * without a file.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <llvm-c/BitReader.h>
+#include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
+#include "generator.h"
+
+typedef struct {
+    int index;
+    LLVMMemoryBufferRef bitcode;    // the whole module, shared read-only
+    int* owner;                     // partition of each function definition, in module order
+    int function_count;
+    LLVMMemoryBufferRef object;     // result
+    char** symbols;                 // global symbols the object defines
+    int symbol_count;
+    bool failed;
+    FILE* diagnostics;
+    bool timed;
+    EmitStats stats;
+} Partition;
+
+// Most target machines kept idle at once
+#define IDLE_MACHINE_LIMIT 64
+
+static pthread_once_t targets_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t machines_lock = PTHREAD_MUTEX_INITIALIZER;
+static LLVMTargetMachineRef idle_machines[IDLE_MACHINE_LIMIT];
+static int idle_machine_count;
+
+static void initialize_targets(void) {
+    LLVMInitializeNativeTarget();
+    LLVMInitializeNativeAsmPrinter();
+}
+
+void generator_initialize_targets(void) {
+    pthread_once(&targets_once, initialize_targets);
+}
+
+static LLVMTargetMachineRef create_target_machine(FILE* diagnostics) {
+    char* triple = LLVMGetDefaultTargetTriple();
+    LLVMTargetRef target;
+    char* message = NULL;
+    LLVMTargetMachineRef machine = NULL;
+    if (LLVMGetTargetFromTriple(triple, &target, &message) == 0) {
+        char* cpu = LLVMGetHostCPUName();
+        char* features = LLVMGetHostCPUFeatures();
+        machine = LLVMCreateTargetMachine(target, triple, cpu, features, LLVMCodeGenLevelDefault,
+                                          LLVMRelocPIC, LLVMCodeModelDefault);
+        LLVMDisposeMessage(cpu);
+        LLVMDisposeMessage(features);
+    } else {
+        fprintf(diagnostics, "Error: No target for %s: %s\n", triple, message);
+        LLVMDisposeMessage(message);
+    }
+    LLVMDisposeMessage(triple);
+    return machine;
+}
+
+static LLVMTargetMachineRef take_target_machine(FILE* diagnostics) {
+    pthread_mutex_lock(&machines_lock);
+    LLVMTargetMachineRef machine = idle_machine_count > 0 ? idle_machines[--idle_machine_count] : NULL;
+    pthread_mutex_unlock(&machines_lock);
+    return machine ? machine : create_target_machine(diagnostics);
+}
+
+static void release_target_machine(LLVMTargetMachineRef machine) {
+    pthread_mutex_lock(&machines_lock);
+    if (idle_machine_count < IDLE_MACHINE_LIMIT) {
+        idle_machines[idle_machine_count++] = machine;
+        machine = NULL;
+    }
+    pthread_mutex_unlock(&machines_lock);
+    if (machine) LLVMDisposeTargetMachine(machine);
+}
+
+static long module_instruction_count(LLVMModuleRef module);
+
+// Runs the O2 pipeline over module and emits it as an object file,
+// adding the time each takes to stats unless it is NULL
+static LLVMMemoryBufferRef optimize_and_emit(LLVMModuleRef module, FILE* diagnostics, EmitStats* stats) {
+    LLVMTargetMachineRef machine = take_target_machine(diagnostics);
+    if (!machine) return NULL;
+    char* triple = LLVMGetTargetMachineTriple(machine);
+    LLVMSetTarget(module, triple);
+    LLVMDisposeMessage(triple);
+    LLVMTargetDataRef layout = LLVMCreateTargetDataLayout(machine);
+    LLVMSetModuleDataLayout(module, layout);
+    LLVMDisposeTargetData(layout);
+
+    LLVMMemoryBufferRef object = NULL;
+    PhaseSample start = stats ? phase_sample() : (PhaseSample){ 0 };
+    LLVMPassBuilderOptionsRef options = LLVMCreatePassBuilderOptions();
+    LLVMErrorRef error = LLVMRunPasses(module, "default<O2>", machine, options);
+    LLVMDisposePassBuilderOptions(options);
+    if (stats) {
+        phase_add_since(&stats->optimize, start);
+        stats->optimized_instructions += module_instruction_count(module);
+        start = phase_sample();
+    }
+    if (error) {
+        char* message = LLVMGetErrorMessage(error);
+        fprintf(diagnostics, "Error: Optimization failed: %s\n", message);
+        LLVMDisposeErrorMessage(message);
+    } else {
+        char* message = NULL;
+        if (LLVMTargetMachineEmitToMemoryBuffer(machine, module, LLVMObjectFile, &message, &object)) {
+            fprintf(diagnostics, "Error: Code generation failed: %s\n", message);
+            LLVMDisposeMessage(message);
+            object = NULL;
+        }
+    }
+    if (stats) phase_add_since(&stats->emit, start);
+    release_target_machine(machine);
+    return object;
+}
+
+static bool is_local(LLVMValueRef global) {
+    LLVMLinkage linkage = LLVMGetLinkage(global);
+    return linkage == LLVMInternalLinkage || linkage == LLVMPrivateLinkage;
+}
+
+// Private unnamed constants are copied into every partition instead of
+// being shared
+static bool copied_per_partition(LLVMValueRef global) {
+    return is_local(global) && LLVMIsGlobalConstant(global) &&
+           LLVMGetUnnamedAddress(global) != LLVMNoUnnamedAddr;
+}
+
+static int instruction_count(LLVMValueRef fn) {
+    int count = 0;
+    for (LLVMBasicBlockRef block = LLVMGetFirstBasicBlock(fn); block; block = LLVMGetNextBasicBlock(block)) {
+        for (LLVMValueRef inst = LLVMGetFirstInstruction(block); inst; inst = LLVMGetNextInstruction(inst)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static long module_instruction_count(LLVMModuleRef module) {
+    long count = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(module); fn; fn = LLVMGetNextFunction(fn)) {
+        count += instruction_count(fn);
+    }
+    return count;
+}
+
+long generator_instruction_count(Generator* gen) {
+    return module_instruction_count(gen->module);
+}
+
+typedef struct {
+    LLVMValueRef function;
+    int partition;
+} FunctionOwner;
+
+static int by_function(const void* a, const void* b) {
+    const FunctionOwner* x = a;
+    const FunctionOwner* y = b;
+    return (x->function > y->function) - (x->function < y->function);
+}
+
+// Assigns the function definitions, in module order, to partitions as
+// contiguous runs of about equal size. Generated programs define
+// related functions next to each other, so most calls stay inside a
+// partition where the inliner can still see them. main is created
+// first and so lands in partition 0.
+static int* assign_partitions(LLVMModuleRef module, int partitions, int* function_count) {
+    int count = 0;
+    long total = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(module); fn; fn = LLVMGetNextFunction(fn)) {
+        if (LLVMIsDeclaration(fn)) continue;
+        count++;
+        total += instruction_count(fn);
+    }
+    int* owner = calloc(count > 0 ? count : 1, sizeof(int));
+    long done = 0;
+    int i = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(module); fn; fn = LLVMGetNextFunction(fn)) {
+        if (LLVMIsDeclaration(fn)) continue;
+        int partition = (int)(done * partitions / (total > 0 ? total : 1));
+        owner[i++] = partition < partitions ? partition : partitions - 1;
+        done += instruction_count(fn);
+    }
+    *function_count = count;
+    return owner;
+}
+
+// True if value is used from a partition other than home. Uses through
+// constant expressions are followed to the instructions behind them; a
+// use from a global's initializer counts as foreign.
+static bool used_elsewhere(LLVMValueRef value, int home, const FunctionOwner* owners, int owner_count) {
+    for (LLVMUseRef use = LLVMGetFirstUse(value); use; use = LLVMGetNextUse(use)) {
+        LLVMValueRef user = LLVMGetUser(use);
+        if (LLVMIsAInstruction(user)) {
+            FunctionOwner key = { LLVMGetBasicBlockParent(LLVMGetInstructionParent(user)), 0 };
+            const FunctionOwner* found = bsearch(&key, owners, owner_count, sizeof(FunctionOwner), by_function);
+            if (!found || found->partition != home) return true;
+        } else if (LLVMIsAConstantExpr(user) || (LLVMIsAConstant(user) && !LLVMIsAGlobalValue(user))) {
+            if (used_elsewhere(user, home, owners, owner_count)) return true;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void externalize(LLVMValueRef global, int* unnamed) {
+    size_t length;
+    if (LLVMGetValueName2(global, &length)[0] == '\0') {
+        char name[32];
+        snprintf(name, sizeof(name), "iwb.split.%d", (*unnamed)++);
+        LLVMSetValueName2(global, name, strlen(name));
+    }
+    LLVMSetLinkage(global, LLVMExternalLinkage);
+    LLVMSetVisibility(global, LLVMHiddenVisibility);
+}
+
+// Gives the local definitions another partition refers to unique
+// hidden global names; everything else keeps its local linkage
+static void externalize_locals(LLVMModuleRef module, const int* owner, int function_count) {
+    FunctionOwner* owners = malloc((function_count > 0 ? function_count : 1) * sizeof(FunctionOwner));
+    int i = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(module); fn; fn = LLVMGetNextFunction(fn)) {
+        if (LLVMIsDeclaration(fn)) continue;
+        owners[i].function = fn;
+        owners[i].partition = owner[i];
+        i++;
+    }
+    FunctionOwner* sorted = malloc((function_count > 0 ? function_count : 1) * sizeof(FunctionOwner));
+    memcpy(sorted, owners, function_count * sizeof(FunctionOwner));
+    qsort(sorted, function_count, sizeof(FunctionOwner), by_function);
+
+    int unnamed = 0;
+    for (i = 0; i < function_count; i++) {
+        LLVMValueRef fn = owners[i].function;
+        if (is_local(fn) && used_elsewhere(fn, owners[i].partition, sorted, function_count)) {
+            externalize(fn, &unnamed);
+        }
+    }
+    for (LLVMValueRef global = LLVMGetFirstGlobal(module); global; global = LLVMGetNextGlobal(global)) {
+        if (LLVMIsDeclaration(global) || !is_local(global) || copied_per_partition(global)) continue;
+        if (used_elsewhere(global, 0, sorted, function_count)) externalize(global, &unnamed);
+    }
+    free(sorted);
+    free(owners);
+}
+
+// Replaces fn with a declaration of the same name and type
+static void drop_body(LLVMModuleRef module, LLVMValueRef fn) {
+    size_t length;
+    char* name = strdup(LLVMGetValueName2(fn, &length));
+    LLVMValueRef declaration = LLVMAddFunction(module, "", LLVMGlobalGetValueType(fn));
+    LLVMSetFunctionCallConv(declaration, LLVMGetFunctionCallConv(fn));
+    LLVMSetVisibility(declaration, LLVMGetVisibility(fn));
+    LLVMReplaceAllUsesWith(fn, declaration);
+    LLVMDeleteFunction(fn);
+    LLVMSetValueName2(declaration, name, length);
+    free(name);
+}
+
+static void collect_symbols(Partition* part, LLVMModuleRef module) {
+    int capacity = 16;
+    part->symbols = malloc(capacity * sizeof(char*));
+    for (int pass = 0; pass < 2; pass++) {
+        LLVMValueRef value = pass == 0 ? LLVMGetFirstFunction(module) : LLVMGetFirstGlobal(module);
+        for (; value; value = pass == 0 ? LLVMGetNextFunction(value) : LLVMGetNextGlobal(value)) {
+            if (LLVMIsDeclaration(value) || is_local(value)) continue;
+            if (part->symbol_count == capacity) {
+                capacity *= 2;
+                part->symbols = realloc(part->symbols, capacity * sizeof(char*));
+            }
+            size_t length;
+            part->symbols[part->symbol_count++] = strdup(LLVMGetValueName2(value, &length));
+        }
+    }
+}
+
+static void* emit_partition(void* arg) {
+    Partition* part = arg;
+    LLVMContextRef context = LLVMContextCreate();
+    LLVMModuleRef module;
+    if (LLVMParseBitcodeInContext2(context, part->bitcode, &module)) {
+        fprintf(part->diagnostics, "Error: Could not reload partition %d\n", part->index);
+        part->failed = true;
+        LLVMContextDispose(context);
+        return NULL;
+    }
+
+    // Collected first: dropping a body moves the declaration to the end
+    LLVMValueRef* foreign = malloc((part->function_count > 0 ? part->function_count : 1) * sizeof(LLVMValueRef));
+    int foreign_count = 0;
+    int i = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(module); fn; fn = LLVMGetNextFunction(fn)) {
+        if (LLVMIsDeclaration(fn)) continue;
+        if (part->owner[i++] != part->index) foreign[foreign_count++] = fn;
+    }
+    for (int k = 0; k < foreign_count; k++) {
+        drop_body(module, foreign[k]);
+    }
+    free(foreign);
+    if (part->index != 0) {
+        for (LLVMValueRef global = LLVMGetFirstGlobal(module); global; global = LLVMGetNextGlobal(global)) {
+            if (!LLVMIsDeclaration(global) && !is_local(global)) {
+                LLVMSetInitializer(global, NULL);
+            }
+        }
+    }
+
+    part->object = optimize_and_emit(module, part->diagnostics, part->timed ? &part->stats : NULL);
+    part->failed = part->object == NULL;
+    if (part->object) collect_symbols(part, module);
+    LLVMDisposeModule(module);
+    LLVMContextDispose(context);
+    return NULL;
+}
+
+static void put_be32(FILE* out, uint32_t value) {
+    unsigned char bytes[4] = { value >> 24, value >> 16, value >> 8, value };
+    fwrite(bytes, 1, 4, out);
+}
+
+static void put_member_header(FILE* out, const char* name, size_t size) {
+    // The name is cut to its 16 columns; the buffer has room for any
+    // size, though members never outgrow the 10 columns ar gives it
+    char header[96];
+    snprintf(header, sizeof(header), "%-16.16s%-12d%-6d%-6d%-8o%-10zu`\n", name, 0, 0, 0, 0644, size);
+    fwrite(header, 1, 60, out);
+}
+
+// The partitions as a System V (GNU) ar archive whose first member is
+// the symbol index the linker searches
+static LLVMMemoryBufferRef build_archive(Partition* parts, int count) {
+    char* data = NULL;
+    size_t data_size = 0;
+    FILE* out = open_memstream(&data, &data_size);
+    if (!out) return NULL;
+
+    size_t symbol_count = 0;
+    size_t names_size = 0;
+    for (int p = 0; p < count; p++) {
+        symbol_count += parts[p].symbol_count;
+        for (int s = 0; s < parts[p].symbol_count; s++) {
+            names_size += strlen(parts[p].symbols[s]) + 1;
+        }
+    }
+    size_t index_size = 4 + 4 * symbol_count + names_size;
+    size_t offset = 8 + 60 + index_size + (index_size & 1);
+    size_t* member_offsets = malloc(count * sizeof(size_t));
+    for (int p = 0; p < count; p++) {
+        member_offsets[p] = offset;
+        size_t size = LLVMGetBufferSize(parts[p].object);
+        offset += 60 + size + (size & 1);
+    }
+
+    fwrite("!<arch>\n", 1, 8, out);
+    put_member_header(out, "/", index_size);
+    put_be32(out, (uint32_t)symbol_count);
+    for (int p = 0; p < count; p++) {
+        for (int s = 0; s < parts[p].symbol_count; s++) {
+            put_be32(out, (uint32_t)member_offsets[p]);
+        }
+    }
+    for (int p = 0; p < count; p++) {
+        for (int s = 0; s < parts[p].symbol_count; s++) {
+            fwrite(parts[p].symbols[s], 1, strlen(parts[p].symbols[s]) + 1, out);
+        }
+    }
+    if (index_size & 1) fputc('\n', out);
+
+    for (int p = 0; p < count; p++) {
+        char name[32];
+        snprintf(name, sizeof(name), "part%d.o/", p);
+        size_t size = LLVMGetBufferSize(parts[p].object);
+        put_member_header(out, name, size);
+        fwrite(LLVMGetBufferStart(parts[p].object), 1, size, out);
+        if (size & 1) fputc('\n', out);
+    }
+    free(member_offsets);
+    bool ok = !ferror(out);
+    if (fclose(out) != 0) ok = false;
+    LLVMMemoryBufferRef archive = NULL;
+    if (ok) archive = LLVMCreateMemoryBufferWithMemoryRangeCopy(data, data_size, "archive");
+    free(data);
+    return archive;
+}
+
+static bool write_buffer(const char* filename, LLVMMemoryBufferRef buffer, FILE* diagnostics) {
+    FILE* out = fopen(filename, "wb");
+    if (!out) {
+        fprintf(diagnostics, "Error: Could not open %s for writing\n", filename);
+        return false;
+    }
+    size_t size = LLVMGetBufferSize(buffer);
+    bool ok = fwrite(LLVMGetBufferStart(buffer), 1, size, out) == size;
+    if (fclose(out) != 0) ok = false;
+    if (!ok) fprintf(diagnostics, "Error: Could not write %s\n", filename);
+    return ok;
+}
+
+bool generator_write_object(Generator* gen, const char* filename, int threads) {
+    LLVMMemoryBufferRef object = generator_emit_object(gen, threads);
+    if (!object) return false;
+    PhaseSample start = gen->emit_stats ? phase_sample() : (PhaseSample){ 0 };
+    bool ok = write_buffer(filename, object, gen->diagnostics);
+    LLVMDisposeMemoryBuffer(object);
+    if (gen->emit_stats) phase_add_since(&gen->emit_stats->emit, start);
+    return ok;
+}
+
+// Adds the stage that started at start to stats. The partitions ran
+// side by side, so optimizing took as long as the slowest of them, and
+// the rest of the stage's wall time is emission. The calling thread's
+// CPU time covers partition 0 and the splitting; the other partitions
+// measured their own threads.
+static void record_emit_stats(EmitStats* stats, PhaseSample start, const Partition* parts, int count) {
+    PhaseSample stage = { 0 };
+    phase_add_since(&stage, start);
+    PhaseSample optimize = { 0 };
+    double other_cpu = 0;
+    for (int p = 0; p < count; p++) {
+        const EmitStats* part = &parts[p].stats;
+        if (part->optimize.wall > optimize.wall) optimize.wall = part->optimize.wall;
+        optimize.cpu += part->optimize.cpu;
+        optimize.heap += part->optimize.heap;
+        if (p > 0) other_cpu += part->optimize.cpu + part->emit.cpu;
+        stats->optimized_instructions += part->optimized_instructions;
+    }
+    stats->optimize.wall += optimize.wall;
+    stats->optimize.cpu += optimize.cpu;
+    stats->optimize.heap += optimize.heap;
+    stats->emit.wall += stage.wall - optimize.wall;
+    stats->emit.cpu += stage.cpu + other_cpu - optimize.cpu;
+    stats->emit.heap += stage.heap - optimize.heap;
+}
+
+LLVMMemoryBufferRef generator_emit_object(Generator* gen, int threads) {
+    generator_initialize_targets();
+    PhaseSample start = gen->emit_stats ? phase_sample() : (PhaseSample){ 0 };
+
+    int function_count = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(gen->module); fn; fn = LLVMGetNextFunction(fn)) {
+        if (!LLVMIsDeclaration(fn)) function_count++;
+    }
+    int partitions = threads < function_count ? threads : function_count;
+    if (partitions <= 1) {
+        Partition whole = { .timed = gen->emit_stats != NULL };
+        LLVMMemoryBufferRef object = optimize_and_emit(gen->module, gen->diagnostics,
+                                                       whole.timed ? &whole.stats : NULL);
+        if (whole.timed) record_emit_stats(gen->emit_stats, start, &whole, 1);
+        return object;
+    }
+
+    int* owner = assign_partitions(gen->module, partitions, &function_count);
+    externalize_locals(gen->module, owner, function_count);
+    LLVMMemoryBufferRef bitcode = LLVMWriteBitcodeToMemoryBuffer(gen->module);
+
+    Partition* parts = calloc(partitions, sizeof(Partition));
+    pthread_t* workers = malloc(partitions * sizeof(pthread_t));
+    bool* started = calloc(partitions, sizeof(bool));
+    for (int p = 0; p < partitions; p++) {
+        parts[p].index = p;
+        parts[p].bitcode = bitcode;
+        parts[p].owner = owner;
+        parts[p].function_count = function_count;
+        parts[p].diagnostics = gen->diagnostics;
+        parts[p].timed = gen->emit_stats != NULL;
+        if (p > 0) started[p] = pthread_create(&workers[p], NULL, emit_partition, &parts[p]) == 0;
+        if (p > 0 && !started[p]) emit_partition(&parts[p]);
+    }
+    emit_partition(&parts[0]);
+    for (int p = 1; p < partitions; p++) {
+        if (started[p]) pthread_join(workers[p], NULL);
+    }
+
+    bool ok = true;
+    for (int p = 0; p < partitions; p++) {
+        if (parts[p].failed) ok = false;
+    }
+    LLVMMemoryBufferRef archive = ok ? build_archive(parts, partitions) : NULL;
+    if (gen->emit_stats) record_emit_stats(gen->emit_stats, start, parts, partitions);
+
+    for (int p = 0; p < partitions; p++) {
+        if (parts[p].object) LLVMDisposeMemoryBuffer(parts[p].object);
+        for (int s = 0; s < parts[p].symbol_count; s++) {
+            free(parts[p].symbols[s]);
+        }
+        free(parts[p].symbols);
+    }
+    free(parts);
+    free(workers);
+    free(started);
+    free(owner);
+    LLVMDisposeMemoryBuffer(bitcode);
+    return archive;
+}
@@ -0,0 +1,631 @@
+/* 
+ * Compiler for IWBC
+ * Created: February 20, 2025 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * The iwbc command line, run by the iwbc executable (src/main.c) from
+ * libiwbc.so and by compile server workers.
+ *
+ * Goals:
+ * 1. Command line parsing
+ * 2. Build pipeline coordination
+ * 3. Error reporting
+ * 4. Resource cleanup
+ * 5. Compiling many files at once (-j)
+ * 6. Emitting object code, optionally split over threads (-c)
+ * 7. Compiling one statement at a time, without holding the whole AST (--stream)
+ * 8. Serving unchanged compiles from a cache (--cache-dir)
+ * 9. Compiling in a long-running server (--server, IWBC_SERVER)
+ * 10. Reporting where a compile's time and memory go (--time-report, --stats)
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "lexer.h"
+#include "parser.h"
+#include "generator.h"
+#include "iwbc.h"
+#include "cache.h"
+#include "server.h"
+#include "phase.h"
+
+static char* read_file(const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open file %s\n", filename);
+        return NULL;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    
+    char* buffer = malloc(size + 1);
+    size_t read_size = fread(buffer, 1, size, file);
+    buffer[read_size] = '\0';
+    
+    fclose(file);
+    return buffer;
+}
+
+#define DEFAULT_CACHE_MB 1024
+
+// Source pages behind the lexer are handed back in steps this large
+#define STREAM_RELEASE_STEP (16 * 1024 * 1024)
+
+// Maps a source file for lexing in place, followed by at least one zero
+// byte: the file goes over an anonymous mapping a page longer than it,
+// so the end stays readable even when the size is a multiple of a page
+static char* map_source(const char* filename, size_t* size) {
+    int fd = open(filename, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Error: Could not open file %s\n", filename);
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    *size = (size_t)info.st_size;
+    char* base = mmap(NULL, *size + page, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base != MAP_FAILED && *size > 0 &&
+        mmap(base, *size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, *size + page);
+        base = MAP_FAILED;
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map file %s\n", filename);
+        return NULL;
+    }
+    madvise(base, *size, MADV_SEQUENTIAL);
+    return base;
+}
+
+// The files the parser read in for INCLUDEs, which outlive it
+static IncludeSet* take_includes(Parser* parser) {
+    if (!parser->owns_includes) return NULL;
+    parser->owns_includes = false;
+    return parser->includes;
+}
+
+typedef enum { REPORT_NONE, REPORT_TEXT, REPORT_JSON } ReportFormat;
+
+typedef enum {
+    PHASE_READ,
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_GENERATE,
+    PHASE_OPTIMIZE,     // objects only
+    PHASE_EMIT,
+    PHASE_COUNT
+} Phase;
+
+static const char* const phase_names[PHASE_COUNT] = {
+    "read", "lex", "parse", "generate", "optimize", "emit"
+};
+
+// What --time-report and --stats print for one file
+typedef struct {
+    PhaseSample phases[PHASE_COUNT];
+    long tokens;
+    long nodes;
+    long instructions;              // IR after generating
+    long optimized_instructions;    // and after optimizing, for objects
+    bool cached;
+} CompileReport;
+
+// A phase starts and ends only when there is a report to measure it for
+static PhaseSample phase_start(const CompileReport* report) {
+    return report ? phase_sample() : (PhaseSample){ 0 };
+}
+
+static void phase_end(CompileReport* report, Phase phase, PhaseSample start) {
+    if (report) phase_add_since(&report->phases[phase], start);
+}
+
+// The parser pulls tokens from the lexer as it goes, so lexing is timed
+// by a separate, untraced pass over the source; the parse phase then has
+// the lexer's share taken out of it
+static void measure_lexing(CompileReport* report, const char* source) {
+    PhaseSample start = phase_sample();
+    Lexer* lexer = lexer_create_in_place(source, NULL);
+    for (;;) {
+        Token* token = lexer_next_token(lexer);
+        bool end = token->type == TOKEN_EOF;
+        free(token->value);
+        free(token);
+        if (end) break;
+        report->tokens++;
+    }
+    lexer_destroy(lexer);
+    phase_end(report, PHASE_LEX, start);
+}
+
+static void take_out_lexing(CompileReport* report) {
+    PhaseSample* parse = &report->phases[PHASE_PARSE];
+    const PhaseSample* lex = &report->phases[PHASE_LEX];
+    parse->wall = parse->wall > lex->wall ? parse->wall - lex->wall : 0;
+    parse->cpu = parse->cpu > lex->cpu ? parse->cpu - lex->cpu : 0;
+}
+
+static long count_nodes(const ASTNode* node) {
+    if (!node) return 0;
+    long count = 1;
+    for (int i = 0; i < node->children_count; i++) {
+        count += count_nodes(node->children[i]);
+    }
+    return count;
+}
+
+static void print_json_string(FILE* out, const char* s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// Prints the report on stderr in one write, so reports of files compiled
+// side by side do not interleave
+static void print_report(const CompileReport* report, const char* input,
+                         ReportFormat time_report, ReportFormat stats) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    long peak_rss = usage.ru_maxrss;    // kilobytes
+    char* text = NULL;
+    size_t length = 0;
+    FILE* out = open_memstream(&text, &length);
+    if (!out) return;
+    
+    if (time_report == REPORT_JSON || stats == REPORT_JSON) {
+        fputs("{\"file\":", out);
+        print_json_string(out, input);
+        fprintf(out, ",\"cached\":%s", report->cached ? "true" : "false");
+        if (!report->cached) {
+            fputs(",\"phases\":{", out);
+            for (int p = 0; p < PHASE_COUNT; p++) {
+                const PhaseSample* phase = &report->phases[p];
+                fprintf(out, "%s\"%s\":{", p ? "," : "", phase_names[p]);
+                if (time_report) fprintf(out, "\"wall\":%.6f,\"cpu\":%.6f", phase->wall, phase->cpu);
+                if (stats) fprintf(out, "%s\"heap\":%lld", time_report ? "," : "", (long long)phase->heap);
+                fputc('}', out);
+            }
+            fputc('}', out);
+        }
+        if (stats) {
+            if (!report->cached) {
+                fprintf(out, ",\"tokens\":%ld,\"nodes\":%ld,\"ir_instructions\":%ld",
+                        report->tokens, report->nodes, report->instructions);
+                if (report->optimized_instructions) {
+                    fprintf(out, ",\"optimized_ir_instructions\":%ld", report->optimized_instructions);
+                }
+            }
+            fprintf(out, ",\"peak_rss\":%lld", (long long)peak_rss * 1024);
+        }
+        fputs("}\n", out);
+    } else if (report->cached) {
+        fprintf(out, "iwbc: %s: from the cache\n", input);
+        if (stats) fprintf(out, "  peak RSS %.1f MB\n", peak_rss / 1024.0);
+    } else {
+        fprintf(out, "iwbc: %s\n  %-10s", input, "phase");
+        if (time_report) fprintf(out, " %12s %12s", "wall ms", "cpu ms");
+        if (stats) fprintf(out, " %12s", "heap KB");
+        fputc('\n', out);
+        PhaseSample total = { 0 };
+        for (int p = 0; p <= PHASE_COUNT; p++) {
+            const PhaseSample* phase = p < PHASE_COUNT ? &report->phases[p] : &total;
+            fprintf(out, "  %-10s", p < PHASE_COUNT ? phase_names[p] : "total");
+            if (time_report) fprintf(out, " %12.3f %12.3f", phase->wall * 1e3, phase->cpu * 1e3);
+            if (stats) fprintf(out, " %+12.1f", phase->heap / 1024.0);
+            fputc('\n', out);
+            if (p < PHASE_COUNT) {
+                total.wall += phase->wall;
+                total.cpu += phase->cpu;
+                total.heap += phase->heap;
+            }
+        }
+        if (stats) {
+            fprintf(out, "  %ld tokens, %ld AST nodes, %ld IR instructions", report->tokens, report->nodes,
+                    report->instructions);
+            if (report->optimized_instructions) {
+                fprintf(out, " (%ld after optimizing)", report->optimized_instructions);
+            }
+            fprintf(out, ", peak RSS %.1f MB\n", peak_rss / 1024.0);
+        }
+    }
+    fclose(out);
+    fputs(text, stderr);
+    free(text);
+}
+
+// Parses and emits one top-level statement at a time, freeing each
+// statement's nodes and tokens before the next, and dropping source
+// pages the lexer has moved past, so the source and AST take memory
+// bounded by the largest statement (a FUNCTION counts as one). The
+// LLVM module still holds the whole program and grows with it.
+// parsed is cleared when a statement fails to parse.
+static bool generate_streaming(Generator* gen, const char* input, bool* parsed, IncludeSet** includes,
+                               CompileReport* report) {
+    PhaseSample start = phase_start(report);
+    size_t size;
+    char* source = map_source(input, &size);
+    phase_end(report, PHASE_READ, start);
+    if (!source) return false;
+    if (report) measure_lexing(report, source);
+    
+    Lexer* lexer = lexer_create_in_place(source, stdout);
+    Parser* parser = parser_create(lexer);
+    parser->path = input;
+    size_t released = 0;
+    ASTNode* statement;
+    for (;;) {
+        start = phase_start(report);
+        statement = parser_next_statement(parser);
+        phase_end(report, PHASE_PARSE, start);
+        if (!statement) break;
+        if (report) report->nodes += count_nodes(statement);
+        start = phase_start(report);
+        generator_generate_statement(gen, statement);
+        phase_end(report, PHASE_GENERATE, start);
+        ast_destroy(statement);
+        if (lexer->position - released >= STREAM_RELEASE_STEP) {
+            size_t end = lexer->position & ~(size_t)(STREAM_RELEASE_STEP - 1);
+            madvise(source + released, end - released, MADV_DONTNEED);
+            released = end;
+        }
+    }
+    *parsed = !parser->failed;
+    if (!*parsed) {
+        printf("Failed to parse statement, stopping\n");
+    }
+    start = phase_start(report);
+    generator_finish(gen);
+    phase_end(report, PHASE_GENERATE, start);
+    
+    *includes = take_includes(parser);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    munmap(source, size + (size_t)sysconf(_SC_PAGESIZE));
+    return true;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [options] <input.iwb> <output>\n", program);
+    fprintf(stderr, "       %s [options] [-j N] <input.iwb>...\n", program);
+    fprintf(stderr, "The second form writes each input.iwb to input.bc (input.o with -c),\n");
+    fprintf(stderr, "compiling N files at once. Options:\n");
+    fprintf(stderr, "  --no-bounds-check      drop array bounds checks\n");
+    fprintf(stderr, "  --no-db-batch          do not run DBEXECSQL loops as one transaction\n");
+    fprintf(stderr, "  -c                     write an optimized object file instead of bitcode\n");
+    fprintf(stderr, "  --codegen-threads N    with -c, split each program into N parts\n");
+    fprintf(stderr, "                         optimized and compiled in parallel; the\n");
+    fprintf(stderr, "                         output is then an ar archive of N objects,\n");
+    fprintf(stderr, "                         which links like one\n");
+    fprintf(stderr, "  --stream               parse and emit one statement at a time, so the\n");
+    fprintf(stderr, "                         whole AST is never held; the generated module\n");
+    fprintf(stderr, "                         still grows with the program\n");
+    fprintf(stderr, "  --cache-dir DIR        reuse outputs of earlier identical compiles kept\n");
+    fprintf(stderr, "                         in DIR (default: $IWBC_CACHE_DIR, if set)\n");
+    fprintf(stderr, "  --cache-size MB        keep the cache under MB megabytes (default %d)\n",
+            DEFAULT_CACHE_MB);
+    fprintf(stderr, "  --time-report[=json]   print each file's wall and CPU time per phase:\n");
+    fprintf(stderr, "                         read, lex, parse, generate, optimize, emit\n");
+    fprintf(stderr, "  --stats[=json]         print each file's heap growth per phase, token,\n");
+    fprintf(stderr, "                         AST node and IR instruction counts and peak RSS\n");
+    fprintf(stderr, "                         (CPU time is the compiling threads'; heap and\n");
+    fprintf(stderr, "                         RSS are the process's, shared under -j)\n");
+    fprintf(stderr, "       %s --server SOCKET [-j N]\n", program);
+    fprintf(stderr, "serves compiles on N workers (default: one per CPU) over the Unix socket\n");
+    fprintf(stderr, "SOCKET. With IWBC_SERVER=SOCKET set, iwbc has the server there run its\n");
+    fprintf(stderr, "command line, and compiles itself when none answers.\n");
+}
+
+typedef struct {
+    const char* input;
+    char* output;
+    bool failed;
+} CompileJob;
+
+typedef struct {
+    CompileJob* jobs;
+    int job_count;
+    _Atomic int next;       // first job no thread has taken
+    bool bounds_check;
+    bool db_batch;
+    bool emit_object;
+    bool stream;
+    int codegen_threads;
+    ReportFormat time_report;
+    ReportFormat stats;
+    const CompileCache* cache;  // NULL when not caching
+    char options[128];          // the options above, for cache keys
+} CompileQueue;
+
+// Lexes, parses and generates one file. Each file gets its own
+// generator and with it its own LLVM context, so files can be compiled
+// on several threads at once.
+static void compile_file(CompileQueue* queue, CompileJob* job) {
+    CompileReport measured = { 0 };
+    CompileReport* report = queue->time_report || queue->stats ? &measured : NULL;
+    char key[CACHE_KEY_LENGTH + 1];
+    bool cached = queue->cache && cache_key(job->input, queue->options, queue->emit_object, key);
+    if (cached && cache_fetch(queue->cache, key, job->output)) {
+        if (report) {
+            report->cached = true;
+            print_report(report, job->input, queue->time_report, queue->stats);
+        }
+        return;
+    }
+    
+    Generator* gen = generator_create("iwbasic_module");
+    gen->bounds_check = queue->bounds_check;
+    gen->db_batch = queue->db_batch;
+    bool parsed = true;
+    IncludeSet* includes = NULL;
+    
+    if (queue->stream) {
+        if (!generate_streaming(gen, job->input, &parsed, &includes, report)) {
+            job->failed = true;
+            generator_destroy(gen);
+            return;
+        }
+    } else {
+        PhaseSample start = phase_start(report);
+        char* source = read_file(job->input);
+        phase_end(report, PHASE_READ, start);
+        if (!source) {
+            job->failed = true;
+            generator_destroy(gen);
+            return;
+        }
+        if (report) measure_lexing(report, source);
+        start = phase_start(report);
+        Lexer* lexer = lexer_create(source);
+        Parser* parser = parser_create(lexer);
+        parser->path = job->input;
+        ASTNode* ast = parser_parse(parser);
+        phase_end(report, PHASE_PARSE, start);
+        parsed = !parser->failed;
+        if (report) report->nodes = count_nodes(ast);
+        start = phase_start(report);
+        generator_generate(gen, ast);
+        phase_end(report, PHASE_GENERATE, start);
+        ast_destroy(ast);
+        includes = take_includes(parser);
+        parser_destroy(parser);
+        lexer_destroy(lexer);
+        free(source);
+    }
+    if (report) {
+        take_out_lexing(report);
+        report->instructions = generator_instruction_count(gen);
+    }
+    
+    // A program with errors gets no output, and loses any an earlier
+    // compile left, so nothing half-built is ever linked or run
+    if (!parsed || gen->error_count > 0) {
+        job->failed = true;
+        remove(job->output);
+        if (report) print_report(report, job->input, queue->time_report, queue->stats);
+        include_set_destroy(includes);
+        generator_destroy(gen);
+        return;
+    }
+    
+    if (queue->emit_object) {
+        EmitStats emit_stats = { 0 };
+        if (report) gen->emit_stats = &emit_stats;
+        if (!generator_write_object(gen, job->output, queue->codegen_threads)) job->failed = true;
+        if (report) {
+            report->phases[PHASE_OPTIMIZE] = emit_stats.optimize;
+            report->phases[PHASE_EMIT] = emit_stats.emit;
+            report->optimized_instructions = emit_stats.optimized_instructions;
+        }
+    } else {
+        PhaseSample start = phase_start(report);
+        if (!generator_write_bitcode(gen, job->output)) job->failed = true;
+        phase_end(report, PHASE_EMIT, start);
+    }
+    if (job->failed) remove(job->output);
+    if (report) print_report(report, job->input, queue->time_report, queue->stats);
+    
+    // Only programs that compiled without errors are kept, so a hit never
+    // hides an error message
+    if (cached && !job->failed) {
+        cache_store(queue->cache, key, job->output,
+                    includes ? includes->paths : NULL, includes ? includes->count : 0);
+    }
+    include_set_destroy(includes);
+    
+    // Cleanup
+    generator_destroy(gen);
+}
+
+static void* compile_worker(void* arg) {
+    CompileQueue* queue = arg;
+    for (;;) {
+        int i = atomic_fetch_add(&queue->next, 1);
+        if (i >= queue->job_count) return NULL;
+        compile_file(queue, &queue->jobs[i]);
+    }
+}
+
+// input.iwb becomes input.bc (or .o); any other name gets it appended
+static char* output_name(const char* input, const char* extension) {
+    size_t length = strlen(input);
+    if (length > 4 && strcmp(input + length - 4, ".iwb") == 0) length -= 4;
+    char* output = malloc(length + strlen(extension) + 1);
+    memcpy(output, input, length);
+    strcpy(output + length, extension);
+    return output;
+}
+
+static bool has_extension(const char* name, const char* extension) {
+    size_t length = strlen(name);
+    size_t ext_length = strlen(extension);
+    return length > ext_length && strcmp(name + length - ext_length, extension) == 0;
+}
+
+static int compile_command(int argc, char* argv[], bool served);
+
+// What a server worker runs for a command line a client forwarded
+static int served_command(int argc, char* argv[]) {
+    return compile_command(argc, argv, true);
+}
+
+static int compile_command(int argc, char* argv[], bool served) {
+    bool bounds_check = true;
+    bool db_batch = true;
+    bool emit_object = false;
+    bool stream = false;
+    int codegen_threads = 1;
+    const char* cache_dir = getenv("IWBC_CACHE_DIR");
+    long cache_mb = DEFAULT_CACHE_MB;
+    int threads = 1;
+    bool threads_given = false;
+    const char* server_path = NULL;
+    ReportFormat time_report = REPORT_NONE;
+    ReportFormat stats = REPORT_NONE;
+    const char** files = malloc(argc * sizeof(const char*));
+    int file_count = 0;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-bounds-check") == 0) {
+            bounds_check = false;
+        } else if (strcmp(argv[i], "--no-db-batch") == 0) {
+            db_batch = false;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            emit_object = true;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = true;
+        } else if (strcmp(argv[i], "--time-report") == 0 || strcmp(argv[i], "--time-report=json") == 0) {
+            time_report = argv[i][13] ? REPORT_JSON : REPORT_TEXT;
+        } else if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats=json") == 0) {
+            stats = argv[i][7] ? REPORT_JSON : REPORT_TEXT;
+        } else if (strcmp(argv[i], "--cache-dir") == 0) {
+            cache_dir = i + 1 < argc ? argv[++i] : "";
+        } else if (strcmp(argv[i], "--cache-size") == 0) {
+            cache_mb = i + 1 < argc ? atol(argv[++i]) : 0;
+            if (cache_mb < 1) {
+                fprintf(stderr, "Error: --cache-size needs a size in megabytes\n");
+                free(files);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--codegen-threads") == 0) {
+            codegen_threads = i + 1 < argc ? atoi(argv[++i]) : 0;
+            if (codegen_threads < 1) {
+                fprintf(stderr, "Error: --codegen-threads needs a thread count\n");
+                free(files);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "-j", 2) == 0) {
+            const char* count = argv[i][2] ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : "");
+            threads = atoi(count);
+            threads_given = true;
+            if (threads < 1) {
+                fprintf(stderr, "Error: -j needs a thread count\n");
+                free(files);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--server") == 0) {
+            server_path = i + 1 < argc ? argv[++i] : "";
+            if (!server_path[0] || served) {
+                fprintf(stderr, served ? "Error: --server cannot be forwarded to a server\n"
+                                       : "Error: --server needs a socket path\n");
+                free(files);
+                return 1;
+            }
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            usage(argv[0]);
+            free(files);
+            return 1;
+        } else {
+            files[file_count++] = argv[i];
+        }
+    }
+    
+    if (server_path) {
+        free(files);
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        return server_run(server_path, threads_given ? threads : (cpus > 0 ? (int)cpus : 1), served_command);
+    }
+    
+    // Two names where the second is not a source file keep the original
+    // "input output" form; otherwise every name is an input
+    bool explicit_output = file_count == 2 && !has_extension(files[1], ".iwb");
+    CompileQueue queue = {
+        .bounds_check = bounds_check,
+        .db_batch = db_batch,
+        .emit_object = emit_object,
+        .stream = stream,
+        .codegen_threads = codegen_threads,
+        .time_report = time_report,
+        .stats = stats
+    };
+    CompileCache cache = { cache_dir, (uint64_t)cache_mb * 1024 * 1024 };
+    if (cache_dir && cache_dir[0]) {
+        queue.cache = &cache;
+        // --codegen-threads changes how an object is laid out, not just
+        // how fast it is made
+        snprintf(queue.options, sizeof(queue.options),
+                 "bounds_check=%d db_batch=%d object=%d codegen_threads=%d stream=%d",
+                 bounds_check, db_batch, emit_object, emit_object ? codegen_threads : 1, stream);
+    }
+    queue.job_count = explicit_output ? 1 : file_count;
+    if (queue.job_count == 0) {
+        usage(argv[0]);
+        free(files);
+        return 1;
+    }
+    
+    queue.jobs = calloc(queue.job_count, sizeof(CompileJob));
+    for (int i = 0; i < queue.job_count; i++) {
+        queue.jobs[i].input = files[i];
+        queue.jobs[i].output = explicit_output ? strdup(files[1]) : output_name(files[i], emit_object ? ".o" : ".bc");
+    }
+    atomic_init(&queue.next, 0);
+    
+    if (threads > queue.job_count) threads = queue.job_count;
+    pthread_t* workers = malloc(threads * sizeof(pthread_t));
+    int started = 0;
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&workers[started], NULL, compile_worker, &queue) == 0) started++;
+    }
+    compile_worker(&queue);
+    for (int t = 0; t < started; t++) {
+        pthread_join(workers[t], NULL);
+    }
+    if (queue.cache) cache_trim(queue.cache);
+    
+    int status = 0;
+    for (int i = 0; i < queue.job_count; i++) {
+        if (queue.jobs[i].failed) status = 1;
+        free(queue.jobs[i].output);
+    }
+    free(workers);
+    free(queue.jobs);
+    free(files);
+    return status;
+}
+
+int iwbc_command(int argc, char* argv[]) {
+    return compile_command(argc, argv, false);
+}
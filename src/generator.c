@@ -1,20 +1,35 @@
 /* 
  * Code Generator functions
  * Created: February 20, 2025 by LHS
- * Last modified: February 27, 2025 by LHS
+ * Last modified: October 19, 2026 by LHS
  *
  */
 
 #include "generator.h"
+#include "iwbhash.h"
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+
+// Prints "Error: " and the message, and counts it against the program
+static void report_error(Generator* gen, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    fputs("Error: ", gen->diagnostics);
+    vfprintf(gen->diagnostics, format, args);
+    va_end(args);
+    gen->error_count++;
+}
 
 static LLVMValueRef get_printf_function(LLVMModuleRef module) {
     LLVMValueRef printf_func = LLVMGetNamedFunction(module, "printf");
     if (!printf_func) {
-        LLVMTypeRef param_types[] = { LLVMPointerType(LLVMInt8Type(), 0) };
-        LLVMTypeRef printf_type = LLVMFunctionType(LLVMInt32Type(), param_types, 1, 1);
+        LLVMContextRef context = LLVMGetModuleContext(module);
+        LLVMTypeRef param_types[] = { LLVMPointerType(LLVMInt8TypeInContext(context), 0) };
+        LLVMTypeRef printf_type = LLVMFunctionType(LLVMInt32TypeInContext(context), param_types, 1, 1);
         printf_func = LLVMAddFunction(module, "printf", printf_type);
         LLVMSetFunctionCallConv(printf_func, LLVMCCallConv);
         LLVMSetLinkage(printf_func, LLVMExternalLinkage);
@@ -22,119 +37,3567 @@ static LLVMValueRef get_printf_function(LLVMModuleRef module) {
     return printf_func;
 }
 
-static LLVMValueRef generate_expression(Generator* gen, ASTNode* node) {
-    switch (node->type) {
-        case NODE_NUMBER: {
-            int value = atoi(node->value);
-            return LLVMConstInt(LLVMInt32Type(), value, 0);
+// Declares an external C function in the module on first use
+static LLVMValueRef get_c_function(LLVMModuleRef module, const char* name, LLVMTypeRef type) {
+    LLVMValueRef func = LLVMGetNamedFunction(module, name);
+    if (!func) {
+        func = LLVMAddFunction(module, name, type);
+        LLVMSetFunctionCallConv(func, LLVMCCallConv);
+        LLVMSetLinkage(func, LLVMExternalLinkage);
+    }
+    return func;
+}
+
+static LLVMTypeRef free_type(Generator* gen) {
+    LLVMTypeRef params[] = { LLVMPointerType(LLVMInt8TypeInContext(gen->context), 0) };
+    return LLVMFunctionType(LLVMVoidTypeInContext(gen->context), params, 1, 0);
+}
+
+// Positions builder directly after inst, which must not be a terminator
+static void position_after(LLVMBuilderRef builder, LLVMValueRef inst) {
+    LLVMValueRef next = LLVMGetNextInstruction(inst);
+    if (next) {
+        LLVMPositionBuilderBefore(builder, next);
+    } else {
+        LLVMPositionBuilderAtEnd(builder, LLVMGetInstructionParent(inst));
+    }
+}
+
+// Allocas are always placed at the top of the entry block so they are
+// promoted to registers by mem2reg and never grow the stack inside loops
+static LLVMValueRef build_entry_alloca(Generator* gen, LLVMTypeRef type, const char* name) {
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(gen->context);
+    LLVMBasicBlockRef entry = LLVMGetEntryBasicBlock(gen->function);
+    LLVMValueRef first = LLVMGetFirstInstruction(entry);
+    if (first) {
+        LLVMPositionBuilderBefore(builder, first);
+    } else {
+        LLVMPositionBuilderAtEnd(builder, entry);
+    }
+    LLVMValueRef alloca = LLVMBuildAlloca(builder, type, name);
+    LLVMDisposeBuilder(builder);
+    return alloca;
+}
+
+static Variable* lookup_variable(Generator* gen, const char* name) {
+    for (int i = 0; i < gen->var_count; i++) {
+        if (strcmp(gen->variables[i].name, name) == 0) {
+            return &gen->variables[i];
         }
-        
-        case NODE_IDENTIFIER: {
-            if (gen->var_count > 0) {
-                LLVMValueRef var = gen->variables[0];
-                return LLVMBuildLoad2(gen->builder, LLVMInt32Type(), var, "load");
-            }
-            return NULL;
+    }
+    return NULL;
+}
+
+static bool is_string_type(LLVMTypeRef type);
+static LLVMTypeRef string_struct_type(Generator* gen);
+
+// String variables hold the string value itself and start out empty
+static Variable* declare_variable(Generator* gen, const char* name, LLVMTypeRef type) {
+    gen->var_count++;
+    gen->variables = realloc(gen->variables, gen->var_count * sizeof(Variable));
+    Variable* var = &gen->variables[gen->var_count - 1];
+    var->name = strdup(name);
+    var->type = type;
+    if (is_string_type(type)) {
+        var->value = build_entry_alloca(gen, string_struct_type(gen), name);
+        LLVMSetAlignment(var->value, 8);
+        LLVMBuilderRef builder = LLVMCreateBuilderInContext(gen->context);
+        position_after(builder, var->value);
+        LLVMBuildStore(builder, LLVMConstNull(string_struct_type(gen)), var->value);
+        LLVMDisposeBuilder(builder);
+    } else {
+        var->value = build_entry_alloca(gen, type, name);
+    }
+    return var;
+}
+
+static ArrayInfo* lookup_array(Generator* gen, const char* name) {
+    for (int i = 0; i < gen->array_count; i++) {
+        if (strcmp(gen->arrays[i].name, name) == 0) {
+            return &gen->arrays[i];
         }
-        
-        case NODE_OPERATOR: {
-            LLVMValueRef left = generate_expression(gen, node->children[0]);
-            LLVMValueRef right = generate_expression(gen, node->children[1]);
+    }
+    return NULL;
+}
+
+// Extent of dimension k; dynamic extents are reloaded from their slot
+static LLVMValueRef array_dim(Generator* gen, ArrayInfo* array, int k) {
+    if (!array->dynamic) {
+        return array->dims[k];
+    }
+    return LLVMBuildLoad2(gen->builder, LLVMInt32TypeInContext(gen->context), array->dims[k], "dim");
+}
+
+// Pointer to element 0; heap arrays are reloaded from their slot
+static LLVMValueRef array_base(Generator* gen, ArrayInfo* array) {
+    if (!array->on_heap) {
+        return array->base;
+    }
+    LLVMValueRef base = LLVMBuildLoad2(gen->builder, LLVMPointerType(LLVMInt32TypeInContext(gen->context), 0),
+                                       array->base, "base");
+    LLVMSetAlignment(base, 8);
+    return base;
+}
+
+static LLVMValueRef generate_expression(Generator* gen, ASTNode* node);
+static LLVMValueRef convert_value(Generator* gen, LLVMValueRef value, LLVMTypeRef type);
+
+// Out-of-range subscripts end the program through this module-local
+// helper; it is marked cold and noreturn so the checks stay off the hot path
+static LLVMValueRef get_bounds_fail_function(Generator* gen) {
+    LLVMValueRef func = LLVMGetNamedFunction(gen->module, "iwb_bounds_fail");
+    if (func) return func;
+    
+    LLVMTypeRef param_types[] = { LLVMInt32TypeInContext(gen->context) };
+    LLVMTypeRef func_type = LLVMFunctionType(LLVMVoidTypeInContext(gen->context), param_types, 1, 0);
+    func = LLVMAddFunction(gen->module, "iwb_bounds_fail", func_type);
+    LLVMSetLinkage(func, LLVMInternalLinkage);
+    const char* attrs[] = { "cold", "noreturn", "noinline" };
+    for (int i = 0; i < 3; i++) {
+        unsigned kind = LLVMGetEnumAttributeKindForName(attrs[i], strlen(attrs[i]));
+        LLVMAddAttributeAtIndex(func, LLVMAttributeFunctionIndex,
+                                LLVMCreateEnumAttribute(gen->context, kind, 0));
+    }
+    
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(gen->context);
+    LLVMPositionBuilderAtEnd(builder, LLVMAppendBasicBlockInContext(gen->context, func, "entry"));
+    LLVMValueRef fmt = LLVMBuildGlobalStringPtr(builder,
+        "Runtime error: array index out of bounds at line %d\n", "boundsfmt");
+    LLVMValueRef args[] = { fmt, LLVMGetParam(func, 0) };
+    LLVMTypeRef printf_type = LLVMFunctionType(LLVMInt32TypeInContext(gen->context),
+                                               (LLVMTypeRef[]){LLVMPointerType(LLVMInt8TypeInContext(gen->context), 0)},
+                                               1, 1);
+    LLVMBuildCall2(builder, printf_type, get_printf_function(gen->module), args, 2, "");
+    
+    LLVMTypeRef exit_type = LLVMFunctionType(LLVMVoidTypeInContext(gen->context), param_types, 1, 0);
+    LLVMValueRef exit_args[] = { LLVMConstInt(LLVMInt32TypeInContext(gen->context), 1, 0) };
+    LLVMBuildCall2(builder, exit_type, get_c_function(gen->module, "exit", exit_type), exit_args, 1, "");
+    LLVMBuildUnreachable(builder);
+    LLVMDisposeBuilder(builder);
+    return func;
+}
+
+// Branches to iwb_bounds_fail unless in_range holds; leaves the builder
+// in the continuation block
+static void build_bounds_guard(Generator* gen, LLVMValueRef in_range, int line) {
+    LLVMBasicBlockRef fail = LLVMAppendBasicBlockInContext(gen->context, gen->function, "bounds.fail");
+    LLVMBasicBlockRef ok = LLVMAppendBasicBlockInContext(gen->context, gen->function, "bounds.ok");
+    LLVMBuildCondBr(gen->builder, in_range, ok, fail);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, fail);
+    LLVMValueRef fail_func = get_bounds_fail_function(gen);
+    LLVMValueRef args[] = { LLVMConstInt(LLVMInt32TypeInContext(gen->context), line, 0) };
+    LLVMBuildCall2(gen->builder, LLVMGlobalGetValueType(fail_func), fail_func, args, 1, "");
+    LLVMBuildUnreachable(gen->builder);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, ok);
+    gen->current_block = ok;
+}
+
+// Interval of values node can take, from constants and the ranges of
+// enclosing FOR variables; false when nothing is known
+static bool static_range(Generator* gen, ASTNode* node, long long* lo, long long* hi) {
+    switch (node->type) {
+        case NODE_NUMBER:
+            *lo = *hi = atoll(node->value);
+            return true;
+            
+        case NODE_IDENTIFIER:
+            for (int i = gen->range_count - 1; i >= 0; i--) {
+                if (strcmp(gen->ranges[i].var, node->value) == 0) {
+                    *lo = gen->ranges[i].lo;
+                    *hi = gen->ranges[i].hi;
+                    return true;
+                }
+            }
+            return false;
             
+        case NODE_OPERATOR: {
+            long long alo, ahi, blo, bhi;
+            if (!static_range(gen, node->children[0], &alo, &ahi) ||
+                !static_range(gen, node->children[1], &blo, &bhi)) {
+                return false;
+            }
+            long long c[4];
             if (strcmp(node->value, "+") == 0) {
-                return LLVMBuildAdd(gen->builder, left, right, "addtmp");
+                *lo = alo + blo;
+                *hi = ahi + bhi;
+                return true;
             } else if (strcmp(node->value, "-") == 0) {
-                return LLVMBuildSub(gen->builder, left, right, "subtmp");
+                *lo = alo - bhi;
+                *hi = ahi - blo;
+                return true;
             } else if (strcmp(node->value, "*") == 0) {
-                return LLVMBuildMul(gen->builder, left, right, "multmp");
-            } else if (strcmp(node->value, "/") == 0) {
-                return LLVMBuildSDiv(gen->builder, left, right, "divtmp");
+                c[0] = alo * blo; c[1] = alo * bhi; c[2] = ahi * blo; c[3] = ahi * bhi;
+            } else if (strcmp(node->value, "/") == 0 && blo == bhi && blo != 0) {
+                c[0] = alo / blo; c[1] = ahi / blo; c[2] = c[0]; c[3] = c[1];
+            } else {
+                return false;
+            }
+            *lo = *hi = c[0];
+            for (int i = 1; i < 4; i++) {
+                if (c[i] < *lo) *lo = c[i];
+                if (c[i] > *hi) *hi = c[i];
             }
+            return true;
         }
         
         default:
-            return NULL;
+            return false;
     }
 }
 
-static LLVMValueRef generate_print(Generator* gen, ASTNode* node) {
-    LLVMValueRef printf_func = get_printf_function(gen->module);
-    ASTNode* expr = node->children[0];
+// True when subscript k of an access to array is provably inside its extent
+static bool index_proven(Generator* gen, ArrayInfo* array, ASTNode* index, int k) {
+    long long lo, hi;
+    if (array->dynamic || !static_range(gen, index, &lo, &hi)) {
+        return false;
+    }
+    return lo >= 0 && hi < (long long)LLVMConstIntGetSExtValue(array->dims[k]);
+}
+
+static bool is_prechecked(Generator* gen, ASTNode* node) {
+    for (int i = 0; i < gen->prechecked_count; i++) {
+        if (gen->prechecked[i] == node) return true;
+    }
+    return false;
+}
+
+// Row-major address of a[i0, i1, ..., in]: ((i0 * d1 + i1) * d2 + i2) ...
+// off a single base pointer, using an inbounds GEP. Subscripts that
+// are neither proven in range nor covered by a loop preheader check
+// are tested against their extent here.
+static LLVMValueRef array_element_ptr(Generator* gen, ASTNode* node) {
+    ArrayInfo* array = lookup_array(gen, node->value);
+    if (!array) {
+        report_error(gen, "Array %s used before DIM\n", node->value);
+        return NULL;
+    }
+    if (node->children_count != array->dim_count) {
+        report_error(gen, "Array %s has %d dimension(s), %d index(es) given\n",
+                node->value, array->dim_count, node->children_count);
+        return NULL;
+    }
     
-    if (expr->type == NODE_STRING) {
-        char* format = "%s\n";
-        LLVMValueRef fmt_str = LLVMBuildGlobalStringPtr(gen->builder, format, "fmt");
-        LLVMValueRef str = LLVMBuildGlobalStringPtr(gen->builder, expr->value, "str");
-        LLVMValueRef args[] = { fmt_str, str };
-        LLVMTypeRef printf_type = LLVMFunctionType(LLVMInt32Type(), 
-                                                  (LLVMTypeRef[]){LLVMPointerType(LLVMInt8Type(), 0)}, 
-                                                  1, 1);
-        return LLVMBuildCall2(gen->builder, printf_type, printf_func, args, 2, "");
+    bool check = gen->bounds_check && !is_prechecked(gen, node);
+    LLVMValueRef linear = NULL;
+    for (int k = 0; k < node->children_count; k++) {
+        LLVMValueRef index = generate_expression(gen, node->children[k]);
+        if (index) index = convert_value(gen, index, LLVMInt32TypeInContext(gen->context));
+        if (!index) return NULL;
+        if (check && !index_proven(gen, array, node->children[k], k)) {
+            // One unsigned compare also rejects negative subscripts
+            LLVMValueRef in_range = LLVMBuildICmp(gen->builder, LLVMIntULT, index,
+                                                  array_dim(gen, array, k), "inbounds");
+            build_bounds_guard(gen, in_range, node->line);
+        }
+        // The element count may pass 2^31, so the offset is built in i64
+        LLVMTypeRef i64 = LLVMInt64TypeInContext(gen->context);
+        index = LLVMBuildSExt(gen->builder, index, i64, "idx");
+        if (!linear) {
+            linear = index;
+        } else {
+            LLVMValueRef extent = LLVMBuildSExt(gen->builder, array_dim(gen, array, k), i64, "extent");
+            LLVMValueRef scaled = LLVMBuildNSWMul(gen->builder, linear, extent, "rowmul");
+            linear = LLVMBuildNSWAdd(gen->builder, scaled, index, "rowadd");
+        }
+    }
+    
+    return LLVMBuildInBoundsGEP2(gen->builder, LLVMInt32TypeInContext(gen->context), array_base(gen, array),
+                                 &linear, 1, "elem");
+}
+
+// Total number of elements in array, as i64
+static LLVMValueRef array_count(Generator* gen, ArrayInfo* array) {
+    LLVMValueRef count = LLVMConstInt(LLVMInt64TypeInContext(gen->context), 1, 0);
+    for (int k = 0; k < array->dim_count; k++) {
+        LLVMValueRef extent = LLVMBuildSExt(gen->builder, array_dim(gen, array, k), LLVMInt64TypeInContext(gen->context), "extent");
+        count = LLVMBuildNSWMul(gen->builder, count, extent, "count");
+    }
+    return count;
+}
+
+// A bare array name in an expression stands for the whole array
+static bool is_array_valued(Generator* gen, ASTNode* node) {
+    switch (node->type) {
+        case NODE_IDENTIFIER:
+            return lookup_array(gen, node->value) != NULL;
+        case NODE_OPERATOR:
+            return is_array_valued(gen, node->children[0]) ||
+                   is_array_valued(gen, node->children[1]);
+        default:
+            return false;
+    }
+}
+
+// State for lowering one whole-array expression into a single fused loop
+typedef struct {
+    ASTNode** scalar_nodes;     // scalar subexpressions, evaluated once before the loop
+    LLVMValueRef* scalar_values;
+    int scalar_count;
+    ArrayInfo* shape;           // first array operand; all others must match its size
+    LLVMValueRef count;         // elements per array operand
+} ArrayLoop;
+
+// Evaluates every scalar subexpression of node up front and checks that
+// the array operands agree in size
+static bool prepare_array_loop(Generator* gen, ArrayLoop* loop, ASTNode* node, int line) {
+    if (!is_array_valued(gen, node)) {
+        LLVMValueRef value = generate_expression(gen, node);
+        if (!value) return false;
+        loop->scalar_count++;
+        loop->scalar_nodes = realloc(loop->scalar_nodes, loop->scalar_count * sizeof(ASTNode*));
+        loop->scalar_values = realloc(loop->scalar_values, loop->scalar_count * sizeof(LLVMValueRef));
+        loop->scalar_nodes[loop->scalar_count - 1] = node;
+        loop->scalar_values[loop->scalar_count - 1] = value;
+        return true;
+    }
+    
+    if (node->type == NODE_IDENTIFIER) {
+        ArrayInfo* array = lookup_array(gen, node->value);
+        LLVMValueRef count = array_count(gen, array);
+        if (!loop->shape) {
+            loop->shape = array;
+            loop->count = count;
+        } else if (LLVMIsConstant(count) && LLVMIsConstant(loop->count)) {
+            if (LLVMConstIntGetSExtValue(count) != LLVMConstIntGetSExtValue(loop->count)) {
+                report_error(gen, "Array %s does not match the size of %s at line %d\n",
+                        array->name, loop->shape->name, line);
+                return false;
+            }
+        } else if (gen->bounds_check) {
+            LLVMValueRef same = LLVMBuildICmp(gen->builder, LLVMIntEQ, count, loop->count, "samesize");
+            build_bounds_guard(gen, same, line);
+        }
+        return true;
+    }
+    
+    return prepare_array_loop(gen, loop, node->children[0], line) &&
+           prepare_array_loop(gen, loop, node->children[1], line);
+}
+
+static void release_array_loop(ArrayLoop* loop) {
+    free(loop->scalar_nodes);
+    free(loop->scalar_values);
+}
+
+// Address of elements [k, k + width) of array, as a pointer to a vector
+// of width lanes. Arrays are 64-byte aligned and k is a multiple of
+// the vector width, so vector accesses are aligned to their own size.
+static LLVMValueRef array_lane_ptr(Generator* gen, ArrayInfo* array, LLVMValueRef k, unsigned width) {
+    LLVMValueRef elem = LLVMBuildInBoundsGEP2(gen->builder, LLVMInt32TypeInContext(gen->context), array_base(gen, array),
+                                              &k, 1, "lane");
+    if (width == 1) return elem;
+    return LLVMBuildBitCast(gen->builder, elem,
+                            LLVMPointerType(LLVMVectorType(LLVMInt32TypeInContext(gen->context), width), 0), "vlane");
+}
+
+// Built-in fixed-width vector types. Values of these types are LLVM
+// vectors, so their operations map one-to-one onto SIMD instructions.
+// New widths or element types only need a row here.
+typedef struct {
+    const char* name;
+    unsigned lanes;
+    bool is_float;
+} VectorTypeInfo;
+
+static const VectorTypeInfo vector_types[] = {
+    { "VEC4I", 4, false },
+    { "VEC8I", 8, false },
+    { "VEC4F", 4, true },
+    { "VEC8F", 8, true },
+};
+
+static const VectorTypeInfo* lookup_vector_type(const char* name) {
+    for (size_t i = 0; i < sizeof(vector_types) / sizeof(vector_types[0]); i++) {
+        if (strcasecmp(vector_types[i].name, name) == 0) {
+            return &vector_types[i];
+        }
+    }
+    return NULL;
+}
+
+static bool is_vector_type(LLVMTypeRef type) {
+    return LLVMGetTypeKind(type) == LLVMVectorTypeKind;
+}
+
+// Element type of a vector, or the type itself for scalars
+static LLVMTypeRef element_type(LLVMTypeRef type) {
+    return is_vector_type(type) ? LLVMGetElementType(type) : type;
+}
+
+static bool is_float_type(LLVMTypeRef type) {
+    return LLVMGetTypeKind(element_type(type)) == LLVMFloatTypeKind;
+}
+
+static LLVMValueRef splat(Generator* gen, LLVMValueRef scalar, unsigned width) {
+    LLVMTypeRef vector_type = LLVMVectorType(LLVMTypeOf(scalar), width);
+    LLVMValueRef single = LLVMBuildInsertElement(gen->builder, LLVMGetUndef(vector_type), scalar,
+                                                 LLVMConstInt(LLVMInt32TypeInContext(gen->context), 0, 0), "splatins");
+    LLVMValueRef mask = LLVMConstNull(LLVMVectorType(LLVMInt32TypeInContext(gen->context), width));
+    return LLVMBuildShuffleVector(gen->builder, single, LLVMGetUndef(vector_type), mask, "splat");
+}
+
+// Converts between i32 and float, lane-wise for vectors, and widens a
+// scalar to a vector by splatting it. Returns NULL when no conversion
+// exists (vectors of different widths, vector to scalar).
+static LLVMValueRef convert_value(Generator* gen, LLVMValueRef value, LLVMTypeRef type) {
+    LLVMTypeRef from = LLVMTypeOf(value);
+    if (from == type) return value;
+    
+    if (is_string_type(from) || is_string_type(type)) {
+        report_error(gen, "Cannot use a string as a number or a number as a string\n");
+        return NULL;
+    }
+    if (LLVMGetTypeKind(from) == LLVMPointerTypeKind || LLVMGetTypeKind(type) == LLVMPointerTypeKind) {
+        report_error(gen, "A task handle can only be assigned or passed to AWAIT\n");
+        return NULL;
+    }
+    
+    if (is_vector_type(type) && !is_vector_type(from)) {
+        LLVMValueRef lane = convert_value(gen, value, LLVMGetElementType(type));
+        return lane ? splat(gen, lane, LLVMGetVectorSize(type)) : NULL;
+    }
+    if (is_vector_type(type) != is_vector_type(from) ||
+        (is_vector_type(type) && LLVMGetVectorSize(type) != LLVMGetVectorSize(from))) {
+        report_error(gen, "Cannot convert between vector types of different widths or to a scalar\n");
+        return NULL;
+    }
+    
+    if (is_float_type(type)) {
+        return LLVMBuildSIToFP(gen->builder, value, type, "tofloat");
+    }
+    return LLVMBuildFPToSI(gen->builder, value, type, "toint");
+}
+
+// Common type of two operands: vector beats scalar, float beats int
+static LLVMTypeRef common_type(LLVMTypeRef a, LLVMTypeRef b) {
+    bool use_float = is_float_type(a) || is_float_type(b);
+    LLVMContextRef context = LLVMGetTypeContext(a);
+    LLVMTypeRef scalar = use_float ? LLVMFloatTypeInContext(context) : LLVMInt32TypeInContext(context);
+    if (is_vector_type(a)) return LLVMVectorType(scalar, LLVMGetVectorSize(a));
+    if (is_vector_type(b)) return LLVMVectorType(scalar, LLVMGetVectorSize(b));
+    return scalar;
+}
+
+// Strings are iwbrt_string values (see iwbrt.h): 24 bytes holding the
+// length, a capacity and either up to 15 inline bytes or a pointer.
+// Expressions yield a pointer to one: a variable's own storage, a
+// constant for literals or an entry-block temporary for results.
+
+static LLVMTypeRef string_struct_type(Generator* gen) {
+    LLVMTypeRef type = LLVMGetTypeByName2(gen->context, "iwb.string");
+    if (!type) {
+        type = LLVMStructCreateNamed(gen->context, "iwb.string");
+        LLVMTypeRef fields[] = { LLVMInt32TypeInContext(gen->context), LLVMInt32TypeInContext(gen->context), LLVMArrayType(LLVMInt8TypeInContext(gen->context), 16) };
+        LLVMStructSetBody(type, fields, 3, 0);
+    }
+    return type;
+}
+
+static LLVMTypeRef string_type(Generator* gen) {
+    return LLVMPointerType(string_struct_type(gen), 0);
+}
+
+static bool is_string_type(LLVMTypeRef type) {
+    return LLVMGetTypeKind(type) == LLVMPointerTypeKind &&
+           LLVMGetElementType(type) == LLVMGetTypeByName2(LLVMGetTypeContext(type), "iwb.string");
+}
+
+// Calls a runtime function, declaring it from the argument types
+static LLVMValueRef call_runtime(Generator* gen, const char* name, LLVMTypeRef ret,
+                                 LLVMValueRef* args, int arg_count) {
+    LLVMTypeRef params[4];
+    for (int i = 0; i < arg_count; i++) {
+        params[i] = LLVMTypeOf(args[i]);
+    }
+    LLVMTypeRef type = LLVMFunctionType(ret, params, arg_count, 0);
+    return LLVMBuildCall2(gen->builder, type, get_c_function(gen->module, name, type), args, arg_count, "");
+}
+
+// Calls the runtime's release(resource) just before exit
+static void build_release(Generator* gen, LLVMValueRef exit, const char* release, LLVMValueRef resource) {
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(gen->context);
+    LLVMPositionBuilderBefore(builder, exit);
+    LLVMTypeRef params[] = { LLVMTypeOf(resource) };
+    LLVMTypeRef type = LLVMFunctionType(LLVMVoidTypeInContext(gen->context), params, 1, 0);
+    LLVMBuildCall2(builder, type, get_c_function(gen->module, release, type), &resource, 1, "");
+    LLVMDisposeBuilder(builder);
+}
+
+// Records a way out of the current function so its arena and task list
+// are released before it, including ones created after the exit was
+// emitted
+static void mark_exit(Generator* gen, LLVMValueRef exit) {
+    if (gen->arena) build_release(gen, exit, "iwbrt_arena_release", gen->arena);
+    if (gen->tasks) build_release(gen, exit, "iwbrt_tasks_release", gen->tasks);
+    gen->exit_count++;
+    gen->exits = realloc(gen->exits, gen->exit_count * sizeof(LLVMValueRef));
+    gen->exits[gen->exit_count - 1] = exit;
+}
+
+// The current function's arena: a zeroed iwbrt_arena in its frame
+static LLVMValueRef get_arena(Generator* gen) {
+    gen->arena_uses++;
+    if (gen->arena) {
+        return gen->arena;
+    }
+    LLVMTypeRef arena_type = LLVMArrayType(LLVMInt64TypeInContext(gen->context), 6);
+    LLVMValueRef arena = build_entry_alloca(gen, arena_type, "arena");
+    LLVMSetAlignment(arena, 8);
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(gen->context);
+    position_after(builder, arena);
+    LLVMBuildStore(builder, LLVMConstNull(arena_type), arena);
+    gen->arena = LLVMBuildBitCast(builder, arena, LLVMPointerType(LLVMInt8TypeInContext(gen->context), 0), "arenaptr");
+    LLVMDisposeBuilder(builder);
+    
+    for (int i = 0; i < gen->exit_count; i++) {
+        build_release(gen, gen->exits[i], "iwbrt_arena_release", gen->arena);
+    }
+    return gen->arena;
+}
+
+// Ends a loop iteration whose body built strings (arena_uses moved past
+// the count the loop started with) by letting the arena drop the ones
+// no variable holds. Variables may still be declared further down, so
+// the roots are filled in when the function is done (finish_collects).
+static void collect_strings(Generator* gen, int arena_uses) {
+    if (gen->arena_uses == arena_uses) return;
+    LLVMValueRef args[] = {
+        get_arena(gen),
+        LLVMConstNull(LLVMPointerType(string_type(gen), 0)),
+        LLVMConstInt(LLVMInt32TypeInContext(gen->context), 0, 0)
+    };
+    LLVMValueRef call = call_runtime(gen, "iwbrt_arena_collect", LLVMVoidTypeInContext(gen->context), args, 3);
+    gen->collect_count++;
+    gen->collects = realloc(gen->collects, gen->collect_count * sizeof(LLVMValueRef));
+    gen->collects[gen->collect_count - 1] = call;
+}
+
+// Points every collection in the function at an array of all its string
+// variables, filled in the entry block after the last alloca
+static void finish_collects(Generator* gen) {
+    if (gen->collect_count == 0) return;
+    int count = 0;
+    for (int i = 0; i < gen->var_count; i++) {
+        if (is_string_type(gen->variables[i].type) && LLVMIsAAllocaInst(gen->variables[i].value)) count++;
+    }
+    LLVMValueRef roots = build_entry_alloca(gen, LLVMArrayType(string_type(gen), count > 0 ? count : 1), "roots");
+    LLVMValueRef last = roots;
+    for (LLVMValueRef inst = LLVMGetFirstInstruction(LLVMGetEntryBasicBlock(gen->function)); inst;
+         inst = LLVMGetNextInstruction(inst)) {
+        if (LLVMIsAAllocaInst(inst)) last = inst;
+    }
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(gen->context);
+    position_after(builder, last);
+    LLVMValueRef first = LLVMBuildBitCast(builder, roots, LLVMPointerType(string_type(gen), 0), "rootlist");
+    int slot = 0;
+    for (int i = 0; i < gen->var_count; i++) {
+        Variable* var = &gen->variables[i];
+        if (!is_string_type(var->type) || !LLVMIsAAllocaInst(var->value)) continue;
+        LLVMValueRef index = LLVMConstInt(LLVMInt64TypeInContext(gen->context), slot++, 0);
+        LLVMBuildStore(builder, var->value, LLVMBuildInBoundsGEP2(builder, string_type(gen), first, &index, 1, "root"));
+    }
+    LLVMDisposeBuilder(builder);
+    for (int i = 0; i < gen->collect_count; i++) {
+        LLVMSetOperand(gen->collects[i], 1, first);
+        LLVMSetOperand(gen->collects[i], 2, LLVMConstInt(LLVMInt32TypeInContext(gen->context), count, 0));
+    }
+    free(gen->collects);
+    gen->collects = NULL;
+    gen->collect_count = 0;
+}
+
+static LLVMValueRef string_temp(Generator* gen) {
+    LLVMValueRef temp = build_entry_alloca(gen, string_struct_type(gen), "strtmp");
+    LLVMSetAlignment(temp, 8);
+    return temp;
+}
+
+// Literals are read-only constants: short ones inline, longer ones
+// pointing at their bytes with the static capacity marker
+static LLVMValueRef string_literal(Generator* gen, const char* text) {
+    size_t length = strlen(text);
+    LLVMValueRef init;
+    if (length < 16) {
+        char small[16] = { 0 };
+        memcpy(small, text, length);
+        LLVMValueRef fields[] = {
+            LLVMConstInt(LLVMInt32TypeInContext(gen->context), length, 0),
+            LLVMConstInt(LLVMInt32TypeInContext(gen->context), 0, 0),
+            LLVMConstStringInContext(gen->context, small, 16, 1)
+        };
+        init = LLVMConstNamedStruct(string_struct_type(gen), fields, 3);
     } else {
-        char* format = "%d\n";
-        LLVMValueRef fmt_str = LLVMBuildGlobalStringPtr(gen->builder, format, "fmt");
-        LLVMValueRef value = generate_expression(gen, expr);
-        LLVMValueRef args[] = { fmt_str, value };
-        LLVMTypeRef printf_type = LLVMFunctionType(LLVMInt32Type(), 
-                                                  (LLVMTypeRef[]){LLVMPointerType(LLVMInt8Type(), 0)}, 
-                                                  1, 1);
-        return LLVMBuildCall2(gen->builder, printf_type, printf_func, args, 2, "");
+        LLVMValueRef bytes = LLVMAddGlobal(gen->module, LLVMArrayType(LLVMInt8TypeInContext(gen->context), length), "strbytes");
+        LLVMSetInitializer(bytes, LLVMConstStringInContext(gen->context, text, length, 1));
+        LLVMSetGlobalConstant(bytes, 1);
+        LLVMSetLinkage(bytes, LLVMPrivateLinkage);
+        LLVMValueRef fields[] = {
+            LLVMConstInt(LLVMInt32TypeInContext(gen->context), length, 0),
+            LLVMConstInt(LLVMInt32TypeInContext(gen->context), UINT32_MAX, 0),
+            LLVMConstBitCast(bytes, LLVMPointerType(LLVMInt8TypeInContext(gen->context), 0)),
+            LLVMConstNull(LLVMArrayType(LLVMInt8TypeInContext(gen->context), 8))
+        };
+        init = LLVMConstStructInContext(gen->context, fields, 4, 0);
     }
+    LLVMValueRef global = LLVMAddGlobal(gen->module, LLVMTypeOf(init), "strlit");
+    LLVMSetInitializer(global, init);
+    LLVMSetGlobalConstant(global, 1);
+    LLVMSetLinkage(global, LLVMPrivateLinkage);
+    LLVMSetAlignment(global, 8);
+    return LLVMConstBitCast(global, string_type(gen));
 }
 
-static void generate_let(Generator* gen, ASTNode* node) {
-    LLVMValueRef value = generate_expression(gen, node->children[1]);
-    LLVMValueRef var = LLVMBuildAlloca(gen->builder, LLVMInt32Type(), node->children[0]->value);
-    LLVMBuildStore(gen->builder, value, var);
+// Numbers become their decimal text (%d or %g), which always fits inline
+static LLVMValueRef to_string(Generator* gen, LLVMValueRef value) {
+    LLVMTypeRef type = LLVMTypeOf(value);
+    if (is_string_type(type)) {
+        return value;
+    }
+    if (is_vector_type(type) || LLVMGetTypeKind(type) == LLVMPointerTypeKind) {
+        report_error(gen, "Only strings and numbers can be joined into a string\n");
+        return NULL;
+    }
+    LLVMValueRef temp = string_temp(gen);
+    LLVMValueRef args[] = { temp, value };
+    call_runtime(gen, is_float_type(type) ? "iwbrt_string_from_float" : "iwbrt_string_from_int",
+                 LLVMVoidTypeInContext(gen->context), args, 2);
+    return temp;
+}
+
+// + joins strings (numbers are converted); comparisons order bytewise
+// and yield -1/0 like numeric ones
+static LLVMValueRef string_binary(Generator* gen, const char* op, LLVMValueRef left, LLVMValueRef right) {
+    if (strcmp(op, "+") == 0) {
+        left = to_string(gen, left);
+        right = to_string(gen, right);
+        if (!left || !right) return NULL;
+        LLVMValueRef temp = string_temp(gen);
+        LLVMValueRef args[] = { get_arena(gen), temp, left, right };
+        call_runtime(gen, "iwbrt_string_concat", LLVMVoidTypeInContext(gen->context), args, 4);
+        return temp;
+    }
     
-    gen->var_count++;
-    gen->variables = realloc(gen->variables, gen->var_count * sizeof(LLVMValueRef));
-    gen->variables[gen->var_count - 1] = var;
+    LLVMIntPredicate predicate;
+    if (strcmp(op, "=") == 0) predicate = LLVMIntEQ;
+    else if (strcmp(op, "<") == 0) predicate = LLVMIntSLT;
+    else if (strcmp(op, ">") == 0) predicate = LLVMIntSGT;
+    else {
+        report_error(gen, "Operator %s does not apply to strings\n", op);
+        return NULL;
+    }
+    if (!is_string_type(LLVMTypeOf(left)) || !is_string_type(LLVMTypeOf(right))) {
+        report_error(gen, "Cannot compare a string with a number\n");
+        return NULL;
+    }
+    LLVMValueRef args[] = { left, right };
+    LLVMValueRef order = call_runtime(gen, "iwbrt_string_compare", LLVMInt32TypeInContext(gen->context), args, 2);
+    LLVMValueRef result = LLVMBuildICmp(gen->builder, predicate, order,
+                                        LLVMConstInt(LLVMInt32TypeInContext(gen->context), 0, 0), "strcmp");
+    return LLVMBuildSExt(gen->builder, result, LLVMInt32TypeInContext(gen->context), "mask");
 }
 
-Generator* generator_create(const char* module_name) {
-    Generator* gen = malloc(sizeof(Generator));
-    gen->module = LLVMModuleCreateWithName(module_name);
-    gen->builder = LLVMCreateBuilder();
+static LLVMValueRef string_length(Generator* gen, LLVMValueRef value) {
+    LLVMValueRef length_ptr = LLVMBuildStructGEP2(gen->builder, string_struct_type(gen), value, 0, "lenptr");
+    return LLVMBuildLoad2(gen->builder, LLVMInt32TypeInContext(gen->context), length_ptr, "len");
+}
+
+// Applies a binary operator to scalars or vectors of i32 or float.
+// Comparisons follow BASIC and SIMD convention: true is -1 (all bits
+// set) and false is 0, lane-wise for vectors, so a compare result
+// can be used directly as a mask.
+static LLVMValueRef build_binary(Generator* gen, const char* op, LLVMValueRef left, LLVMValueRef right) {
+    if (is_string_type(LLVMTypeOf(left)) || is_string_type(LLVMTypeOf(right))) {
+        return string_binary(gen, op, left, right);
+    }
+    LLVMTypeRef type = common_type(LLVMTypeOf(left), LLVMTypeOf(right));
+    left = convert_value(gen, left, type);
+    right = convert_value(gen, right, type);
+    if (!left || !right) return NULL;
+    bool fp = is_float_type(type);
     
-    LLVMTypeRef main_type = LLVMFunctionType(LLVMInt32Type(), NULL, 0, 0);
-    gen->function = LLVMAddFunction(gen->module, "main", main_type);
+    if (strcmp(op, "+") == 0) {
+        return fp ? LLVMBuildFAdd(gen->builder, left, right, "addtmp")
+                  : LLVMBuildAdd(gen->builder, left, right, "addtmp");
+    } else if (strcmp(op, "-") == 0) {
+        return fp ? LLVMBuildFSub(gen->builder, left, right, "subtmp")
+                  : LLVMBuildSub(gen->builder, left, right, "subtmp");
+    } else if (strcmp(op, "*") == 0) {
+        return fp ? LLVMBuildFMul(gen->builder, left, right, "multmp")
+                  : LLVMBuildMul(gen->builder, left, right, "multmp");
+    } else if (strcmp(op, "/") == 0) {
+        return fp ? LLVMBuildFDiv(gen->builder, left, right, "divtmp")
+                  : LLVMBuildSDiv(gen->builder, left, right, "divtmp");
+    }
     
-    gen->current_block = LLVMAppendBasicBlock(gen->function, "entry");
-    LLVMPositionBuilderAtEnd(gen->builder, gen->current_block);
+    LLVMValueRef cmp;
+    if (strcmp(op, ">") == 0) {
+        cmp = fp ? LLVMBuildFCmp(gen->builder, LLVMRealOGT, left, right, "cmptmp")
+                 : LLVMBuildICmp(gen->builder, LLVMIntSGT, left, right, "cmptmp");
+    } else if (strcmp(op, "<") == 0) {
+        cmp = fp ? LLVMBuildFCmp(gen->builder, LLVMRealOLT, left, right, "cmptmp")
+                 : LLVMBuildICmp(gen->builder, LLVMIntSLT, left, right, "cmptmp");
+    } else if (strcmp(op, "=") == 0) {
+        cmp = fp ? LLVMBuildFCmp(gen->builder, LLVMRealOEQ, left, right, "cmptmp")
+                 : LLVMBuildICmp(gen->builder, LLVMIntEQ, left, right, "cmptmp");
+    } else {
+        report_error(gen, "Unknown operator %s\n", op);
+        return NULL;
+    }
+    LLVMTypeRef mask_type = is_vector_type(type) ? LLVMVectorType(LLVMInt32TypeInContext(gen->context), LLVMGetVectorSize(type))
+                                                 : LLVMInt32TypeInContext(gen->context);
+    return LLVMBuildSExt(gen->builder, cmp, mask_type, "mask");
+}
+
+// Value of node for elements [k, k + width): one lane when width is 1,
+// a vector of width lanes otherwise
+static LLVMValueRef array_lane_value(Generator* gen, ArrayLoop* loop, ASTNode* node,
+                                     LLVMValueRef k, unsigned width) {
+    for (int i = 0; i < loop->scalar_count; i++) {
+        if (loop->scalar_nodes[i] == node) {
+            LLVMTypeRef lane_type = width == 1 ? LLVMInt32TypeInContext(gen->context) : LLVMVectorType(LLVMInt32TypeInContext(gen->context), width);
+            return convert_value(gen, loop->scalar_values[i], lane_type);
+        }
+    }
     
-    gen->variables = NULL;
-    gen->var_count = 0;
+    if (node->type == NODE_IDENTIFIER) {
+        ArrayInfo* array = lookup_array(gen, node->value);
+        LLVMTypeRef type = width == 1 ? LLVMInt32TypeInContext(gen->context) : LLVMVectorType(LLVMInt32TypeInContext(gen->context), width);
+        LLVMValueRef value = LLVMBuildLoad2(gen->builder, type, array_lane_ptr(gen, array, k, width), "lanes");
+        LLVMSetAlignment(value, 4 * width);
+        return value;
+    }
     
-    return gen;
+    LLVMValueRef left = array_lane_value(gen, loop, node->children[0], k, width);
+    LLVMValueRef right = array_lane_value(gen, loop, node->children[1], k, width);
+    if (!left || !right) return NULL;
+    LLVMValueRef value = build_binary(gen, node->value, left, right);
+    if (!value) return NULL;
+    
+    // Arrays hold i32, so float scalars mixed in are truncated per element
+    LLVMTypeRef lane_type = width == 1 ? LLVMInt32TypeInContext(gen->context) : LLVMVectorType(LLVMInt32TypeInContext(gen->context), width);
+    return convert_value(gen, value, lane_type);
 }
 
-void generator_generate(Generator* gen, ASTNode* node) {
-    for (int i = 0; i < node->children_count; i++) {
-        ASTNode* child = node->children[i];
-        switch (child->type) {
-            case NODE_PRINT:
-                generate_print(gen, child);
-                break;
-            case NODE_LET:
-                generate_let(gen, child);
-                break;
+// for (k = from; k < to; k += step) over i64 counters
+typedef struct {
+    LLVMValueRef counter;
+    LLVMBasicBlockRef cond_block;
+    LLVMBasicBlockRef exit_block;
+} CountedLoop;
+
+// Emits the loop header and leaves the builder in the body; returns k
+static LLVMValueRef counted_loop_begin(Generator* gen, CountedLoop* loop,
+                                       LLVMValueRef from, LLVMValueRef to) {
+    loop->counter = build_entry_alloca(gen, LLVMInt64TypeInContext(gen->context), "k");
+    LLVMBuildStore(gen->builder, from, loop->counter);
+    loop->cond_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "array.cond");
+    LLVMBasicBlockRef body_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "array.body");
+    loop->exit_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "array.end");
+    LLVMBuildBr(gen->builder, loop->cond_block);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, loop->cond_block);
+    LLVMValueRef k = LLVMBuildLoad2(gen->builder, LLVMInt64TypeInContext(gen->context), loop->counter, "k");
+    LLVMValueRef more = LLVMBuildICmp(gen->builder, LLVMIntSLT, k, to, "more");
+    LLVMBuildCondBr(gen->builder, more, body_block, loop->exit_block);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, body_block);
+    return k;
+}
+
+static void counted_loop_end(Generator* gen, CountedLoop* loop, LLVMValueRef k, unsigned step) {
+    LLVMValueRef next = LLVMBuildNSWAdd(gen->builder, k, LLVMConstInt(LLVMInt64TypeInContext(gen->context), step, 0), "knext");
+    LLVMBuildStore(gen->builder, next, loop->counter);
+    LLVMBuildBr(gen->builder, loop->cond_block);
+    LLVMPositionBuilderAtEnd(gen->builder, loop->exit_block);
+    gen->current_block = loop->exit_block;
+}
+
+// Largest multiple of the vector width not above count
+static LLVMValueRef vector_limit(Generator* gen, LLVMValueRef count) {
+    LLVMValueRef mask = LLVMConstInt(LLVMInt64TypeInContext(gen->context), ~(unsigned long long)(GENERATOR_VECTOR_WIDTH - 1), 0);
+    return LLVMBuildAnd(gen->builder, count, mask, "veclimit");
+}
+
+// LET a = <array expression>: one fused pass over the elements, a full
+// vector at a time followed by a scalar tail, with no temporaries
+static void generate_array_let(Generator* gen, ASTNode* node) {
+    ArrayInfo* target = lookup_array(gen, node->children[0]->value);
+    ArrayLoop loop = { NULL, NULL, 0, NULL, NULL };
+    
+    // The target takes part in the size check like any other operand
+    if (!prepare_array_loop(gen, &loop, node->children[0], node->line) ||
+        !prepare_array_loop(gen, &loop, node->children[1], node->line)) {
+        release_array_loop(&loop);
+        return;
+    }
+    
+    LLVMValueRef limit = vector_limit(gen, loop.count);
+    unsigned widths[] = { GENERATOR_VECTOR_WIDTH, 1 };
+    LLVMValueRef from = LLVMConstInt(LLVMInt64TypeInContext(gen->context), 0, 0);
+    LLVMValueRef bounds[] = { limit, loop.count };
+    for (int pass = 0; pass < 2; pass++) {
+        CountedLoop counted;
+        LLVMValueRef k = counted_loop_begin(gen, &counted, from, bounds[pass]);
+        LLVMValueRef value = array_lane_value(gen, &loop, node->children[1], k, widths[pass]);
+        if (!value) break;
+        LLVMValueRef store = LLVMBuildStore(gen->builder, value, array_lane_ptr(gen, target, k, widths[pass]));
+        LLVMSetAlignment(store, 4 * widths[pass]);
+        counted_loop_end(gen, &counted, k, widths[pass]);
+        from = limit;
+    }
+    
+    release_array_loop(&loop);
+}
+
+// Overloaded intrinsic such as llvm.smax.v8i32, mangled on the type of
+// its last parameter
+static LLVMValueRef get_intrinsic(Generator* gen, const char* base, LLVMTypeRef ret,
+                                  LLVMTypeRef* params, int param_count) {
+    LLVMTypeRef type = params[param_count - 1];
+    const char* element = is_float_type(type) ? "f32" : "i32";
+    char name[64];
+    if (is_vector_type(type)) {
+        snprintf(name, sizeof(name), "%s.v%u%s", base, LLVMGetVectorSize(type), element);
+    } else {
+        snprintf(name, sizeof(name), "%s.%s", base, element);
+    }
+    return get_c_function(gen->module, name, LLVMFunctionType(ret, params, param_count, 0));
+}
+
+static LLVMValueRef call_intrinsic2(Generator* gen, const char* base, LLVMValueRef a, LLVMValueRef b) {
+    LLVMTypeRef type = LLVMTypeOf(a);
+    LLVMTypeRef params[] = { type, type };
+    LLVMValueRef func = get_intrinsic(gen, base, type, params, 2);
+    LLVMValueRef args[] = { a, b };
+    return LLVMBuildCall2(gen->builder, LLVMGlobalGetValueType(func), func, args, 2, "");
+}
+
+// Horizontal SUM, MAX or MIN of a vector value with one
+// llvm.vector.reduce.* call
+static LLVMValueRef reduce_vector(Generator* gen, const char* which, LLVMValueRef value) {
+    LLVMTypeRef type = LLVMTypeOf(value);
+    LLVMTypeRef lane = LLVMGetElementType(type);
+    bool fp = is_float_type(type);
+    const char* reduce;
+    if (strcasecmp(which, "SUM") == 0) {
+        reduce = fp ? "llvm.vector.reduce.fadd" : "llvm.vector.reduce.add";
+    } else if (strcasecmp(which, "MAX") == 0) {
+        reduce = fp ? "llvm.vector.reduce.fmax" : "llvm.vector.reduce.smax";
+    } else {
+        reduce = fp ? "llvm.vector.reduce.fmin" : "llvm.vector.reduce.smin";
+    }
+    
+    // The float sum takes an explicit start value
+    if (fp && strcasecmp(which, "SUM") == 0) {
+        LLVMTypeRef params[] = { lane, type };
+        LLVMValueRef func = get_intrinsic(gen, reduce, lane, params, 2);
+        LLVMValueRef args[] = { LLVMConstReal(lane, 0.0), value };
+        return LLVMBuildCall2(gen->builder, LLVMGlobalGetValueType(func), func, args, 2, "reduced");
+    }
+    LLVMTypeRef params[] = { type };
+    LLVMValueRef func = get_intrinsic(gen, reduce, lane, params, 1);
+    return LLVMBuildCall2(gen->builder, LLVMGlobalGetValueType(func), func, &value, 1, "reduced");
+}
+
+// SUM(expr), MAX(expr) and MIN(expr) over an array expression. The
+// vector pass keeps a vector accumulator and collapses it with
+// llvm.vector.reduce.*; the scalar tail continues from that result.
+static LLVMValueRef generate_reduction(Generator* gen, ASTNode* node) {
+    const char* combine;        // lane-wise combining operation
+    const char* reduce;         // horizontal reduction of the accumulator
+    long long identity;
+    if (strcasecmp(node->value, "SUM") == 0) {
+        combine = NULL;
+        reduce = "llvm.vector.reduce.add";
+        identity = 0;
+    } else if (strcasecmp(node->value, "MAX") == 0) {
+        combine = "llvm.smax";
+        reduce = "llvm.vector.reduce.smax";
+        identity = -2147483647LL - 1;
+    } else {
+        combine = "llvm.smin";
+        reduce = "llvm.vector.reduce.smin";
+        identity = 2147483647LL;
+    }
+    
+    // MAX(a, b, ...) and MIN(a, b, ...) of numbers, lane-wise for vectors
+    if (combine && node->children_count >= 2) {
+        LLVMValueRef result = NULL;
+        for (int i = 0; i < node->children_count; i++) {
+            if (is_array_valued(gen, node->children[i])) {
+                report_error(gen, "%s of several values takes numbers or vectors, not arrays, at line %d\n",
+                        node->value, node->line);
+                return NULL;
+            }
+            LLVMValueRef value = generate_expression(gen, node->children[i]);
+            if (!value) return NULL;
+            if (!result) {
+                result = value;
+                continue;
+            }
+            LLVMTypeRef type = common_type(LLVMTypeOf(result), LLVMTypeOf(value));
+            result = convert_value(gen, result, type);
+            value = convert_value(gen, value, type);
+            if (!result || !value) return NULL;
+            const char* pick = is_float_type(type) ? (strcasecmp(node->value, "MAX") == 0 ? "llvm.maxnum" : "llvm.minnum")
+                                                   : combine;
+            result = call_intrinsic2(gen, pick, result, value);
+        }
+        return result;
+    }
+    
+    if (node->children_count == 1 && !is_array_valued(gen, node->children[0])) {
+        LLVMValueRef value = generate_expression(gen, node->children[0]);
+        if (!value) return NULL;
+        if (is_vector_type(LLVMTypeOf(value))) {
+            return reduce_vector(gen, node->value, value);
         }
     }
+    if (node->children_count != 1 || !is_array_valued(gen, node->children[0])) {
+        report_error(gen, "%s expects one array or vector argument at line %d\n",
+                node->value, node->line);
+        return NULL;
+    }
+    
+    ArrayLoop loop = { NULL, NULL, 0, NULL, NULL };
+    if (!prepare_array_loop(gen, &loop, node->children[0], node->line)) {
+        release_array_loop(&loop);
+        return NULL;
+    }
+    
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(gen->context);
+    LLVMTypeRef vector_type = LLVMVectorType(i32, GENERATOR_VECTOR_WIDTH);
+    LLVMValueRef limit = vector_limit(gen, loop.count);
+    
+    LLVMValueRef vacc = build_entry_alloca(gen, vector_type, "vacc");
+    LLVMBuildStore(gen->builder, splat(gen, LLVMConstInt(i32, identity, 1), GENERATOR_VECTOR_WIDTH), vacc);
+    CountedLoop counted;
+    LLVMValueRef k = counted_loop_begin(gen, &counted, LLVMConstInt(LLVMInt64TypeInContext(gen->context), 0, 0), limit);
+    LLVMValueRef lanes = array_lane_value(gen, &loop, node->children[0], k, GENERATOR_VECTOR_WIDTH);
+    LLVMValueRef acc = LLVMBuildLoad2(gen->builder, vector_type, vacc, "vacc");
+    acc = combine ? call_intrinsic2(gen, combine, acc, lanes) : LLVMBuildAdd(gen->builder, acc, lanes, "vsum");
+    LLVMBuildStore(gen->builder, acc, vacc);
+    counted_loop_end(gen, &counted, k, GENERATOR_VECTOR_WIDTH);
+    
+    LLVMTypeRef reduce_params[] = { vector_type };
+    LLVMValueRef reduce_func = get_intrinsic(gen, reduce, i32, reduce_params, 1);
+    LLVMValueRef vector_result = LLVMBuildLoad2(gen->builder, vector_type, vacc, "vacc");
+    LLVMValueRef reduced = LLVMBuildCall2(gen->builder, LLVMGlobalGetValueType(reduce_func),
+                                          reduce_func, &vector_result, 1, "reduced");
+    
+    LLVMValueRef sacc = build_entry_alloca(gen, i32, "sacc");
+    LLVMBuildStore(gen->builder, reduced, sacc);
+    k = counted_loop_begin(gen, &counted, limit, loop.count);
+    LLVMValueRef lane = array_lane_value(gen, &loop, node->children[0], k, 1);
+    LLVMValueRef sum = LLVMBuildLoad2(gen->builder, i32, sacc, "sacc");
+    sum = combine ? call_intrinsic2(gen, combine, sum, lane) : LLVMBuildAdd(gen->builder, sum, lane, "ssum");
+    LLVMBuildStore(gen->builder, sum, sacc);
+    counted_loop_end(gen, &counted, k, 1);
+    
+    release_array_loop(&loop);
+    return LLVMBuildLoad2(gen->builder, i32, sacc, "reduction");
+}
+
+static bool is_vector_variable(Generator* gen, const char* name) {
+    Variable* var = lookup_array(gen, name) ? NULL : lookup_variable(gen, name);
+    return var && is_vector_type(var->type);
+}
+
+// Lane number of v[i] on a vector variable, checked like a subscript
+static LLVMValueRef vector_lane_index(Generator* gen, Variable* var, ASTNode* node) {
+    if (node->children_count != 1) {
+        report_error(gen, "Vector %s takes one lane index at line %d\n", node->value, node->line);
+        return NULL;
+    }
+    LLVMValueRef index = generate_expression(gen, node->children[0]);
+    if (index) index = convert_value(gen, index, LLVMInt32TypeInContext(gen->context));
+    if (!index) return NULL;
+    
+    unsigned lanes = LLVMGetVectorSize(var->type);
+    long long lo, hi;
+    bool proven = static_range(gen, node->children[0], &lo, &hi) && lo >= 0 && hi < lanes;
+    if (gen->bounds_check && !proven) {
+        LLVMValueRef in_range = LLVMBuildICmp(gen->builder, LLVMIntULT, index,
+                                              LLVMConstInt(LLVMInt32TypeInContext(gen->context), lanes, 0), "inlanes");
+        build_bounds_guard(gen, in_range, node->line);
+    }
+    return index;
+}
+
+// VEC4I(a, b, c, d) builds a vector lane by lane; VEC4I(x) splats x
+static LLVMValueRef generate_vector_constructor(Generator* gen, ASTNode* node,
+                                                const VectorTypeInfo* info) {
+    LLVMTypeRef lane_type = info->is_float ? LLVMFloatTypeInContext(gen->context) : LLVMInt32TypeInContext(gen->context);
+    LLVMTypeRef type = LLVMVectorType(lane_type, info->lanes);
+    if (node->children_count != 1 && node->children_count != (int)info->lanes) {
+        report_error(gen, "%s takes 1 or %u values at line %d\n", info->name, info->lanes, node->line);
+        return NULL;
+    }
     
-    LLVMBuildRet(gen->builder, LLVMConstInt(LLVMInt32Type(), 0, 0));
+    if (node->children_count == 1) {
+        LLVMValueRef value = generate_expression(gen, node->children[0]);
+        return value ? convert_value(gen, value, type) : NULL;
+    }
+    
+    LLVMValueRef vector = LLVMGetUndef(type);
+    for (unsigned i = 0; i < info->lanes; i++) {
+        LLVMValueRef value = generate_expression(gen, node->children[i]);
+        if (!value) return NULL;
+        value = convert_value(gen, value, lane_type);
+        if (!value) return NULL;
+        vector = LLVMBuildInsertElement(gen->builder, vector, value,
+                                        LLVMConstInt(LLVMInt32TypeInContext(gen->context), i, 0), "lane");
+    }
+    return vector;
+}
+
+// SHUFFLE(v, i0, ..., in) picks lanes of v; SHUFFLE(v, w, i0, ..., in)
+// picks from the lanes of v followed by those of w. The indices must
+// be constants and the result has one lane per index.
+static LLVMValueRef generate_shuffle(Generator* gen, ASTNode* node) {
+    if (node->children_count < 2) {
+        report_error(gen, "SHUFFLE needs a vector and lane indices at line %d\n", node->line);
+        return NULL;
+    }
+    
+    LLVMValueRef first = generate_expression(gen, node->children[0]);
+    if (!first) return NULL;
+    if (!is_vector_type(LLVMTypeOf(first))) {
+        report_error(gen, "SHUFFLE expects a vector at line %d\n", node->line);
+        return NULL;
+    }
+    
+    int index_start = 1;
+    LLVMValueRef second = LLVMGetUndef(LLVMTypeOf(first));
+    if (node->children[1]->type != NODE_NUMBER) {
+        second = generate_expression(gen, node->children[1]);
+        if (!second || LLVMTypeOf(second) != LLVMTypeOf(first)) {
+            report_error(gen, "SHUFFLE operands must have the same vector type at line %d\n", node->line);
+            return NULL;
+        }
+        index_start = 2;
+    }
+    
+    unsigned available = LLVMGetVectorSize(LLVMTypeOf(first)) * (index_start == 2 ? 2 : 1);
+    int count = node->children_count - index_start;
+    LLVMValueRef* indices = malloc(count * sizeof(LLVMValueRef));
+    for (int i = 0; i < count; i++) {
+        ASTNode* index = node->children[index_start + i];
+        if (index->type != NODE_NUMBER || (unsigned)atoi(index->value) >= available) {
+            report_error(gen, "SHUFFLE lane indices must be constants below %u at line %d\n",
+                    available, node->line);
+            free(indices);
+            return NULL;
+        }
+        indices[i] = LLVMConstInt(LLVMInt32TypeInContext(gen->context), atoi(index->value), 0);
+    }
+    LLVMValueRef mask = LLVMConstVector(indices, count);
+    free(indices);
+    return LLVMBuildShuffleVector(gen->builder, first, second, mask, "shuffle");
+}
+
+// BLEND(mask, a, b) takes a where mask is non-zero and b elsewhere,
+// lane by lane; the mask is typically the result of a compare
+static LLVMValueRef generate_blend(Generator* gen, ASTNode* node) {
+    if (node->children_count != 3) {
+        report_error(gen, "BLEND takes a mask and two values at line %d\n", node->line);
+        return NULL;
+    }
+    LLVMValueRef mask = generate_expression(gen, node->children[0]);
+    LLVMValueRef a = generate_expression(gen, node->children[1]);
+    LLVMValueRef b = generate_expression(gen, node->children[2]);
+    if (!mask || !a || !b) return NULL;
+    
+    LLVMTypeRef type = common_type(LLVMTypeOf(a), LLVMTypeOf(b));
+    if (is_vector_type(LLVMTypeOf(mask))) {
+        type = common_type(type, LLVMVectorType(LLVMInt32TypeInContext(gen->context), LLVMGetVectorSize(LLVMTypeOf(mask))));
+    }
+    a = convert_value(gen, a, type);
+    b = convert_value(gen, b, type);
+    LLVMTypeRef mask_type = is_vector_type(type) ? LLVMVectorType(LLVMInt32TypeInContext(gen->context), LLVMGetVectorSize(type))
+                                                 : LLVMInt32TypeInContext(gen->context);
+    mask = convert_value(gen, mask, mask_type);
+    if (!a || !b || !mask) return NULL;
+    
+    LLVMValueRef take = LLVMBuildICmp(gen->builder, LLVMIntNE, mask, LLVMConstNull(mask_type), "take");
+    return LLVMBuildSelect(gen->builder, take, a, b, "blend");
+}
+
+static LLVMValueRef generate_user_call(Generator* gen, ASTNode* node);
+static LLVMValueRef generate_spawn(Generator* gen, ASTNode* node);
+static LLVMValueRef generate_await(Generator* gen, ASTNode* node);
+
+static LLVMTypeRef i8_ptr_type(Generator* gen) {
+    return LLVMPointerType(LLVMInt8TypeInContext(gen->context), 0);
+}
+
+// FUNCTION name is emitted as the internal function iwb_fn_name so it
+// cannot clash with C symbols; SPAWN goes through iwb_task_name
+static char* function_symbol(const char* prefix, const char* name) {
+    char* symbol = malloc(strlen(prefix) + strlen(name) + 1);
+    strcpy(symbol, prefix);
+    strcat(symbol, name);
+    return symbol;
+}
+
+// DICTs are module globals (iwb_dict_name) holding an iwbrt_dict*,
+// reachable from every FUNCTION like channels
+static LLVMValueRef lookup_dict(Generator* gen, const char* name) {
+    char* symbol = function_symbol("iwb_dict_", name);
+    LLVMValueRef global = LLVMGetNamedGlobal(gen->module, symbol);
+    free(symbol);
+    return global;
+}
+
+// name[key] is an entry of a DICT unless a local array or vector of that
+// name hides it
+static bool is_dict_access(Generator* gen, ASTNode* node) {
+    return node->type == NODE_ARRAY_ACCESS && !lookup_array(gen, node->value) &&
+           !is_vector_variable(gen, node->value) && lookup_dict(gen, node->value);
+}
+
+static void declare_dict(Generator* gen, ASTNode* node) {
+    if (node->type != NODE_DICT || lookup_dict(gen, node->value)) return;
+    char* symbol = function_symbol("iwb_dict_", node->value);
+    LLVMValueRef global = LLVMAddGlobal(gen->module, i8_ptr_type(gen), symbol);
+    LLVMSetInitializer(global, LLVMConstNull(i8_ptr_type(gen)));
+    LLVMSetLinkage(global, LLVMInternalLinkage);
+    free(symbol);
+}
+
+static void declare_dicts(Generator* gen, ASTNode* program) {
+    for (int i = 0; i < program->children_count; i++) {
+        declare_dict(gen, program->children[i]);
+    }
+}
+
+// DICT name [size] creates an empty dictionary with room for size keys,
+// freeing the one a previous run of the statement created
+static void generate_dict(Generator* gen, ASTNode* node) {
+    LLVMValueRef global = lookup_dict(gen, node->value);
+    if (!global) {
+        report_error(gen, "DICT %s must be declared at the top level at line %d\n",
+                node->value, node->line);
+        return;
+    }
+    LLVMValueRef capacity = LLVMConstInt(LLVMInt32TypeInContext(gen->context), 0, 0);
+    if (node->children_count > 0) {
+        capacity = generate_expression(gen, node->children[0]);
+        if (capacity) capacity = convert_value(gen, capacity, LLVMInt32TypeInContext(gen->context));
+        if (!capacity) return;
+    }
+    LLVMValueRef old = LLVMBuildLoad2(gen->builder, i8_ptr_type(gen), global, "olddict");
+    call_runtime(gen, "iwbrt_dict_destroy", LLVMVoidTypeInContext(gen->context), &old, 1);
+    LLVMValueRef dict = call_runtime(gen, "iwbrt_dict_create", i8_ptr_type(gen), &capacity, 1);
+    LLVMBuildStore(gen->builder, dict, global);
+}
+
+// Calls iwbrt_dict_<op>_int or _str for the entry of DICT name under
+// key. A string literal key is hashed here, at compile time.
+static LLVMValueRef dict_call(Generator* gen, const char* op, LLVMTypeRef ret,
+                              const char* name, ASTNode* key_node) {
+    LLVMValueRef dict = LLVMBuildLoad2(gen->builder, i8_ptr_type(gen), lookup_dict(gen, name), "dict");
+    LLVMValueRef key = generate_expression(gen, key_node);
+    if (!key) return NULL;
+    
+    char function[32];
+    if (!is_string_type(LLVMTypeOf(key))) {
+        key = convert_value(gen, key, LLVMInt32TypeInContext(gen->context));
+        if (!key) return NULL;
+        snprintf(function, sizeof(function), "iwbrt_dict_%s_int", op);
+        LLVMValueRef args[] = { dict, key };
+        return call_runtime(gen, function, ret, args, 2);
+    }
+    
+    LLVMValueRef hash;
+    if (key_node->type == NODE_STRING) {
+        hash = LLVMConstInt(LLVMInt64TypeInContext(gen->context), iwb_hash_bytes(key_node->value, strlen(key_node->value)), 0);
+    } else {
+        hash = call_runtime(gen, "iwbrt_string_hash", LLVMInt64TypeInContext(gen->context), &key, 1);
+    }
+    snprintf(function, sizeof(function), "iwbrt_dict_%s_str", op);
+    LLVMValueRef args[] = { dict, key, hash };
+    return call_runtime(gen, function, ret, args, 3);
+}
+
+static bool check_dict_key(Generator* gen, ASTNode* node) {
+    if (node->children_count != 1) {
+        report_error(gen, "DICT %s takes a single key at line %d\n", node->value, node->line);
+        return false;
+    }
+    return true;
+}
+
+// Entries are stored through the slot call, which adds missing keys
+static void store_dict_entry(Generator* gen, ASTNode* target, LLVMValueRef value) {
+    value = convert_value(gen, value, LLVMInt32TypeInContext(gen->context));
+    if (!value || !check_dict_key(gen, target)) return;
+    LLVMValueRef slot = dict_call(gen, "slot", LLVMPointerType(LLVMInt32TypeInContext(gen->context), 0),
+                                  target->value, target->children[0]);
+    if (!slot) return;
+    LLVMValueRef store = LLVMBuildStore(gen->builder, value, slot);
+    LLVMSetAlignment(store, 4);
+}
+
+// DICTs are not safe to change from several threads at once
+static bool writes_dict(Generator* gen, ASTNode* node) {
+    if (node->type == NODE_DICT) return true;
+    if (node->type == NODE_LET && is_dict_access(gen, node->children[0])) return true;
+    if (node->type == NODE_RECEIVE && is_dict_access(gen, node->children[0])) return true;
+    for (int i = 0; i < node->children_count; i++) {
+        if (writes_dict(gen, node->children[i])) return true;
+    }
+    return false;
+}
+
+// SORT name sorts the whole array, all dimensions as one row-major run
+static void generate_sort(Generator* gen, ASTNode* node) {
+    ArrayInfo* array = lookup_array(gen, node->value);
+    if (!array) {
+        report_error(gen, "SORT needs an array, %s is not one, at line %d\n", node->value, node->line);
+        return;
+    }
+    LLVMValueRef args[] = { array_base(gen, array), array_count(gen, array) };
+    call_runtime(gen, "iwbrt_sort_i32", LLVMVoidTypeInContext(gen->context), args, 2);
+}
+
+// BSEARCH(array, key) on a sorted array and FIND(array, key) on any
+// array give the key's element number (counting from 0), or -1
+static LLVMValueRef generate_search(Generator* gen, ASTNode* node, const char* function) {
+    ArrayInfo* array = NULL;
+    if (node->children_count == 2 && node->children[0]->type == NODE_IDENTIFIER) {
+        array = lookup_array(gen, node->children[0]->value);
+    }
+    if (!array) {
+        report_error(gen, "%s needs an array and a key at line %d\n", node->value, node->line);
+        return NULL;
+    }
+    LLVMValueRef key = generate_expression(gen, node->children[1]);
+    if (key) key = convert_value(gen, key, LLVMInt32TypeInContext(gen->context));
+    if (!key) return NULL;
+    LLVMValueRef args[] = { array_base(gen, array), array_count(gen, array), key };
+    return call_runtime(gen, function, LLVMInt32TypeInContext(gen->context), args, 3);
+}
+
+// Files are module globals (iwb_file_name) holding an iwbrt_file*, so a
+// file opened in one FUNCTION can be read in another
+static LLVMValueRef lookup_file(Generator* gen, const char* name) {
+    char* symbol = function_symbol("iwb_file_", name);
+    LLVMValueRef global = LLVMGetNamedGlobal(gen->module, symbol);
+    free(symbol);
+    return global;
+}
+
+static void declare_files(Generator* gen, ASTNode* node) {
+    if ((node->type == NODE_OPEN || node->type == NODE_READLINE ||
+         node->type == NODE_WRITELINE || node->type == NODE_CLOSE) && !lookup_file(gen, node->value)) {
+        char* symbol = function_symbol("iwb_file_", node->value);
+        LLVMValueRef global = LLVMAddGlobal(gen->module, i8_ptr_type(gen), symbol);
+        LLVMSetInitializer(global, LLVMConstNull(i8_ptr_type(gen)));
+        LLVMSetLinkage(global, LLVMInternalLinkage);
+        free(symbol);
+    }
+    for (int i = 0; i < node->children_count; i++) {
+        declare_files(gen, node->children[i]);
+    }
+}
+
+static LLVMValueRef load_file(Generator* gen, const char* name) {
+    return LLVMBuildLoad2(gen->builder, i8_ptr_type(gen), lookup_file(gen, name), "file");
+}
+
+// Query cursors are module globals (iwb_cursor_name) like files
+static LLVMValueRef lookup_cursor(Generator* gen, const char* name) {
+    char* symbol = function_symbol("iwb_cursor_", name);
+    LLVMValueRef global = LLVMGetNamedGlobal(gen->module, symbol);
+    free(symbol);
+    return global;
+}
+
+static void declare_cursors(Generator* gen, ASTNode* node) {
+    if (node->type == NODE_DBQUERY && !lookup_cursor(gen, node->value)) {
+        char* symbol = function_symbol("iwb_cursor_", node->value);
+        LLVMValueRef global = LLVMAddGlobal(gen->module, i8_ptr_type(gen), symbol);
+        LLVMSetInitializer(global, LLVMConstNull(i8_ptr_type(gen)));
+        LLVMSetLinkage(global, LLVMInternalLinkage);
+        free(symbol);
+    }
+    for (int i = 0; i < node->children_count; i++) {
+        declare_cursors(gen, node->children[i]);
+    }
+}
+
+// DBFETCH(cursor, array, ...) fills the arrays with the next block of
+// rows, column i of the result going to the i-th array, and returns how
+// many rows it filled; 0 once the rows are used up. A block is as many
+// rows as the smallest array holds.
+static LLVMValueRef generate_dbfetch(Generator* gen, ASTNode* node) {
+    if (node->children_count < 2 || node->children[0]->type != NODE_IDENTIFIER ||
+        !lookup_cursor(gen, node->children[0]->value)) {
+        report_error(gen, "DBFETCH needs a cursor and arrays at line %d\n", node->line);
+        return NULL;
+    }
+    int count = node->children_count - 1;
+    LLVMTypeRef columns_type = LLVMArrayType(LLVMPointerType(LLVMInt32TypeInContext(gen->context), 0), count);
+    LLVMValueRef columns = build_entry_alloca(gen, columns_type, "columns");
+    LLVMValueRef capacity = NULL;
+    for (int i = 0; i < count; i++) {
+        ASTNode* arg = node->children[i + 1];
+        ArrayInfo* array = arg->type == NODE_IDENTIFIER ? lookup_array(gen, arg->value) : NULL;
+        if (!array) {
+            report_error(gen, "DBFETCH reads into DIM arrays at line %d\n", node->line);
+            return NULL;
+        }
+        LLVMValueRef indices[] = {
+            LLVMConstInt(LLVMInt32TypeInContext(gen->context), 0, 0),
+            LLVMConstInt(LLVMInt32TypeInContext(gen->context), i, 0)
+        };
+        LLVMValueRef slot = LLVMBuildGEP2(gen->builder, columns_type, columns, indices, 2, "column");
+        LLVMBuildStore(gen->builder, array_base(gen, array), slot);
+        LLVMValueRef size = array_count(gen, array);
+        if (!capacity) {
+            capacity = size;
+        } else {
+            LLVMValueRef smaller = LLVMBuildICmp(gen->builder, LLVMIntSLT, size, capacity, "smaller");
+            capacity = LLVMBuildSelect(gen->builder, smaller, size, capacity, "block");
+        }
+    }
+    LLVMValueRef args[] = {
+        LLVMBuildLoad2(gen->builder, i8_ptr_type(gen), lookup_cursor(gen, node->children[0]->value), "cursor"),
+        LLVMBuildBitCast(gen->builder, columns, LLVMPointerType(LLVMPointerType(LLVMInt32TypeInContext(gen->context), 0), 0), "columns"),
+        LLVMConstInt(LLVMInt32TypeInContext(gen->context), count, 0),
+        capacity
+    };
+    return call_runtime(gen, "iwbrt_db_fetch", LLVMInt32TypeInContext(gen->context), args, 4);
+}
+
+// Built-in functions first, then FUNCTIONs defined in the program
+static LLVMValueRef generate_call(Generator* gen, ASTNode* node) {
+    const VectorTypeInfo* vector_info = lookup_vector_type(node->value);
+    if (vector_info) {
+        return generate_vector_constructor(gen, node, vector_info);
+    }
+    if (strcasecmp(node->value, "SHUFFLE") == 0) {
+        return generate_shuffle(gen, node);
+    }
+    if (strcasecmp(node->value, "BLEND") == 0) {
+        return generate_blend(gen, node);
+    }
+    if (strcasecmp(node->value, "SUM") == 0 ||
+        strcasecmp(node->value, "MAX") == 0 ||
+        strcasecmp(node->value, "MIN") == 0) {
+        return generate_reduction(gen, node);
+    }
+    if (strcasecmp(node->value, "EOF") == 0) {
+        // EOF(file) is -1 once every line has been read
+        if (node->children_count != 1 || node->children[0]->type != NODE_IDENTIFIER ||
+            !lookup_file(gen, node->children[0]->value)) {
+            report_error(gen, "EOF needs a file at line %d\n", node->line);
+            return NULL;
+        }
+        LLVMValueRef file = load_file(gen, node->children[0]->value);
+        return call_runtime(gen, "iwbrt_file_eof", LLVMInt32TypeInContext(gen->context), &file, 1);
+    }
+    if (strcasecmp(node->value, "DBFETCH") == 0) {
+        return generate_dbfetch(gen, node);
+    }
+    if (strcasecmp(node->value, "BSEARCH") == 0) {
+        return generate_search(gen, node, "iwbrt_bsearch_i32");
+    }
+    if (strcasecmp(node->value, "FIND") == 0) {
+        return generate_search(gen, node, "iwbrt_find_i32");
+    }
+    if (strcasecmp(node->value, "HASKEY") == 0) {
+        // HASKEY(dict, key) is -1 when the key is present, 0 otherwise
+        if (node->children_count != 2 || node->children[0]->type != NODE_IDENTIFIER ||
+            !lookup_dict(gen, node->children[0]->value)) {
+            report_error(gen, "HASKEY needs a DICT and a key at line %d\n", node->line);
+            return NULL;
+        }
+        LLVMValueRef found = dict_call(gen, "has", LLVMInt32TypeInContext(gen->context), node->children[0]->value, node->children[1]);
+        if (!found) return NULL;
+        return LLVMBuildNeg(gen->builder, found, "mask");
+    }
+    if (strcasecmp(node->value, "LEN") == 0 && node->children_count == 1 &&
+        node->children[0]->type == NODE_IDENTIFIER && !lookup_variable(gen, node->children[0]->value) &&
+        lookup_dict(gen, node->children[0]->value)) {
+        // LEN(dict) counts its keys
+        LLVMValueRef dict = LLVMBuildLoad2(gen->builder, i8_ptr_type(gen),
+                                           lookup_dict(gen, node->children[0]->value), "dict");
+        return call_runtime(gen, "iwbrt_dict_count", LLVMInt32TypeInContext(gen->context), &dict, 1);
+    }
+    if (strcasecmp(node->value, "LEN") == 0 && node->children_count == 1) {
+        LLVMValueRef value = generate_expression(gen, node->children[0]);
+        if (!value) return NULL;
+        if (!is_string_type(LLVMTypeOf(value))) {
+            report_error(gen, "LEN needs a string at line %d\n", node->line);
+            return NULL;
+        }
+        return string_length(gen, value);
+    }
+    return generate_user_call(gen, node);
+}
+
+static LLVMValueRef generate_expression(Generator* gen, ASTNode* node) {
+    switch (node->type) {
+        case NODE_NUMBER: {
+            if (strchr(node->value, '.')) {
+                return LLVMConstReal(LLVMFloatTypeInContext(gen->context), atof(node->value));
+            }
+            int value = atoi(node->value);
+            return LLVMConstInt(LLVMInt32TypeInContext(gen->context), value, 0);
+        }
+        
+        case NODE_IDENTIFIER: {
+            if (gen->subst_name && strcmp(gen->subst_name, node->value) == 0) {
+                return gen->subst_value;
+            }
+            Variable* var = lookup_variable(gen, node->value);
+            if (!var) {
+                // BASIC variables spring into existence as zero
+                fprintf(gen->diagnostics, "Warning: Variable %s used before assignment\n", node->value);
+                return LLVMConstInt(LLVMInt32TypeInContext(gen->context), 0, 0);
+            }
+            if (is_string_type(var->type)) {
+                return var->value;
+            }
+            return LLVMBuildLoad2(gen->builder, var->type, var->value, "load");
+        }
+        
+        case NODE_ARRAY_ACCESS: {
+            if (is_dict_access(gen, node)) {
+                if (!check_dict_key(gen, node)) return NULL;
+                return dict_call(gen, "get", LLVMInt32TypeInContext(gen->context), node->value, node->children[0]);
+            }
+            if (is_vector_variable(gen, node->value)) {
+                Variable* var = lookup_variable(gen, node->value);
+                LLVMValueRef index = vector_lane_index(gen, var, node);
+                if (!index) return NULL;
+                LLVMValueRef vector = LLVMBuildLoad2(gen->builder, var->type, var->value, "vload");
+                return LLVMBuildExtractElement(gen->builder, vector, index, "lane");
+            }
+            LLVMValueRef ptr = array_element_ptr(gen, node);
+            if (!ptr) return NULL;
+            LLVMValueRef value = LLVMBuildLoad2(gen->builder, LLVMInt32TypeInContext(gen->context), ptr, "elemload");
+            LLVMSetAlignment(value, 4);
+            return value;
+        }
+        
+        case NODE_CALL:
+            return generate_call(gen, node);
+        
+        case NODE_STRING:
+            return string_literal(gen, node->value);
+        
+        case NODE_SPAWN:
+            return generate_spawn(gen, node);
+        
+        case NODE_AWAIT:
+            return generate_await(gen, node);
+        
+        case NODE_OPERATOR: {
+            LLVMValueRef left = generate_expression(gen, node->children[0]);
+            LLVMValueRef right = generate_expression(gen, node->children[1]);
+            if (!left || !right) return NULL;
+            return build_binary(gen, node->value, left, right);
+        }
+        
+        default:
+            return NULL;
+    }
+}
+
+// printf conversion for one scalar; floats are passed as double
+static const char* print_conversion(Generator* gen, LLVMValueRef* value) {
+    if (is_float_type(LLVMTypeOf(*value))) {
+        *value = LLVMBuildFPExt(gen->builder, *value, LLVMDoubleTypeInContext(gen->context), "todouble");
+        return "%g";
+    }
+    return "%d";
+}
+
+static LLVMValueRef generate_print(Generator* gen, ASTNode* node) {
+    LLVMValueRef printf_func = get_printf_function(gen->module);
+    ASTNode* expr = node->children[0];
+    LLVMTypeRef printf_type = LLVMFunctionType(LLVMInt32TypeInContext(gen->context), 
+                                              (LLVMTypeRef[]){LLVMPointerType(LLVMInt8TypeInContext(gen->context), 0)}, 
+                                              1, 1);
+    
+    if (expr->type == NODE_STRING) {
+        char* format = "%s\n";
+        LLVMValueRef fmt_str = LLVMBuildGlobalStringPtr(gen->builder, format, "fmt");
+        LLVMValueRef str = LLVMBuildGlobalStringPtr(gen->builder, expr->value, "str");
+        LLVMValueRef args[] = { fmt_str, str };
+        return LLVMBuildCall2(gen->builder, printf_type, printf_func, args, 2, "");
+    }
+    
+    LLVMValueRef value = generate_expression(gen, expr);
+    if (!value) return NULL;
+    if (is_string_type(LLVMTypeOf(value))) {
+        return call_runtime(gen, "iwbrt_string_print", LLVMVoidTypeInContext(gen->context), &value, 1);
+    }
+    if (LLVMGetTypeKind(LLVMTypeOf(value)) == LLVMPointerTypeKind) {
+        report_error(gen, "Cannot PRINT a task handle; PRINT AWAIT it instead\n");
+        return NULL;
+    }
+    
+    // Vectors print their lanes on one line, separated by spaces
+    bool vector = is_vector_type(LLVMTypeOf(value));
+    unsigned lanes = vector ? LLVMGetVectorSize(LLVMTypeOf(value)) : 1;
+    LLVMValueRef* args = malloc((lanes + 1) * sizeof(LLVMValueRef));
+    char format[128] = "";
+    for (unsigned i = 0; i < lanes; i++) {
+        LLVMValueRef lane = value;
+        if (vector) {
+            lane = LLVMBuildExtractElement(gen->builder, value, LLVMConstInt(LLVMInt32TypeInContext(gen->context), i, 0), "lane");
+        }
+        if (i > 0) strcat(format, " ");
+        strcat(format, print_conversion(gen, &lane));
+        args[i + 1] = lane;
+    }
+    strcat(format, "\n");
+    args[0] = LLVMBuildGlobalStringPtr(gen->builder, format, "fmt");
+    LLVMValueRef call = LLVMBuildCall2(gen->builder, printf_type, printf_func, args, lanes + 1, "");
+    free(args);
+    return call;
+}
+
+// Stores value into a scalar variable, a vector lane or an array element
+static void store_target(Generator* gen, ASTNode* target, LLVMValueRef value) {
+    if (target->type == NODE_ARRAY_ACCESS && is_vector_variable(gen, target->value)) {
+        Variable* var = lookup_variable(gen, target->value);
+        LLVMValueRef index = vector_lane_index(gen, var, target);
+        value = convert_value(gen, value, LLVMGetElementType(var->type));
+        if (!index || !value) return;
+        LLVMValueRef vector = LLVMBuildLoad2(gen->builder, var->type, var->value, "vload");
+        vector = LLVMBuildInsertElement(gen->builder, vector, value, index, "setlane");
+        LLVMBuildStore(gen->builder, vector, var->value);
+        return;
+    }
+    
+    if (is_dict_access(gen, target)) {
+        store_dict_entry(gen, target, value);
+        return;
+    }
+    
+    if (target->type == NODE_ARRAY_ACCESS) {
+        value = convert_value(gen, value, LLVMInt32TypeInContext(gen->context));
+        if (!value) return;
+        LLVMValueRef ptr = array_element_ptr(gen, target);
+        if (!ptr) return;
+        LLVMValueRef store = LLVMBuildStore(gen->builder, value, ptr);
+        LLVMSetAlignment(store, 4);
+        return;
+    }
+    
+    // A variable takes the type of the first value assigned to it;
+    // later assignments are converted to that type
+    Variable* var = lookup_variable(gen, target->value);
+    if (!var) {
+        var = declare_variable(gen, target->value, LLVMTypeOf(value));
+    }
+    if (is_string_type(var->type) && is_string_type(LLVMTypeOf(value))) {
+        LLVMValueRef args[] = { var->value, value };
+        call_runtime(gen, "iwbrt_string_assign", LLVMVoidTypeInContext(gen->context), args, 2);
+        return;
+    }
+    value = convert_value(gen, value, var->type);
+    if (!value) return;
+    LLVMBuildStore(gen->builder, value, var->value);
+}
+
+// True if the identifier name occurs anywhere in node
+static bool mentions(ASTNode* node, const char* name) {
+    if (node->type == NODE_IDENTIFIER && strcmp(node->value, name) == 0) return true;
+    for (int i = 0; i < node->children_count; i++) {
+        if (mentions(node->children[i], name)) return true;
+    }
+    return false;
+}
+
+// s = s + a + b ... on a string s appends a, b, ... to s in place, so
+// building a string in a loop costs time proportional to its length
+// instead of its square. Operands after the first that read s again
+// would see it half-built and go the ordinary way.
+static bool generate_append_let(Generator* gen, ASTNode* target, ASTNode* expr) {
+    Variable* var = lookup_variable(gen, target->value);
+    if (!var || !is_string_type(var->type)) return false;
+    
+    int tail_count = 0;
+    ASTNode* leftmost = expr;
+    while (leftmost->type == NODE_OPERATOR && strcmp(leftmost->value, "+") == 0) {
+        tail_count++;
+        leftmost = leftmost->children[0];
+    }
+    if (tail_count == 0 || leftmost->type != NODE_IDENTIFIER || strcmp(leftmost->value, var->name) != 0) {
+        return false;
+    }
+    
+    // Collect the appended operands in source order
+    ASTNode** tails = malloc(tail_count * sizeof(ASTNode*));
+    ASTNode* op = expr;
+    for (int i = tail_count - 1; i >= 0; i--) {
+        tails[i] = op->children[1];
+        op = op->children[0];
+    }
+    for (int i = 1; i < tail_count; i++) {
+        if (mentions(tails[i], var->name)) {
+            free(tails);
+            return false;
+        }
+    }
+    
+    for (int i = 0; i < tail_count; i++) {
+        LLVMValueRef value = generate_expression(gen, tails[i]);
+        if (value) value = to_string(gen, value);
+        if (!value) break;
+        LLVMValueRef args[] = { get_arena(gen), var->value, value };
+        call_runtime(gen, "iwbrt_string_append", LLVMVoidTypeInContext(gen->context), args, 3);
+    }
+    free(tails);
+    return true;
+}
+
+// The string variable name, declared empty if it does not exist yet
+static Variable* string_variable(Generator* gen, const char* name, int line) {
+    Variable* var = lookup_variable(gen, name);
+    if (!var) {
+        var = declare_variable(gen, name, string_type(gen));
+    }
+    if (!is_string_type(var->type)) {
+        report_error(gen, "%s is not a string at line %d\n", name, line);
+        return NULL;
+    }
+    return var;
+}
+
+// STRINGBUILDER name [capacity] empties name and reserves room for
+// capacity bytes (256 by default) so APPENDs do not reallocate early
+static void generate_stringbuilder(Generator* gen, ASTNode* node) {
+    Variable* var = string_variable(gen, node->value, node->line);
+    if (!var) return;
+    LLVMValueRef capacity = LLVMConstInt(LLVMInt32TypeInContext(gen->context), 256, 0);
+    if (node->children_count > 0) {
+        capacity = generate_expression(gen, node->children[0]);
+        if (capacity) capacity = convert_value(gen, capacity, LLVMInt32TypeInContext(gen->context));
+        if (!capacity) return;
+    }
+    LLVMValueRef args[] = { get_arena(gen), var->value, capacity };
+    call_runtime(gen, "iwbrt_string_reserve", LLVMVoidTypeInContext(gen->context), args, 3);
+}
+
+// APPEND name, expr
+static void generate_append(Generator* gen, ASTNode* node) {
+    Variable* var = string_variable(gen, node->value, node->line);
+    if (!var) return;
+    LLVMValueRef value = generate_expression(gen, node->children[0]);
+    if (value) value = to_string(gen, value);
+    if (!value) return;
+    LLVMValueRef args[] = { get_arena(gen), var->value, value };
+    call_runtime(gen, "iwbrt_string_append", LLVMVoidTypeInContext(gen->context), args, 3);
+}
+
+// Where a file's lines may go: the FUNCTION (NULL for the main program)
+// holding every OPEN, READLINE and CLOSE of it, and the one variable
+// its READLINEs fill
+typedef struct {
+    bool seen;
+    bool mixed;             // used from several functions or into several variables
+    ASTNode* function;
+    const char* target;
+} FileUse;
+
+static void scan_file_use(ASTNode* node, ASTNode* function, const char* name, FileUse* use) {
+    if (node->type == NODE_FUNCTION) function = node;
+    if ((node->type == NODE_OPEN || node->type == NODE_READLINE || node->type == NODE_CLOSE) &&
+        strcmp(node->value, name) == 0) {
+        if (use->seen && use->function != function) use->mixed = true;
+        use->seen = true;
+        use->function = function;
+        if (node->type == NODE_READLINE) {
+            const char* target = node->children[0]->value;
+            if (use->target && strcmp(use->target, target) != 0) use->mixed = true;
+            use->target = target;
+        }
+    }
+    for (int i = 0; i < node->children_count; i++) {
+        scan_file_use(node->children[i], function, name, use);
+    }
+}
+
+// True if a LET in node makes another variable share var's bytes
+static bool shares_string(ASTNode* node, const char* var, bool skip_functions) {
+    if (skip_functions && node->type == NODE_FUNCTION) return false;
+    if (node->type == NODE_LET && node->children[1]->type == NODE_IDENTIFIER &&
+        strcmp(node->children[1]->value, var) == 0 &&
+        (node->children[0]->type != NODE_IDENTIFIER || strcmp(node->children[0]->value, var) != 0)) {
+        return true;
+    }
+    for (int i = 0; i < node->children_count; i++) {
+        if (shares_string(node->children[i], var, skip_functions)) return true;
+    }
+    return false;
+}
+
+// READLINE may hand back a view of the file's memory instead of a copy
+// when nothing can hold on to the line past the next READLINE or CLOSE:
+// all reads go into one variable that no other variable is assigned
+// from, and the file is only opened, read and closed in one function,
+// which copies the last line out whenever it closes the file. The
+// variable returned is that one, or NULL when lines must be copied.
+static const char* line_view_variable(Generator* gen, const char* name) {
+    if (!gen->program) return NULL;
+    FileUse use = { false, false, NULL, NULL };
+    scan_file_use(gen->program, NULL, name, &use);
+    if (use.mixed || !use.target) return NULL;
+    ASTNode* scope = use.function ? use.function : gen->program;
+    if (shares_string(scope, use.target, use.function == NULL)) return NULL;
+    return use.target;
+}
+
+// Copies the line a view variable holds into the arena before the
+// memory it may point into goes away, so the variable keeps its value
+// just as it would if lines were copied all along
+static void keep_line_view(Generator* gen, const char* name) {
+    const char* view = line_view_variable(gen, name);
+    Variable* var = view ? lookup_variable(gen, view) : NULL;
+    if (var && is_string_type(var->type)) {
+        LLVMValueRef args[] = { get_arena(gen), var->value };
+        call_runtime(gen, "iwbrt_string_detach", LLVMVoidTypeInContext(gen->context), args, 2);
+    }
+}
+
+// OPEN file, path [, mode] closes whatever file was open under the name
+static void generate_open(Generator* gen, ASTNode* node) {
+    LLVMValueRef path = generate_expression(gen, node->children[0]);
+    LLVMValueRef mode = node->children_count > 1 ? generate_expression(gen, node->children[1])
+                                                 : LLVMConstNull(string_type(gen));
+    if (!path || !mode) return;
+    if (!is_string_type(LLVMTypeOf(path)) || !is_string_type(LLVMTypeOf(mode))) {
+        report_error(gen, "OPEN needs a path and mode as strings at line %d\n", node->line);
+        return;
+    }
+    keep_line_view(gen, node->value);
+    LLVMValueRef old = load_file(gen, node->value);
+    call_runtime(gen, "iwbrt_file_close", LLVMVoidTypeInContext(gen->context), &old, 1);
+    LLVMValueRef args[] = { path, mode };
+    LLVMValueRef file = call_runtime(gen, "iwbrt_file_open", i8_ptr_type(gen), args, 2);
+    LLVMBuildStore(gen->builder, file, lookup_file(gen, node->value));
+}
+
+static void generate_close(Generator* gen, ASTNode* node) {
+    keep_line_view(gen, node->value);
+    LLVMValueRef file = load_file(gen, node->value);
+    call_runtime(gen, "iwbrt_file_close", LLVMVoidTypeInContext(gen->context), &file, 1);
+    LLVMBuildStore(gen->builder, LLVMConstNull(i8_ptr_type(gen)), lookup_file(gen, node->value));
+}
+
+// READLINE file, var reads the next line into the string variable var
+static void generate_readline(Generator* gen, ASTNode* node) {
+    Variable* var = string_variable(gen, node->children[0]->value, node->line);
+    if (!var) return;
+    bool view = line_view_variable(gen, node->value) != NULL;
+    LLVMValueRef args[] = {
+        load_file(gen, node->value),
+        view ? LLVMConstNull(i8_ptr_type(gen)) : get_arena(gen),
+        var->value,
+        LLVMConstInt(LLVMInt32TypeInContext(gen->context), view, 0)
+    };
+    call_runtime(gen, "iwbrt_file_readline", LLVMInt32TypeInContext(gen->context), args, 4);
+}
+
+// WRITELINE file, expr writes expr (numbers as text) and a newline
+static void generate_writeline(Generator* gen, ASTNode* node) {
+    LLVMValueRef text = generate_expression(gen, node->children[0]);
+    if (text) text = to_string(gen, text);
+    if (!text) return;
+    LLVMValueRef args[] = { load_file(gen, node->value), text };
+    call_runtime(gen, "iwbrt_file_writeline", LLVMVoidTypeInContext(gen->context), args, 2);
+}
+
+static void generate_let(Generator* gen, ASTNode* node) {
+    ASTNode* target = node->children[0];
+    if (target->type == NODE_IDENTIFIER && lookup_array(gen, target->value)) {
+        generate_array_let(gen, node);
+        return;
+    }
+    if (target->type == NODE_IDENTIFIER && generate_append_let(gen, target, node->children[1])) {
+        return;
+    }
+    
+    LLVMValueRef value = generate_expression(gen, node->children[1]);
+    if (!value) return;
+    store_target(gen, target, value);
+}
+
+// DIM name[d0, d1, ...] reserves one contiguous, 64-byte aligned,
+// zero-filled block of d0*d1*... i32 elements laid out row-major.
+// Constant-sized arrays that fit GENERATOR_STACK_ARRAY_LIMIT are a single
+// entry-block alloca; everything else comes from iwbrt_array_alloc, which
+// rejects extents below one and sizes that do not fit, and is released
+// when main returns. Constant extents are checked here.
+static void generate_dim(Generator* gen, ASTNode* node) {
+    if (lookup_array(gen, node->value)) {
+        report_error(gen, "Array %s is already dimensioned\n", node->value);
+        return;
+    }
+    
+    ArrayInfo array;
+    array.dim_count = node->children_count;
+    array.dynamic = false;
+    
+    unsigned long long total = 1;
+    for (int k = 0; k < array.dim_count; k++) {
+        ASTNode* extent = node->children[k];
+        if (extent->type != NODE_NUMBER) {
+            array.dynamic = true;
+            continue;
+        }
+        unsigned long long value = strtoull(extent->value, NULL, 10);
+        if (value < 1 || value > INT32_MAX) {
+            report_error(gen, "Array %s needs extents from 1 to %d, not %s, at line %d\n",
+                    node->value, INT32_MAX, extent->value, node->line);
+            return;
+        }
+        if (__builtin_mul_overflow(total, value, &total) || total > INT64_MAX / 4) {
+            report_error(gen, "Array %s is too large at line %d\n", node->value, node->line);
+            return;
+        }
+    }
+    
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(gen->context);
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(gen->context);
+    LLVMTypeRef extents_type = LLVMArrayType(i32, array.dim_count);
+    LLVMValueRef extents = NULL;
+    array.dims = malloc(array.dim_count * sizeof(LLVMValueRef));
+    
+    if (!array.dynamic) {
+        for (int k = 0; k < array.dim_count; k++) {
+            array.dims[k] = LLVMConstInt(i32, strtoull(node->children[k]->value, NULL, 10), 0);
+        }
+        array.on_heap = total * 4 > GENERATOR_STACK_ARRAY_LIMIT;
+        if (array.on_heap) {
+            extents = LLVMAddGlobal(gen->module, extents_type, "extents");
+            LLVMSetInitializer(extents, LLVMConstArray(i32, array.dims, array.dim_count));
+            LLVMSetGlobalConstant(extents, 1);
+            LLVMSetLinkage(extents, LLVMPrivateLinkage);
+        }
+    } else {
+        // Extents are evaluated once, here, and kept in slots so later
+        // subscripts see the size the array was created with
+        extents = build_entry_alloca(gen, extents_type, "extents");
+        LLVMBuilderRef entry = LLVMCreateBuilderInContext(gen->context);
+        position_after(entry, extents);
+        for (int k = 0; k < array.dim_count; k++) {
+            LLVMValueRef indices[] = { LLVMConstInt(i64, 0, 0), LLVMConstInt(i64, k, 0) };
+            array.dims[k] = LLVMBuildInBoundsGEP2(entry, extents_type, extents, indices, 2, "dimslot");
+        }
+        LLVMDisposeBuilder(entry);
+        for (int k = 0; k < array.dim_count; k++) {
+            LLVMValueRef extent = generate_expression(gen, node->children[k]);
+            if (extent) extent = convert_value(gen, extent, i32);
+            if (!extent) {
+                free(array.dims);
+                return;
+            }
+            LLVMBuildStore(gen->builder, extent, array.dims[k]);
+        }
+        array.on_heap = true;
+    }
+    array.name = strdup(node->value);
+    
+    if (!array.on_heap) {
+        LLVMValueRef storage = build_entry_alloca(gen, LLVMArrayType(i32, (unsigned)total), node->value);
+        LLVMSetAlignment(storage, GENERATOR_ARRAY_ALIGN);
+        
+        // The element pointer is formed next to the alloca so it
+        // dominates every later subscript, wherever the DIM sits
+        LLVMBuilderRef entry = LLVMCreateBuilderInContext(gen->context);
+        position_after(entry, storage);
+        LLVMValueRef zero = LLVMConstInt(i64, 0, 0);
+        LLVMValueRef indices[] = { zero, zero };
+        array.base = LLVMBuildInBoundsGEP2(entry, LLVMArrayType(i32, (unsigned)total),
+                                           storage, indices, 2, "base");
+        LLVMDisposeBuilder(entry);
+        LLVMBuildMemSet(gen->builder, array.base, LLVMConstInt(LLVMInt8TypeInContext(gen->context), 0, 0),
+                        LLVMConstInt(i64, total * 4, 0), GENERATOR_ARRAY_ALIGN);
+    } else {
+        // The slot starts out null so freeing an array whose DIM never ran
+        // (or re-running a DIM inside a loop) is harmless
+        LLVMTypeRef slot_type = LLVMPointerType(i32, 0);
+        array.base = build_entry_alloca(gen, slot_type, "arrayslot");
+        LLVMBuilderRef init = LLVMCreateBuilderInContext(gen->context);
+        position_after(init, array.base);
+        LLVMBuildStore(init, LLVMConstNull(slot_type), array.base);
+        LLVMDisposeBuilder(init);
+        
+        LLVMValueRef free_func = get_c_function(gen->module, "free", free_type(gen));
+        LLVMValueRef old = LLVMBuildLoad2(gen->builder, slot_type, array.base, "old");
+        LLVMValueRef old_raw = LLVMBuildBitCast(gen->builder, old, LLVMPointerType(LLVMInt8TypeInContext(gen->context), 0), "oldraw");
+        LLVMBuildCall2(gen->builder, free_type(gen), free_func, &old_raw, 1, "");
+        
+        LLVMValueRef zero = LLVMConstInt(i64, 0, 0);
+        LLVMValueRef indices[] = { zero, zero };
+        LLVMValueRef args[] = {
+            LLVMBuildInBoundsGEP2(gen->builder, extents_type, extents, indices, 2, "extentlist"),
+            LLVMConstInt(i32, array.dim_count, 0),
+            LLVMConstInt(i32, node->line, 0)
+        };
+        LLVMValueRef data = call_runtime(gen, "iwbrt_array_alloc", slot_type, args, 3);
+        LLVMValueRef store = LLVMBuildStore(gen->builder, data, array.base);
+        LLVMSetAlignment(store, 8);
+    }
+    
+    gen->array_count++;
+    gen->arrays = realloc(gen->arrays, gen->array_count * sizeof(ArrayInfo));
+    gen->arrays[gen->array_count - 1] = array;
+}
+
+// Releases heap arrays before the current function returns
+static void generate_cleanup(Generator* gen) {
+    for (int i = 0; i < gen->array_count; i++) {
+        ArrayInfo* array = &gen->arrays[i];
+        if (!array->on_heap) continue;
+        
+        LLVMValueRef free_func = get_c_function(gen->module, "free", free_type(gen));
+        LLVMValueRef data = array_base(gen, array);
+        LLVMValueRef raw = LLVMBuildBitCast(gen->builder, data, LLVMPointerType(LLVMInt8TypeInContext(gen->context), 0), "raw");
+        LLVMBuildCall2(gen->builder, free_type(gen), free_func, &raw, 1, "");
+    }
+}
+
+static void generate_statement(Generator* gen, ASTNode* node);
+
+// True if any statement in the FOR body may assign name, either as a
+// variable, an inner loop variable or by (re)dimensioning an array.
+// Element stores leave the array's shape alone and do not count.
+static bool body_writes(ASTNode* node, int first, const char* name) {
+    for (int i = first; i < node->children_count; i++) {
+        ASTNode* child = node->children[i];
+        switch (child->type) {
+            case NODE_LET:
+                if (child->children[0]->type == NODE_IDENTIFIER &&
+                    strcmp(child->children[0]->value, name) == 0) return true;
+                break;
+            case NODE_DIM:
+                if (strcmp(child->value, name) == 0) return true;
+                break;
+            case NODE_FOR:
+            case NODE_PARALLEL_FOR:
+                if (strcmp(child->value, name) == 0) return true;
+                if (body_writes(child, 2, name)) return true;
+                break;
+            case NODE_FOR_EACH:
+                if (strcmp(child->value, name) == 0) return true;
+                if (body_writes(child, 1, name)) return true;
+                break;
+            case NODE_REDUCE:
+                if (strcmp(child->children[0]->value, name) == 0) return true;
+                break;
+            case NODE_STRINGBUILDER:
+            case NODE_APPEND:
+                if (strcmp(child->value, name) == 0) return true;
+                break;
+            case NODE_RECEIVE:
+                if (child->children[0]->type == NODE_IDENTIFIER &&
+                    strcmp(child->children[0]->value, name) == 0) return true;
+                break;
+            case NODE_IF:
+            case NODE_WHILE:
+                for (int b = 1; b < child->children_count; b++) {
+                    if (body_writes(child->children[b], 0, name)) return true;
+                }
+                break;
+            case NODE_READLINE:
+                if (strcmp(child->children[0]->value, name) == 0) return true;
+                break;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+// True if a node of the given type appears anywhere inside node
+static bool contains_type(ASTNode* node, NodeType type) {
+    if (node->type == type) return true;
+    for (int i = 0; i < node->children_count; i++) {
+        if (contains_type(node->children[i], type)) return true;
+    }
+    return false;
+}
+
+typedef enum {
+    LINEAR_INVARIANT,   // does not change while the loop runs
+    LINEAR_IN_VAR,      // a * var + b with a and b loop invariant
+    LINEAR_NONE
+} Linearity;
+
+// Classifies node with respect to the variable of loop. Linear
+// subscripts reach their extremes at the first and last iteration, so
+// checking those two points covers the whole loop.
+static Linearity linearity(ASTNode* node, ASTNode* loop) {
+    switch (node->type) {
+        case NODE_NUMBER:
+            return LINEAR_INVARIANT;
+        case NODE_IDENTIFIER:
+            if (strcmp(node->value, loop->value) == 0) return LINEAR_IN_VAR;
+            return body_writes(loop, 2, node->value) ? LINEAR_NONE : LINEAR_INVARIANT;
+        case NODE_OPERATOR: {
+            Linearity a = linearity(node->children[0], loop);
+            Linearity b = linearity(node->children[1], loop);
+            if (a == LINEAR_NONE || b == LINEAR_NONE) return LINEAR_NONE;
+            if (strcmp(node->value, "+") == 0 || strcmp(node->value, "-") == 0) {
+                return (a == LINEAR_IN_VAR || b == LINEAR_IN_VAR) ? LINEAR_IN_VAR : LINEAR_INVARIANT;
+            }
+            if (strcmp(node->value, "*") == 0) {
+                if (a == LINEAR_IN_VAR && b == LINEAR_IN_VAR) return LINEAR_NONE;
+                return (a == LINEAR_IN_VAR || b == LINEAR_IN_VAR) ? LINEAR_IN_VAR : LINEAR_INVARIANT;
+            }
+            return (a == LINEAR_INVARIANT && b == LINEAR_INVARIANT) ? LINEAR_INVARIANT : LINEAR_NONE;
+        }
+        default:
+            return LINEAR_NONE;
+    }
+}
+
+// Collects subscripts in expr that still need a check and whose indices
+// are linear in the loop variable
+static void collect_hoistable(Generator* gen, ASTNode* expr, ASTNode* loop,
+                              ASTNode*** found, int* found_count) {
+    if (expr->type == NODE_ARRAY_ACCESS) {
+        ArrayInfo* array = lookup_array(gen, expr->value);
+        bool hoistable = array && !body_writes(loop, 2, expr->value) &&
+                         expr->children_count == array->dim_count;
+        bool proven = true;
+        for (int k = 0; hoistable && k < expr->children_count; k++) {
+            if (linearity(expr->children[k], loop) == LINEAR_NONE) hoistable = false;
+            if (!index_proven(gen, array, expr->children[k], k)) proven = false;
+        }
+        if (hoistable && !proven) {
+            (*found_count)++;
+            *found = realloc(*found, *found_count * sizeof(ASTNode*));
+            (*found)[*found_count - 1] = expr;
+        }
+    }
+    for (int i = 0; i < expr->children_count; i++) {
+        collect_hoistable(gen, expr->children[i], loop, found, found_count);
+    }
+}
+
+// Replaces the per-iteration checks of the subscripts the body executes
+// on every iteration with one range check in the loop preheader:
+// each subscript is evaluated at the first and last value of the loop
+// variable. Bodies holding statements that could skip an access fall
+// back to per-access checks.
+static void generate_preheader_checks(Generator* gen, ASTNode* loop,
+                                      LLVMValueRef start, LLVMValueRef end) {
+    ASTNode** found = NULL;
+    int found_count = 0;
+    
+    for (int i = 2; i < loop->children_count; i++) {
+        ASTNode* stmt = loop->children[i];
+        switch (stmt->type) {
+            case NODE_LET:
+            case NODE_PRINT:
+            case NODE_SEND:
+            case NODE_RECEIVE:
+            case NODE_STRINGBUILDER:
+            case NODE_APPEND:
+            case NODE_OPEN:
+            case NODE_READLINE:
+            case NODE_WRITELINE:
+            case NODE_CLOSE:
+                for (int c = 0; c < stmt->children_count; c++) {
+                    collect_hoistable(gen, stmt->children[c], loop, &found, &found_count);
+                }
+                break;
+            case NODE_FOR:
+                // Only the bounds of an inner loop run unconditionally,
+                // and a RETURN inside it may end the outer loop early
+                if (contains_type(stmt, NODE_RETURN)) {
+                    free(found);
+                    return;
+                }
+                collect_hoistable(gen, stmt->children[0], loop, &found, &found_count);
+                collect_hoistable(gen, stmt->children[1], loop, &found, &found_count);
+                break;
+            case NODE_DIM:
+            case NODE_SORT:
+                break;
+            default:
+                free(found);
+                return;
+        }
+    }
+    
+    if (found_count == 0) {
+        free(found);
+        return;
+    }
+    
+    LLVMBasicBlockRef check_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "for.check");
+    LLVMBasicBlockRef after_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "for.checked");
+    LLVMValueRef runs = LLVMBuildICmp(gen->builder, LLVMIntSLE, start, end, "runs");
+    LLVMBuildCondBr(gen->builder, runs, check_block, after_block);
+    LLVMPositionBuilderAtEnd(gen->builder, check_block);
+    
+    LLVMValueRef in_range = LLVMConstInt(LLVMInt1TypeInContext(gen->context), 1, 0);
+    LLVMValueRef endpoints[] = { start, end };
+    gen->subst_name = loop->value;
+    for (int e = 0; e < 2; e++) {
+        gen->subst_value = endpoints[e];
+        for (int i = 0; i < found_count; i++) {
+            ArrayInfo* array = lookup_array(gen, found[i]->value);
+            for (int k = 0; k < found[i]->children_count; k++) {
+                LLVMValueRef index = generate_expression(gen, found[i]->children[k]);
+                LLVMValueRef ok = LLVMBuildICmp(gen->builder, LLVMIntULT, index,
+                                                array_dim(gen, array, k), "inbounds");
+                in_range = LLVMBuildAnd(gen->builder, in_range, ok, "allinbounds");
+            }
+        }
+    }
+    gen->subst_name = NULL;
+    gen->subst_value = NULL;
+    
+    build_bounds_guard(gen, in_range, loop->line);
+    LLVMBuildBr(gen->builder, after_block);
+    LLVMPositionBuilderAtEnd(gen->builder, after_block);
+    gen->current_block = after_block;
+    
+    gen->prechecked = realloc(gen->prechecked,
+                              (gen->prechecked_count + found_count) * sizeof(ASTNode*));
+    memcpy(gen->prechecked + gen->prechecked_count, found, found_count * sizeof(ASTNode*));
+    gen->prechecked_count += found_count;
+    free(found);
+}
+
+// FOR var = start TO end ... NEXT; end is evaluated once, before the loop
+static void generate_for(Generator* gen, ASTNode* node) {
+    LLVMValueRef start = generate_expression(gen, node->children[0]);
+    LLVMValueRef end = generate_expression(gen, node->children[1]);
+    if (start) start = convert_value(gen, start, LLVMInt32TypeInContext(gen->context));
+    if (end) end = convert_value(gen, end, LLVMInt32TypeInContext(gen->context));
+    if (!start || !end) return;
+    
+    Variable* var = lookup_variable(gen, node->value);
+    if (!var) {
+        var = declare_variable(gen, node->value, LLVMInt32TypeInContext(gen->context));
+    }
+    // Variables the body declares move gen->variables, so only the
+    // variable's storage is kept past this point
+    LLVMValueRef counter_ptr = var->value;
+    LLVMBuildStore(gen->builder, start, counter_ptr);
+    
+    // A loop variable the body leaves alone stays within the bounds,
+    // which lets subscripts built from it be proven at compile time
+    long long start_lo, start_hi, end_lo, end_hi;
+    bool ranged = !body_writes(node, 2, node->value) &&
+                  static_range(gen, node->children[0], &start_lo, &start_hi) &&
+                  static_range(gen, node->children[1], &end_lo, &end_hi);
+    if (ranged) {
+        gen->range_count++;
+        gen->ranges = realloc(gen->ranges, gen->range_count * sizeof(LoopRange));
+        gen->ranges[gen->range_count - 1] = (LoopRange){ node->value, start_lo, end_hi };
+    }
+    
+    // The body's subscripts are only prechecked while it is emitted; the
+    // nodes may be freed once the statement is done (--stream)
+    int prechecked_count = gen->prechecked_count;
+    if (gen->bounds_check && !body_writes(node, 2, node->value)) {
+        generate_preheader_checks(gen, node, start, end);
+    }
+    
+    LLVMBasicBlockRef cond_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "for.cond");
+    LLVMBasicBlockRef body_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "for.body");
+    LLVMBasicBlockRef exit_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "for.end");
+    LLVMBuildBr(gen->builder, cond_block);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, cond_block);
+    LLVMValueRef current = LLVMBuildLoad2(gen->builder, LLVMInt32TypeInContext(gen->context), counter_ptr, node->value);
+    LLVMValueRef more = LLVMBuildICmp(gen->builder, LLVMIntSLE, current, end, "forcond");
+    LLVMBuildCondBr(gen->builder, more, body_block, exit_block);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, body_block);
+    gen->current_block = body_block;
+    int arena_uses = gen->arena_uses;
+    for (int i = 2; i < node->children_count; i++) {
+        generate_statement(gen, node->children[i]);
+    }
+    collect_strings(gen, arena_uses);
+    LLVMValueRef counter = LLVMBuildLoad2(gen->builder, LLVMInt32TypeInContext(gen->context), counter_ptr, node->value);
+    LLVMValueRef next = LLVMBuildNSWAdd(gen->builder, counter, LLVMConstInt(LLVMInt32TypeInContext(gen->context), 1, 0), "next");
+    LLVMBuildStore(gen->builder, next, counter_ptr);
+    LLVMBuildBr(gen->builder, cond_block);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, exit_block);
+    gen->current_block = exit_block;
+    if (ranged) {
+        gen->range_count--;
+    }
+    gen->prechecked_count = prechecked_count;
+}
+
+static void free_scope_tables(Variable* variables, int var_count, ArrayInfo* arrays, int array_count) {
+    for (int i = 0; i < var_count; i++) {
+        free(variables[i].name);
+    }
+    for (int i = 0; i < array_count; i++) {
+        free(arrays[i].name);
+        free(arrays[i].dims);
+    }
+    free(variables);
+    free(arrays);
+}
+
+// Generator state of the enclosing function while another is emitted
+typedef struct {
+    LLVMValueRef function;
+    LLVMBasicBlockRef block;
+    Variable* variables;
+    int var_count;
+    ArrayInfo* arrays;
+    int array_count;
+    LLVMValueRef arena;
+    LLVMValueRef* exits;
+    int exit_count;
+    int arena_uses;
+    LLVMValueRef* collects;
+    int collect_count;
+    LLVMValueRef tasks;
+} FunctionScope;
+
+// Starts emitting into function with empty variable and array tables
+static void enter_function(Generator* gen, FunctionScope* saved, LLVMValueRef function) {
+    saved->function = gen->function;
+    saved->block = LLVMGetInsertBlock(gen->builder);
+    saved->variables = gen->variables;
+    saved->var_count = gen->var_count;
+    saved->arrays = gen->arrays;
+    saved->array_count = gen->array_count;
+    saved->arena = gen->arena;
+    saved->exits = gen->exits;
+    saved->exit_count = gen->exit_count;
+    saved->arena_uses = gen->arena_uses;
+    saved->collects = gen->collects;
+    saved->collect_count = gen->collect_count;
+    saved->tasks = gen->tasks;
+    
+    gen->function = function;
+    gen->variables = NULL;
+    gen->var_count = 0;
+    gen->arrays = NULL;
+    gen->array_count = 0;
+    gen->arena = NULL;
+    gen->exits = NULL;
+    gen->exit_count = 0;
+    gen->arena_uses = 0;
+    gen->collects = NULL;
+    gen->collect_count = 0;
+    gen->tasks = NULL;
+    gen->current_block = LLVMAppendBasicBlockInContext(gen->context, function, "entry");
+    LLVMPositionBuilderAtEnd(gen->builder, gen->current_block);
+}
+
+static void leave_function(Generator* gen, FunctionScope* saved) {
+    finish_collects(gen);
+    free_scope_tables(gen->variables, gen->var_count, gen->arrays, gen->array_count);
+    gen->function = saved->function;
+    gen->variables = saved->variables;
+    gen->var_count = saved->var_count;
+    gen->arrays = saved->arrays;
+    gen->array_count = saved->array_count;
+    free(gen->exits);
+    gen->arena = saved->arena;
+    gen->exits = saved->exits;
+    gen->exit_count = saved->exit_count;
+    gen->arena_uses = saved->arena_uses;
+    gen->collects = saved->collects;
+    gen->collect_count = saved->collect_count;
+    gen->tasks = saved->tasks;
+    gen->current_block = saved->block;
+    LLVMPositionBuilderAtEnd(gen->builder, saved->block);
+}
+
+// Folds a chunk's private reduction value into the shared variable
+static void combine_reduction(Generator* gen, const char* op, LLVMValueRef shared, LLVMValueRef value) {
+    if (strcmp(op, "+") == 0) {
+        LLVMAtomicRMWBinOp bin = is_float_type(LLVMTypeOf(value)) ? LLVMAtomicRMWBinOpFAdd
+                                                                   : LLVMAtomicRMWBinOpAdd;
+        LLVMBuildAtomicRMW(gen->builder, bin, shared, value, LLVMAtomicOrderingMonotonic, 0);
+        return;
+    }
+    if (strcasecmp(op, "MAX") == 0 || strcasecmp(op, "MIN") == 0) {
+        LLVMAtomicRMWBinOp bin = strcasecmp(op, "MAX") == 0 ? LLVMAtomicRMWBinOpMax : LLVMAtomicRMWBinOpMin;
+        LLVMBuildAtomicRMW(gen->builder, bin, shared, value, LLVMAtomicOrderingMonotonic, 0);
+        return;
+    }
+    
+    // There is no atomic multiply, so retry a compare-exchange
+    LLVMTypeRef type = LLVMTypeOf(value);
+    LLVMValueRef expected_slot = build_entry_alloca(gen, type, "expected");
+    LLVMValueRef initial = LLVMBuildLoad2(gen->builder, type, shared, "current");
+    LLVMSetOrdering(initial, LLVMAtomicOrderingMonotonic);
+    LLVMSetAlignment(initial, 4);
+    LLVMBuildStore(gen->builder, initial, expected_slot);
+    
+    LLVMBasicBlockRef retry = LLVMAppendBasicBlockInContext(gen->context, gen->function, "reduce.retry");
+    LLVMBasicBlockRef done = LLVMAppendBasicBlockInContext(gen->context, gen->function, "reduce.done");
+    LLVMBuildBr(gen->builder, retry);
+    LLVMPositionBuilderAtEnd(gen->builder, retry);
+    LLVMValueRef expected = LLVMBuildLoad2(gen->builder, type, expected_slot, "expected");
+    LLVMValueRef desired = LLVMBuildMul(gen->builder, expected, value, "product");
+    LLVMValueRef pair = LLVMBuildAtomicCmpXchg(gen->builder, shared, expected, desired,
+                                               LLVMAtomicOrderingMonotonic, LLVMAtomicOrderingMonotonic, 0);
+    LLVMBuildStore(gen->builder, LLVMBuildExtractValue(gen->builder, pair, 0, "seen"), expected_slot);
+    LLVMBuildCondBr(gen->builder, LLVMBuildExtractValue(gen->builder, pair, 1, "swapped"), done, retry);
+    LLVMPositionBuilderAtEnd(gen->builder, done);
+    gen->current_block = done;
+}
+
+static LLVMValueRef reduction_identity(const char* op, LLVMTypeRef type) {
+    if (is_float_type(type)) return LLVMConstReal(type, 0.0);
+    if (strcmp(op, "*") == 0) return LLVMConstInt(type, 1, 0);
+    if (strcasecmp(op, "MAX") == 0) return LLVMConstInt(type, -2147483647LL - 1, 1);
+    if (strcasecmp(op, "MIN") == 0) return LLVMConstInt(type, 2147483647LL, 1);
+    return LLVMConstInt(type, 0, 0);
+}
+
+static ASTNode* find_reduction(ASTNode* node, const char* name) {
+    for (int i = 2; i < node->children_count && node->children[i]->type == NODE_REDUCE; i++) {
+        if (strcmp(node->children[i]->children[0]->value, name) == 0) {
+            return node->children[i];
+        }
+    }
+    return NULL;
+}
+
+// PARALLEL FOR var = start TO end [REDUCE op: v, ...] ... NEXT
+//
+// The body is outlined into iwb_parallel_body(ctx, lo, hi), which runs
+// an ordinary FOR over lo..hi, and the loop is handed to
+// iwbrt_parallel_for. Variables and arrays of the enclosing function
+// are passed by address through ctx. Variables the body assigns are
+// private to each chunk (starting from their value before the loop).
+// Reduction variables start each chunk at the identity of their
+// operator and are folded into the shared variable atomically once
+// per chunk.
+static void generate_parallel_for(Generator* gen, ASTNode* node) {
+    int body_first = 2;
+    while (body_first < node->children_count && node->children[body_first]->type == NODE_REDUCE) {
+        body_first++;
+    }
+    for (int i = body_first; i < node->children_count; i++) {
+        if (node->children[i]->type == NODE_DIM) {
+            report_error(gen, "DIM is not allowed inside PARALLEL FOR at line %d\n", node->line);
+            return;
+        }
+        if (contains_type(node->children[i], NODE_RETURN) || contains_type(node->children[i], NODE_YIELD)) {
+            report_error(gen, "RETURN and YIELD are not allowed inside PARALLEL FOR at line %d\n", node->line);
+            return;
+        }
+        if (writes_dict(gen, node->children[i])) {
+            report_error(gen, "A DICT cannot be changed inside PARALLEL FOR at line %d\n", node->line);
+            return;
+        }
+    }
+    
+    LLVMValueRef start = generate_expression(gen, node->children[0]);
+    LLVMValueRef end = generate_expression(gen, node->children[1]);
+    if (start) start = convert_value(gen, start, LLVMInt32TypeInContext(gen->context));
+    if (end) end = convert_value(gen, end, LLVMInt32TypeInContext(gen->context));
+    if (!start || !end) return;
+    
+    // Reduction variables and the loop variable must exist out here
+    for (int i = 2; i < body_first; i++) {
+        ASTNode* reduce = node->children[i];
+        Variable* var = lookup_variable(gen, reduce->children[0]->value);
+        if (!var) {
+            var = declare_variable(gen, reduce->children[0]->value, LLVMInt32TypeInContext(gen->context));
+            LLVMBuildStore(gen->builder, LLVMConstInt(LLVMInt32TypeInContext(gen->context), 0, 0), var->value);
+        }
+        if (is_vector_type(var->type) || is_string_type(var->type) ||
+            (is_float_type(var->type) && strcmp(reduce->value, "+") != 0)) {
+            report_error(gen, "REDUCE %s: %s is not supported for this type at line %d\n",
+                    reduce->value, var->name, node->line);
+            return;
+        }
+    }
+    Variable* loop_var = lookup_variable(gen, node->value);
+    if (!loop_var) {
+        loop_var = declare_variable(gen, node->value, LLVMInt32TypeInContext(gen->context));
+    }
+    
+    // Capture every visible variable and array by address
+    int slot_count = 0;
+    for (int i = 0; i < gen->var_count; i++) {
+        if (&gen->variables[i] != loop_var) slot_count++;
+    }
+    for (int i = 0; i < gen->array_count; i++) {
+        slot_count += 1 + (gen->arrays[i].dynamic ? gen->arrays[i].dim_count : 0);
+    }
+    LLVMTypeRef ctx_type = LLVMArrayType(i8_ptr_type(gen), slot_count > 0 ? slot_count : 1);
+    LLVMValueRef ctx = build_entry_alloca(gen, ctx_type, "parctx");
+    LLVMValueRef ctx_slots = LLVMBuildBitCast(gen->builder, ctx, LLVMPointerType(i8_ptr_type(gen), 0), "ctxslots");
+    int slot = 0;
+    #define STORE_CAPTURE(ptr) do { \
+        LLVMValueRef index = LLVMConstInt(LLVMInt64TypeInContext(gen->context), slot++, 0); \
+        LLVMValueRef dst = LLVMBuildInBoundsGEP2(gen->builder, i8_ptr_type(gen), ctx_slots, &index, 1, "capture"); \
+        LLVMBuildStore(gen->builder, LLVMBuildBitCast(gen->builder, (ptr), i8_ptr_type(gen), "captured"), dst); \
+    } while (0)
+    for (int i = 0; i < gen->var_count; i++) {
+        if (&gen->variables[i] != loop_var) STORE_CAPTURE(gen->variables[i].value);
+    }
+    for (int i = 0; i < gen->array_count; i++) {
+        STORE_CAPTURE(gen->arrays[i].base);
+        for (int k = 0; gen->arrays[i].dynamic && k < gen->arrays[i].dim_count; k++) {
+            STORE_CAPTURE(gen->arrays[i].dims[k]);
+        }
+    }
+    #undef STORE_CAPTURE
+    
+    // Outlined body
+    LLVMTypeRef params[] = { i8_ptr_type(gen), LLVMInt32TypeInContext(gen->context), LLVMInt32TypeInContext(gen->context) };
+    LLVMTypeRef body_type = LLVMFunctionType(LLVMVoidTypeInContext(gen->context), params, 3, 0);
+    LLVMValueRef body = LLVMAddFunction(gen->module, "iwb_parallel_body", body_type);
+    LLVMSetLinkage(body, LLVMInternalLinkage);
+    
+    Variable* outer_vars = gen->variables;
+    int outer_var_count = gen->var_count;
+    ArrayInfo* outer_arrays = gen->arrays;
+    int outer_array_count = gen->array_count;
+    FunctionScope scope;
+    enter_function(gen, &scope, body);
+    
+    LLVMValueRef body_slots = LLVMBuildBitCast(gen->builder, LLVMGetParam(body, 0),
+                                               LLVMPointerType(i8_ptr_type(gen), 0), "ctxslots");
+    slot = 0;
+    #define LOAD_CAPTURE(type) LLVMBuildBitCast(gen->builder, \
+        LLVMBuildLoad2(gen->builder, i8_ptr_type(gen), \
+            LLVMBuildInBoundsGEP2(gen->builder, i8_ptr_type(gen), body_slots, \
+                (LLVMValueRef[]){ LLVMConstInt(LLVMInt64TypeInContext(gen->context), slot++, 0) }, 1, "capture"), "captured"), \
+        LLVMPointerType((type), 0), "shared")
+    
+    LLVMValueRef* reduce_shared = calloc(outer_var_count > 0 ? outer_var_count : 1, sizeof(LLVMValueRef));
+    for (int i = 0; i < outer_var_count; i++) {
+        Variable* outer = &outer_vars[i];
+        if (outer == loop_var) continue;
+        bool string = is_string_type(outer->type);
+        LLVMValueRef shared = LOAD_CAPTURE(string ? string_struct_type(gen) : outer->type);
+        ASTNode* reduce = find_reduction(node, outer->name);
+        if (reduce) {
+            Variable* local = declare_variable(gen, outer->name, outer->type);
+            LLVMBuildStore(gen->builder, reduction_identity(reduce->value, outer->type), local->value);
+            reduce_shared[i] = shared;
+        } else if (body_writes(node, body_first, outer->name)) {
+            fprintf(gen->diagnostics, "Warning: PARALLEL FOR at line %d assigns %s, which is not REDUCEd: "
+                    "each chunk of iterations works on its own copy and %s keeps its value from before the loop\n",
+                    node->line, outer->name, outer->name);
+            // A private string copy gets no spare room, so appends in the
+            // body never write into the shared buffer
+            Variable* local = declare_variable(gen, outer->name, outer->type);
+            if (string) {
+                LLVMValueRef args[] = { local->value, shared };
+                call_runtime(gen, "iwbrt_string_assign", LLVMVoidTypeInContext(gen->context), args, 2);
+            } else {
+                LLVMBuildStore(gen->builder, LLVMBuildLoad2(gen->builder, outer->type, shared, "firstprivate"),
+                               local->value);
+            }
+        } else {
+            gen->var_count++;
+            gen->variables = realloc(gen->variables, gen->var_count * sizeof(Variable));
+            gen->variables[gen->var_count - 1] = (Variable){ strdup(outer->name), shared, outer->type };
+        }
+    }
+    for (int i = 0; i < outer_array_count; i++) {
+        ArrayInfo array = outer_arrays[i];
+        array.name = strdup(array.name);
+        array.dims = malloc(array.dim_count * sizeof(LLVMValueRef));
+        array.base = LOAD_CAPTURE(array.on_heap ? LLVMPointerType(LLVMInt32TypeInContext(gen->context), 0) : LLVMInt32TypeInContext(gen->context));
+        for (int k = 0; k < array.dim_count; k++) {
+            array.dims[k] = array.dynamic ? LOAD_CAPTURE(LLVMInt32TypeInContext(gen->context)) : outer_arrays[i].dims[k];
+        }
+        gen->array_count++;
+        gen->arrays = realloc(gen->arrays, gen->array_count * sizeof(ArrayInfo));
+        gen->arrays[gen->array_count - 1] = array;
+    }
+    #undef LOAD_CAPTURE
+    
+    // The chunk is an ordinary FOR from lo to hi. The names of the
+    // bound variables cannot clash with BASIC identifiers.
+    Variable* lo = declare_variable(gen, "__lo", LLVMInt32TypeInContext(gen->context));
+    LLVMBuildStore(gen->builder, LLVMGetParam(body, 1), lo->value);
+    Variable* hi = declare_variable(gen, "__hi", LLVMInt32TypeInContext(gen->context));
+    LLVMBuildStore(gen->builder, LLVMGetParam(body, 2), hi->value);
+    ASTNode lo_node = { NODE_IDENTIFIER, "__lo", NULL, 0, node->line, 0 };
+    ASTNode hi_node = { NODE_IDENTIFIER, "__hi", NULL, 0, node->line, 0 };
+    int chunk_children = 2 + node->children_count - body_first;
+    ASTNode** children = malloc(chunk_children * sizeof(ASTNode*));
+    children[0] = &lo_node;
+    children[1] = &hi_node;
+    memcpy(children + 2, node->children + body_first, (node->children_count - body_first) * sizeof(ASTNode*));
+    ASTNode chunk = { NODE_FOR, node->value, children, chunk_children, node->line, 0 };
+    
+    // Whatever chunk runs, the variable stays within the full loop's bounds
+    long long start_lo, start_hi, end_lo, end_hi;
+    bool ranged = !body_writes(node, body_first, node->value) &&
+                  static_range(gen, node->children[0], &start_lo, &start_hi) &&
+                  static_range(gen, node->children[1], &end_lo, &end_hi);
+    if (ranged) {
+        gen->range_count++;
+        gen->ranges = realloc(gen->ranges, gen->range_count * sizeof(LoopRange));
+        gen->ranges[gen->range_count - 1] = (LoopRange){ node->value, start_lo, end_hi };
+    }
+    generate_for(gen, &chunk);
+    if (ranged) {
+        gen->range_count--;
+    }
+    free(children);
+    
+    for (int i = 0; i < outer_var_count; i++) {
+        if (!reduce_shared[i]) continue;
+        Variable* local = lookup_variable(gen, outer_vars[i].name);
+        LLVMValueRef value = LLVMBuildLoad2(gen->builder, local->type, local->value, "partial");
+        combine_reduction(gen, find_reduction(node, outer_vars[i].name)->value, reduce_shared[i], value);
+    }
+    free(reduce_shared);
+    mark_exit(gen, LLVMBuildRetVoid(gen->builder));
+    leave_function(gen, &scope);
+    
+    LLVMTypeRef run_params[] = { LLVMInt32TypeInContext(gen->context), LLVMInt32TypeInContext(gen->context), LLVMPointerType(body_type, 0), i8_ptr_type(gen) };
+    LLVMTypeRef run_type = LLVMFunctionType(LLVMVoidTypeInContext(gen->context), run_params, 4, 0);
+    LLVMValueRef run = get_c_function(gen->module, "iwbrt_parallel_for", run_type);
+    LLVMValueRef args[] = { start, end, body, LLVMBuildBitCast(gen->builder, ctx, i8_ptr_type(gen), "ctx") };
+    LLVMBuildCall2(gen->builder, run_type, run, args, 4, "");
+    
+    // Like a serial FOR, the variable ends one past the last iteration
+    LLVMValueRef ran = LLVMBuildICmp(gen->builder, LLVMIntSLE, start, end, "ran");
+    LLVMValueRef past = LLVMBuildNSWAdd(gen->builder, end, LLVMConstInt(LLVMInt32TypeInContext(gen->context), 1, 0), "past");
+    LLVMBuildStore(gen->builder, LLVMBuildSelect(gen->builder, ran, past, start, "final"), loop_var->value);
+}
+
+// IF cond THEN ... [ELSE ...] ENDIF; any non-zero condition is true
+static LLVMValueRef generate_condition(Generator* gen, ASTNode* node, const char* what) {
+    LLVMValueRef cond = generate_expression(gen, node->children[0]);
+    if (!cond) return NULL;
+    if (is_vector_type(LLVMTypeOf(cond)) || LLVMGetTypeKind(LLVMTypeOf(cond)) == LLVMPointerTypeKind) {
+        report_error(gen, "%s condition must be a number at line %d\n", what, node->line);
+        return NULL;
+    }
+    return is_float_type(LLVMTypeOf(cond))
+        ? LLVMBuildFCmp(gen->builder, LLVMRealONE, cond, LLVMConstReal(LLVMFloatTypeInContext(gen->context), 0.0), "cond")
+        : LLVMBuildICmp(gen->builder, LLVMIntNE, cond, LLVMConstInt(LLVMInt32TypeInContext(gen->context), 0, 0), "cond");
+}
+
+static void generate_if(Generator* gen, ASTNode* node) {
+    LLVMValueRef taken = generate_condition(gen, node, "IF");
+    if (!taken) return;
+    
+    LLVMBasicBlockRef then_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "if.then");
+    LLVMBasicBlockRef else_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "if.else");
+    LLVMBasicBlockRef merge_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "if.end");
+    LLVMBuildCondBr(gen->builder, taken, then_block, else_block);
+    
+    LLVMBasicBlockRef branches[] = { then_block, else_block };
+    for (int b = 0; b < 2; b++) {
+        LLVMPositionBuilderAtEnd(gen->builder, branches[b]);
+        gen->current_block = branches[b];
+        if (b + 1 < node->children_count) {
+            ASTNode* block = node->children[b + 1];
+            for (int i = 0; i < block->children_count; i++) {
+                generate_statement(gen, block->children[i]);
+            }
+        }
+        LLVMBuildBr(gen->builder, merge_block);
+    }
+    
+    LLVMPositionBuilderAtEnd(gen->builder, merge_block);
+    gen->current_block = merge_block;
+}
+
+// WHILE cond ... WEND tests cond before every pass, including the first
+static void generate_while(Generator* gen, ASTNode* node) {
+    LLVMBasicBlockRef cond_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "while.cond");
+    LLVMBasicBlockRef body_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "while.body");
+    LLVMBasicBlockRef exit_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "while.end");
+    LLVMBuildBr(gen->builder, cond_block);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, cond_block);
+    gen->current_block = cond_block;
+    LLVMValueRef more = generate_condition(gen, node, "WHILE");
+    if (!more) more = LLVMConstInt(LLVMInt1TypeInContext(gen->context), 0, 0);
+    LLVMBuildCondBr(gen->builder, more, body_block, exit_block);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, body_block);
+    gen->current_block = body_block;
+    ASTNode* body = node->children[1];
+    int arena_uses = gen->arena_uses;
+    for (int i = 0; i < body->children_count; i++) {
+        generate_statement(gen, body->children[i]);
+    }
+    collect_strings(gen, arena_uses);
+    LLVMBuildBr(gen->builder, cond_block);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, exit_block);
+    gen->current_block = exit_block;
+}
+
+static LLVMValueRef lookup_function(Generator* gen, const char* name) {
+    char* symbol = function_symbol("iwb_fn_", name);
+    LLVMValueRef func = LLVMGetNamedFunction(gen->module, symbol);
+    free(symbol);
+    return func;
+}
+
+static LLVMTypeRef function_type(LLVMValueRef func) {
+    return LLVMGetElementType(LLVMTypeOf(func));
+}
+
+// Generators return their coroutine handle instead of an i32
+static bool is_generator(LLVMValueRef func) {
+    return LLVMGetTypeKind(LLVMGetReturnType(function_type(func))) == LLVMPointerTypeKind;
+}
+
+static unsigned argument_count(LLVMValueRef func) {
+    return LLVMCountParams(func);
+}
+
+// Adds iwb_fn_name taking param_count i32s and returning an i32, or for
+// a generator its coroutine handle
+static LLVMValueRef add_function(Generator* gen, const char* name, int param_count, bool generator) {
+    LLVMTypeRef* params = malloc((param_count > 0 ? param_count : 1) * sizeof(LLVMTypeRef));
+    for (int p = 0; p < param_count; p++) {
+        params[p] = LLVMInt32TypeInContext(gen->context);
+    }
+    if (generator) {
+        gen->has_coroutines = true;
+    }
+    char* symbol = function_symbol("iwb_fn_", name);
+    LLVMTypeRef ret = generator ? i8_ptr_type(gen) : LLVMInt32TypeInContext(gen->context);
+    LLVMTypeRef type = LLVMFunctionType(ret, params, param_count, 0);
+    LLVMValueRef func = LLVMAddFunction(gen->module, symbol, type);
+    LLVMSetLinkage(func, LLVMInternalLinkage);
+    if (generator) {
+        // LLVM 14's coroutine passes only split functions the
+        // front end has marked as presplit coroutines
+        LLVMAttributeRef presplit = LLVMCreateStringAttribute(gen->context,
+                                                              "coroutine.presplit", 18, "0", 1);
+        LLVMAddAttributeAtIndex(func, LLVMAttributeFunctionIndex, presplit);
+    }
+    free(symbol);
+    free(params);
+    return func;
+}
+
+// The FUNCTION a call goes to. When streaming, one not seen yet is
+// declared from the call and its definition must match it.
+static LLVMValueRef call_target(Generator* gen, ASTNode* call, bool generator) {
+    LLVMValueRef func = lookup_function(gen, call->value);
+    if (!func && gen->streaming) {
+        func = add_function(gen, call->value, call->children_count, generator);
+    }
+    return func;
+}
+
+// Evaluates the arguments of a call to func, converted to i32
+static LLVMValueRef* generate_arguments(Generator* gen, ASTNode* node, LLVMValueRef func) {
+    unsigned param_count = argument_count(func);
+    if ((unsigned)node->children_count != param_count) {
+        report_error(gen, "%s takes %u argument(s), %d given at line %d\n",
+                node->value, param_count, node->children_count, node->line);
+        return NULL;
+    }
+    LLVMValueRef* args = malloc((param_count > 0 ? param_count : 1) * sizeof(LLVMValueRef));
+    for (unsigned i = 0; i < param_count; i++) {
+        args[i] = generate_expression(gen, node->children[i]);
+        if (args[i]) args[i] = convert_value(gen, args[i], LLVMInt32TypeInContext(gen->context));
+        if (!args[i]) {
+            free(args);
+            return NULL;
+        }
+    }
+    return args;
+}
+
+static LLVMValueRef generate_user_call(Generator* gen, ASTNode* node) {
+    LLVMValueRef func = call_target(gen, node, false);
+    if (!func) {
+        report_error(gen, "Unknown function %s at line %d\n", node->value, node->line);
+        return NULL;
+    }
+    if (is_generator(func)) {
+        report_error(gen, "%s YIELDs values and can only be used in FOR EACH at line %d\n",
+                node->value, node->line);
+        return NULL;
+    }
+    LLVMValueRef* args = generate_arguments(gen, node, func);
+    if (!args) return NULL;
+    LLVMValueRef result = LLVMBuildCall2(gen->builder, function_type(func),
+                                         func, args, LLVMCountParams(func), "call");
+    free(args);
+    return result;
+}
+
+// i32 iwb_task_name(i8* args): unpacks the argument block the runtime
+// copied at SPAWN and calls the function
+static LLVMValueRef get_task_thunk(Generator* gen, LLVMValueRef func, const char* name) {
+    char* symbol = function_symbol("iwb_task_", name);
+    LLVMValueRef thunk = LLVMGetNamedFunction(gen->module, symbol);
+    if (thunk) {
+        free(symbol);
+        return thunk;
+    }
+    
+    LLVMTypeRef params[] = { i8_ptr_type(gen) };
+    thunk = LLVMAddFunction(gen->module, symbol, LLVMFunctionType(LLVMInt32TypeInContext(gen->context), params, 1, 0));
+    LLVMSetLinkage(thunk, LLVMInternalLinkage);
+    free(symbol);
+    
+    FunctionScope scope;
+    enter_function(gen, &scope, thunk);
+    unsigned param_count = LLVMCountParams(func);
+    LLVMValueRef block = LLVMBuildBitCast(gen->builder, LLVMGetParam(thunk, 0),
+                                          LLVMPointerType(LLVMInt32TypeInContext(gen->context), 0), "args");
+    LLVMValueRef* args = malloc((param_count > 0 ? param_count : 1) * sizeof(LLVMValueRef));
+    for (unsigned i = 0; i < param_count; i++) {
+        LLVMValueRef index = LLVMConstInt(LLVMInt64TypeInContext(gen->context), i, 0);
+        LLVMValueRef ptr = LLVMBuildInBoundsGEP2(gen->builder, LLVMInt32TypeInContext(gen->context), block, &index, 1, "argptr");
+        args[i] = LLVMBuildLoad2(gen->builder, LLVMInt32TypeInContext(gen->context), ptr, "arg");
+    }
+    LLVMValueRef result = LLVMBuildCall2(gen->builder, function_type(func), func, args, param_count, "result");
+    LLVMBuildRet(gen->builder, result);
+    free(args);
+    leave_function(gen, &scope);
+    return thunk;
+}
+
+// The current function's task list: a null iwbrt_task* in its frame
+static LLVMValueRef get_tasks(Generator* gen) {
+    if (gen->tasks) {
+        return gen->tasks;
+    }
+    gen->tasks = build_entry_alloca(gen, i8_ptr_type(gen), "tasks");
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(gen->context);
+    position_after(builder, gen->tasks);
+    LLVMBuildStore(builder, LLVMConstNull(i8_ptr_type(gen)), gen->tasks);
+    LLVMDisposeBuilder(builder);
+    
+    for (int i = 0; i < gen->exit_count; i++) {
+        build_release(gen, gen->exits[i], "iwbrt_tasks_release", gen->tasks);
+    }
+    return gen->tasks;
+}
+
+// SPAWN f(args) evaluates the arguments now, queues f on the runtime's
+// work-stealing scheduler and yields the task handle (an i8*)
+static LLVMValueRef generate_spawn(Generator* gen, ASTNode* node) {
+    ASTNode* call = node->children[0];
+    LLVMValueRef func = call_target(gen, call, false);
+    if (!func || is_generator(func)) {
+        report_error(gen, "SPAWN needs a FUNCTION defined in the program that does not YIELD, "
+                "not %s, at line %d\n", call->value, node->line);
+        return NULL;
+    }
+    LLVMValueRef* args = generate_arguments(gen, call, func);
+    if (!args) return NULL;
+    
+    unsigned param_count = LLVMCountParams(func);
+    LLVMValueRef block = build_entry_alloca(gen, LLVMArrayType(LLVMInt32TypeInContext(gen->context), param_count > 0 ? param_count : 1),
+                                            "spawnargs");
+    LLVMValueRef slots = LLVMBuildBitCast(gen->builder, block, LLVMPointerType(LLVMInt32TypeInContext(gen->context), 0), "slots");
+    for (unsigned i = 0; i < param_count; i++) {
+        LLVMValueRef index = LLVMConstInt(LLVMInt64TypeInContext(gen->context), i, 0);
+        LLVMBuildStore(gen->builder, args[i],
+                       LLVMBuildInBoundsGEP2(gen->builder, LLVMInt32TypeInContext(gen->context), slots, &index, 1, "argptr"));
+    }
+    free(args);
+    
+    LLVMValueRef thunk = get_task_thunk(gen, func, call->value);
+    LLVMTypeRef spawn_params[] = {
+        LLVMTypeOf(thunk), i8_ptr_type(gen), LLVMInt64TypeInContext(gen->context), LLVMPointerType(i8_ptr_type(gen), 0)
+    };
+    LLVMTypeRef spawn_type = LLVMFunctionType(i8_ptr_type(gen), spawn_params, 4, 0);
+    LLVMValueRef spawn = get_c_function(gen->module, "iwbrt_spawn", spawn_type);
+    LLVMValueRef spawn_args[] = {
+        thunk,
+        LLVMBuildBitCast(gen->builder, block, i8_ptr_type(gen), "argblock"),
+        LLVMConstInt(LLVMInt64TypeInContext(gen->context), param_count * sizeof(int32_t), 0),
+        get_tasks(gen)
+    };
+    return LLVMBuildCall2(gen->builder, spawn_type, spawn, spawn_args, 4, "task");
+}
+
+// AWAIT h yields the result of the task, helping with queued tasks
+// while it is outstanding. The task stays on its spawning function's
+// list until that returns, so any copy of h may be awaited again.
+static LLVMValueRef generate_await(Generator* gen, ASTNode* node) {
+    LLVMValueRef handle = generate_expression(gen, node->children[0]);
+    if (!handle) return NULL;
+    if (LLVMTypeOf(handle) != i8_ptr_type(gen)) {
+        report_error(gen, "AWAIT needs a task handle from SPAWN at line %d\n", node->line);
+        return NULL;
+    }
+    LLVMTypeRef await_params[] = { i8_ptr_type(gen) };
+    LLVMTypeRef await_type = LLVMFunctionType(LLVMInt32TypeInContext(gen->context), await_params, 1, 0);
+    LLVMValueRef await = get_c_function(gen->module, "iwbrt_await", await_type);
+    return LLVMBuildCall2(gen->builder, await_type, await, &handle, 1, "awaited");
+}
+
+// Channels are module globals (iwb_chan_name) so every FUNCTION and
+// task reaches them by name; each holds an iwbrt_channel*
+static LLVMValueRef lookup_channel(Generator* gen, const char* name) {
+    char* symbol = function_symbol("iwb_chan_", name);
+    LLVMValueRef global = LLVMGetNamedGlobal(gen->module, symbol);
+    free(symbol);
+    return global;
+}
+
+static void declare_channel(Generator* gen, ASTNode* node) {
+    if (node->type != NODE_CHANNEL || lookup_channel(gen, node->value)) return;
+    char* symbol = function_symbol("iwb_chan_", node->value);
+    LLVMValueRef global = LLVMAddGlobal(gen->module, i8_ptr_type(gen), symbol);
+    LLVMSetInitializer(global, LLVMConstNull(i8_ptr_type(gen)));
+    LLVMSetLinkage(global, LLVMInternalLinkage);
+    free(symbol);
+}
+
+static void declare_channels(Generator* gen, ASTNode* program) {
+    for (int i = 0; i < program->children_count; i++) {
+        declare_channel(gen, program->children[i]);
+    }
+}
+
+// CHANNEL name[capacity] creates the channel, replacing (and freeing)
+// the one a previous run of the statement created
+static void generate_channel(Generator* gen, ASTNode* node) {
+    LLVMValueRef global = lookup_channel(gen, node->value);
+    if (!global) {
+        report_error(gen, "CHANNEL %s must be declared at the top level at line %d\n",
+                node->value, node->line);
+        return;
+    }
+    LLVMValueRef capacity = generate_expression(gen, node->children[0]);
+    if (capacity) capacity = convert_value(gen, capacity, LLVMInt32TypeInContext(gen->context));
+    if (!capacity) return;
+    
+    LLVMTypeRef destroy_params[] = { i8_ptr_type(gen) };
+    LLVMTypeRef destroy_type = LLVMFunctionType(LLVMVoidTypeInContext(gen->context), destroy_params, 1, 0);
+    LLVMValueRef destroy = get_c_function(gen->module, "iwbrt_channel_destroy", destroy_type);
+    LLVMValueRef old = LLVMBuildLoad2(gen->builder, i8_ptr_type(gen), global, "oldchan");
+    LLVMBuildCall2(gen->builder, destroy_type, destroy, &old, 1, "");
+    
+    LLVMTypeRef create_params[] = { LLVMInt32TypeInContext(gen->context) };
+    LLVMTypeRef create_type = LLVMFunctionType(i8_ptr_type(gen), create_params, 1, 0);
+    LLVMValueRef create = get_c_function(gen->module, "iwbrt_channel_create", create_type);
+    LLVMValueRef channel = LLVMBuildCall2(gen->builder, create_type, create, &capacity, 1, "chan");
+    LLVMBuildStore(gen->builder, channel, global);
+}
+
+// Calls iwbrt_channel_send_batch or _receive_batch on a whole array
+static void generate_channel_batch(Generator* gen, const char* name, LLVMValueRef channel, ArrayInfo* array) {
+    LLVMTypeRef params[] = { i8_ptr_type(gen), LLVMPointerType(LLVMInt32TypeInContext(gen->context), 0), LLVMInt64TypeInContext(gen->context) };
+    LLVMTypeRef batch_type = LLVMFunctionType(LLVMVoidTypeInContext(gen->context), params, 3, 0);
+    LLVMValueRef batch = get_c_function(gen->module, name, batch_type);
+    LLVMValueRef args[] = { channel, array_base(gen, array), array_count(gen, array) };
+    LLVMBuildCall2(gen->builder, batch_type, batch, args, 3, "");
+}
+
+// SEND channel, value / SEND channel, array
+static void generate_send(Generator* gen, ASTNode* node) {
+    LLVMValueRef global = lookup_channel(gen, node->value);
+    if (!global) {
+        report_error(gen, "Unknown channel %s at line %d\n", node->value, node->line);
+        return;
+    }
+    LLVMValueRef channel = LLVMBuildLoad2(gen->builder, i8_ptr_type(gen), global, "chan");
+    
+    ASTNode* operand = node->children[0];
+    if (operand->type == NODE_IDENTIFIER && lookup_array(gen, operand->value)) {
+        generate_channel_batch(gen, "iwbrt_channel_send_batch", channel, lookup_array(gen, operand->value));
+        return;
+    }
+    
+    LLVMValueRef value = generate_expression(gen, operand);
+    if (value) value = convert_value(gen, value, LLVMInt32TypeInContext(gen->context));
+    if (!value) return;
+    LLVMTypeRef params[] = { i8_ptr_type(gen), LLVMInt32TypeInContext(gen->context) };
+    LLVMTypeRef send_type = LLVMFunctionType(LLVMVoidTypeInContext(gen->context), params, 2, 0);
+    LLVMValueRef send = get_c_function(gen->module, "iwbrt_channel_send", send_type);
+    LLVMValueRef args[] = { channel, value };
+    LLVMBuildCall2(gen->builder, send_type, send, args, 2, "");
+}
+
+// RECEIVE channel, target / RECEIVE channel, array (fills every element)
+static void generate_receive(Generator* gen, ASTNode* node) {
+    LLVMValueRef global = lookup_channel(gen, node->value);
+    if (!global) {
+        report_error(gen, "Unknown channel %s at line %d\n", node->value, node->line);
+        return;
+    }
+    LLVMValueRef channel = LLVMBuildLoad2(gen->builder, i8_ptr_type(gen), global, "chan");
+    
+    ASTNode* target = node->children[0];
+    if (target->type == NODE_IDENTIFIER && lookup_array(gen, target->value)) {
+        generate_channel_batch(gen, "iwbrt_channel_receive_batch", channel, lookup_array(gen, target->value));
+        return;
+    }
+    
+    LLVMTypeRef params[] = { i8_ptr_type(gen) };
+    LLVMTypeRef receive_type = LLVMFunctionType(LLVMInt32TypeInContext(gen->context), params, 1, 0);
+    LLVMValueRef receive = get_c_function(gen->module, "iwbrt_channel_receive", receive_type);
+    LLVMValueRef value = LLVMBuildCall2(gen->builder, receive_type, receive, &channel, 1, "received");
+    store_target(gen, target, value);
+}
+
+// Generators follow LLVM's switched-resume coroutine lowering. The
+// function starts like any other and runs to its first YIELD, which
+// stores the value in the coroutine's promise and suspends; the call
+// then returns the coroutine handle. FOR EACH reads the value from the
+// promise in the generator's frame (never the other way round: the
+// frame of a generator that consumes another is noalias in its resume
+// function, so nothing outside may write into it), runs
+// its body and resumes the handle until the coroutine reaches its final
+// suspend. The coroutine passes split the function into ramp, resume
+// and destroy parts when the module is finished; once the ramp is
+// inlined into the loop the frame lives on the consumer's stack and
+// the two sides fold into one loop.
+
+static LLVMValueRef coro_intrinsic(Generator* gen, const char* name, LLVMTypeRef ret,
+                                   LLVMTypeRef* params, int param_count) {
+    return get_c_function(gen->module, name, LLVMFunctionType(ret, params, param_count, 0));
+}
+
+static LLVMValueRef call_coro(Generator* gen, const char* name, LLVMTypeRef ret,
+                              LLVMValueRef* args, int arg_count, const char* value_name) {
+    LLVMTypeRef params[4];
+    for (int i = 0; i < arg_count; i++) {
+        params[i] = LLVMTypeOf(args[i]);
+    }
+    LLVMValueRef func = coro_intrinsic(gen, name, ret, params, arg_count);
+    return LLVMBuildCall2(gen->builder, function_type(func), func, args, arg_count, value_name);
+}
+
+static LLVMValueRef token_none(Generator* gen) {
+    return LLVMConstNull(LLVMTokenTypeInContext(gen->context));
+}
+
+// Suspends the coroutine; resumption continues in a fresh block. A
+// destroy request goes to the cleanup block.
+static void build_suspend(Generator* gen, bool final) {
+    LLVMValueRef args[] = { token_none(gen), LLVMConstInt(LLVMInt1TypeInContext(gen->context), final, 0) };
+    LLVMValueRef state = call_coro(gen, "llvm.coro.suspend", LLVMInt8TypeInContext(gen->context), args, 2, "suspend");
+    LLVMValueRef dispatch = LLVMBuildSwitch(gen->builder, state, gen->coro_suspend, 2);
+    LLVMAddCase(dispatch, LLVMConstInt(LLVMInt8TypeInContext(gen->context), 1, 0), gen->coro_cleanup);
+    if (!final) {
+        LLVMBasicBlockRef resume = LLVMAppendBasicBlockInContext(gen->context, gen->function, "coro.resume");
+        LLVMAddCase(dispatch, LLVMConstInt(LLVMInt8TypeInContext(gen->context), 0, 0), resume);
+        LLVMPositionBuilderAtEnd(gen->builder, resume);
+        gen->current_block = resume;
+    }
+}
+
+// Emits the coroutine prologue: frame allocation (skipped when the
+// frame is elided) and coro.begin. The builder is left in the block
+// the body starts in.
+static void begin_coroutine(Generator* gen, LLVMValueRef func) {
+    LLVMValueRef null = LLVMConstNull(i8_ptr_type(gen));
+    gen->coro_out = build_entry_alloca(gen, LLVMInt32TypeInContext(gen->context), "promise");
+    LLVMSetAlignment(gen->coro_out, GENERATOR_PROMISE_ALIGN);
+    LLVMValueRef promise = LLVMBuildBitCast(gen->builder, gen->coro_out, i8_ptr_type(gen), "promise.raw");
+    LLVMValueRef id_args[] = {
+        LLVMConstInt(LLVMInt32TypeInContext(gen->context), GENERATOR_PROMISE_ALIGN, 0), promise, null, null
+    };
+    gen->coro_id = call_coro(gen, "llvm.coro.id", LLVMTokenTypeInContext(gen->context),
+                             id_args, 4, "id");
+    LLVMValueRef need_alloc = call_coro(gen, "llvm.coro.alloc", LLVMInt1TypeInContext(gen->context), &gen->coro_id, 1, "needalloc");
+    
+    LLVMBasicBlockRef entry = LLVMGetInsertBlock(gen->builder);
+    LLVMBasicBlockRef alloc_block = LLVMAppendBasicBlockInContext(gen->context, func, "coro.alloc");
+    LLVMBasicBlockRef begin_block = LLVMAppendBasicBlockInContext(gen->context, func, "coro.begin");
+    LLVMBuildCondBr(gen->builder, need_alloc, alloc_block, begin_block);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, alloc_block);
+    LLVMValueRef size = call_coro(gen, "llvm.coro.size.i64", LLVMInt64TypeInContext(gen->context), NULL, 0, "framesize");
+    LLVMTypeRef malloc_params[] = { LLVMInt64TypeInContext(gen->context) };
+    LLVMTypeRef malloc_type = LLVMFunctionType(i8_ptr_type(gen), malloc_params, 1, 0);
+    LLVMValueRef frame = LLVMBuildCall2(gen->builder, malloc_type,
+                                        get_c_function(gen->module, "malloc", malloc_type), &size, 1, "frame");
+    LLVMBuildBr(gen->builder, begin_block);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, begin_block);
+    LLVMValueRef memory = LLVMBuildPhi(gen->builder, i8_ptr_type(gen), "framemem");
+    LLVMBasicBlockRef incoming_blocks[] = { entry, alloc_block };
+    LLVMValueRef incoming_values[] = { null, frame };
+    LLVMAddIncoming(memory, incoming_values, incoming_blocks, 2);
+    LLVMValueRef begin_args[] = { gen->coro_id, memory };
+    gen->coro_handle = call_coro(gen, "llvm.coro.begin", i8_ptr_type(gen), begin_args, 2, "handle");
+    
+    gen->coro_final = LLVMAppendBasicBlockInContext(gen->context, func, "coro.final");
+    gen->coro_cleanup = LLVMAppendBasicBlockInContext(gen->context, func, "coro.cleanup");
+    gen->coro_suspend = LLVMAppendBasicBlockInContext(gen->context, func, "coro.suspend");
+    gen->current_block = begin_block;
+}
+
+// Finishes a generator: final suspend, cleanup and the shared exit
+static void end_coroutine(Generator* gen) {
+    LLVMBuildBr(gen->builder, gen->coro_final);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, gen->coro_final);
+    build_suspend(gen, true);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, gen->coro_cleanup);
+    generate_cleanup(gen);
+    LLVMValueRef free_args[] = { gen->coro_id, gen->coro_handle };
+    LLVMValueRef memory = call_coro(gen, "llvm.coro.free", i8_ptr_type(gen), free_args, 2, "framemem");
+    LLVMBuildCall2(gen->builder, free_type(gen), get_c_function(gen->module, "free", free_type(gen)), &memory, 1, "");
+    mark_exit(gen, LLVMBuildBr(gen->builder, gen->coro_suspend));
+    
+    LLVMPositionBuilderAtEnd(gen->builder, gen->coro_suspend);
+    LLVMValueRef end_args[] = { gen->coro_handle, LLVMConstInt(LLVMInt1TypeInContext(gen->context), 0, 0) };
+    call_coro(gen, "llvm.coro.end", LLVMInt1TypeInContext(gen->context), end_args, 2, "");
+    LLVMBuildRet(gen->builder, gen->coro_handle);
+    
+    gen->coro_id = NULL;
+    gen->coro_handle = NULL;
+    gen->coro_out = NULL;
+    gen->coro_final = NULL;
+    gen->coro_cleanup = NULL;
+    gen->coro_suspend = NULL;
+}
+
+// YIELD expr hands one value to the FOR EACH loop and suspends
+static void generate_yield(Generator* gen, ASTNode* node) {
+    if (!gen->coro_final) {
+        report_error(gen, "YIELD outside a FUNCTION at line %d\n", node->line);
+        return;
+    }
+    LLVMValueRef value = generate_expression(gen, node->children[0]);
+    if (value) value = convert_value(gen, value, LLVMInt32TypeInContext(gen->context));
+    if (!value) return;
+    LLVMBuildStore(gen->builder, value, gen->coro_out);
+    build_suspend(gen, false);
+}
+
+static void destroy_generator(Generator* gen, LLVMValueRef handle) {
+    call_coro(gen, "llvm.coro.destroy", LLVMVoidTypeInContext(gen->context), &handle, 1, "");
+}
+
+// FOR EACH var IN f(args) ... NEXT
+static void generate_for_each(Generator* gen, ASTNode* node) {
+    ASTNode* call = node->children[0];
+    LLVMValueRef func = call_target(gen, call, true);
+    if (!func || !is_generator(func)) {
+        report_error(gen, "FOR EACH needs a FUNCTION that YIELDs, not %s, at line %d\n",
+                call->value, node->line);
+        return;
+    }
+    LLVMValueRef* args = generate_arguments(gen, call, func);
+    if (!args) return;
+    unsigned arg_count = argument_count(func);
+    LLVMValueRef handle = LLVMBuildCall2(gen->builder, function_type(func), func, args, arg_count, "generator");
+    free(args);
+    LLVMValueRef promise_args[] = {
+        handle,
+        LLVMConstInt(LLVMInt32TypeInContext(gen->context), GENERATOR_PROMISE_ALIGN, 0),
+        LLVMConstInt(LLVMInt1TypeInContext(gen->context), 0, 0)
+    };
+    LLVMValueRef promise = call_coro(gen, "llvm.coro.promise", i8_ptr_type(gen), promise_args, 3, "promise");
+    LLVMValueRef slot = LLVMBuildBitCast(gen->builder, promise, LLVMPointerType(LLVMInt32TypeInContext(gen->context), 0),
+                                         "each.slot");
+    
+    LLVMBasicBlockRef cond_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "each.cond");
+    LLVMBasicBlockRef body_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "each.body");
+    LLVMBasicBlockRef exit_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "each.end");
+    LLVMBuildBr(gen->builder, cond_block);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, cond_block);
+    LLVMValueRef done = call_coro(gen, "llvm.coro.done", LLVMInt1TypeInContext(gen->context), &handle, 1, "done");
+    LLVMBuildCondBr(gen->builder, done, exit_block, body_block);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, body_block);
+    gen->current_block = body_block;
+    ASTNode target = { NODE_IDENTIFIER, node->value, NULL, 0, node->line, 0 };
+    store_target(gen, &target, LLVMBuildLoad2(gen->builder, LLVMInt32TypeInContext(gen->context), slot, "yielded"));
+    
+    gen->open_generator_count++;
+    gen->open_generators = realloc(gen->open_generators, gen->open_generator_count * sizeof(LLVMValueRef));
+    gen->open_generators[gen->open_generator_count - 1] = handle;
+    int arena_uses = gen->arena_uses;
+    for (int i = 1; i < node->children_count; i++) {
+        generate_statement(gen, node->children[i]);
+    }
+    collect_strings(gen, arena_uses);
+    gen->open_generator_count--;
+    
+    call_coro(gen, "llvm.coro.resume", LLVMVoidTypeInContext(gen->context), &handle, 1, "");
+    LLVMBuildBr(gen->builder, cond_block);
+    
+    LLVMPositionBuilderAtEnd(gen->builder, exit_block);
+    gen->current_block = exit_block;
+    destroy_generator(gen, handle);
+}
+
+// Splits the generators into coroutine parts, inlining their ramps so
+// coro-elide can move frames onto the caller's stack. As in LLVM's own
+// pipeline a caller is split only after the ramps it calls have been
+// inlined and elided; a generator consuming another generator then
+// keeps the elided frame in its own frame rather than on the stack of
+// one resume.
+static void lower_coroutines(Generator* gen) {
+    LLVMPassBuilderOptionsRef options = LLVMCreatePassBuilderOptions();
+    LLVMErrorRef error = LLVMRunPasses(gen->module,
+        "function(coro-early),cgscc(inline,function(coro-elide),coro-split),function(coro-cleanup)",
+        NULL, options);
+    if (error) {
+        char* message = LLVMGetErrorMessage(error);
+        report_error(gen, "Lowering generators failed: %s\n", message);
+        LLVMDisposeErrorMessage(message);
+    }
+    LLVMDisposePassBuilderOptions(options);
+}
+
+// RETURN expr leaves the current FUNCTION with expr converted to i32;
+// in the main program it ends the program with expr as exit status.
+// In a generator the value is evaluated and dropped.
+static void generate_return(Generator* gen, ASTNode* node) {
+    LLVMValueRef value = generate_expression(gen, node->children[0]);
+    if (value) value = convert_value(gen, value, LLVMInt32TypeInContext(gen->context));
+    if (!value) return;
+    
+    for (int i = gen->open_generator_count - 1; i >= 0; i--) {
+        destroy_generator(gen, gen->open_generators[i]);
+    }
+    if (gen->coro_final) {
+        // A generator has no result; RETURN ends its sequence
+        LLVMBuildBr(gen->builder, gen->coro_final);
+    } else {
+        generate_cleanup(gen);
+        mark_exit(gen, LLVMBuildRet(gen->builder, value));
+    }
+    
+    // Anything after the RETURN in this block is unreachable but still
+    // needs a block to go in
+    gen->current_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "after.return");
+    LLVMPositionBuilderAtEnd(gen->builder, gen->current_block);
+}
+
+// False when node is a FUNCTION whose body must not be emitted
+static bool declare_function(Generator* gen, ASTNode* node) {
+    if (node->type != NODE_FUNCTION) return true;
+    int param_count = 0;
+    while (param_count < node->children_count && node->children[param_count]->type == NODE_IDENTIFIER) {
+        param_count++;
+    }
+    bool generator = contains_type(node, NODE_YIELD);
+    
+    LLVMValueRef func = lookup_function(gen, node->value);
+    if (func && gen->streaming && LLVMCountBasicBlocks(func) == 0) {
+        // Declared by a call further up
+        if (argument_count(func) != (unsigned)param_count || is_generator(func) != generator) {
+            report_error(gen, "FUNCTION %s does not match how it was called before line %d\n",
+                    node->value, node->line);
+            return false;
+        }
+        return true;
+    }
+    if (func) {
+        report_error(gen, "FUNCTION %s is defined twice at line %d\n", node->value, node->line);
+        return false;
+    }
+    add_function(gen, node->value, param_count, generator);
+    return true;
+}
+
+// Declares every top-level FUNCTION so calls may precede definitions
+// and functions may call each other
+static void declare_functions(Generator* gen, ASTNode* program) {
+    for (int i = 0; i < program->children_count; i++) {
+        declare_function(gen, program->children[i]);
+    }
+}
+
+// Emits the body of a FUNCTION declared by declare_functions. Parameters
+// are i32 locals; falling off the end returns 0, or for a generator
+// ends the sequence.
+static void generate_function(Generator* gen, ASTNode* node) {
+    LLVMValueRef func = lookup_function(gen, node->value);
+    if (!func || LLVMCountBasicBlocks(func) > 0) {
+        report_error(gen, "FUNCTION %s must be defined at the top level at line %d\n",
+                node->value, node->line);
+        return;
+    }
+    
+    FunctionScope scope;
+    enter_function(gen, &scope, func);
+    LoopRange* outer_ranges = gen->ranges;
+    int outer_range_count = gen->range_count;
+    gen->ranges = NULL;
+    gen->range_count = 0;
+    
+    bool generator = is_generator(func);
+    if (generator) {
+        begin_coroutine(gen, func);
+    }
+    
+    unsigned param_count = argument_count(func);
+    for (unsigned p = 0; p < param_count; p++) {
+        Variable* var = declare_variable(gen, node->children[p]->value, LLVMInt32TypeInContext(gen->context));
+        LLVMBuildStore(gen->builder, LLVMGetParam(func, p), var->value);
+    }
+    for (int i = param_count; i < node->children_count; i++) {
+        generate_statement(gen, node->children[i]);
+    }
+    if (generator) {
+        end_coroutine(gen);
+    } else {
+        generate_cleanup(gen);
+        mark_exit(gen, LLVMBuildRet(gen->builder, LLVMConstInt(LLVMInt32TypeInContext(gen->context), 0, 0)));
+    }
+    
+    free(gen->ranges);
+    gen->ranges = outer_ranges;
+    gen->range_count = outer_range_count;
+    leave_function(gen, &scope);
+}
+
+// DBCONNECT database [user [password]]; SQLite has no users, so the
+// credentials are evaluated and otherwise ignored
+static void generate_dbconnect(Generator* gen, ASTNode* node) {
+    LLVMValueRef name = NULL;
+    for (int i = 0; i < node->children_count; i++) {
+        LLVMValueRef value = generate_expression(gen, node->children[i]);
+        if (!value) return;
+        if (!is_string_type(LLVMTypeOf(value))) {
+            report_error(gen, "DBCONNECT needs strings at line %d\n", node->line);
+            return;
+        }
+        if (i == 0) name = value;
+    }
+    call_runtime(gen, "iwbrt_db_connect", LLVMVoidTypeInContext(gen->context), &name, 1);
+}
+
+// Looks up the statement for children[0] and binds the rest of the
+// children to its ? parameters in order. Leaves the database locked
+// (see iwbrt_db_prepare); NULL without generating the lookup when an
+// operand is in error.
+static LLVMValueRef prepare_statement(Generator* gen, ASTNode* node, const char* what, const char* bind_text) {
+    ASTNode* sql_node = node->children[0];
+    LLVMValueRef sql = generate_expression(gen, sql_node);
+    if (!sql) return NULL;
+    if (!is_string_type(LLVMTypeOf(sql))) {
+        report_error(gen, "%s needs the SQL as a string at line %d\n", what, node->line);
+        return NULL;
+    }
+    
+    // Evaluated before the statement is looked up, which takes the
+    // database lock until it has run
+    int count = node->children_count - 1;
+    LLVMValueRef* values = malloc((count + 1) * sizeof(LLVMValueRef));
+    for (int i = 0; i < count; i++) {
+        values[i] = generate_expression(gen, node->children[i + 1]);
+        LLVMTypeRef type = values[i] ? LLVMTypeOf(values[i]) : NULL;
+        if (!type) {
+            free(values);
+            return NULL;
+        }
+        if (!is_string_type(type) && (is_vector_type(type) || LLVMGetTypeKind(type) == LLVMPointerTypeKind)) {
+            report_error(gen, "%s values must be numbers or strings at line %d\n", what, node->line);
+            free(values);
+            return NULL;
+        }
+    }
+    
+    LLVMValueRef hash = sql_node->type == NODE_STRING
+        ? LLVMConstInt(LLVMInt64TypeInContext(gen->context), iwb_hash_bytes(sql_node->value, strlen(sql_node->value)), 0)
+        : call_runtime(gen, "iwbrt_string_hash", LLVMInt64TypeInContext(gen->context), &sql, 1);
+    LLVMValueRef prepare_args[] = { sql, hash };
+    LLVMValueRef statement = call_runtime(gen, "iwbrt_db_prepare", i8_ptr_type(gen), prepare_args, 2);
+    for (int i = 0; i < count; i++) {
+        LLVMTypeRef type = LLVMTypeOf(values[i]);
+        const char* bind = is_string_type(type) ? bind_text
+                         : is_float_type(type) ? "iwbrt_db_bind_float" : "iwbrt_db_bind_int";
+        LLVMValueRef args[] = { statement, LLVMConstInt(LLVMInt32TypeInContext(gen->context), i + 1, 0), values[i] };
+        call_runtime(gen, bind, LLVMVoidTypeInContext(gen->context), args, 3);
+    }
+    free(values);
+    return statement;
+}
+
+// DBEXECSQL sql [, value ...] runs sql from the statement cache with the
+// values bound to its ? parameters in order
+static void generate_dbexecsql(Generator* gen, ASTNode* node) {
+    LLVMValueRef statement = prepare_statement(gen, node, "DBEXECSQL", "iwbrt_db_bind_text");
+    if (!statement) return;
+    call_runtime(gen, "iwbrt_db_execute", LLVMVoidTypeInContext(gen->context), &statement, 1);
+}
+
+// DBQUERY cursor, sql [, value ...] starts sql and leaves its rows for
+// DBFETCH; a cursor still open from before is closed first
+static void generate_dbquery(Generator* gen, ASTNode* node) {
+    LLVMValueRef cursor = lookup_cursor(gen, node->value);
+    LLVMValueRef old = LLVMBuildLoad2(gen->builder, i8_ptr_type(gen), cursor, "cursor");
+    LLVMValueRef statement = prepare_statement(gen, node, "DBQUERY", "iwbrt_db_bind_text_copy");
+    if (!statement) return;
+    LLVMValueRef args[] = { statement, old };
+    LLVMBuildStore(gen->builder, call_runtime(gen, "iwbrt_db_query", i8_ptr_type(gen), args, 2), cursor);
+}
+
+// The outermost loop that runs DBEXECSQL becomes one transaction
+// instead of one per statement, unless --no-db-batch is given. Loops
+// that may be left early (RETURN, or a generator suspending at YIELD)
+// or that reconnect are left alone, as are loops inside a batch.
+static bool begin_db_batch(Generator* gen, ASTNode* node) {
+    if (node->type != NODE_FOR && node->type != NODE_WHILE &&
+        node->type != NODE_PARALLEL_FOR && node->type != NODE_FOR_EACH) {
+        return false;
+    }
+    if (!gen->db_batch || gen->in_db_batch || !contains_type(node, NODE_DBEXECSQL) ||
+        contains_type(node, NODE_RETURN) || contains_type(node, NODE_YIELD) ||
+        contains_type(node, NODE_DBCONNECT)) {
+        return false;
+    }
+    call_runtime(gen, "iwbrt_db_batch_begin", LLVMVoidTypeInContext(gen->context), NULL, 0);
+    gen->in_db_batch = true;
+    return true;
+}
+
+static void end_db_batch(Generator* gen, bool batch) {
+    if (batch) {
+        call_runtime(gen, "iwbrt_db_batch_end", LLVMVoidTypeInContext(gen->context), NULL, 0);
+        gen->in_db_batch = false;
+    }
+}
+
+static void generate_statement(Generator* gen, ASTNode* node) {
+    bool batch = begin_db_batch(gen, node);
+    switch (node->type) {
+        case NODE_PRINT:
+            generate_print(gen, node);
+            break;
+        case NODE_LET:
+            generate_let(gen, node);
+            break;
+        case NODE_DIM:
+            generate_dim(gen, node);
+            break;
+        case NODE_FOR:
+            generate_for(gen, node);
+            break;
+        case NODE_PARALLEL_FOR:
+            generate_parallel_for(gen, node);
+            break;
+        case NODE_IF:
+            generate_if(gen, node);
+            break;
+        case NODE_RETURN:
+            generate_return(gen, node);
+            break;
+        case NODE_FUNCTION:
+            generate_function(gen, node);
+            break;
+        case NODE_CHANNEL:
+            generate_channel(gen, node);
+            break;
+        case NODE_SEND:
+            generate_send(gen, node);
+            break;
+        case NODE_RECEIVE:
+            generate_receive(gen, node);
+            break;
+        case NODE_YIELD:
+            generate_yield(gen, node);
+            break;
+        case NODE_STRINGBUILDER:
+            generate_stringbuilder(gen, node);
+            break;
+        case NODE_DICT:
+            generate_dict(gen, node);
+            break;
+        case NODE_SORT:
+            generate_sort(gen, node);
+            break;
+        case NODE_WHILE:
+            generate_while(gen, node);
+            break;
+        case NODE_OPEN:
+            generate_open(gen, node);
+            break;
+        case NODE_CLOSE:
+            generate_close(gen, node);
+            break;
+        case NODE_READLINE:
+            generate_readline(gen, node);
+            break;
+        case NODE_WRITELINE:
+            generate_writeline(gen, node);
+            break;
+        case NODE_APPEND:
+            generate_append(gen, node);
+            break;
+        case NODE_FOR_EACH:
+            generate_for_each(gen, node);
+            break;
+        case NODE_DBCONNECT:
+            generate_dbconnect(gen, node);
+            break;
+        case NODE_DBEXECSQL:
+            generate_dbexecsql(gen, node);
+            break;
+        case NODE_DBQUERY:
+            generate_dbquery(gen, node);
+            break;
+        case NODE_INCLUDE:
+            // Top-level INCLUDEs are read in before statements are emitted
+            report_error(gen, "INCLUDE must be at the top level at line %d\n", node->line);
+            break;
+        default:
+            break;
+    }
+    end_db_batch(gen, batch);
+}
+
+Generator* generator_create(const char* module_name) {
+    Generator* gen = malloc(sizeof(Generator));
+    gen->context = LLVMContextCreate();
+    gen->module = LLVMModuleCreateWithNameInContext(module_name, gen->context);
+    gen->builder = LLVMCreateBuilderInContext(gen->context);
+    
+    LLVMTypeRef main_type = LLVMFunctionType(LLVMInt32TypeInContext(gen->context), NULL, 0, 0);
+    gen->function = LLVMAddFunction(gen->module, "main", main_type);
+    
+    gen->current_block = LLVMAppendBasicBlockInContext(gen->context, gen->function, "entry");
+    LLVMPositionBuilderAtEnd(gen->builder, gen->current_block);
+    
+    gen->variables = NULL;
+    gen->var_count = 0;
+    gen->arrays = NULL;
+    gen->array_count = 0;
+    
+    gen->bounds_check = true;
+    gen->ranges = NULL;
+    gen->range_count = 0;
+    gen->prechecked = NULL;
+    gen->prechecked_count = 0;
+    gen->subst_name = NULL;
+    gen->subst_value = NULL;
+    
+    gen->coro_id = NULL;
+    gen->coro_handle = NULL;
+    gen->coro_out = NULL;
+    gen->coro_final = NULL;
+    gen->coro_cleanup = NULL;
+    gen->coro_suspend = NULL;
+    gen->has_coroutines = false;
+    gen->open_generators = NULL;
+    gen->open_generator_count = 0;
+    gen->arena = NULL;
+    gen->exits = NULL;
+    gen->exit_count = 0;
+    gen->arena_uses = 0;
+    gen->collects = NULL;
+    gen->collect_count = 0;
+    gen->tasks = NULL;
+    gen->program = NULL;
+    gen->streaming = false;
+    gen->error_count = 0;
+    gen->diagnostics = stderr;
+    gen->emit_stats = NULL;
+    gen->db_batch = true;
+    gen->in_db_batch = false;
+    
+    return gen;
+}
+
+void generator_generate(Generator* gen, ASTNode* node) {
+    declare_functions(gen, node);
+    declare_channels(gen, node);
+    declare_dicts(gen, node);
+    declare_files(gen, node);
+    declare_cursors(gen, node);
+    gen->program = node;
+    for (int i = 0; i < node->children_count; i++) {
+        generate_statement(gen, node->children[i]);
+    }
+    generator_finish(gen);
+}
+
+// Everything generator_generate declares up front comes from the
+// statement itself here. CHANNELs and DICTs therefore have to come
+// before the FUNCTIONs that use them, and READLINE always copies lines,
+// since nothing after the statement can be seen.
+void generator_generate_statement(Generator* gen, ASTNode* statement) {
+    if (statement->type == NODE_INCLUDE) {
+        for (int i = 0; i < statement->children_count; i++) {
+            generator_generate_statement(gen, statement->children[i]);
+        }
+        return;
+    }
+    if (!gen->streaming) {
+        // Names of instructions and blocks are most of the memory a
+        // large main takes; nothing reads them
+        LLVMContextSetDiscardValueNames(gen->context, 1);
+        gen->streaming = true;
+    }
+    if (!declare_function(gen, statement)) return;
+    declare_channel(gen, statement);
+    declare_dict(gen, statement);
+    declare_files(gen, statement);
+    declare_cursors(gen, statement);
+    generate_statement(gen, statement);
+}
+
+void generator_finish(Generator* gen) {
+    generate_cleanup(gen);
+    mark_exit(gen, LLVMBuildRet(gen->builder, LLVMConstInt(LLVMInt32TypeInContext(gen->context), 0, 0)));
+    finish_collects(gen);
+    
+    if (gen->streaming) {
+        // Functions declared by a call but never defined
+        size_t prefix = strlen("iwb_fn_");
+        for (LLVMValueRef func = LLVMGetFirstFunction(gen->module); func; func = LLVMGetNextFunction(func)) {
+            const char* symbol = LLVMGetValueName(func);
+            if (strncmp(symbol, "iwb_fn_", prefix) == 0 && LLVMCountBasicBlocks(func) == 0) {
+                report_error(gen, "Unknown function %s\n", symbol + prefix);
+                LLVMSetLinkage(func, LLVMExternalLinkage);
+            }
+        }
+    }
+    
+    // Every output comes from here, so IR the generator got wrong is
+    // caught before LLVM's passes or code generation trip over it
+    if (gen->error_count == 0) {
+        char* message = NULL;
+        if (LLVMVerifyModule(gen->module, LLVMReturnStatusAction, &message)) {
+            report_error(gen, "Generated IR is invalid, a compiler bug:\n%s", message);
+        }
+        LLVMDisposeMessage(message);
+    }
+    
+    if (gen->has_coroutines && gen->error_count == 0) {
+        lower_coroutines(gen);
+    }
 }
 
-void generator_write_bitcode(Generator* gen, const char* filename) {
+bool generator_write_bitcode(Generator* gen, const char* filename) {
     if (LLVMWriteBitcodeToFile(gen->module, filename) != 0) {
-        fprintf(stderr, "Error writing bitcode to file\n");
+        fprintf(gen->diagnostics, "Error writing bitcode to file\n");
+        return false;
     }
+    return true;
 }
 
 void generator_destroy(Generator* gen) {
-    free(gen->variables);
+    free_scope_tables(gen->variables, gen->var_count, gen->arrays, gen->array_count);
+    free(gen->ranges);
+    free(gen->prechecked);
+    free(gen->open_generators);
+    free(gen->exits);
+    free(gen->collects);
     LLVMDisposeBuilder(gen->builder);
     LLVMDisposeModule(gen->module);
+    LLVMContextDispose(gen->context);
     free(gen);
 }
 
@@ -0,0 +1,312 @@
+/*
+ * INCLUDE and the parsed-module cache for IWBC
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * INCLUDE "file" reads in the top-level statements of another file. A
+ * name that is not absolute is taken relative to the including file.
+ * Files are told apart by their real path and each is read in once per
+ * compile; including it again adds nothing.
+ *
+ * The parse of an included file is kept next to it in file.ast: the
+ * nodes in preorder, each a type byte followed by LEB128 line, column,
+ * child count and value length (0 for none, else length + 1) and the
+ * value bytes. The header records the hash and length of the source it
+ * came from and how many node types the parser had, so an edited file,
+ * or a parser with other node types, parses again and rewrites it.
+ * Reading a module back is a walk over the mapped file, with no lexing
+ * and none of the parser's per-token work. The INCLUDEs of a module are
+ * kept as written and resolved each time, so a change in a file it
+ * includes never leaves it stale. A directory that cannot be written
+ * just means no cache.
+ */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "iwbhash.h"
+#include "parser.h"
+
+#define MODULE_MAGIC "IWBAST1"
+#define MODULE_NODE_TYPES (NODE_INCLUDE + 1)
+
+typedef struct {
+    char magic[8];
+    uint32_t node_types;
+    uint32_t reserved;
+    uint64_t source_hash;
+    uint64_t source_length;
+} ModuleHeader;
+
+typedef struct {
+    unsigned char* data;
+    size_t size;
+    size_t capacity;
+} ByteBuffer;
+
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+    size_t pos;
+    bool bad;
+} ByteReader;
+
+static void put_byte(ByteBuffer* buffer, unsigned char byte) {
+    if (buffer->size == buffer->capacity) {
+        buffer->capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+    buffer->data[buffer->size++] = byte;
+}
+
+static void put_number(ByteBuffer* buffer, uint64_t value) {
+    while (value >= 0x80) {
+        put_byte(buffer, (unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    put_byte(buffer, (unsigned char)value);
+}
+
+static void put_node(ByteBuffer* buffer, const ASTNode* node) {
+    put_byte(buffer, (unsigned char)node->type);
+    put_number(buffer, (uint32_t)node->line);
+    put_number(buffer, (uint32_t)node->column);
+    put_number(buffer, (uint32_t)node->children_count);
+    size_t length = node->value ? strlen(node->value) : 0;
+    put_number(buffer, node->value ? length + 1 : 0);
+    for (size_t i = 0; i < length; i++) {
+        put_byte(buffer, (unsigned char)node->value[i]);
+    }
+    for (int i = 0; i < node->children_count; i++) {
+        put_node(buffer, node->children[i]);
+    }
+}
+
+static uint64_t get_number(ByteReader* reader) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (reader->pos >= reader->size) break;
+        unsigned char byte = reader->data[reader->pos++];
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    reader->bad = true;
+    return 0;
+}
+
+static ASTNode* get_node(ByteReader* reader) {
+    if (reader->pos >= reader->size || reader->data[reader->pos] >= MODULE_NODE_TYPES) {
+        reader->bad = true;
+        return NULL;
+    }
+    NodeType type = (NodeType)reader->data[reader->pos++];
+    uint64_t line = get_number(reader);
+    uint64_t column = get_number(reader);
+    uint64_t count = get_number(reader);
+    uint64_t value_size = get_number(reader);
+    // Every child takes at least five bytes, which bounds a bad count
+    if (reader->bad || line > INT_MAX || column > INT_MAX ||
+        count > (reader->size - reader->pos) / 5 ||
+        (value_size > 0 && value_size - 1 > reader->size - reader->pos)) {
+        reader->bad = true;
+        return NULL;
+    }
+
+    ASTNode* node = malloc(sizeof(ASTNode));
+    node->type = type;
+    node->line = (int)line;
+    node->column = (int)column;
+    node->value = NULL;
+    node->children = NULL;
+    node->children_count = 0;
+    if (value_size > 0) {
+        size_t length = (size_t)value_size - 1;
+        node->value = malloc(length + 1);
+        memcpy(node->value, reader->data + reader->pos, length);
+        node->value[length] = '\0';
+        reader->pos += length;
+    }
+    if (count > 0) {
+        node->children = malloc(count * sizeof(ASTNode*));
+        for (uint64_t i = 0; i < count; i++) {
+            ASTNode* child = get_node(reader);
+            if (!child) {
+                ast_destroy(node);
+                return NULL;
+            }
+            node->children[node->children_count++] = child;
+        }
+    }
+    return node;
+}
+
+static char* cache_path(const char* path) {
+    char* cached = malloc(strlen(path) + 5);
+    strcpy(cached, path);
+    strcat(cached, ".ast");
+    return cached;
+}
+
+// The module cached for a source with this hash and length, or NULL
+static ASTNode* read_module(const char* path, uint64_t hash, size_t length) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ModuleHeader)) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t)info.st_size;
+    unsigned char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    ModuleHeader header;
+    memcpy(&header, data, sizeof(header));
+    ASTNode* module = NULL;
+    if (memcmp(header.magic, MODULE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.node_types == MODULE_NODE_TYPES &&
+        header.source_hash == hash && header.source_length == length) {
+        ByteReader reader = { data, size, sizeof(ModuleHeader), false };
+        module = get_node(&reader);
+        if (module && (reader.pos != size || module->type != NODE_PROGRAM)) {
+            ast_destroy(module);
+            module = NULL;
+        }
+    }
+    munmap(data, size);
+    return module;
+}
+
+// Written to a temporary file and renamed, so a compile running at the
+// same time reads the old cache or the new one, never half of one
+static void write_module(const char* path, const ASTNode* module, uint64_t hash, size_t length) {
+    ModuleHeader header = { MODULE_MAGIC, MODULE_NODE_TYPES, 0, hash, length };
+    ByteBuffer buffer = { NULL, 0, 0 };
+    put_node(&buffer, module);
+
+    char* temp = malloc(strlen(path) + 8);
+    sprintf(temp, "%s.XXXXXX", path);
+    int fd = mkstemp(temp);
+    if (fd >= 0) {
+        bool ok = write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header) &&
+                  write(fd, buffer.data, buffer.size) == (ssize_t)buffer.size;
+        if (fchmod(fd, 0644) != 0) ok = false;
+        if (close(fd) != 0) ok = false;
+        if (!ok || rename(temp, path) != 0) unlink(temp);
+    }
+    free(temp);
+    free(buffer.data);
+}
+
+static char* read_source(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* source = size >= 0 ? malloc((size_t)size + 1) : NULL;
+    if (source) {
+        *length = fread(source, 1, (size_t)size, file);
+        source[*length] = '\0';
+    }
+    fclose(file);
+    return source;
+}
+
+// The statements of the file at path, from its cache when that is
+// current, otherwise parsed and cached
+static ASTNode* load_module(Parser* including, const char* path) {
+    size_t length;
+    char* source = read_source(path, &length);
+    if (!source) return NULL;
+    uint64_t hash = iwb_hash_bytes(source, length);
+    char* cached = cache_path(path);
+
+    ASTNode* module = read_module(cached, hash, length);
+    if (module) {
+        if (including->trace) fprintf(including->trace, "Loaded parsed module %s\n", cached);
+    } else {
+        Lexer* lexer = lexer_create_in_place(source, including->trace);
+        Parser* parser = parser_create(lexer);
+        parser->errors = including->errors;
+        module = parser_parse_module(parser);
+        parser_destroy(parser);
+        lexer_destroy(lexer);
+        if (module) write_module(cached, module, hash, length);
+    }
+    free(cached);
+    free(source);
+    return module;
+}
+
+// name relative to the directory of the file from, unless absolute
+static char* resolve(const char* from, const char* name) {
+    const char* slash = from ? strrchr(from, '/') : NULL;
+    if (name[0] == '/' || !slash) return strdup(name);
+    size_t dir = (size_t)(slash - from) + 1;
+    char* path = malloc(dir + strlen(name) + 1);
+    memcpy(path, from, dir);
+    strcpy(path + dir, name);
+    return path;
+}
+
+static bool include_file(Parser* parser, const char* from, ASTNode* node) {
+    IncludeSet* includes = parser->includes;
+    char* name = resolve(from, node->value);
+    char* path = realpath(name, NULL);
+    free(name);
+    if (!path) {
+        parser_error(parser, "Cannot open INCLUDE file %s at line %d\n", node->value, node->line);
+        return false;
+    }
+    for (int i = 0; i < includes->count; i++) {
+        if (strcmp(includes->paths[i], path) == 0) {
+            if (parser->trace) fprintf(parser->trace, "Already included %s\n", path);
+            free(path);
+            return true;
+        }
+    }
+    includes->paths = realloc(includes->paths, (includes->count + 1) * sizeof(char*));
+    includes->paths[includes->count++] = path;
+
+    ASTNode* module = load_module(parser, path);
+    if (!module) {
+        parser_error(parser, "Failed to parse INCLUDE file %s\n", path);
+        return false;
+    }
+    for (int i = 0; i < module->children_count; i++) {
+        ASTNode* statement = module->children[i];
+        if (statement->type == NODE_INCLUDE && !include_file(parser, path, statement)) {
+            ast_destroy(module);
+            return false;
+        }
+    }
+    // The module's statements become the INCLUDE's children
+    node->children = module->children;
+    node->children_count = module->children_count;
+    module->children = NULL;
+    module->children_count = 0;
+    ast_destroy(module);
+    return true;
+}
+
+bool parser_include(Parser* parser, ASTNode* node) {
+    if (!parser->includes) {
+        parser->includes = calloc(1, sizeof(IncludeSet));
+        parser->owns_includes = true;
+        // A library including the program back gets nothing
+        char* program = parser->path ? realpath(parser->path, NULL) : NULL;
+        if (program) {
+            parser->includes->paths = malloc(sizeof(char*));
+            parser->includes->paths[parser->includes->count++] = program;
+        }
+    }
+    return include_file(parser, parser->path, node);
+}
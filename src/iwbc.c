@@ -0,0 +1,176 @@
+/*
+ * In-memory compile API for IWBC (libiwbc)
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * Runs the same pipeline as iwbc over a source buffer. The lexer and
+ * parser trace nowhere unless asked to, and parse errors, generator
+ * errors and warnings are written to a memory stream that becomes the
+ * result's diagnostics. Bitcode comes from LLVMWriteBitcodeToMemoryBuffer
+ * and objects from generator_emit_object, so the bytes match what iwbc
+ * writes to a file.
+ *
+ * A JIT is an LLJIT instance per result, fed the optimized object file
+ * of the program (in one part: the JIT links object files, not
+ * archives). Its main JITDylib falls back on the symbols of the process
+ * for the runtime and libc.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
+#include "iwbc.h"
+#include "generator.h"
+
+struct IwbcResult {
+    bool ok;
+    char* diagnostics;
+    size_t diagnostics_size;
+    LLVMMemoryBufferRef data;   // bitcode or object
+    LLVMOrcLLJITRef jit;
+};
+
+void iwbc_options_init(IwbcOptions* options) {
+    options->bounds_check = true;
+    options->db_batch = true;
+    options->codegen_threads = 1;
+    options->path = NULL;
+    options->trace = NULL;
+}
+
+static void report_llvm_error(FILE* diagnostics, const char* what, LLVMErrorRef error) {
+    char* message = LLVMGetErrorMessage(error);
+    fprintf(diagnostics, "Error: %s: %s\n", what, message);
+    LLVMDisposeErrorMessage(message);
+}
+
+// Takes object over, whether or not it loads
+static LLVMOrcLLJITRef load_object(LLVMMemoryBufferRef object, FILE* diagnostics) {
+    LLVMOrcLLJITRef jit;
+    LLVMErrorRef error = LLVMOrcCreateLLJIT(&jit, NULL);
+    if (error) {
+        report_llvm_error(diagnostics, "Could not create JIT", error);
+        LLVMDisposeMemoryBuffer(object);
+        return NULL;
+    }
+    LLVMOrcJITDylibRef dylib = LLVMOrcLLJITGetMainJITDylib(jit);
+    LLVMOrcDefinitionGeneratorRef process;
+    error = LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(&process, LLVMOrcLLJITGetGlobalPrefix(jit),
+                                                                 NULL, NULL);
+    if (error) {
+        report_llvm_error(diagnostics, "Could not search process symbols", error);
+        LLVMDisposeMemoryBuffer(object);
+        LLVMOrcDisposeLLJIT(jit);
+        return NULL;
+    }
+    LLVMOrcJITDylibAddGenerator(dylib, process);
+    error = LLVMOrcLLJITAddObjectFile(jit, dylib, object);
+    if (error) {
+        report_llvm_error(diagnostics, "Could not load program", error);
+        LLVMOrcDisposeLLJIT(jit);
+        return NULL;
+    }
+    return jit;
+}
+
+IwbcResult* iwbc_compile(const char* source, size_t length, IwbcOutput output,
+                         const IwbcOptions* options) {
+    IwbcOptions defaults;
+    if (!options) {
+        iwbc_options_init(&defaults);
+        options = &defaults;
+    }
+    IwbcResult* result = calloc(1, sizeof(IwbcResult));
+    FILE* diagnostics = open_memstream(&result->diagnostics, &result->diagnostics_size);
+    if (!diagnostics) {
+        result->diagnostics = strdup("Error: Out of memory\n");
+        return result;
+    }
+
+    // The lexer reads up to a zero byte
+    char* text = malloc(length + 1);
+    memcpy(text, source, length);
+    text[length] = '\0';
+    Lexer* lexer = lexer_create_in_place(text, options->trace);
+    Parser* parser = parser_create(lexer);
+    parser->path = options->path;
+    parser->errors = diagnostics;
+    ASTNode* ast = parser_parse(parser);
+    bool parsed = !parser->failed;
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    free(text);
+
+    Generator* gen = generator_create("iwbasic_module");
+    gen->bounds_check = options->bounds_check;
+    gen->db_batch = options->db_batch;
+    gen->diagnostics = diagnostics;
+    generator_generate(gen, ast);
+    ast_destroy(ast);
+
+    if (parsed && gen->error_count == 0) {
+        switch (output) {
+            case IWBC_OUTPUT_BITCODE:
+                result->data = LLVMWriteBitcodeToMemoryBuffer(gen->module);
+                break;
+            case IWBC_OUTPUT_OBJECT:
+                result->data = generator_emit_object(gen, options->codegen_threads);
+                break;
+            case IWBC_OUTPUT_JIT: {
+                LLVMMemoryBufferRef object = generator_emit_object(gen, 1);
+                if (object) result->jit = load_object(object, diagnostics);
+                break;
+            }
+        }
+        result->ok = result->data || result->jit;
+    }
+    generator_destroy(gen);
+    fclose(diagnostics);
+    return result;
+}
+
+bool iwbc_result_ok(const IwbcResult* result) {
+    return result->ok;
+}
+
+const char* iwbc_result_diagnostics(const IwbcResult* result) {
+    return result->diagnostics;
+}
+
+const void* iwbc_result_data(const IwbcResult* result, size_t* size) {
+    if (!result->data) {
+        *size = 0;
+        return NULL;
+    }
+    *size = LLVMGetBufferSize(result->data);
+    return LLVMGetBufferStart(result->data);
+}
+
+void* iwbc_result_symbol(IwbcResult* result, const char* name) {
+    if (!result->jit) return NULL;
+    LLVMOrcExecutorAddress address;
+    LLVMErrorRef error = LLVMOrcLLJITLookup(result->jit, &address, name);
+    if (error) {
+        LLVMConsumeError(error);
+        return NULL;
+    }
+    return (void*)(uintptr_t)address;
+}
+
+int iwbc_result_run(IwbcResult* result) {
+    void* main_address = iwbc_result_symbol(result, "main");
+    if (!main_address) return -1;
+    int (*program)(void) = (int (*)(void))(uintptr_t)main_address;
+    return program();
+}
+
+void iwbc_result_destroy(IwbcResult* result) {
+    if (!result) return;
+    if (result->data) LLVMDisposeMemoryBuffer(result->data);
+    if (result->jit) LLVMOrcDisposeLLJIT(result->jit);
+    free(result->diagnostics);
+    free(result);
+}
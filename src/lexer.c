@@ -1,7 +1,7 @@
 /* 
  * Lexer for IWBC
  * Created: February 20, 2025 by LHS
- * Last modified: February 28, 2025 by LHS
+ * Last modified: October 19, 2026 by LHS
  *
  */
 
@@ -18,6 +18,41 @@ static const char* token_type_to_string(TokenType type) {
     switch(type) {
         case TOKEN_LET: return "LET";
         case TOKEN_PRINT: return "PRINT";
+        case TOKEN_DIM: return "DIM";
+        case TOKEN_FOR: return "FOR";
+        case TOKEN_TO: return "TO";
+        case TOKEN_NEXT: return "NEXT";
+        case TOKEN_WHILE: return "WHILE";
+        case TOKEN_WEND: return "WEND";
+        case TOKEN_PARALLEL: return "PARALLEL";
+        case TOKEN_REDUCE: return "REDUCE";
+        case TOKEN_IF: return "IF";
+        case TOKEN_THEN: return "THEN";
+        case TOKEN_ELSE: return "ELSE";
+        case TOKEN_ENDIF: return "ENDIF";
+        case TOKEN_FUNCTION: return "FUNCTION";
+        case TOKEN_RETURN: return "RETURN";
+        case TOKEN_END: return "END";
+        case TOKEN_SPAWN: return "SPAWN";
+        case TOKEN_AWAIT: return "AWAIT";
+        case TOKEN_CHANNEL: return "CHANNEL";
+        case TOKEN_SEND: return "SEND";
+        case TOKEN_RECEIVE: return "RECEIVE";
+        case TOKEN_YIELD: return "YIELD";
+        case TOKEN_EACH: return "EACH";
+        case TOKEN_IN: return "IN";
+        case TOKEN_STRINGBUILDER: return "STRINGBUILDER";
+        case TOKEN_APPEND: return "APPEND";
+        case TOKEN_DICT: return "DICT";
+        case TOKEN_SORT: return "SORT";
+        case TOKEN_OPEN: return "OPEN";
+        case TOKEN_READLINE: return "READLINE";
+        case TOKEN_WRITELINE: return "WRITELINE";
+        case TOKEN_CLOSE: return "CLOSE";
+        case TOKEN_DBCONNECT: return "DBCONNECT";
+        case TOKEN_DBEXECSQL: return "DBEXECSQL";
+        case TOKEN_DBQUERY: return "DBQUERY";
+        case TOKEN_INCLUDE: return "INCLUDE";
         case TOKEN_IDENTIFIER: return "IDENTIFIER";
         case TOKEN_NUMBER: return "NUMBER";
         case TOKEN_STRING: return "STRING";
@@ -26,19 +61,29 @@ static const char* token_type_to_string(TokenType type) {
         case TOKEN_MINUS: return "MINUS";
         case TOKEN_MULTIPLY: return "MULTIPLY";
         case TOKEN_DIVIDE: return "DIVIDE";
+        case TOKEN_GT: return "GT";
+        case TOKEN_LT: return "LT";
+        case TOKEN_LPAREN: return "LPAREN";
+        case TOKEN_RPAREN: return "RPAREN";
+        case TOKEN_LBRACKET: return "LBRACKET";
+        case TOKEN_RBRACKET: return "RBRACKET";
+        case TOKEN_COMMA: return "COMMA";
+        case TOKEN_COLON: return "COLON";
         case TOKEN_EOF: return "EOF";
         case TOKEN_UNKNOWN: return "UNKNOWN";
         default: return "UNDEFINED";
     }
 }
 
-static Token* create_token(TokenType type, const char* value, int line, int column) {
+static Token* create_token(Lexer* lexer, TokenType type, const char* value, int line, int column) {
     Token* token = malloc(sizeof(Token));
     token->type = type;
     token->value = value ? strdup(value) : NULL;
     token->line = line;
     token->column = column;
-    printf("Created token: %s, value: %s\n", token_type_to_string(type), value ? value : "null");
+    if (lexer->trace) {
+        fprintf(lexer->trace, "Created token: %s, value: %s\n", token_type_to_string(type), value ? value : "null");
+    }
     return token;
 }
 
@@ -60,20 +105,27 @@ static char advance(Lexer* lexer) {
 }
 
 static void skip_whitespace(Lexer* lexer) {
-    while (isspace(peek(lexer))) {
+    while (isspace(peek(lexer)) || peek(lexer) == '\'') {
+        // A ' starts a comment that runs to the end of the line
+        if (peek(lexer) == '\'') {
+            while (peek(lexer) != '\n' && peek(lexer) != '\0') {
+                advance(lexer);
+            }
+            continue;
+        }
         advance(lexer);
     }
 }
 
 static Token* read_identifier(Lexer* lexer) {
-    int start_pos = lexer->position;
+    size_t start_pos = lexer->position;
     int start_column = lexer->column;
     
     while (isalnum(peek(lexer)) || peek(lexer) == '_') {
         advance(lexer);
     }
     
-    int length = lexer->position - start_pos;
+    size_t length = lexer->position - start_pos;
     char* value = malloc(length + 1);
     strncpy(value, &lexer->source[start_pos], length);
     value[length] = '\0';
@@ -82,26 +134,69 @@ static Token* read_identifier(Lexer* lexer) {
     if (strcasecmp(value, "LET") == 0) type = TOKEN_LET;
     else if (strcasecmp(value, "PRINT") == 0) type = TOKEN_PRINT;
     else if (strcasecmp(value, "ECHO") == 0) type = TOKEN_PRINT; 
+    else if (strcasecmp(value, "DIM") == 0) type = TOKEN_DIM;
+    else if (strcasecmp(value, "FOR") == 0) type = TOKEN_FOR;
+    else if (strcasecmp(value, "TO") == 0) type = TOKEN_TO;
+    else if (strcasecmp(value, "NEXT") == 0) type = TOKEN_NEXT;
+    else if (strcasecmp(value, "WHILE") == 0) type = TOKEN_WHILE;
+    else if (strcasecmp(value, "WEND") == 0) type = TOKEN_WEND;
+    else if (strcasecmp(value, "PARALLEL") == 0) type = TOKEN_PARALLEL;
+    else if (strcasecmp(value, "REDUCE") == 0) type = TOKEN_REDUCE;
+    else if (strcasecmp(value, "IF") == 0) type = TOKEN_IF;
+    else if (strcasecmp(value, "THEN") == 0) type = TOKEN_THEN;
+    else if (strcasecmp(value, "ELSE") == 0) type = TOKEN_ELSE;
+    else if (strcasecmp(value, "ENDIF") == 0) type = TOKEN_ENDIF;
+    else if (strcasecmp(value, "FUNCTION") == 0) type = TOKEN_FUNCTION;
+    else if (strcasecmp(value, "RETURN") == 0) type = TOKEN_RETURN;
+    else if (strcasecmp(value, "END") == 0) type = TOKEN_END;
+    else if (strcasecmp(value, "SPAWN") == 0) type = TOKEN_SPAWN;
+    else if (strcasecmp(value, "AWAIT") == 0) type = TOKEN_AWAIT;
+    else if (strcasecmp(value, "CHANNEL") == 0) type = TOKEN_CHANNEL;
+    else if (strcasecmp(value, "SEND") == 0) type = TOKEN_SEND;
+    else if (strcasecmp(value, "RECEIVE") == 0) type = TOKEN_RECEIVE;
+    else if (strcasecmp(value, "YIELD") == 0) type = TOKEN_YIELD;
+    else if (strcasecmp(value, "EACH") == 0) type = TOKEN_EACH;
+    else if (strcasecmp(value, "IN") == 0) type = TOKEN_IN;
+    else if (strcasecmp(value, "STRINGBUILDER") == 0) type = TOKEN_STRINGBUILDER;
+    else if (strcasecmp(value, "APPEND") == 0) type = TOKEN_APPEND;
+    else if (strcasecmp(value, "DICT") == 0) type = TOKEN_DICT;
+    else if (strcasecmp(value, "SORT") == 0) type = TOKEN_SORT;
+    else if (strcasecmp(value, "OPEN") == 0) type = TOKEN_OPEN;
+    else if (strcasecmp(value, "READLINE") == 0) type = TOKEN_READLINE;
+    else if (strcasecmp(value, "WRITELINE") == 0) type = TOKEN_WRITELINE;
+    else if (strcasecmp(value, "CLOSE") == 0) type = TOKEN_CLOSE;
+    else if (strcasecmp(value, "DBCONNECT") == 0) type = TOKEN_DBCONNECT;
+    else if (strcasecmp(value, "DBEXECSQL") == 0) type = TOKEN_DBEXECSQL;
+    else if (strcasecmp(value, "DBQUERY") == 0) type = TOKEN_DBQUERY;
+    else if (strcasecmp(value, "INCLUDE") == 0) type = TOKEN_INCLUDE;
     
-    Token* token = create_token(type, value, lexer->line, start_column);
+    Token* token = create_token(lexer, type, value, lexer->line, start_column);
     free(value);
     return token;
 }
 
 static Token* read_number(Lexer* lexer) {
-    int start_pos = lexer->position;
+    size_t start_pos = lexer->position;
     int start_column = lexer->column;
     
     while (isdigit(peek(lexer))) {
         advance(lexer);
     }
     
-    int length = lexer->position - start_pos;
+    // Optional fractional part makes a floating point literal
+    if (peek(lexer) == '.' && isdigit(lexer->source[lexer->position + 1])) {
+        advance(lexer);
+        while (isdigit(peek(lexer))) {
+            advance(lexer);
+        }
+    }
+    
+    size_t length = lexer->position - start_pos;
     char* value = malloc(length + 1);
     strncpy(value, &lexer->source[start_pos], length);
     value[length] = '\0';
     
-    Token* token = create_token(TOKEN_NUMBER, value, lexer->line, start_column);
+    Token* token = create_token(lexer, TOKEN_NUMBER, value, lexer->line, start_column);
     free(value);
     return token;
 }
@@ -110,12 +205,12 @@ static Token* read_string(Lexer* lexer) {
     int start_column = lexer->column;
     advance(lexer); // Skip opening quote
     
-    int start_pos = lexer->position;
+    size_t start_pos = lexer->position;
     while (peek(lexer) != '"' && peek(lexer) != '\0') {
         advance(lexer);
     }
     
-    int length = lexer->position - start_pos;
+    size_t length = lexer->position - start_pos;
     char* value = malloc(length + 1);
     strncpy(value, &lexer->source[start_pos], length);
     value[length] = '\0';
@@ -124,7 +219,7 @@ static Token* read_string(Lexer* lexer) {
         advance(lexer); // Skip closing quote
     }
     
-    Token* token = create_token(TOKEN_STRING, value, lexer->line, start_column);
+    Token* token = create_token(lexer, TOKEN_STRING, value, lexer->line, start_column);
     free(value);
     return token;
 }
@@ -132,21 +227,35 @@ static Token* read_string(Lexer* lexer) {
 Lexer* lexer_create(const char* source) {
     Lexer* lexer = malloc(sizeof(Lexer));
     lexer->source = strdup(source);
+    lexer->owns_source = true;
     lexer->position = 0;
     lexer->line = 1;
     lexer->column = 0;
+    lexer->trace = stdout;
     printf("Lexer created with source: %s\n", source);
     return lexer;
 }
 
+Lexer* lexer_create_in_place(const char* source, FILE* trace) {
+    Lexer* lexer = malloc(sizeof(Lexer));
+    lexer->source = (char*)source;
+    lexer->owns_source = false;
+    lexer->position = 0;
+    lexer->line = 1;
+    lexer->column = 0;
+    lexer->trace = trace;
+    if (trace) fprintf(trace, "Lexer created over source in place\n");
+    return lexer;
+}
+
 Token* lexer_next_token(Lexer* lexer) {
     skip_whitespace(lexer);
     
     char c = peek(lexer);
-    printf("Processing character: %c\n", c);
+    if (lexer->trace) fprintf(lexer->trace, "Processing character: %c\n", c);
     
     if (c == '\0') {
-        return create_token(TOKEN_EOF, NULL, lexer->line, lexer->column);
+        return create_token(lexer, TOKEN_EOF, NULL, lexer->line, lexer->column);
     }
     
     if (isalpha(c)) {
@@ -163,18 +272,26 @@ Token* lexer_next_token(Lexer* lexer) {
     
     advance(lexer);
     switch (c) {
-        case '=': return create_token(TOKEN_EQUALS, "=", lexer->line, lexer->column - 1);
-        case '+': return create_token(TOKEN_PLUS, "+", lexer->line, lexer->column - 1);
-        case '-': return create_token(TOKEN_MINUS, "-", lexer->line, lexer->column - 1);
-        case '*': return create_token(TOKEN_MULTIPLY, "*", lexer->line, lexer->column - 1);
-        case '/': return create_token(TOKEN_DIVIDE, "/", lexer->line, lexer->column - 1);
+        case '=': return create_token(lexer, TOKEN_EQUALS, "=", lexer->line, lexer->column - 1);
+        case '+': return create_token(lexer, TOKEN_PLUS, "+", lexer->line, lexer->column - 1);
+        case '-': return create_token(lexer, TOKEN_MINUS, "-", lexer->line, lexer->column - 1);
+        case '*': return create_token(lexer, TOKEN_MULTIPLY, "*", lexer->line, lexer->column - 1);
+        case '/': return create_token(lexer, TOKEN_DIVIDE, "/", lexer->line, lexer->column - 1);
+        case '(': return create_token(lexer, TOKEN_LPAREN, "(", lexer->line, lexer->column - 1);
+        case ')': return create_token(lexer, TOKEN_RPAREN, ")", lexer->line, lexer->column - 1);
+        case '[': return create_token(lexer, TOKEN_LBRACKET, "[", lexer->line, lexer->column - 1);
+        case ']': return create_token(lexer, TOKEN_RBRACKET, "]", lexer->line, lexer->column - 1);
+        case '>': return create_token(lexer, TOKEN_GT, ">", lexer->line, lexer->column - 1);
+        case '<': return create_token(lexer, TOKEN_LT, "<", lexer->line, lexer->column - 1);
+        case ',': return create_token(lexer, TOKEN_COMMA, ",", lexer->line, lexer->column - 1);
+        case ':': return create_token(lexer, TOKEN_COLON, ":", lexer->line, lexer->column - 1);
     }
     
-    return create_token(TOKEN_UNKNOWN, NULL, lexer->line, lexer->column - 1);
+    return create_token(lexer, TOKEN_UNKNOWN, NULL, lexer->line, lexer->column - 1);
 }
 
 void lexer_destroy(Lexer* lexer) {
-    free(lexer->source);
+    if (lexer->owns_source) free(lexer->source);
     free(lexer);
 }
 
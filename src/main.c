@@ -1,68 +1,45 @@
-/* 
- * Compiler for IWBC
- * Created: February 20, 2025 by LHS
- * Last modified: February 27, 2025 by LHS
+/*
+ * iwbc launcher
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
  *
- * Goals:
- * 1. Command line parsing
- * 2. Build pipeline coordination
- * 3. Error reporting
- * 4. Resource cleanup
+ * The iwbc executable does not link LLVM. When IWBC_SERVER names a
+ * running compile server it hands the command line over and waits,
+ * which costs about as much as starting any small program; otherwise
+ * it loads the compiler from libiwbc.so and runs the command line here
+ * (iwbc_command, src/driver.c).
  */
 
+#include <dlfcn.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdbool.h>
-#include <stddef.h>
-#include "lexer.h"
-#include "parser.h"
-#include "generator.h"
+#include <string.h>
+#include "server.h"
 
-static char* read_file(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        fprintf(stderr, "Error: Could not open file %s\n", filename);
-        return NULL;
+// Found through the executable's run path: next to it in a build tree,
+// in ../lib once installed
+#define COMPILER_LIBRARY "libiwbc.so"
+
+static bool has_argument(int argc, char* argv[], const char* argument) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], argument) == 0) return true;
     }
-    
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    char* buffer = malloc(size + 1);
-    size_t read_size = fread(buffer, 1, size, file);
-    buffer[read_size] = '\0';
-    
-    fclose(file);
-    return buffer;
+    return false;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <input.iwb> <output.bc>\n", argv[0]);
-        return 1;
+    const char* server = getenv("IWBC_SERVER");
+    int status;
+    if (server && server[0] && !has_argument(argc, argv, "--server") &&
+        server_forward(server, argc, argv, &status)) {
+        return status;
     }
-    
-    char* source = read_file(argv[1]);
-    if (!source) {
+
+    void* compiler = dlopen(COMPILER_LIBRARY, RTLD_LAZY);
+    int (*command)(int, char**) = compiler ? (int (*)(int, char**))dlsym(compiler, "iwbc_command") : NULL;
+    if (!command) {
+        fprintf(stderr, "Error: Could not load the compiler: %s\n", dlerror());
         return 1;
     }
-    
-    Lexer* lexer = lexer_create(source);
-    Parser* parser = parser_create(lexer);
-    ASTNode* ast = parser_parse(parser);
-    
-    Generator* gen = generator_create("iwbasic_module");
-    generator_generate(gen, ast);
-    generator_write_bitcode(gen, argv[2]);
-    
-    // Cleanup
-    generator_destroy(gen);
-    ast_destroy(ast);
-    parser_destroy(parser);
-    lexer_destroy(lexer);
-    free(source);
-    
-    return 0;
+    return command(argc, argv);
 }
-
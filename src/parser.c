@@ -1,87 +1,216 @@
 /* 
  * Parser for IWBC
  * Created: February 20, 2025 by LHS
- * Last modified: February 27, 2025 by LHS
+ * Last modified: October 19, 2026 by LHS
  *
  */
 
 #include "parser.h"
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
+#include <stdarg.h>
 
-// Debug variables for GDB inspection
-Token* debug_token = NULL;
-Parser* debug_parser = NULL;
+// The parse as it goes, when the parser has somewhere to write it
+static void trace(Parser* parser, const char* format, ...) {
+    if (!parser->trace) return;
+    va_list args;
+    va_start(args, format);
+    vfprintf(parser->trace, format, args);
+    va_end(args);
+}
+
+void parser_error(Parser* parser, const char* format, ...) {
+    fputs("ERROR: ", parser->errors);
+    va_list args;
+    va_start(args, format);
+    vfprintf(parser->errors, format, args);
+    va_end(args);
+}
 
 // Node management functions
-ASTNode* create_node(NodeType type, const char* value) {
+static ASTNode* create_node(Parser* parser, NodeType type, const char* value) {
     ASTNode* node = malloc(sizeof(ASTNode));
     node->type = type;
     node->value = value ? strdup(value) : NULL;
     node->children = NULL;
     node->children_count = 0;
-    printf("Created node type=%d value=%s\n", type, value ? value : "null");
+    node->line = 0;
+    node->column = 0;
+    trace(parser, "Created node type=%d value=%s\n", type, value ? value : "null");
     return node;
 }
 
-void add_child(ASTNode* parent, ASTNode* child) {
+static void add_child(Parser* parser, ASTNode* parent, ASTNode* child) {
     parent->children_count++;
     parent->children = realloc(parent->children, parent->children_count * sizeof(ASTNode*));
     parent->children[parent->children_count - 1] = child;
-    printf("Added child to parent type=%d\n", parent->type);
+    trace(parser, "Added child to parent type=%d\n", parent->type);
 }
 
 Token* get_next_token(Parser* parser) {
     Token* token = parser->current_token;
-    debug_token = token;
-    printf("Current token: type=%d value=%s\n", 
-           token->type, 
-           token->value ? token->value : "null");
+    trace(parser, "Current token: type=%d value=%s\n", 
+          token->type, 
+          token->value ? token->value : "null");
+    // Parse functions read a token after moving past it, so it is
+    // kept until the statement is done
+    if (parser->spent_count == parser->spent_capacity) {
+        parser->spent_capacity = parser->spent_capacity ? parser->spent_capacity * 2 : 64;
+        parser->spent = realloc(parser->spent, parser->spent_capacity * sizeof(Token*));
+    }
+    parser->spent[parser->spent_count++] = token;
     parser->current_token = lexer_next_token(parser->lexer);
     return token;
 }
 
+static void free_token(Token* token) {
+    free(token->value);
+    free(token);
+}
+
+static void free_spent_tokens(Parser* parser) {
+    for (int i = 0; i < parser->spent_count; i++) {
+        free_token(parser->spent[i]);
+    }
+    parser->spent_count = 0;
+}
+
 // Forward declarations
 ASTNode* parse_expression(Parser* parser);
+ASTNode* parse_additive(Parser* parser);
+ASTNode* parse_term(Parser* parser);
 ASTNode* parse_primary(Parser* parser);
 ASTNode* parse_statement(Parser* parser);
 
+// Parses "[expr, expr, ...]" and appends each expression to node.
+// Used for both DIM extents and array subscripts.
+static int parse_index_list(Parser* parser, ASTNode* node) {
+    if (parser->current_token->type != TOKEN_LBRACKET) {
+        parser_error(parser, "Expected [ after array name\n");
+        return 0;
+    }
+    get_next_token(parser);
+
+    while (1) {
+        ASTNode* index = parse_expression(parser);
+        if (!index) return 0;
+        add_child(parser, node, index);
+
+        if (parser->current_token->type == TOKEN_COMMA) {
+            get_next_token(parser);
+            continue;
+        }
+        break;
+    }
+
+    if (parser->current_token->type != TOKEN_RBRACKET) {
+        parser_error(parser, "Expected ] after array index\n");
+        return 0;
+    }
+    get_next_token(parser);
+    trace(parser, "Parsed index list with %d dimension(s)\n", node->children_count);
+    return 1;
+}
+
 ASTNode* parse_primary(Parser* parser) {
     Token* token = parser->current_token;
-    printf("Parsing primary: type=%d value=%s\n", 
-           token->type, 
-           token->value ? token->value : "null");
+    trace(parser, "Parsing primary: type=%d value=%s\n", 
+          token->type, 
+          token->value ? token->value : "null");
     
     switch (token->type) {
         case TOKEN_NUMBER: {
-            ASTNode* node = create_node(NODE_NUMBER, token->value);
+            ASTNode* node = create_node(parser, NODE_NUMBER, token->value);
             get_next_token(parser);
             return node;
         }
-        case TOKEN_IDENTIFIER: {
-            ASTNode* node = create_node(NODE_IDENTIFIER, token->value);
+        case TOKEN_SPAWN: {
+            // SPAWN f(args) starts f as a task and yields its handle
+            get_next_token(parser);
+            ASTNode* call = parse_primary(parser);
+            if (!call) return NULL;
+            if (call->type != NODE_CALL) {
+                parser_error(parser, "Expected function call after SPAWN\n");
+                return NULL;
+            }
+            ASTNode* node = create_node(parser, NODE_SPAWN, NULL);
+            node->line = token->line;
+            add_child(parser, node, call);
+            return node;
+        }
+        case TOKEN_AWAIT: {
+            // AWAIT h waits for the task behind handle h and yields its result
             get_next_token(parser);
+            ASTNode* handle = parse_primary(parser);
+            if (!handle) return NULL;
+            ASTNode* node = create_node(parser, NODE_AWAIT, NULL);
+            node->line = token->line;
+            add_child(parser, node, handle);
             return node;
         }
+        case TOKEN_LPAREN: {
+            get_next_token(parser);
+            ASTNode* node = parse_expression(parser);
+            if (!node) return NULL;
+            if (parser->current_token->type != TOKEN_RPAREN) {
+                parser_error(parser, "Expected ) after expression\n");
+                return NULL;
+            }
+            get_next_token(parser);
+            return node;
+        }
+        case TOKEN_IDENTIFIER: {
+            get_next_token(parser);
+            if (parser->current_token->type == TOKEN_LPAREN) {
+                // name(arg, ...) is a call; built-ins such as SUM and MAX
+                // are resolved by the generator
+                ASTNode* node = create_node(parser, NODE_CALL, token->value);
+                node->line = token->line;
+                node->column = token->column;
+                get_next_token(parser);
+                while (parser->current_token->type != TOKEN_RPAREN) {
+                    ASTNode* arg = parse_expression(parser);
+                    if (!arg) return NULL;
+                    add_child(parser, node, arg);
+                    if (parser->current_token->type == TOKEN_COMMA) {
+                        get_next_token(parser);
+                    } else if (parser->current_token->type != TOKEN_RPAREN) {
+                        parser_error(parser, "Expected , or ) in argument list\n");
+                        return NULL;
+                    }
+                }
+                get_next_token(parser);
+                trace(parser, "Parsed call %s with %d argument(s)\n", node->value, node->children_count);
+                return node;
+            }
+            if (parser->current_token->type == TOKEN_LBRACKET) {
+                ASTNode* node = create_node(parser, NODE_ARRAY_ACCESS, token->value);
+                node->line = token->line;
+                node->column = token->column;
+                if (!parse_index_list(parser, node)) return NULL;
+                return node;
+            }
+            return create_node(parser, NODE_IDENTIFIER, token->value);
+        }
         case TOKEN_STRING: {
-            ASTNode* node = create_node(NODE_STRING, token->value);
+            ASTNode* node = create_node(parser, NODE_STRING, token->value);
             get_next_token(parser);
             return node;
         }
         default:
-            printf("ERROR: Unexpected token in primary expression\n");
+            parser_error(parser, "Unexpected token in primary expression\n");
             return NULL;
     }
 }
 
-ASTNode* parse_expression(Parser* parser) {
+// * and / bind tighter than + and -
+ASTNode* parse_term(Parser* parser) {
     ASTNode* left = parse_primary(parser);
     if (!left) return NULL;
     
-    while (parser->current_token->type == TOKEN_PLUS ||
-           parser->current_token->type == TOKEN_MINUS ||
-           parser->current_token->type == TOKEN_MULTIPLY ||
+    while (parser->current_token->type == TOKEN_MULTIPLY ||
            parser->current_token->type == TOKEN_DIVIDE) {
         
         Token* op_token = parser->current_token;
@@ -90,37 +219,343 @@ ASTNode* parse_expression(Parser* parser) {
         ASTNode* right = parse_primary(parser);
         if (!right) return NULL;
         
-        ASTNode* op_node = create_node(NODE_OPERATOR, op_token->value);
-        add_child(op_node, left);
-        add_child(op_node, right);
+        ASTNode* op_node = create_node(parser, NODE_OPERATOR, op_token->value);
+        add_child(parser, op_node, left);
+        add_child(parser, op_node, right);
         left = op_node;
     }
     
     return left;
 }
 
-ASTNode* parse_statement(Parser* parser) {
-    debug_parser = parser;
-    debug_token = parser->current_token;
+ASTNode* parse_additive(Parser* parser) {
+    ASTNode* left = parse_term(parser);
+    if (!left) return NULL;
+    
+    while (parser->current_token->type == TOKEN_PLUS ||
+           parser->current_token->type == TOKEN_MINUS) {
+        
+        Token* op_token = parser->current_token;
+        get_next_token(parser);
+        
+        ASTNode* right = parse_term(parser);
+        if (!right) return NULL;
+        
+        ASTNode* op_node = create_node(parser, NODE_OPERATOR, op_token->value);
+        add_child(parser, op_node, left);
+        add_child(parser, op_node, right);
+        left = op_node;
+    }
+    
+    return left;
+}
+
+// Comparisons bind loosest: a + 1 > b * 2 compares two sums
+ASTNode* parse_expression(Parser* parser) {
+    ASTNode* left = parse_additive(parser);
+    if (!left) return NULL;
+    
+    while (parser->current_token->type == TOKEN_GT ||
+           parser->current_token->type == TOKEN_LT ||
+           parser->current_token->type == TOKEN_EQUALS) {
+        
+        Token* op_token = parser->current_token;
+        get_next_token(parser);
+        
+        ASTNode* right = parse_additive(parser);
+        if (!right) return NULL;
+        
+        ASTNode* op_node = create_node(parser, NODE_OPERATOR, op_token->value);
+        add_child(parser, op_node, left);
+        add_child(parser, op_node, right);
+        left = op_node;
+    }
+    
+    return left;
+}
+
+// Parses statements into block until one of the given tokens, which
+// is left as the current token
+static int parse_block(Parser* parser, ASTNode* block, TokenType stop1, TokenType stop2) {
+    while (parser->current_token->type != stop1 && parser->current_token->type != stop2) {
+        if (parser->current_token->type == TOKEN_EOF) {
+            parser_error(parser, "Unexpected end of file inside block\n");
+            return 0;
+        }
+        ASTNode* statement = parse_statement(parser);
+        if (!statement) return 0;
+        add_child(parser, block, statement);
+    }
+    return 1;
+}
+
+// IF cond THEN ... [ELSE ...] ENDIF. Children are the condition, a
+// NODE_PROGRAM holding the THEN branch and, when present, another
+// holding the ELSE branch.
+static ASTNode* parse_if(Parser* parser) {
+    int line = parser->current_token->line;
+    get_next_token(parser);
+    
+    ASTNode* cond = parse_expression(parser);
+    if (!cond) return NULL;
+    if (parser->current_token->type != TOKEN_THEN) {
+        parser_error(parser, "Expected THEN after IF condition\n");
+        return NULL;
+    }
+    get_next_token(parser);
     
-    printf("Parsing statement: type=%d value=%s\n", 
-           debug_token->type,
-           debug_token->value ? debug_token->value : "null");
+    ASTNode* if_node = create_node(parser, NODE_IF, NULL);
+    if_node->line = line;
+    add_child(parser, if_node, cond);
+    
+    ASTNode* then_block = create_node(parser, NODE_PROGRAM, NULL);
+    add_child(parser, if_node, then_block);
+    if (!parse_block(parser, then_block, TOKEN_ELSE, TOKEN_ENDIF)) return NULL;
+    
+    if (parser->current_token->type == TOKEN_ELSE) {
+        get_next_token(parser);
+        ASTNode* else_block = create_node(parser, NODE_PROGRAM, NULL);
+        add_child(parser, if_node, else_block);
+        if (!parse_block(parser, else_block, TOKEN_ENDIF, TOKEN_ENDIF)) return NULL;
+    }
+    get_next_token(parser);
+    
+    trace(parser, "Parsed IF with %d branch(es)\n", if_node->children_count - 1);
+    return if_node;
+}
+
+// WHILE cond ... WEND. Children are the condition and a NODE_PROGRAM
+// holding the body, which runs as long as the condition is nonzero.
+static ASTNode* parse_while(Parser* parser) {
+    int line = parser->current_token->line;
+    get_next_token(parser);
+    
+    ASTNode* cond = parse_expression(parser);
+    if (!cond) return NULL;
+    
+    ASTNode* while_node = create_node(parser, NODE_WHILE, NULL);
+    while_node->line = line;
+    add_child(parser, while_node, cond);
+    ASTNode* body = create_node(parser, NODE_PROGRAM, NULL);
+    add_child(parser, while_node, body);
+    if (!parse_block(parser, body, TOKEN_WEND, TOKEN_WEND)) return NULL;
+    get_next_token(parser);
+    
+    trace(parser, "Parsed WHILE with %d statement(s)\n", body->children_count);
+    return while_node;
+}
+
+// FUNCTION name(param, ...) ... END. The node carries the name; the
+// parameters come first as NODE_IDENTIFIER children, followed by the
+// body statements.
+static ASTNode* parse_function(Parser* parser) {
+    int line = parser->current_token->line;
+    get_next_token(parser);
+    
+    if (parser->current_token->type != TOKEN_IDENTIFIER) {
+        parser_error(parser, "Expected function name after FUNCTION\n");
+        return NULL;
+    }
+    ASTNode* func = create_node(parser, NODE_FUNCTION, parser->current_token->value);
+    func->line = line;
+    get_next_token(parser);
+    
+    if (parser->current_token->type != TOKEN_LPAREN) {
+        parser_error(parser, "Expected ( after function name\n");
+        return NULL;
+    }
+    get_next_token(parser);
+    while (parser->current_token->type == TOKEN_IDENTIFIER) {
+        add_child(parser, func, create_node(parser, NODE_IDENTIFIER, parser->current_token->value));
+        get_next_token(parser);
+        if (parser->current_token->type != TOKEN_COMMA) break;
+        get_next_token(parser);
+    }
+    if (parser->current_token->type != TOKEN_RPAREN) {
+        parser_error(parser, "Expected ) after parameters\n");
+        return NULL;
+    }
+    get_next_token(parser);
+    
+    if (!parse_block(parser, func, TOKEN_END, TOKEN_END)) return NULL;
+    get_next_token(parser);
+    
+    trace(parser, "Parsed FUNCTION %s with %d child node(s)\n", func->value, func->children_count);
+    return func;
+}
+
+// REDUCE op: var [, op: var ...] where op is +, *, MAX or MIN. Each
+// reduction becomes a NODE_REDUCE child of loop carrying the operator,
+// with the variable as its only child.
+static int parse_reduce_clause(Parser* parser, ASTNode* loop) {
+    get_next_token(parser);
+    while (1) {
+        Token* op = parser->current_token;
+        if (op->type != TOKEN_PLUS && op->type != TOKEN_MULTIPLY &&
+            !(op->type == TOKEN_IDENTIFIER &&
+              (strcasecmp(op->value, "MAX") == 0 || strcasecmp(op->value, "MIN") == 0))) {
+            parser_error(parser, "Expected +, *, MAX or MIN in REDUCE clause\n");
+            return 0;
+        }
+        get_next_token(parser);
+        
+        if (parser->current_token->type != TOKEN_COLON) {
+            parser_error(parser, "Expected : after REDUCE operator\n");
+            return 0;
+        }
+        get_next_token(parser);
+        
+        if (parser->current_token->type != TOKEN_IDENTIFIER) {
+            parser_error(parser, "Expected variable in REDUCE clause\n");
+            return 0;
+        }
+        ASTNode* reduce = create_node(parser, NODE_REDUCE, op->value);
+        add_child(parser, reduce, create_node(parser, NODE_IDENTIFIER, parser->current_token->value));
+        add_child(parser, loop, reduce);
+        get_next_token(parser);
+        
+        if (parser->current_token->type != TOKEN_COMMA) break;
+        get_next_token(parser);
+    }
+    return 1;
+}
+
+// Statements up to NEXT [var], appended to loop
+static int parse_loop_body(Parser* parser, ASTNode* loop) {
+    while (parser->current_token->type != TOKEN_NEXT) {
+        if (parser->current_token->type == TOKEN_EOF) {
+            parser_error(parser, "Missing NEXT for FOR %s\n", loop->value);
+            return 0;
+        }
+        ASTNode* statement = parse_statement(parser);
+        if (!statement) return 0;
+        add_child(parser, loop, statement);
+    }
+    get_next_token(parser);
+    
+    // NEXT may repeat the loop variable
+    if (parser->current_token->type == TOKEN_IDENTIFIER &&
+        strcmp(parser->current_token->value, loop->value) == 0) {
+        get_next_token(parser);
+    }
+    return 1;
+}
+
+// FOR EACH var IN f(args) ... NEXT [var]. The node carries the loop
+// variable; the first child is the call to the generator FUNCTION,
+// the rest are the body statements.
+static ASTNode* parse_for_each(Parser* parser, int line) {
+    get_next_token(parser);
+    
+    if (parser->current_token->type != TOKEN_IDENTIFIER) {
+        parser_error(parser, "Expected loop variable after FOR EACH\n");
+        return NULL;
+    }
+    ASTNode* each_node = create_node(parser, NODE_FOR_EACH, parser->current_token->value);
+    each_node->line = line;
+    get_next_token(parser);
+    
+    if (parser->current_token->type != TOKEN_IN) {
+        parser_error(parser, "Expected IN after FOR EACH variable\n");
+        return NULL;
+    }
+    get_next_token(parser);
+    
+    ASTNode* source = parse_primary(parser);
+    if (!source) return NULL;
+    if (source->type != NODE_CALL) {
+        parser_error(parser, "FOR EACH needs a generator call after IN\n");
+        return NULL;
+    }
+    add_child(parser, each_node, source);
+    
+    if (!parse_loop_body(parser, each_node)) return NULL;
+    
+    trace(parser, "Parsed FOR EACH %s with %d child node(s)\n", each_node->value, each_node->children_count);
+    return each_node;
+}
+
+// FOR var = start TO end ... NEXT [var]. The node carries the loop
+// variable; children are the start and end expressions, then for a
+// PARALLEL FOR any NODE_REDUCE clauses, then the body statements.
+static ASTNode* parse_for(Parser* parser, NodeType type) {
+    int line = parser->current_token->line;
+    get_next_token(parser);
+    
+    if (type == NODE_FOR && parser->current_token->type == TOKEN_EACH) {
+        return parse_for_each(parser, line);
+    }
+    
+    if (parser->current_token->type != TOKEN_IDENTIFIER) {
+        parser_error(parser, "Expected loop variable after FOR\n");
+        return NULL;
+    }
+    
+    ASTNode* for_node = create_node(parser, type, parser->current_token->value);
+    for_node->line = line;
+    get_next_token(parser);
+    
+    if (parser->current_token->type != TOKEN_EQUALS) {
+        parser_error(parser, "Expected = after FOR variable\n");
+        return NULL;
+    }
+    get_next_token(parser);
+    
+    ASTNode* start = parse_expression(parser);
+    if (!start) return NULL;
+    add_child(parser, for_node, start);
+    
+    if (parser->current_token->type != TOKEN_TO) {
+        parser_error(parser, "Expected TO in FOR statement\n");
+        return NULL;
+    }
+    get_next_token(parser);
+    
+    ASTNode* end = parse_expression(parser);
+    if (!end) return NULL;
+    add_child(parser, for_node, end);
+    
+    if (type == NODE_PARALLEL_FOR && parser->current_token->type == TOKEN_REDUCE) {
+        if (!parse_reduce_clause(parser, for_node)) return NULL;
+    }
+    
+    if (!parse_loop_body(parser, for_node)) return NULL;
+    
+    trace(parser, "Parsed %sFOR %s with %d child node(s)\n", type == NODE_PARALLEL_FOR ? "PARALLEL " : "",
+          for_node->value, for_node->children_count);
+    return for_node;
+}
+
+ASTNode* parse_statement(Parser* parser) {
+    trace(parser, "Parsing statement: type=%d value=%s\n", 
+          parser->current_token->type,
+          parser->current_token->value ? parser->current_token->value : "null");
     
     switch (parser->current_token->type) {
         case TOKEN_LET: {
+            int line = parser->current_token->line;
             get_next_token(parser);
             
             if (parser->current_token->type != TOKEN_IDENTIFIER) {
-                printf("ERROR: Expected identifier after LET\n");
+                parser_error(parser, "Expected identifier after LET\n");
                 return NULL;
             }
             
             Token* identifier = parser->current_token;
             get_next_token(parser);
             
+            ASTNode* target;
+            if (parser->current_token->type == TOKEN_LBRACKET) {
+                target = create_node(parser, NODE_ARRAY_ACCESS, identifier->value);
+                target->line = identifier->line;
+                target->column = identifier->column;
+                if (!parse_index_list(parser, target)) return NULL;
+            } else {
+                target = create_node(parser, NODE_IDENTIFIER, identifier->value);
+            }
+            
             if (parser->current_token->type != TOKEN_EQUALS) {
-                printf("ERROR: Expected = after identifier\n");
+                parser_error(parser, "Expected = after identifier\n");
                 return NULL;
             }
             get_next_token(parser);
@@ -128,28 +563,348 @@ ASTNode* parse_statement(Parser* parser) {
             ASTNode* expr = parse_expression(parser);
             if (!expr) return NULL;
             
-            ASTNode* let_node = create_node(NODE_LET, NULL);
-            add_child(let_node, create_node(NODE_IDENTIFIER, identifier->value));
-            add_child(let_node, expr);
+            ASTNode* let_node = create_node(parser, NODE_LET, NULL);
+            let_node->line = line;
+            add_child(parser, let_node, target);
+            add_child(parser, let_node, expr);
             return let_node;
         }
         
+        case TOKEN_DIM: {
+            get_next_token(parser);
+            
+            if (parser->current_token->type != TOKEN_IDENTIFIER) {
+                parser_error(parser, "Expected array name after DIM\n");
+                return NULL;
+            }
+            
+            // The DIM node carries the array name; its children are the
+            // extents of each dimension, outermost first (row-major)
+            ASTNode* dim_node = create_node(parser, NODE_DIM, parser->current_token->value);
+            dim_node->line = parser->current_token->line;
+            get_next_token(parser);
+            if (!parse_index_list(parser, dim_node)) return NULL;
+            return dim_node;
+        }
+        
+        case TOKEN_SORT: {
+            // SORT name orders every element of a DIM array ascending
+            int line = parser->current_token->line;
+            get_next_token(parser);
+            if (parser->current_token->type != TOKEN_IDENTIFIER) {
+                parser_error(parser, "Expected array name after SORT\n");
+                return NULL;
+            }
+            ASTNode* sort_node = create_node(parser, NODE_SORT, parser->current_token->value);
+            sort_node->line = line;
+            get_next_token(parser);
+            return sort_node;
+        }
+        
+        case TOKEN_OPEN:
+        case TOKEN_READLINE:
+        case TOKEN_WRITELINE: {
+            // OPEN file, path [, mode] / READLINE file, target /
+            // WRITELINE file, expr. The node carries the file name and
+            // the operands follow as children.
+            TokenType kind = parser->current_token->type;
+            int line = parser->current_token->line;
+            get_next_token(parser);
+            if (parser->current_token->type != TOKEN_IDENTIFIER) {
+                parser_error(parser, "Expected file name\n");
+                return NULL;
+            }
+            NodeType type = kind == TOKEN_OPEN ? NODE_OPEN : kind == TOKEN_READLINE ? NODE_READLINE : NODE_WRITELINE;
+            ASTNode* file_node = create_node(parser, type, parser->current_token->value);
+            file_node->line = line;
+            get_next_token(parser);
+            if (parser->current_token->type != TOKEN_COMMA) {
+                parser_error(parser, "Expected , after file name\n");
+                return NULL;
+            }
+            get_next_token(parser);
+            ASTNode* operand = parse_expression(parser);
+            if (!operand) return NULL;
+            add_child(parser, file_node, operand);
+            if (type == NODE_READLINE && operand->type != NODE_IDENTIFIER) {
+                parser_error(parser, "READLINE needs a variable to read into\n");
+                return NULL;
+            }
+            if (type == NODE_OPEN && parser->current_token->type == TOKEN_COMMA) {
+                get_next_token(parser);
+                ASTNode* mode = parse_expression(parser);
+                if (!mode) return NULL;
+                add_child(parser, file_node, mode);
+            }
+            return file_node;
+        }
+        
+        case TOKEN_CLOSE: {
+            int line = parser->current_token->line;
+            get_next_token(parser);
+            if (parser->current_token->type != TOKEN_IDENTIFIER) {
+                parser_error(parser, "Expected file name after CLOSE\n");
+                return NULL;
+            }
+            ASTNode* close_node = create_node(parser, NODE_CLOSE, parser->current_token->value);
+            close_node->line = line;
+            get_next_token(parser);
+            return close_node;
+        }
+        
+        case TOKEN_INCLUDE: {
+            // INCLUDE "file"; the file's statements are read in by
+            // parser_next_statement when it is at the top level
+            int line = parser->current_token->line;
+            get_next_token(parser);
+            if (parser->current_token->type != TOKEN_STRING) {
+                parser_error(parser, "Expected file name after INCLUDE\n");
+                return NULL;
+            }
+            ASTNode* include_node = create_node(parser, NODE_INCLUDE, parser->current_token->value);
+            include_node->line = line;
+            get_next_token(parser);
+            return include_node;
+        }
+        
+        case TOKEN_DBCONNECT: {
+            // DBCONNECT database [user [password]]; the operands may be
+            // separated by spaces or commas
+            ASTNode* connect_node = create_node(parser, NODE_DBCONNECT, NULL);
+            connect_node->line = parser->current_token->line;
+            get_next_token(parser);
+            while (connect_node->children_count < 3 &&
+                   (parser->current_token->type == TOKEN_STRING ||
+                    parser->current_token->type == TOKEN_IDENTIFIER ||
+                    parser->current_token->type == TOKEN_LPAREN)) {
+                ASTNode* operand = parse_expression(parser);
+                if (!operand) return NULL;
+                add_child(parser, connect_node, operand);
+                if (parser->current_token->type == TOKEN_COMMA) get_next_token(parser);
+            }
+            if (connect_node->children_count == 0) {
+                parser_error(parser, "Expected database name after DBCONNECT\n");
+                return NULL;
+            }
+            return connect_node;
+        }
+        
+        case TOKEN_DBEXECSQL: {
+            // DBEXECSQL sql [, value ...]; the values fill the ? parameters
+            ASTNode* exec_node = create_node(parser, NODE_DBEXECSQL, NULL);
+            exec_node->line = parser->current_token->line;
+            get_next_token(parser);
+            ASTNode* sql = parse_expression(parser);
+            if (!sql) return NULL;
+            add_child(parser, exec_node, sql);
+            while (parser->current_token->type == TOKEN_COMMA) {
+                get_next_token(parser);
+                ASTNode* value = parse_expression(parser);
+                if (!value) return NULL;
+                add_child(parser, exec_node, value);
+            }
+            return exec_node;
+        }
+        
+        case TOKEN_DBQUERY: {
+            // DBQUERY cursor, sql [, value ...]; DBFETCH reads the rows
+            int line = parser->current_token->line;
+            get_next_token(parser);
+            if (parser->current_token->type != TOKEN_IDENTIFIER) {
+                parser_error(parser, "Expected cursor name after DBQUERY\n");
+                return NULL;
+            }
+            ASTNode* query_node = create_node(parser, NODE_DBQUERY, parser->current_token->value);
+            query_node->line = line;
+            get_next_token(parser);
+            if (parser->current_token->type != TOKEN_COMMA) {
+                parser_error(parser, "Expected ',' after cursor name\n");
+                return NULL;
+            }
+            while (parser->current_token->type == TOKEN_COMMA) {
+                get_next_token(parser);
+                ASTNode* operand = parse_expression(parser);
+                if (!operand) return NULL;
+                add_child(parser, query_node, operand);
+            }
+            return query_node;
+        }
+        
+        case TOKEN_CHANNEL: {
+            int line = parser->current_token->line;
+            get_next_token(parser);
+            
+            if (parser->current_token->type != TOKEN_IDENTIFIER) {
+                parser_error(parser, "Expected channel name after CHANNEL\n");
+                return NULL;
+            }
+            
+            // CHANNEL name[capacity]; the only child is the capacity
+            ASTNode* channel_node = create_node(parser, NODE_CHANNEL, parser->current_token->value);
+            channel_node->line = line;
+            get_next_token(parser);
+            if (!parse_index_list(parser, channel_node)) return NULL;
+            if (channel_node->children_count != 1) {
+                parser_error(parser, "CHANNEL takes a single capacity\n");
+                return NULL;
+            }
+            return channel_node;
+        }
+        
+        case TOKEN_DICT: {
+            // DICT name [expected size]; name[key] then reads and writes
+            // entries like array elements
+            int line = parser->current_token->line;
+            get_next_token(parser);
+            if (parser->current_token->type != TOKEN_IDENTIFIER) {
+                parser_error(parser, "Expected dictionary name after DICT\n");
+                return NULL;
+            }
+            ASTNode* dict_node = create_node(parser, NODE_DICT, parser->current_token->value);
+            dict_node->line = line;
+            get_next_token(parser);
+            if (parser->current_token->type == TOKEN_LBRACKET) {
+                if (!parse_index_list(parser, dict_node)) return NULL;
+                if (dict_node->children_count != 1) {
+                    parser_error(parser, "DICT takes a single size\n");
+                    return NULL;
+                }
+            }
+            return dict_node;
+        }
+        
+        case TOKEN_SEND:
+        case TOKEN_RECEIVE: {
+            // SEND channel, expr / RECEIVE channel, target. A bare array
+            // name moves the whole array in one batch.
+            NodeType type = parser->current_token->type == TOKEN_SEND ? NODE_SEND : NODE_RECEIVE;
+            int line = parser->current_token->line;
+            get_next_token(parser);
+            
+            if (parser->current_token->type != TOKEN_IDENTIFIER) {
+                parser_error(parser, "Expected channel name\n");
+                return NULL;
+            }
+            ASTNode* node = create_node(parser, type, parser->current_token->value);
+            node->line = line;
+            get_next_token(parser);
+            if (parser->current_token->type != TOKEN_COMMA) {
+                parser_error(parser, "Expected , after channel name\n");
+                return NULL;
+            }
+            get_next_token(parser);
+            
+            ASTNode* operand = parse_expression(parser);
+            if (!operand) return NULL;
+            if (type == NODE_RECEIVE && operand->type != NODE_IDENTIFIER &&
+                operand->type != NODE_ARRAY_ACCESS) {
+                parser_error(parser, "RECEIVE needs a variable or array to store into\n");
+                return NULL;
+            }
+            add_child(parser, node, operand);
+            return node;
+        }
+        
+        case TOKEN_STRINGBUILDER: {
+            // STRINGBUILDER name [capacity]: an empty string variable
+            // with room reserved for appending
+            int line = parser->current_token->line;
+            get_next_token(parser);
+            if (parser->current_token->type != TOKEN_IDENTIFIER) {
+                parser_error(parser, "Expected variable name after STRINGBUILDER\n");
+                return NULL;
+            }
+            ASTNode* builder_node = create_node(parser, NODE_STRINGBUILDER, parser->current_token->value);
+            builder_node->line = line;
+            get_next_token(parser);
+            if (parser->current_token->type == TOKEN_LBRACKET) {
+                if (!parse_index_list(parser, builder_node)) return NULL;
+                if (builder_node->children_count != 1) {
+                    parser_error(parser, "STRINGBUILDER takes a single capacity\n");
+                    return NULL;
+                }
+            }
+            return builder_node;
+        }
+        
+        case TOKEN_APPEND: {
+            // APPEND name, expr adds to the end of a string in place
+            int line = parser->current_token->line;
+            get_next_token(parser);
+            if (parser->current_token->type != TOKEN_IDENTIFIER) {
+                parser_error(parser, "Expected variable name after APPEND\n");
+                return NULL;
+            }
+            ASTNode* append_node = create_node(parser, NODE_APPEND, parser->current_token->value);
+            append_node->line = line;
+            get_next_token(parser);
+            if (parser->current_token->type != TOKEN_COMMA) {
+                parser_error(parser, "Expected , after APPEND variable\n");
+                return NULL;
+            }
+            get_next_token(parser);
+            ASTNode* expr = parse_expression(parser);
+            if (!expr) return NULL;
+            add_child(parser, append_node, expr);
+            return append_node;
+        }
+        
         case TOKEN_PRINT: {
             get_next_token(parser);
             ASTNode* expr = parse_expression(parser);
             if (!expr) return NULL;
             
-            ASTNode* print_node = create_node(NODE_PRINT, NULL);
-            add_child(print_node, expr);
+            ASTNode* print_node = create_node(parser, NODE_PRINT, NULL);
+            add_child(parser, print_node, expr);
             return print_node;
         }
         
+        case TOKEN_FOR:
+            return parse_for(parser, NODE_FOR);
+        
+        case TOKEN_IF:
+            return parse_if(parser);
+        
+        case TOKEN_WHILE:
+            return parse_while(parser);
+        
+        case TOKEN_FUNCTION:
+            return parse_function(parser);
+        
+        case TOKEN_YIELD: {
+            ASTNode* yield_node = create_node(parser, NODE_YIELD, NULL);
+            yield_node->line = parser->current_token->line;
+            get_next_token(parser);
+            ASTNode* expr = parse_expression(parser);
+            if (!expr) return NULL;
+            add_child(parser, yield_node, expr);
+            return yield_node;
+        }
+        
+        case TOKEN_RETURN: {
+            ASTNode* return_node = create_node(parser, NODE_RETURN, NULL);
+            return_node->line = parser->current_token->line;
+            get_next_token(parser);
+            ASTNode* expr = parse_expression(parser);
+            if (!expr) return NULL;
+            add_child(parser, return_node, expr);
+            return return_node;
+        }
+        
+        case TOKEN_PARALLEL:
+            get_next_token(parser);
+            if (parser->current_token->type != TOKEN_FOR) {
+                parser_error(parser, "Expected FOR after PARALLEL\n");
+                return NULL;
+            }
+            return parse_for(parser, NODE_PARALLEL_FOR);
+        
         case TOKEN_EOF:
-            printf("DEBUG: Reached end of file\n");
+            trace(parser, "DEBUG: Reached end of file\n");
             return NULL;
             
         default:
-            printf("ERROR: Unknown statement type: %d\n", parser->current_token->type);
+            parser_error(parser, "Unknown statement type: %d\n", parser->current_token->type);
             return NULL;
     }
 }
@@ -158,25 +913,79 @@ Parser* parser_create(Lexer* lexer) {
     Parser* parser = malloc(sizeof(Parser));
     parser->lexer = lexer;
     parser->current_token = lexer_next_token(parser->lexer);
-    debug_parser = parser;
-    printf("Parser created, first token: type=%d\n", parser->current_token->type);
+    parser->spent = NULL;
+    parser->spent_count = 0;
+    parser->spent_capacity = 0;
+    parser->path = NULL;
+    parser->includes = NULL;
+    parser->owns_includes = false;
+    parser->failed = false;
+    parser->trace = lexer->trace;
+    parser->errors = stdout;
+    trace(parser, "Parser created, first token: type=%d\n", parser->current_token->type);
     return parser;
 }
 
+// Adds a statement to the program, splicing in the statements of an
+// INCLUDE in its place
+static void add_statement(Parser* parser, ASTNode* root, ASTNode* statement) {
+    if (statement->type != NODE_INCLUDE) {
+        add_child(parser, root, statement);
+        return;
+    }
+    for (int i = 0; i < statement->children_count; i++) {
+        add_statement(parser, root, statement->children[i]);
+    }
+    free(statement->children);
+    free(statement->value);
+    free(statement);
+}
+
 ASTNode* parser_parse(Parser* parser) {
-    ASTNode* root = create_node(NODE_PROGRAM, NULL);
-    printf("Starting program parse\n");
+    ASTNode* root = create_node(parser, NODE_PROGRAM, NULL);
+    trace(parser, "Starting program parse\n");
     
     while (parser->current_token->type != TOKEN_EOF) {
-        ASTNode* statement = parse_statement(parser);
+        ASTNode* statement = parser_next_statement(parser);
         if (!statement) {
-            printf("Failed to parse statement, stopping\n");
+            trace(parser, "Failed to parse statement, stopping\n");
             break;
         }
-        add_child(root, statement);
+        add_statement(parser, root, statement);
     }
     
-    printf("Completed program parse\n");
+    trace(parser, "Completed program parse\n");
+    return root;
+}
+
+static ASTNode* next_statement(Parser* parser) {
+    free_spent_tokens(parser);
+    if (parser->current_token->type == TOKEN_EOF) return NULL;
+    ASTNode* statement = parse_statement(parser);
+    if (!statement) parser->failed = true;
+    return statement;
+}
+
+ASTNode* parser_next_statement(Parser* parser) {
+    ASTNode* statement = next_statement(parser);
+    if (statement && statement->type == NODE_INCLUDE && !parser_include(parser, statement)) {
+        ast_destroy(statement);
+        parser->failed = true;
+        return NULL;
+    }
+    return statement;
+}
+
+ASTNode* parser_parse_module(Parser* parser) {
+    ASTNode* root = create_node(parser, NODE_PROGRAM, NULL);
+    ASTNode* statement;
+    while ((statement = next_statement(parser))) {
+        add_child(parser, root, statement);
+    }
+    if (parser->failed) {
+        ast_destroy(root);
+        return NULL;
+    }
     return root;
 }
 
@@ -192,7 +1001,20 @@ void ast_destroy(ASTNode* node) {
     free(node);
 }
 
+void include_set_destroy(IncludeSet* includes) {
+    if (!includes) return;
+    for (int i = 0; i < includes->count; i++) {
+        free(includes->paths[i]);
+    }
+    free(includes->paths);
+    free(includes);
+}
+
 void parser_destroy(Parser* parser) {
+    free_spent_tokens(parser);
+    free(parser->spent);
+    free_token(parser->current_token);
+    if (parser->owns_includes) include_set_destroy(parser->includes);
     free(parser);
 }
 
@@ -0,0 +1,276 @@
+/*
+ * Compile server for IWBC
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * iwbc --server SOCKET keeps compilers running so a build of many small
+ * programs pays for process startup, loading LLVM and setting up the
+ * target once instead of once per program. The server warms up with an
+ * empty compile and then forks the workers, which all accept on the
+ * same socket and inherit its initialized targets and target machine.
+ * Each worker runs one request at a time and is replaced after
+ * SERVER_WORKER_REQUESTS of them, or when it dies.
+ *
+ * A client (iwbc with IWBC_SERVER set) sends its command line together
+ * with its working directory, umask and IWBC_CACHE_DIR, and passes its
+ * stdout and stderr along as file descriptors. The worker puts those in
+ * place of its own, runs the command line as iwbc would and answers with
+ * the exit status, so everything the compile prints reaches the client
+ * as it is written. A compile runs as the user the server runs as: the
+ * socket is created accessible to that user only.
+ *
+ * Each worker has the process to itself while it serves a request, so
+ * the working directory and environment can simply be switched. LLVM
+ * contexts are still made per compile: a context only grows with every
+ * module built in it.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "generator.h"
+#include "server.h"
+
+// Requests a worker serves before a fresh one takes over
+#define SERVER_WORKER_REQUESTS 10000
+
+// Seconds a worker waits for a connected client's request
+#define SERVER_RECEIVE_TIMEOUT 10
+
+// Largest command line a worker accepts, in bytes
+#define SERVER_REQUEST_LIMIT (1024 * 1024)
+
+static volatile sig_atomic_t stopping;
+
+static void stop(int signal) {
+    (void)signal;
+    stopping = 1;
+}
+
+// Reads a request: the header arrives with the client's stdout and
+// stderr, then the strings. strings holds them back to back.
+static bool receive_request(int client, RequestHeader* header, int fds[2], char** strings) {
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    struct iovec part = { header, sizeof(*header) };
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t n;
+    do {
+        n = recvmsg(client, &message, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return false;
+
+    fds[0] = fds[1] = -1;
+    struct cmsghdr* fd_message = CMSG_FIRSTHDR(&message);
+    if (fd_message && fd_message->cmsg_level == SOL_SOCKET && fd_message->cmsg_type == SCM_RIGHTS &&
+        fd_message->cmsg_len == CMSG_LEN(2 * sizeof(int))) {
+        memcpy(fds, CMSG_DATA(fd_message), 2 * sizeof(int));
+    }
+    bool ok = fds[0] >= 0 && fds[1] >= 0 &&
+              server_read(client, (char*)header + n, sizeof(*header) - (size_t)n) &&
+              memcmp(header->magic, SERVER_MAGIC, sizeof(header->magic)) == 0 &&
+              header->string_count >= 3 && header->size > 0 && header->size <= SERVER_REQUEST_LIMIT;
+    if (ok) {
+        *strings = malloc(header->size);
+        ok = server_read(client, *strings, header->size) && (*strings)[header->size - 1] == '\0';
+        uint32_t zeros = 0;
+        for (uint32_t i = 0; ok && i < header->size; i++) {
+            if ((*strings)[i] == '\0') zeros++;
+        }
+        if (zeros != header->string_count) ok = false;
+        if (!ok) free(*strings);
+    }
+    if (!ok) {
+        if (fds[0] >= 0) close(fds[0]);
+        if (fds[1] >= 0) close(fds[1]);
+    }
+    return ok;
+}
+
+// Runs one request with the client's streams in place of the worker's
+static int run_request(const RequestHeader* header, char* strings, int fds[2], ServerCommand command) {
+    char** args = malloc(header->string_count * sizeof(char*));
+    char* s = strings;
+    for (uint32_t i = 0; i < header->string_count; i++) {
+        args[i] = s;
+        s += strlen(s) + 1;
+    }
+    const char* cwd = args[0];
+    const char* cache_dir = args[1];
+    int argc = (int)header->string_count - 2;
+    char** argv = malloc((argc + 1) * sizeof(char*));
+    memcpy(argv, args + 2, argc * sizeof(char*));
+    argv[argc] = NULL;
+
+    fflush(stdout);
+    fflush(stderr);
+    int own_out = dup(STDOUT_FILENO);
+    int own_err = dup(STDERR_FILENO);
+    dup2(fds[0], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+
+    int status;
+    if (chdir(cwd) != 0) {
+        fprintf(stderr, "Error: Compile server could not enter %s\n", cwd);
+        status = 1;
+    } else {
+        umask((mode_t)header->umask);
+        if (cache_dir[0]) {
+            setenv("IWBC_CACHE_DIR", cache_dir, 1);
+        } else {
+            unsetenv("IWBC_CACHE_DIR");
+        }
+        status = command(argc, argv);
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    dup2(own_out, STDOUT_FILENO);
+    dup2(own_err, STDERR_FILENO);
+    close(own_out);
+    close(own_err);
+    free(argv);
+    free(args);
+    return status;
+}
+
+static void serve(int listener, ServerCommand command) {
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    // A client that goes away must not take the worker with it
+    signal(SIGPIPE, SIG_IGN);
+    for (int served = 0; served < SERVER_WORKER_REQUESTS;) {
+        int client = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            fprintf(stderr, "Error: Compile server could not accept: %s\n", strerror(errno));
+            _exit(1);
+        }
+        // A client that connects and sends nothing does not hold the
+        // worker for long
+        struct timeval timeout = { SERVER_RECEIVE_TIMEOUT, 0 };
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        RequestHeader header;
+        int fds[2];
+        char* strings;
+        if (receive_request(client, &header, fds, &strings)) {
+            int32_t status = run_request(&header, strings, fds, command);
+            server_send(client, &status, sizeof(status));
+            free(strings);
+            served++;
+        }
+        close(client);
+    }
+    _exit(0);
+}
+
+static pid_t start_worker(int listener, ServerCommand command) {
+    pid_t pid = fork();
+    if (pid == 0) serve(listener, command);
+    if (pid < 0) fprintf(stderr, "Error: Compile server could not start a worker: %s\n", strerror(errno));
+    return pid;
+}
+
+// Compiles an empty program, which sets up the target and leaves a
+// target machine idle for the workers to inherit
+static void warm_up(void) {
+    generator_initialize_targets();
+    Generator* gen = generator_create("iwbasic_module");
+    ASTNode program = { NODE_PROGRAM, NULL, NULL, 0, 0, 0 };
+    generator_generate(gen, &program);
+    LLVMMemoryBufferRef object = generator_emit_object(gen, 1);
+    if (object) LLVMDisposeMemoryBuffer(object);
+    generator_destroy(gen);
+}
+
+static int listen_at(const char* path) {
+    struct sockaddr_un address;
+    if (!server_address(path, &address)) {
+        fprintf(stderr, "Error: Socket path %s is too long\n", path);
+        return -1;
+    }
+    int probe = server_connect(path);
+    if (probe >= 0) {
+        close(probe);
+        fprintf(stderr, "Error: A compile server is already listening on %s\n", path);
+        return -1;
+    }
+    // Left behind by a server that is gone
+    struct stat info;
+    if (lstat(path, &info) == 0 && S_ISSOCK(info.st_mode)) unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Could not create socket: %s\n", strerror(errno));
+        return -1;
+    }
+    mode_t mask = umask(077);
+    int bound = bind(fd, (struct sockaddr*)&address, sizeof(address));
+    umask(mask);
+    if (bound != 0 || listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Error: Could not listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int server_run(const char* path, int workers, ServerCommand command) {
+    int listener = listen_at(path);
+    if (listener < 0) return 1;
+    warm_up();
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    pid_t* pids = calloc(workers, sizeof(pid_t));
+    for (int i = 0; i < workers; i++) {
+        pids[i] = start_worker(listener, command);
+    }
+    fprintf(stderr, "iwbc: serving on %s with %d worker(s)\n", path, workers);
+    while (!stopping) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < workers; i++) {
+            if (pids[i] != pid) continue;
+            if (WIFSIGNALED(status)) {
+                fprintf(stderr, "iwbc: worker %d stopped by signal %d, starting another\n",
+                        (int)pid, WTERMSIG(status));
+            }
+            pids[i] = stopping ? 0 : start_worker(listener, command);
+        }
+    }
+
+    for (int i = 0; i < workers; i++) {
+        if (pids[i] > 0) kill(pids[i], SIGTERM);
+    }
+    while (waitpid(-1, NULL, 0) > 0 || errno == EINTR) {
+    }
+    close(listener);
+    unlink(path);
+    free(pids);
+    return 0;
+}
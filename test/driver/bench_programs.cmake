@@ -0,0 +1,36 @@
+# iwbc_bench's synthetic programs are repeatable for a seed, compile
+# without warnings and run the same batch and streamed, and the bench
+# times a program it is given
+include(${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+foreach(shape "1;4;8;20" "7;5;3;60" "12;1;16;0")
+    list(GET shape 0 seed)
+    list(GET shape 1 depth)
+    list(GET shape 2 length)
+    list(GET shape 3 strings)
+    set(name synthetic${seed})
+    foreach(copy ${name} again)
+        execute_process(COMMAND ${BENCH} --statements 150 --depth ${depth} --ident-length ${length}
+                                --strings ${strings} --seed ${seed} --write ${work}/${copy}.iwb
+                        RESULT_VARIABLE status ERROR_VARIABLE errors)
+        if(NOT status EQUAL 0)
+            message(FATAL_ERROR "${test_name}: iwbc_bench --write failed:\n${errors}")
+        endif()
+    endforeach()
+    file(READ ${work}/${name}.iwb first)
+    file(READ ${work}/again.iwb second)
+    expect_equal("program for seed ${seed} written twice" "${second}" "${first}")
+
+    run_iwbc(errors -c ${name}.iwb ${name}.o)
+    expect_equal("diagnostics for seed ${seed}" "${errors}" "")
+    link_and_run(${name}.o batch)
+    run_iwbc(errors -c --stream ${name}.iwb ${name}.o)
+    link_and_run(${name}.o streamed)
+    expect_equal("streamed output for seed ${seed}" "${streamed}" "${batch}")
+endforeach()
+
+execute_process(COMMAND ${BENCH} --runs 1 synthetic1.iwb WORKING_DIRECTORY ${work}
+                RESULT_VARIABLE status OUTPUT_VARIABLE report ERROR_VARIABLE errors)
+if(NOT status EQUAL 0 OR NOT report MATCHES "\n  end to end +[0-9.]+")
+    message(FATAL_ERROR "${test_name}: iwbc_bench synthetic1.iwb failed:\n${report}${errors}")
+endif()
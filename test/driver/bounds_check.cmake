@@ -0,0 +1,54 @@
+# Subscripts out of range end the program with an error, whether they
+# are checked per access or once before a loop; --no-bounds-check leaves
+# no checks in the object
+include(${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+# Compiles and links name.iwb with the given options and runs it, which
+# must fail; what it printed goes to the variable named by out
+function(run_failing name out)
+    run_iwbc(errors -c ${ARGN} ${name}.iwb ${name}.o)
+    execute_process(COMMAND ${CC} -o ${work}/${name} ${work}/${name}.o ${RUNTIME} -lpthread -ldl -lm
+                    RESULT_VARIABLE status ERROR_VARIABLE errors)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "${test_name}: linking ${name}.o failed:\n${errors}")
+    endif()
+    execute_process(COMMAND ${work}/${name} WORKING_DIRECTORY ${work}
+                    RESULT_VARIABLE status OUTPUT_VARIABLE output ERROR_VARIABLE errors TIMEOUT 60)
+    if(status EQUAL 0)
+        message(FATAL_ERROR "${test_name}: ${name} ran past an out-of-range subscript:\n${output}")
+    endif()
+    set(${out} "${output}${errors}" PARENT_SCOPE)
+endfunction()
+
+# The subscript is not linear in i, so each access is checked
+file(WRITE ${work}/each.iwb "DIM a[5]
+LET total = 0
+FOR i = 1 TO 6
+    LET k = i * i - i * i + i
+    LET a[k - 1] = i
+    LET total = total + i
+    PRINT total
+NEXT i
+")
+run_failing(each output)
+expect_equal("checked per access" "${output}"
+             "1\n3\n6\n10\n15\nRuntime error: array index out of bounds at line 5\n")
+
+# The subscript is linear in i, so one check before the loop, reported
+# at the FOR, fails before any iteration runs
+file(WRITE ${work}/hoisted.iwb "DIM a[5]
+PRINT 1
+FOR i = 0 TO 5
+    PRINT i
+    LET a[i] = i
+NEXT i
+")
+run_failing(hoisted output)
+expect_equal("checked before the loop" "${output}"
+             "1\nRuntime error: array index out of bounds at line 3\n")
+
+run_iwbc(errors -c --no-bounds-check each.iwb unchecked.o)
+file(STRINGS ${work}/unchecked.o message REGEX "out of bounds")
+if(message)
+    message(FATAL_ERROR "${test_name}: --no-bounds-check left a bounds check in the object")
+endif()
@@ -0,0 +1,57 @@
+# --cache-dir: a second identical compile is a hit with the same output;
+# editing the program or a file it INCLUDEs, or changing options, is not
+include(${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+file(WRITE ${work}/prog.iwb "INCLUDE \"lib.iwb\"\nPRINT twice(21)\n")
+file(WRITE ${work}/lib.iwb "FUNCTION twice(n)\n    RETURN n * 2\nEND\n")
+
+# Compiles prog.iwb with the cache and checks whether it was a hit
+function(compile_cached expect_hit)
+    run_iwbc(report -c --cache-dir cache --time-report=json ${ARGN} prog.iwb prog.o)
+    if(report MATCHES "\"cached\":true")
+        set(hit TRUE)
+    else()
+        set(hit FALSE)
+    endif()
+    if(NOT hit STREQUAL expect_hit)
+        message(FATAL_ERROR "${test_name}: expected cached to be ${expect_hit} (${ARGN}):\n${report}")
+    endif()
+endfunction()
+
+compile_cached(FALSE)
+file(READ ${work}/prog.o first HEX)
+link_and_run(prog.o output)
+expect_equal("first compile" "${output}" "42\n")
+
+compile_cached(TRUE)
+file(READ ${work}/prog.o second HEX)
+expect_equal("object from the cache" "${second}" "${first}")
+
+compile_cached(FALSE --no-bounds-check)
+compile_cached(TRUE --no-bounds-check)
+
+file(WRITE ${work}/lib.iwb "FUNCTION twice(n)\n    RETURN n * 2 + 1\nEND\n")
+compile_cached(FALSE)
+link_and_run(prog.o output)
+expect_equal("after editing lib.iwb" "${output}" "43\n")
+
+file(APPEND ${work}/prog.iwb "PRINT twice(1)\n")
+compile_cached(FALSE)
+compile_cached(TRUE)
+link_and_run(prog.o output)
+expect_equal("after editing prog.iwb" "${output}" "43\n3\n")
+
+# The same program in another directory INCLUDEs that directory's lib.iwb
+foreach(dir a b)
+    file(MAKE_DIRECTORY ${work}/${dir})
+    file(WRITE ${work}/${dir}/main.iwb "INCLUDE \"lib.iwb\"\nPRINT f(1)\n")
+endforeach()
+file(WRITE ${work}/a/lib.iwb "FUNCTION f(x)\n    RETURN x + 100\nEND\n")
+file(WRITE ${work}/b/lib.iwb "FUNCTION f(x)\n    RETURN x + 200\nEND\n")
+foreach(dir a b)
+    run_iwbc(errors -c --cache-dir cache ${dir}/main.iwb ${dir}/main.o)
+endforeach()
+link_and_run(a/main.o output)
+expect_equal("a/main.iwb" "${output}" "101\n")
+link_and_run(b/main.o output)
+expect_equal("b/main.iwb from the same cache" "${output}" "201\n")
@@ -0,0 +1,29 @@
+# -c --codegen-threads N: several partitions come out as an ar archive
+# that links and runs like the single object
+include(${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+file(WRITE ${work}/parts.iwb "FUNCTION square(n)
+    RETURN n * n
+END
+FUNCTION cube(n)
+    RETURN n * square(n)
+END
+FUNCTION sum_to(n)
+    LET total = 0
+    FOR i = 1 TO n
+        LET total = total + cube(i)
+    NEXT
+    RETURN total
+END
+PRINT square(12)
+PRINT sum_to(20)
+")
+
+run_iwbc(errors -c parts.iwb single.o)
+run_iwbc(errors -c --codegen-threads 4 parts.iwb split.o)
+file(READ ${work}/split.o magic LIMIT 8)
+expect_equal("start of split.o" "${magic}" "!<arch>\n")
+link_and_run(single.o single)
+link_and_run(split.o split)
+expect_equal("output of split.o" "${split}" "${single}")
+expect_equal("output of single.o" "${single}" "144\n44100\n")
@@ -0,0 +1,43 @@
+# Helpers the driver tests (test/driver/*.cmake) share
+#
+# Each test runs as cmake -P with IWBC, BENCH (iwbc_bench), RUNTIME, CC
+# and WORK set, in a fresh directory ${work} of its own.
+
+get_filename_component(test_name ${CMAKE_SCRIPT_MODE_FILE} NAME_WE)
+set(work ${WORK}/${test_name})
+file(REMOVE_RECURSE ${work})
+file(MAKE_DIRECTORY ${work})
+
+# Runs iwbc with the remaining arguments in ${work}; it must succeed.
+# Its standard error goes to the variable named by out.
+function(run_iwbc out)
+    execute_process(COMMAND ${IWBC} ${ARGN} WORKING_DIRECTORY ${work}
+                    RESULT_VARIABLE status OUTPUT_QUIET ERROR_VARIABLE errors TIMEOUT 120)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "${test_name}: iwbc ${ARGN} failed:\n${errors}")
+    endif()
+    set(${out} "${errors}" PARENT_SCOPE)
+endfunction()
+
+# Links object with the runtime, runs it in ${work} and leaves what it
+# printed in the variable named by out
+function(link_and_run object out)
+    get_filename_component(program ${object} NAME_WE)
+    execute_process(COMMAND ${CC} -o ${work}/${program} ${work}/${object} ${RUNTIME} -lpthread -ldl -lm
+                    RESULT_VARIABLE status ERROR_VARIABLE errors)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "${test_name}: linking ${object} failed:\n${errors}")
+    endif()
+    execute_process(COMMAND ${work}/${program} WORKING_DIRECTORY ${work}
+                    RESULT_VARIABLE status OUTPUT_VARIABLE output ERROR_VARIABLE errors TIMEOUT 60)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "${test_name}: ${program} exited with ${status}:\n${output}${errors}")
+    endif()
+    set(${out} "${output}" PARENT_SCOPE)
+endfunction()
+
+function(expect_equal what actual expected)
+    if(NOT "${actual}" STREQUAL "${expected}")
+        message(FATAL_ERROR "${test_name}: ${what}: expected\n${expected}\ngot\n${actual}")
+    endif()
+endfunction()
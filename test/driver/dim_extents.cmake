@@ -0,0 +1,43 @@
+# DIM extents: constant ones below 1 or above INT32_MAX fail the compile,
+# and run-time ones below 1, or too large to allocate, end the program
+# with the line of the DIM
+include(${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+foreach(case "zero;DIM a[0]\n;Array a needs extents from 1 to 2147483647, not 0, at line 1"
+             "wide;PRINT 1\nDIM a[3000000000]\n;Array a needs extents from 1 to 2147483647, not 3000000000, at line 2"
+             "huge;DIM a[2000000000, 2000000000, 4]\n;Array a is too large at line 1")
+    list(GET case 0 name)
+    list(GET case 1 source)
+    list(GET case 2 expected)
+    string(REPLACE "\\n" "\n" source "${source}")
+    file(WRITE ${work}/${name}.iwb "${source}")
+    execute_process(COMMAND ${IWBC} -c ${name}.iwb ${name}.o WORKING_DIRECTORY ${work}
+                    RESULT_VARIABLE status OUTPUT_QUIET ERROR_VARIABLE errors)
+    string(FIND "${errors}" "Error: ${expected}" at)
+    if(status EQUAL 0 OR at EQUAL -1)
+        message(FATAL_ERROR "${test_name}: ${name}.iwb: expected \"${expected}\", got:\n${errors}")
+    endif()
+endforeach()
+
+foreach(case "negative;LET n = 0 - 5\nDIM a[n]\nLET a[3] = 3\nPRINT a[3]\n;DIM with an extent of -5 at line 2"
+             "second;LET n = 4\nDIM a[n, n - 4]\n;DIM with an extent of 0 at line 2"
+             "overflow;LET n = 2000000000\nDIM a[n, n, 4]\n;DIM of an array too large for memory at line 2"
+             "memory;LET n = 1000000000\nDIM a[n, n]\n;out of memory for DIM at line 2")
+    list(GET case 0 name)
+    list(GET case 1 source)
+    list(GET case 2 expected)
+    string(REPLACE "\\n" "\n" source "${source}")
+    file(WRITE ${work}/${name}.iwb "${source}")
+    run_iwbc(errors -c ${name}.iwb ${name}.o)
+    execute_process(COMMAND ${CC} -o ${work}/${name} ${work}/${name}.o ${RUNTIME} -lpthread -ldl -lm
+                    RESULT_VARIABLE status ERROR_VARIABLE errors)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "${test_name}: linking ${name}.o failed:\n${errors}")
+    endif()
+    execute_process(COMMAND ${work}/${name} WORKING_DIRECTORY ${work}
+                    RESULT_VARIABLE status OUTPUT_VARIABLE output ERROR_VARIABLE errors TIMEOUT 60)
+    if(status EQUAL 0 OR NOT errors STREQUAL "Runtime error: ${expected}\n" OR NOT output STREQUAL "")
+        message(FATAL_ERROR "${test_name}: ${name}: expected \"${expected}\" and no output, got "
+                "status ${status}:\n${output}${errors}")
+    endif()
+endforeach()
@@ -0,0 +1,32 @@
+# A program with errors makes iwbc fail and write nothing, and removes
+# the output an earlier compile left
+include(${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+# Fine as a whole program; under --stream the FUNCTION is emitted before
+# the DICT it uses has been seen
+file(WRITE ${work}/late_dict.iwb "FUNCTION total(n)
+    RETURN d[n]
+END
+DICT d
+LET d[3] = 7
+PRINT total(3)
+")
+
+run_iwbc(errors -c late_dict.iwb late_dict.o)
+link_and_run(late_dict.o output)
+expect_equal("output of late_dict" "${output}" "7\n")
+
+foreach(flags "--stream" "-c;--stream")
+    execute_process(COMMAND ${IWBC} ${flags} late_dict.iwb late_dict.o WORKING_DIRECTORY ${work}
+                    RESULT_VARIABLE status OUTPUT_QUIET ERROR_VARIABLE errors)
+    if(status EQUAL 0)
+        message(FATAL_ERROR "${test_name}: iwbc ${flags} compiled late_dict.iwb:\n${errors}")
+    endif()
+    string(FIND "${errors}" "Array d used before DIM" at)
+    if(at EQUAL -1)
+        message(FATAL_ERROR "${test_name}: iwbc ${flags} failed without the error:\n${errors}")
+    endif()
+    if(EXISTS ${work}/late_dict.o)
+        message(FATAL_ERROR "${test_name}: iwbc ${flags} left late_dict.o behind")
+    endif()
+endforeach()
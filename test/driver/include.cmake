@@ -0,0 +1,38 @@
+# INCLUDE: each file is read in once however often it is included, its
+# parse is cached in file.iwb.ast, and editing a file (directly or
+# through a nested INCLUDE) invalidates that cache
+include(${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+file(WRITE ${work}/inner.iwb "FUNCTION base()\n    RETURN 10\nEND\n")
+file(WRITE ${work}/lib.iwb "INCLUDE \"inner.iwb\"\nFUNCTION twice(n)\n    RETURN n * 2 + base()\nEND\n")
+file(WRITE ${work}/prog.iwb
+    "INCLUDE \"lib.iwb\"\nINCLUDE \"inner.iwb\"\nINCLUDE \"lib.iwb\"\nPRINT twice(1)\nPRINT base()\n")
+
+run_iwbc(errors -c prog.iwb prog.o)
+link_and_run(prog.o output)
+expect_equal("included twice" "${output}" "12\n10\n")
+foreach(module lib inner)
+    if(NOT EXISTS ${work}/${module}.iwb.ast)
+        message(FATAL_ERROR "${test_name}: no parse cache written for ${module}.iwb")
+    endif()
+endforeach()
+file(READ ${work}/lib.iwb.ast lib_ast HEX)
+
+# A second compile reads the caches and gives the same program
+run_iwbc(errors -c prog.iwb prog.o)
+link_and_run(prog.o output)
+expect_equal("from the parse cache" "${output}" "12\n10\n")
+
+file(WRITE ${work}/lib.iwb "INCLUDE \"inner.iwb\"\nFUNCTION twice(n)\n    RETURN n * 3 + base()\nEND\n")
+run_iwbc(errors -c prog.iwb prog.o)
+link_and_run(prog.o output)
+expect_equal("after editing lib.iwb" "${output}" "13\n10\n")
+file(READ ${work}/lib.iwb.ast edited_ast HEX)
+if(edited_ast STREQUAL lib_ast)
+    message(FATAL_ERROR "${test_name}: lib.iwb.ast was not rewritten after lib.iwb changed")
+endif()
+
+file(WRITE ${work}/inner.iwb "FUNCTION base()\n    RETURN 100\nEND\n")
+run_iwbc(errors -c prog.iwb prog.o)
+link_and_run(prog.o output)
+expect_equal("after editing the nested inner.iwb" "${output}" "103\n100\n")
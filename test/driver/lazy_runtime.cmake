@@ -0,0 +1,17 @@
+# A program pulls in only the runtime it uses: a PRINT-only program
+# references nothing but printf, so neither the runtime's subsystems nor
+# SQLite (loaded on the first DBCONNECT) end up in it
+include(${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+file(WRITE ${work}/hello.iwb "PRINT 5\n")
+run_iwbc(errors -c hello.iwb hello.o)
+file(STRINGS ${work}/hello.o runtime REGEX "iwbrt_")
+if(runtime)
+    message(FATAL_ERROR "${test_name}: a PRINT-only object references the runtime: ${runtime}")
+endif()
+link_and_run(hello.o output)
+expect_equal("output of hello" "${output}" "5\n")
+file(STRINGS ${work}/hello sqlite REGEX "sqlite")
+if(sqlite)
+    message(FATAL_ERROR "${test_name}: a PRINT-only program links SQLite")
+endif()
@@ -0,0 +1,31 @@
+# -j N: each input.iwb is compiled to its own input.o, and a file with
+# errors fails the run without stopping the others
+include(${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+set(names one two three four five)
+set(inputs)
+foreach(name ${names})
+    list(LENGTH inputs index)
+    math(EXPR value "(${index} + 1) * 11")
+    file(WRITE ${work}/${name}.iwb "FUNCTION value()\n    RETURN ${value}\nEND\nPRINT value()\n")
+    list(APPEND inputs ${name}.iwb)
+endforeach()
+
+run_iwbc(errors -c -j 2 ${inputs})
+set(value 11)
+foreach(name ${names})
+    link_and_run(${name}.o output)
+    expect_equal("output of ${name}" "${output}" "${value}\n")
+    math(EXPR value "${value} + 11")
+endforeach()
+
+file(REMOVE ${work}/one.o ${work}/three.o)
+file(WRITE ${work}/bad.iwb "FUNCTION name(n)\n    RETURN \"abc\"\nEND\nPRINT name(1)\n")
+execute_process(COMMAND ${IWBC} -c -j 2 one.iwb bad.iwb three.iwb WORKING_DIRECTORY ${work}
+                RESULT_VARIABLE status OUTPUT_QUIET ERROR_VARIABLE errors)
+if(status EQUAL 0)
+    message(FATAL_ERROR "${test_name}: -j succeeded with bad.iwb among the inputs")
+endif()
+if(EXISTS ${work}/bad.o OR NOT EXISTS ${work}/one.o OR NOT EXISTS ${work}/three.o)
+    message(FATAL_ERROR "${test_name}: expected one.o and three.o but no bad.o:\n${errors}")
+endif()
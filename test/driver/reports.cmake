@@ -0,0 +1,30 @@
+# --time-report and --stats print one report per compiled file, as text
+# or as one JSON line each
+include(${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+file(WRITE ${work}/prog.iwb "FUNCTION twice(n)\n    RETURN n * 2\nEND\nPRINT twice(21)\n")
+file(WRITE ${work}/other.iwb "PRINT 7\n")
+
+function(expect_match what text pattern)
+    if(NOT text MATCHES "${pattern}")
+        message(FATAL_ERROR "${test_name}: ${what} does not match ${pattern}:\n${text}")
+    endif()
+endfunction()
+
+run_iwbc(report -c --time-report --stats prog.iwb prog.o)
+expect_match("text report" "${report}" "iwbc: prog.iwb\n  phase +wall ms +cpu ms +heap KB\n")
+foreach(phase read lex parse generate optimize emit total)
+    expect_match("text report" "${report}" "\n  ${phase} +[0-9.]+ +[0-9.]+ +[-+][0-9.]+\n")
+endforeach()
+expect_match("text report" "${report}" "\n  [0-9]+ tokens, [0-9]+ AST nodes, [0-9]+ IR instructions")
+link_and_run(prog.o output)
+expect_equal("output with reports" "${output}" "42\n")
+
+run_iwbc(report -c -j 2 --time-report=json --stats=json prog.iwb other.iwb)
+string(REGEX MATCHALL "[^\n]+" lines "${report}")
+list(LENGTH lines count)
+expect_equal("JSON report lines" "${count}" "2")
+foreach(name prog other)
+    expect_match("JSON report" "${report}"
+                 "{\"file\":\"${name}.iwb\",\"cached\":false,\"phases\":{\"read\":{\"wall\":[0-9.e-]+,\"cpu\":[0-9.e-]+,\"heap\":-?[0-9]+}[^\n]*,\"tokens\":[0-9]+,\"nodes\":[0-9]+,[^\n]*\"peak_rss\":[0-9]+}")
+endforeach()
@@ -0,0 +1,74 @@
+# iwbc --server: a launcher with IWBC_SERVER set compiles through the
+# server, gets its output and exit status back, and the server cleans up
+# its socket when stopped
+include(${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+# A copy of the launcher without libiwbc.so next to it can only compile
+# through the server
+file(COPY ${IWBC} DESTINATION ${work}/client)
+get_filename_component(launcher ${IWBC} NAME)
+set(client ${work}/client/${launcher})
+execute_process(COMMAND ${client} -c missing.iwb missing.o WORKING_DIRECTORY ${work}
+                RESULT_VARIABLE status OUTPUT_QUIET ERROR_QUIET)
+if(status EQUAL 0)
+    message(FATAL_ERROR "${test_name}: the copied launcher compiled without a server")
+endif()
+
+execute_process(COMMAND sh -c "'${IWBC}' --server sock >server.log 2>&1 & echo $! >server.pid"
+                WORKING_DIRECTORY ${work})
+foreach(attempt RANGE 100)
+    if(EXISTS ${work}/sock)
+        break()
+    endif()
+    execute_process(COMMAND sleep 0.1)
+endforeach()
+file(READ ${work}/server.pid pid)
+string(STRIP "${pid}" pid)
+
+# Fails unless the variable named by condition is true, stopping the
+# server first
+function(check_served what condition)
+    if(NOT ${condition})
+        execute_process(COMMAND kill ${pid})
+        file(READ ${work}/server.log log)
+        message(FATAL_ERROR "${test_name}: ${what}\nserver log:\n${log}")
+    endif()
+endfunction()
+
+set(started FALSE)
+if(EXISTS ${work}/sock)
+    set(started TRUE)
+endif()
+check_served("the server did not start" started)
+
+file(WRITE ${work}/prog.iwb "FUNCTION twice(n)\n    RETURN n * 2\nEND\nPRINT twice(21)\n")
+execute_process(COMMAND ${CMAKE_COMMAND} -E env IWBC_SERVER=sock ${client} -c prog.iwb prog.o
+                WORKING_DIRECTORY ${work} RESULT_VARIABLE status OUTPUT_QUIET ERROR_VARIABLE errors)
+set(compiled FALSE)
+if(status EQUAL 0 AND EXISTS ${work}/prog.o)
+    set(compiled TRUE)
+endif()
+check_served("compiling through the server failed: ${errors}" compiled)
+
+file(WRITE ${work}/bad.iwb "FUNCTION name(n)\n    RETURN \"abc\"\nEND\nPRINT name(1)\n")
+execute_process(COMMAND ${CMAKE_COMMAND} -E env IWBC_SERVER=sock ${client} -c bad.iwb bad.o
+                WORKING_DIRECTORY ${work} RESULT_VARIABLE status OUTPUT_QUIET ERROR_VARIABLE errors)
+set(reported FALSE)
+if(NOT status EQUAL 0 AND errors MATCHES "Error: Cannot use a string as a number")
+    set(reported TRUE)
+endif()
+check_served("a failed compile was not reported back (status ${status}): ${errors}" reported)
+
+execute_process(COMMAND kill ${pid})
+foreach(attempt RANGE 100)
+    if(NOT EXISTS ${work}/sock)
+        break()
+    endif()
+    execute_process(COMMAND sleep 0.1)
+endforeach()
+if(EXISTS ${work}/sock)
+    message(FATAL_ERROR "${test_name}: the server left its socket behind")
+endif()
+
+link_and_run(prog.o output)
+expect_equal("compiled by the server" "${output}" "42\n")
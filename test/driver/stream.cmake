@@ -0,0 +1,26 @@
+# --stream: a call to a FUNCTION defined further down declares it, the
+# definition must then match the call, and a FUNCTION called but never
+# defined is reported at the end with no output written
+include(${CMAKE_CURRENT_LIST_DIR}/common.cmake)
+
+file(WRITE ${work}/forward.iwb "PRINT later(4)\nFUNCTION later(n)\n    RETURN n + 1\nEND\nPRINT later(9)\n")
+run_iwbc(errors -c --stream forward.iwb forward.o)
+link_and_run(forward.o output)
+expect_equal("call before the FUNCTION" "${output}" "5\n10\n")
+
+file(WRITE ${work}/mismatch.iwb "PRINT later(4)\nFUNCTION later(n, m)\n    RETURN n + m\nEND\n")
+file(WRITE ${work}/missing.iwb "PRINT 1\nPRINT nowhere(4)\nPRINT 2\n")
+foreach(case "mismatch;FUNCTION later does not match how it was called before line 2"
+             "missing;Unknown function nowhere")
+    list(GET case 0 name)
+    list(GET case 1 expected)
+    execute_process(COMMAND ${IWBC} -c --stream ${name}.iwb ${name}.o WORKING_DIRECTORY ${work}
+                    RESULT_VARIABLE status OUTPUT_QUIET ERROR_VARIABLE errors)
+    if(status EQUAL 0 OR EXISTS ${work}/${name}.o)
+        message(FATAL_ERROR "${test_name}: ${name}.iwb compiled:\n${errors}")
+    endif()
+    string(FIND "${errors}" "Error: ${expected}" at)
+    if(at EQUAL -1)
+        message(FATAL_ERROR "${test_name}: ${name}.iwb failed without \"${expected}\":\n${errors}")
+    endif()
+endforeach()
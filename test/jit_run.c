@@ -0,0 +1,60 @@
+/*
+ * JIT test host
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * Runs a BASIC program through libiwbc's JIT for test/run_program.cmake:
+ * jit_run program.iwb. The program is compiled to an object first and
+ * thrown away, so the compile that runs is the second in the process,
+ * the way every compile but the first is in iwbc -j, the compile server
+ * and any host of the library. Exits with the program's status, or 1
+ * when it does not compile.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "iwbc.h"
+
+static char* read_program(const char* filename, size_t* length) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open file %s\n", filename);
+        return NULL;
+    }
+    char* text = NULL;
+    *length = 0;
+    size_t capacity = 0;
+    for (;;) {
+        if (*length == capacity) {
+            capacity = capacity * 2 + 4096;
+            text = realloc(text, capacity);
+        }
+        size_t n = fread(text + *length, 1, capacity - *length, file);
+        if (n == 0) break;
+        *length += n;
+    }
+    fclose(file);
+    return text;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s program.iwb\n", argv[0]);
+        return 1;
+    }
+    size_t length;
+    char* source = read_program(argv[1], &length);
+    if (!source) return 1;
+    IwbcOptions options;
+    iwbc_options_init(&options);
+    options.path = argv[1];
+
+    iwbc_result_destroy(iwbc_compile(source, length, IWBC_OUTPUT_OBJECT, &options));
+    IwbcResult* result = iwbc_compile(source, length, IWBC_OUTPUT_JIT, &options);
+    fputs(iwbc_result_diagnostics(result), stderr);
+    int status = iwbc_result_ok(result) ? iwbc_result_run(result) : 1;
+    fflush(stdout);
+    iwbc_result_destroy(result);
+    free(source);
+    return status;
+}
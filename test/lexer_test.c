@@ -63,11 +63,50 @@ TEST(string_literal) {
     lexer_destroy(lexer);
 }
 
+TEST(array_tokens) {
+    const char* input = "DIM grid[3, 4] ' trailing comment";
+    TokenType expected[] = {
+        TOKEN_DIM, TOKEN_IDENTIFIER, TOKEN_LBRACKET, TOKEN_NUMBER,
+        TOKEN_COMMA, TOKEN_NUMBER, TOKEN_RBRACKET, TOKEN_EOF
+    };
+    Lexer* lexer = lexer_create(input);
+    
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        Token* token = lexer_next_token(lexer);
+        ASSERT(token->type == expected[i]);
+        free(token->value);
+        free(token);
+    }
+    
+    lexer_destroy(lexer);
+}
+
+TEST(task_tokens) {
+    const char* input = "LET h = spawn f(1) PRINT Await h";
+    TokenType expected[] = {
+        TOKEN_LET, TOKEN_IDENTIFIER, TOKEN_EQUALS, TOKEN_SPAWN, TOKEN_IDENTIFIER,
+        TOKEN_LPAREN, TOKEN_NUMBER, TOKEN_RPAREN, TOKEN_PRINT, TOKEN_AWAIT,
+        TOKEN_IDENTIFIER, TOKEN_EOF
+    };
+    Lexer* lexer = lexer_create(input);
+    
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        Token* token = lexer_next_token(lexer);
+        ASSERT(token->type == expected[i]);
+        free(token->value);
+        free(token);
+    }
+    
+    lexer_destroy(lexer);
+}
+
 int main() {
     printf("Running lexer tests...\n");
     
     test_basic_tokens();
     test_string_literal();
+    test_array_tokens();
+    test_task_tokens();
     
     printf("All tests passed!\n");
     return 0;
@@ -0,0 +1,148 @@
+/*
+ * libiwbc tests
+ * Created: October 19, 2026 by LHS
+ * Last modified: October 19, 2026 by LHS
+ *
+ * Compiles programs held in memory through libiwbc: each kind of output,
+ * errors returned as diagnostics instead of printed, a JIT-compiled
+ * program run in this process and compiles on several threads at once.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "iwbc.h"
+
+#define TEST(name) void test_##name()
+#define ASSERT(condition) do { \
+    if (!(condition)) { \
+        printf("Test failed: %s\n", #condition); \
+        exit(1); \
+    } \
+} while (0)
+
+#define COMPILE_THREADS 4
+
+static const char* program =
+    "FUNCTION twice(n)\n"
+    "    RETURN n * 2\n"
+    "END\n"
+    "PRINT twice(21)\n";
+
+// Its last iteration writes past the end of the array
+static const char* out_of_bounds =
+    "DIM a[5]\n"
+    "FOR i = 1 TO 6\n"
+    "    LET k = i * i - i * i + i\n"
+    "    LET a[k - 1] = i\n"
+    "NEXT i\n";
+
+static IwbcResult* compile(const char* source, IwbcOutput output, const IwbcOptions* options) {
+    return iwbc_compile(source, strlen(source), output, options);
+}
+
+TEST(bitcode) {
+    IwbcResult* result = compile(program, IWBC_OUTPUT_BITCODE, NULL);
+    ASSERT(iwbc_result_ok(result));
+    ASSERT(strcmp(iwbc_result_diagnostics(result), "") == 0);
+    size_t size;
+    const unsigned char* data = iwbc_result_data(result, &size);
+    ASSERT(data && size > 4);
+    ASSERT(memcmp(data, "BC\xc0\xde", 4) == 0);
+    iwbc_result_destroy(result);
+}
+
+TEST(object) {
+    IwbcResult* result = compile(out_of_bounds, IWBC_OUTPUT_OBJECT, NULL);
+    ASSERT(iwbc_result_ok(result));
+    size_t size;
+    const char* data = iwbc_result_data(result, &size);
+    ASSERT(data && size > 4);
+    ASSERT(memcmp(data, "\x7f" "ELF", 4) == 0);
+    ASSERT(memmem(data, size, "out of bounds", 13));
+    iwbc_result_destroy(result);
+
+    IwbcOptions options;
+    iwbc_options_init(&options);
+    options.bounds_check = false;
+    result = compile(out_of_bounds, IWBC_OUTPUT_OBJECT, &options);
+    ASSERT(iwbc_result_ok(result));
+    data = iwbc_result_data(result, &size);
+    ASSERT(data && !memmem(data, size, "out of bounds", 13));
+    iwbc_result_destroy(result);
+}
+
+TEST(errors) {
+    const char* generate_error = "FUNCTION name(n)\n    RETURN \"abc\"\nEND\nPRINT name(1)\n";
+    IwbcResult* result = compile(generate_error, IWBC_OUTPUT_OBJECT, NULL);
+    ASSERT(!iwbc_result_ok(result));
+    ASSERT(strstr(iwbc_result_diagnostics(result),
+                  "Error: Cannot use a string as a number or a number as a string"));
+    size_t size = 1;
+    ASSERT(iwbc_result_data(result, &size) == NULL);
+    iwbc_result_destroy(result);
+
+    result = compile("PRINT (1 +\n", IWBC_OUTPUT_JIT, NULL);
+    ASSERT(!iwbc_result_ok(result));
+    ASSERT(strcmp(iwbc_result_diagnostics(result), "") != 0);
+    ASSERT(iwbc_result_symbol(result, "main") == NULL);
+    ASSERT(iwbc_result_run(result) == -1);
+    iwbc_result_destroy(result);
+}
+
+TEST(jit) {
+    IwbcResult* result = compile(program, IWBC_OUTPUT_JIT, NULL);
+    ASSERT(iwbc_result_ok(result));
+    ASSERT(iwbc_result_symbol(result, "main") != NULL);
+    ASSERT(iwbc_result_symbol(result, "twice") == NULL);
+    ASSERT(iwbc_result_run(result) == 0);
+    fflush(stdout);
+    iwbc_result_destroy(result);
+}
+
+typedef struct {
+    IwbcResult* result;
+} CompileJob;
+
+static void* compile_job(void* argument) {
+    CompileJob* job = argument;
+    job->result = compile(program, IWBC_OUTPUT_OBJECT, NULL);
+    return NULL;
+}
+
+TEST(threads) {
+    CompileJob jobs[COMPILE_THREADS];
+    pthread_t threads[COMPILE_THREADS];
+    for (int i = 0; i < COMPILE_THREADS; i++) {
+        ASSERT(pthread_create(&threads[i], NULL, compile_job, &jobs[i]) == 0);
+    }
+    for (int i = 0; i < COMPILE_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    size_t first_size;
+    const void* first = iwbc_result_data(jobs[0].result, &first_size);
+    for (int i = 0; i < COMPILE_THREADS; i++) {
+        ASSERT(iwbc_result_ok(jobs[i].result));
+        size_t size;
+        const void* data = iwbc_result_data(jobs[i].result, &size);
+        ASSERT(size == first_size && memcmp(data, first, size) == 0);
+    }
+    for (int i = 0; i < COMPILE_THREADS; i++) {
+        iwbc_result_destroy(jobs[i].result);
+    }
+}
+
+int main() {
+    printf("Running libiwbc tests...\n");
+
+    test_bitcode();
+    test_object();
+    test_errors();
+    test_jit();
+    test_threads();
+
+    printf("All tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,86 @@
+# Runs one test program of test/programs (cmake -P, from CTest)
+#
+# The program is compiled to an object with iwbc, then again with
+# --stream unless its first line holds "test: no-stream", linked with
+# the runtime and run; it is also run through the JIT (jit_run). Each
+# run starts in a fresh directory holding test/programs/data, and what
+# it prints must equal name.expected. A program with a name.error file
+# instead must fail to compile with that message and leave no output
+# file behind.
+#
+# Takes IWBC, JIT_RUN, RUNTIME, CC, SOURCE and WORK.
+
+get_filename_component(name ${SOURCE} NAME_WE)
+get_filename_component(dir ${SOURCE} DIRECTORY)
+set(work ${WORK}/${name})
+file(REMOVE_RECURSE ${work})
+file(MAKE_DIRECTORY ${work})
+
+if(EXISTS ${dir}/${name}.error)
+    file(READ ${dir}/${name}.error expected_error)
+    string(STRIP "${expected_error}" expected_error)
+    foreach(flags "-c" "--stream")
+        # Parse errors are printed among the parser's trace on stdout
+        execute_process(COMMAND ${IWBC} ${flags} ${SOURCE} ${work}/${name}.out
+                        RESULT_VARIABLE status OUTPUT_VARIABLE trace ERROR_VARIABLE errors)
+        string(APPEND errors "${trace}")
+        if(status EQUAL 0)
+            message(FATAL_ERROR "${name} (${flags}): compiled, expected \"${expected_error}\"")
+        endif()
+        string(FIND "${errors}" "${expected_error}" at)
+        if(at EQUAL -1)
+            message(FATAL_ERROR "${name} (${flags}): expected \"${expected_error}\", got:\n${errors}")
+        endif()
+        if(EXISTS ${work}/${name}.out)
+            message(FATAL_ERROR "${name} (${flags}): the failed compile left its output behind")
+        endif()
+    endforeach()
+    return()
+endif()
+
+file(READ ${dir}/${name}.expected expected)
+file(STRINGS ${SOURCE} first_line LIMIT_COUNT 1)
+set(modes batch)
+if(NOT first_line MATCHES "test: no-stream")
+    list(APPEND modes stream)
+endif()
+list(APPEND modes jit)
+
+foreach(mode ${modes})
+    set(run ${work}/${mode})
+    file(MAKE_DIRECTORY ${run})
+    if(EXISTS ${dir}/data)
+        file(GLOB data ${dir}/data/*)
+        if(data)
+            file(COPY ${data} DESTINATION ${run})
+        endif()
+    endif()
+
+    if(mode STREQUAL "jit")
+        execute_process(COMMAND ${JIT_RUN} ${SOURCE} WORKING_DIRECTORY ${run}
+                        RESULT_VARIABLE status OUTPUT_VARIABLE output ERROR_VARIABLE errors TIMEOUT 60)
+    else()
+        set(flags -c)
+        if(mode STREQUAL "stream")
+            list(APPEND flags --stream)
+        endif()
+        execute_process(COMMAND ${IWBC} ${flags} ${SOURCE} ${run}/${name}.o
+                        RESULT_VARIABLE status OUTPUT_QUIET ERROR_VARIABLE errors)
+        if(NOT status EQUAL 0)
+            message(FATAL_ERROR "${name} (${mode}): iwbc failed:\n${errors}")
+        endif()
+        execute_process(COMMAND ${CC} -o ${run}/${name} ${run}/${name}.o ${RUNTIME} -lpthread -ldl -lm
+                        RESULT_VARIABLE status ERROR_VARIABLE errors)
+        if(NOT status EQUAL 0)
+            message(FATAL_ERROR "${name} (${mode}): link failed:\n${errors}")
+        endif()
+        execute_process(COMMAND ${run}/${name} WORKING_DIRECTORY ${run}
+                        RESULT_VARIABLE status OUTPUT_VARIABLE output ERROR_VARIABLE errors TIMEOUT 60)
+    endif()
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "${name} (${mode}): exited with ${status}:\n${output}${errors}")
+    endif()
+    if(NOT output STREQUAL expected)
+        message(FATAL_ERROR "${name} (${mode}): printed\n${output}\nexpected\n${expected}")
+    endif()
+endforeach()